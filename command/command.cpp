@@ -5,9 +5,36 @@
 #include "lib/libc.h"
 #include "kernel/mem/pmm.h"
 #include "kernel/cpu/cpuinfo.h"
+#include "kernel/cpu/cpufeature.h"
+#include "kernel/cpu/alternative.h"
 #include "kernel/drivers/rtc.h"
 #include "kernel/drivers/ethernet/virtio_net.h"
 #include "kernel/cpu/pci_ids.h"
+#include "kernel/klog.h"
+#include "kernel/tracepoint.h"
+#include "kernel/drivers/font.h"
+#include "kernel/cpu/irq.h"
+#include "kernel/cpu/isr.h"
+#include "kernel/time/clock.h"
+#include "kernel/time/clockevent.h"
+#include "kernel/time/tick.h"
+#include "kernel/time/timer_wheel.h"
+#include "kernel/time/hrtimer.h"
+#include "kernel/softirq.h"
+#include "kernel/workqueue.h"
+#include "kernel/cpu/smp.h"
+#include "kernel/sync/lockstat.h"
+#include "kernel/sync/rcu.h"
+#include "kernel/sched/sched.h"
+#include "kernel/sched/taskpool.h"
+#include "kernel/sched/async.h"
+#include "kernel/sched/idle.h"
+#include "kernel/drivers/ata/ata.h"
+#include "kernel/perf.h"
+#include "kernel/bootchart.h"
+#include "kernel/probe.h"
+#include "kernel/drivers/serial.h"
+#include "shell.h"
 
 #define COMMAND_VERSION "1.12.0-dirty+"
 
@@ -47,6 +74,26 @@ void cmd_help() {
     tty_print("  version - Show kernel and command version\n", 0xFFFFFF);
     tty_print("  nettest - Check Network Status\n", 0xFFFFFF);
     tty_print("  lspci - List PCI devices\n", 0xFFFFFF);
+    tty_print("  dmesg - Show kernel log buffer\n", 0xFFFFFF);
+    tty_print("  trace [on|off <name|all>] - List or toggle static tracepoints\n", 0xFFFFFF);
+    tty_print("  font - Show console font and glyph cache stats\n", 0xFFFFFF);
+    tty_print("  apic - Show interrupt controller, IRQ routing and vector stats\n", 0xFFFFFF);
+    tty_print("  clock - Show TSC clocksource and uptime\n", 0xFFFFFF);
+    tty_print("  tick - Show clockevent device and idle/busy interrupt rates\n", 0xFFFFFF);
+    tty_print("  timers - Show pending timers and softirq counts\n", 0xFFFFFF);
+    tty_print("  bh     - Show softirq budget overruns, ksoftirqd runs and workqueues\n", 0xFFFFFF);
+    tty_print("  smp    - Show online CPUs and their APIC IDs\n", 0xFFFFFF);
+    tty_print("  lockstat [reset] - Show lock contention statistics\n", 0xFFFFFF);
+    tty_print("  rcu [bench] - Show RCU grace periods, or compare RCU with rwlocks\n", 0xFFFFFF);
+    tty_print("  ipi [bench] - Show cross-CPU call counters, or measure IPI latency\n", 0xFFFFFF);
+    tty_print("  ps          - List kernel threads and per-CPU run queues\n", 0xFFFFFF);
+    tty_print("  tasks [bench] - Show task pool workers, or time parallel page zeroing\n", 0xFFFFFF);
+    tty_print("  async [ata]   - Show async executors and ATA IRQ stats, or time async disk reads\n", 0xFFFFFF);
+    tty_print("  idle [poll <us>] - Show idle residency and wake latency, or set the poll window\n", 0xFFFFFF);
+    tty_print("  irqstat     - Per-vector, per-CPU interrupt counts, rates and handler latency\n", 0xFFFFFF);
+    tty_print("  perf [start|stop|top|folded] - Sampling profiler: live top functions, folded stacks to serial\n", 0xFFFFFF);
+    tty_print("  bootchart [serial] - Show per-phase boot times and time to shell, or export them to serial\n", 0xFFFFFF);
+    tty_print("  probe - Show boot device probe tasks, their dependencies and timings\n", 0xFFFFFF);
 }
 
 void cmd_clear() {
@@ -91,23 +138,15 @@ void cmd_cpuinfo() {
     char brand[49];
     get_cpu_brand_string(brand);
     tty_print("\nCPU Brand: ", 0xFFFFFF); tty_print(brand, 0x00FFFF);
-    uint32_t ecx, edx;
-    get_cpu_features(&ecx, &edx);
-    tty_print("\nFeatures: ", 0xFFFFFF);
-    if (edx & (1 << 23)) tty_print(" MMX", 0x00FF00);
-    if (edx & (1 << 25)) tty_print(" SSE", 0x00FF00);
-    if (edx & (1 << 26)) tty_print(" SSE2", 0x00FF00);
-    if (ecx & (1 << 0)) tty_print(" SSE3", 0x00FF00);
-    if (ecx & (1 << 19)) tty_print(" SSE4.1", 0x00FF00);
-    if (ecx & (1 << 20)) tty_print(" SSE4.2", 0x00FF00);
-    if (ecx & (1 << 28)) tty_print(" AVX", 0x00FF00);
     tty_print("\n", 0x00FFFF);
+    cpu_features_dump();
     // 新增主频、缓存、占用率输出
     uint32_t l1, l2, l3;
     get_cpu_cache_info(&l1, &l2, &l3);
     tty_print("L1 Cache: ", 0xFFFFFF); print_dec(l1, 0x00FFFF); tty_print(" KB  ", 0xFFFFFF);
     tty_print("L2 Cache: ", 0xFFFFFF); print_dec(l2, 0x00FFFF); tty_print(" KB  ", 0xFFFFFF);
     tty_print("L3 Cache: ", 0xFFFFFF); print_dec(l3, 0x00FFFF); tty_print(" KB\n", 0xFFFFFF);
+    alternatives_dump();
 }
 
 void cmd_time() {
@@ -177,6 +216,9 @@ void cmd_memtest() {
 
 void cmd_nettest_virtio() {
     tty_print("\n--- VirtIO Network Test ---\n", 0x00FFFF);
+    // 网卡在启动探测线程里初始化，shell 可能比它先起来：先等 PCI 扫描登记网卡任务，再等网卡
+    probe_wait(probe_find("pci scan"));
+    probe_wait(probe_find("virtio-net"));
     const uint8_t* mac = virtio_net_get_mac_address();
     if (mac[0] == 0 && mac[1] == 0 && mac[2] == 0) {
         tty_print("VirtIO MAC address is not set. Aborting test.\n", 0xFF0000);
@@ -244,6 +286,357 @@ void cmd_reboot() {
     for(;;) asm("hlt"); // 如果重启失败，就永久停机
 }
 
+void cmd_dmesg() {
+    tty_print("\n", 0xFFFFFF);
+    klog_dump();
+}
+
+void cmd_trace(const char* command) {
+    const char* arg = command + 5;
+    while (*arg == ' ') arg++;
+
+    if (*arg == '\0') {
+        tty_print("\nTracepoints:\n", 0x00FFFF);
+        tracepoint_list();
+        return;
+    }
+
+    bool enable;
+    if (strncmp(arg, "on ", 3) == 0) {
+        enable = true;
+        arg += 3;
+    } else if (strncmp(arg, "off ", 4) == 0) {
+        enable = false;
+        arg += 4;
+    } else {
+        tty_print("\nUsage: trace [on|off <name|all>]\n", 0xFF6060);
+        return;
+    }
+    while (*arg == ' ') arg++;
+
+    int count = tracepoint_set(arg, enable);
+    if (count == 0) {
+        tty_print("\nNo such tracepoint: ", 0xFF6060);
+        tty_print(arg, 0xFF6060);
+        tty_print("\n", 0xFF6060);
+        return;
+    }
+    tty_print(enable ? "\nEnabled " : "\nDisabled ", 0x00FF00);
+    print_dec(count, 0x00FF00);
+    tty_print(" tracepoint(s).\n", 0x00FF00);
+}
+
+void cmd_font() {
+    font_cache_stats st;
+    font_get_stats(&st);
+
+    tty_print("\nFont: ", 0xFFFFFF);
+    tty_print(font_is_psf() ? "PSF2 module" : "built-in ASCII", 0x00FFFF);
+    tty_print(" (", 0xFFFFFF);
+    print_dec(font_width(), 0xFFFFFF);
+    tty_print("x", 0xFFFFFF);
+    print_dec(font_height(), 0xFFFFFF);
+    tty_print(")\nGlyph cache: ", 0xFFFFFF);
+    print_dec(st.used, 0x00FF00);
+    tty_print("/", 0xFFFFFF);
+    print_dec(st.capacity, 0xFFFFFF);
+    tty_print(" slots, hits=", 0xFFFFFF);
+    print_dec(st.hits, 0x00FF00);
+    tty_print(" misses=", 0xFFFFFF);
+    print_dec(st.misses, 0xFFFF00);
+    tty_print(" evictions=", 0xFFFFFF);
+    print_dec(st.evictions, 0xFF6060);
+    tty_print("\n", 0xFFFFFF);
+}
+
+void cmd_clock() {
+    const clock_info* info = clock_get_info();
+    uint64_t now = clock_monotonic_ns();
+
+    tty_print("\nClocksource: TSC ", 0xFFFFFF);
+    print_dec(info->tsc_khz / 1000, 0x00FFFF);
+    tty_print(".", 0x00FFFF);
+    char frac[8];
+    snprintf(frac, sizeof(frac), "%03llu", (unsigned long long)(info->tsc_khz % 1000));
+    tty_print(frac, 0x00FFFF);
+    tty_print(" MHz, ", 0xFFFFFF);
+    tty_print(info->invariant ? "invariant" : "not invariant", info->invariant ? 0x00FF00 : 0xFFFF00);
+    tty_print("\nCalibrated against: ", 0xFFFFFF);
+    tty_print(clock_ref_name(info->ref), 0x00FFFF);
+    tty_print("\nUptime: ", 0xFFFFFF);
+    print_dec(now / 1000000, 0x00FF00);
+    tty_print(" ms\n", 0xFFFFFF);
+}
+
+// 每秒中断数 = 次数 / 时间；时间为 0 时显示 0
+static uint64_t per_second(uint64_t count, uint64_t ns) {
+    return ns ? count * 1000000000ull / ns : 0;
+}
+
+void cmd_tick() {
+    const clock_event_device* dev = clockevents_device();
+    tick_stats st;
+    tick_get_stats(0, &st);
+
+    tty_print("\nClockevent: ", 0xFFFFFF);
+    tty_print(dev ? dev->name : "none", 0x00FFFF);
+    tty_print("  busy tick: ", 0xFFFFFF);
+    print_dec(TICK_HZ, 0x00FFFF);
+    tty_print(" Hz  jiffies: ", 0xFFFFFF);
+    print_dec(jiffies, 0x00FFFF);
+    tty_print("  events: ", 0xFFFFFF);
+    print_dec(st.events, 0x00FFFF);
+
+    // 每个 CPU 的中断数只和它自己的空闲/忙碌时间相比
+    tty_print("\nCPU   idle ms  idle irqs   irqs/s    busy ms  busy irqs   irqs/s\n", 0xFFFF00);
+    char line[96];
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (!cpu_online(cpu)) continue;
+        tick_get_stats(cpu, &st);
+        snprintf(line, sizeof(line), "%3u %9llu %10llu %8llu %10llu %10llu %8llu\n", cpu,
+                 (unsigned long long)(st.idle_ns / 1000000), (unsigned long long)st.idle_irqs,
+                 (unsigned long long)per_second(st.idle_irqs, st.idle_ns),
+                 (unsigned long long)(st.busy_ns / 1000000), (unsigned long long)st.busy_irqs,
+                 (unsigned long long)per_second(st.busy_irqs, st.busy_ns));
+        tty_print(line, 0xFFFFFF);
+    }
+}
+
+void cmd_timers() {
+    uint64_t wheel_next = timer_wheel_next_expiry();
+    uint64_t hr_next = hrtimer_next_expiry();
+    uint64_t now = clock_monotonic_ns();
+
+    tty_print("\nTimer wheel: ", 0xFFFFFF);
+    print_dec(timer_wheel_pending(), 0x00FFFF);
+    tty_print(" pending", 0xFFFFFF);
+    if (wheel_next != ~0ull) {
+        tty_print(", next in ", 0xFFFFFF);
+        print_dec(wheel_next > jiffies ? wheel_next - jiffies : 0, 0x00FF00);
+        tty_print(" jiffies", 0xFFFFFF);
+    }
+    tty_print("\nHrtimers: ", 0xFFFFFF);
+    print_dec(hrtimer_pending(), 0x00FFFF);
+    tty_print(" pending", 0xFFFFFF);
+    if (hr_next != ~0ull) {
+        tty_print(", next in ", 0xFFFFFF);
+        print_dec(hr_next > now ? (hr_next - now) / 1000 : 0, 0x00FF00);
+        tty_print(" us", 0xFFFFFF);
+    }
+    tty_print("\nSoftirqs:", 0xFFFFFF);
+    for (int nr = 0; nr < NR_SOFTIRQS; nr++) {
+        tty_print(" ", 0xFFFFFF);
+        tty_print(softirq_name((softirq_nr)nr), 0xFFFFFF);
+        tty_print("=", 0xFFFFFF);
+        print_dec(softirq_count((softirq_nr)nr), 0x00FFFF);
+    }
+    tty_print("\n", 0xFFFFFF);
+}
+
+void cmd_smp() {
+    smp_dump();
+}
+
+void cmd_lockstat(const char* command) {
+    const char* arg = command + 8;
+    while (*arg == ' ') arg++;
+    if (strcmp(arg, "reset") == 0) {
+        lockstat_reset();
+        tty_print("\nLock statistics cleared.\n", 0x00FF00);
+        return;
+    }
+    lockstat_dump();
+}
+
+void cmd_rcu(const char* command) {
+    const char* arg = command + 3;
+    while (*arg == ' ') arg++;
+    if (strcmp(arg, "bench") == 0) {
+        rcu_benchmark();
+        return;
+    }
+    rcu_dump();
+}
+
+void cmd_ipi(const char* command) {
+    const char* arg = command + 3;
+    while (*arg == ' ') arg++;
+    if (strcmp(arg, "bench") == 0) {
+        smp_call_benchmark();
+        return;
+    }
+    smp_call_dump();
+}
+
+void cmd_bh() {
+    tty_print("\nCPU  budget exhausted  ksoftirqd runs\n", 0xFFFF00);
+    char line[64];
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (!cpu_online(cpu)) continue;
+        softirq_cpu_stats st;
+        softirq_get_cpu_stats(cpu, &st);
+        snprintf(line, sizeof(line), "%3u %17llu %15llu\n", cpu,
+                 (unsigned long long)st.budget_exhausted, (unsigned long long)st.ksoftirqd_runs);
+        tty_print(line, 0xFFFFFF);
+    }
+    workqueue_dump();
+}
+
+void cmd_ps() {
+    sched_dump();
+}
+
+void cmd_tasks(const char* command) {
+    const char* arg = command + 5;
+    while (*arg == ' ') arg++;
+    if (strcmp(arg, "bench") == 0) {
+        taskpool_benchmark();
+        return;
+    }
+    taskpool_dump();
+}
+
+void cmd_async(const char* command) {
+    const char* arg = command + 5;
+    while (*arg == ' ') arg++;
+    char line[96];
+    if (strcmp(arg, "ata") == 0) {
+        // shell 线程可以睡眠，ata_read_sectors 会走执行器并等 IRQ14
+        if (!probe_wait(probe_find("ata"))) {
+            tty_print("\nasync: no ATA drive\n", 0xFF6060);
+            return;
+        }
+        static uint8_t sector[512];
+        const int rounds = 8;
+        uint64_t start = clock_monotonic_ns();
+        int ok = 0;
+        for (int i = 0; i < rounds; i++) {
+            if (ata_read_sectors(0, 0, 1, sector)) ok++;
+        }
+        uint64_t elapsed = clock_monotonic_ns() - start;
+        snprintf(line, sizeof(line), "\n%d/%d reads of LBA 0 ok, %llu us per read\n", ok, rounds,
+                 (unsigned long long)(elapsed / rounds / 1000));
+        tty_print(line, 0x00FF00);
+    }
+    async_dump();
+    ata_stats st;
+    ata_get_stats(&st);
+    tty_print("\nATA      irqs  async reads  polled reads  lost irqs  timeouts\n", 0xFFFF00);
+    snprintf(line, sizeof(line), "    %10llu %12llu %13llu %10llu %9llu\n", (unsigned long long)st.irqs,
+             (unsigned long long)st.async_reads, (unsigned long long)st.polled_reads,
+             (unsigned long long)st.lost_irqs, (unsigned long long)st.timeouts);
+    tty_print(line, 0xFFFFFF);
+}
+
+void cmd_idle(const char* command) {
+    const char* arg = command + 4;
+    while (*arg == ' ') arg++;
+    if (strncmp(arg, "poll", 4) == 0 && (arg[4] == ' ' || arg[4] == '\0')) {
+        arg += 4;
+        while (*arg == ' ') arg++;
+        if (*arg < '0' || *arg > '9') {
+            tty_print("\nUsage: idle poll <us>   (0 disables polling)\n", 0xFF6060);
+            return;
+        }
+        uint64_t us = 0;
+        while (*arg >= '0' && *arg <= '9') us = us * 10 + (uint64_t)(*arg++ - '0');
+        idle_set_poll_max_ns(us * 1000);
+    }
+    idle_dump();
+}
+
+void cmd_irqstat() {
+    isr_dump_irqstat();
+}
+
+void cmd_bootchart(const char* command) {
+    const char* arg = command + 9;
+    while (*arg == ' ') arg++;
+    if (strcmp(arg, "serial") == 0) {
+        if (!serial_present()) {
+            tty_print("\nbootchart: no serial port\n", 0xFF6060);
+            return;
+        }
+        bootchart_export();
+        tty_print("\nBoot timeline written to serial\n", 0x00FF00);
+        return;
+    } else if (*arg) {
+        tty_print("\nUsage: bootchart [serial]\n", 0xFF6060);
+        return;
+    }
+    bootchart_dump();
+}
+
+void cmd_probe() {
+    probe_dump();
+}
+
+static void perf_print_status() {
+    perf_stats st;
+    perf_get_stats(&st);
+    char line[128];
+    snprintf(line, sizeof(line), "\nProfiler %s: %llu samples, %llu dropped, %llu stacks (%llu lost)\n",
+             perf_running() ? "running" : "stopped", (unsigned long long)st.samples,
+             (unsigned long long)st.dropped, (unsigned long long)st.stacks,
+             (unsigned long long)st.stacks_lost);
+    tty_print(line, 0x00FFFF);
+}
+
+// 每 100ms 取一次样本，每秒刷新一次前 20 个函数，按任意键退出
+static void perf_top() {
+    bool started = !perf_running();
+    if (started && !perf_start()) {
+        tty_print("\nperf: out of memory\n", 0xFF6060);
+        return;
+    }
+    uint64_t next_draw = 0;
+    char c;
+    while (!shell_poll_key(&c)) {
+        perf_collect();
+        uint64_t now = clock_monotonic_ns();
+        if (now >= next_draw) {
+            next_draw = now + 1000000000ull;
+            tty_clear();
+            tty_print("perf top - press any key to stop\n", 0x00FF00);
+            perf_print_top(20);
+        }
+        msleep(100);
+    }
+    if (started) perf_stop();
+}
+
+void cmd_perf(const char* command) {
+    const char* arg = command + 4;
+    while (*arg == ' ') arg++;
+    if (strcmp(arg, "start") == 0) {
+        if (!perf_start()) {
+            tty_print("\nperf: out of memory\n", 0xFF6060);
+            return;
+        }
+    } else if (strcmp(arg, "stop") == 0) {
+        perf_stop();
+    } else if (strcmp(arg, "top") == 0) {
+        perf_top();
+    } else if (strcmp(arg, "folded") == 0) {
+        if (!serial_present()) {
+            tty_print("\nperf: no serial port\n", 0xFF6060);
+            return;
+        }
+        perf_collect();
+        uint64_t lines = perf_write_folded();
+        serial_flush();
+        char line[80];
+        snprintf(line, sizeof(line), "\n%llu folded stacks written to serial\n", (unsigned long long)lines);
+        tty_print(line, 0x00FF00);
+        return;
+    } else if (*arg) {
+        tty_print("\nUsage: perf [start|stop|top|folded]\n", 0xFF6060);
+        return;
+    }
+    perf_collect();
+    perf_print_status();
+}
+
 
 // ================== 命令分发 ==================
 
@@ -315,6 +708,46 @@ void execute_command(const char* command) {
         cmd_lspci();
     } else if (strcmp(command, "reboot") == 0) {
         cmd_reboot();
+    } else if (strcmp(command, "dmesg") == 0) {
+        cmd_dmesg();
+    } else if (strncmp(command, "trace", 5) == 0 && (command[5] == ' ' || command[5] == '\0')) {
+        cmd_trace(command);
+    } else if (strcmp(command, "font") == 0) {
+        cmd_font();
+    } else if (strcmp(command, "apic") == 0) {
+        irq_dump();
+    } else if (strcmp(command, "clock") == 0) {
+        cmd_clock();
+    } else if (strcmp(command, "tick") == 0) {
+        cmd_tick();
+    } else if (strcmp(command, "timers") == 0) {
+        cmd_timers();
+    } else if (strcmp(command, "bh") == 0) {
+        cmd_bh();
+    } else if (strcmp(command, "smp") == 0) {
+        cmd_smp();
+    } else if (strncmp(command, "lockstat", 8) == 0 && (command[8] == ' ' || command[8] == '\0')) {
+        cmd_lockstat(command);
+    } else if (strncmp(command, "rcu", 3) == 0 && (command[3] == ' ' || command[3] == '\0')) {
+        cmd_rcu(command);
+    } else if (strncmp(command, "ipi", 3) == 0 && (command[3] == ' ' || command[3] == '\0')) {
+        cmd_ipi(command);
+    } else if (strcmp(command, "ps") == 0) {
+        cmd_ps();
+    } else if (strcmp(command, "irqstat") == 0) {
+        cmd_irqstat();
+    } else if (strncmp(command, "idle", 4) == 0 && (command[4] == ' ' || command[4] == '\0')) {
+        cmd_idle(command);
+    } else if (strncmp(command, "async", 5) == 0 && (command[5] == ' ' || command[5] == '\0')) {
+        cmd_async(command);
+    } else if (strncmp(command, "tasks", 5) == 0 && (command[5] == ' ' || command[5] == '\0')) {
+        cmd_tasks(command);
+    } else if (strncmp(command, "perf", 4) == 0 && (command[4] == ' ' || command[4] == '\0')) {
+        cmd_perf(command);
+    } else if (strncmp(command, "bootchart", 9) == 0 && (command[9] == ' ' || command[9] == '\0')) {
+        cmd_bootchart(command);
+    } else if (strcmp(command, "probe") == 0) {
+        cmd_probe();
     } else {
         tty_print("\nUnknown command: ", 0xFF6060);
         tty_print(command, 0xFF6060);
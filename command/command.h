@@ -16,4 +16,23 @@ void cmd_memtest();
 void cmd_nettest_virtio();
 void cmd_version();
 void cmd_lspci();
-void cmd_reboot();
\ No newline at end of file
+void cmd_reboot();
+void cmd_dmesg();
+void cmd_trace(const char* command);
+void cmd_font();
+void cmd_clock();
+void cmd_tick();
+void cmd_timers();
+void cmd_smp();
+void cmd_lockstat(const char* command);
+void cmd_rcu(const char* command);
+void cmd_ipi(const char* command);
+void cmd_ps();
+void cmd_tasks(const char* command);
+void cmd_bh();
+void cmd_async(const char* command);
+void cmd_idle(const char* command);
+void cmd_irqstat();
+void cmd_perf(const char* command);
+void cmd_bootchart(const char* command);
+void cmd_probe();
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include "kernel/drivers/tty.h"
 #include <stdint.h>
 #include "kernel/boot.h"
+#include "kernel/sched/sched.h"
+#include "kernel/bootchart.h"
 
 //  外部依赖 
 extern void tty_print(const char* str, uint32_t color);
@@ -17,6 +19,15 @@ static int cmd_buffer_index = 0;
 //  新增：记录当前命令行的起始 X 坐标 
 static uint32_t line_start_x = 0;
 
+// 中断处理函数只把字符放进输入环，命令在 shell 线程里执行，可以睡眠、可以被抢占
+#define INPUT_RING_SIZE 256
+static char input_ring[INPUT_RING_SIZE];
+static uint32_t input_head = 0;     // 下一个读取位置 (shell 线程)
+static uint32_t input_tail = 0;     // 下一个写入位置 (中断处理函数)
+static spinlock input_lock;
+static wait_queue input_wait;
+static thread* shell_thread = nullptr;
+
 void init_shell() {
     for(int i = 0; i < CMD_BUFFER_SIZE; ++i) cmd_buffer[i] = 0;
     cmd_buffer_index = 0;
@@ -34,7 +45,7 @@ void execute_and_reset_shell() {
     init_shell(); // 准备好新的一行
 }
 
-void shell_handle_char(char c) {
+static void shell_process_char(char c) {
     if (c == '\n') { // 回车
         execute_and_reset_shell();
     } else if (c == '\b') { // 退格
@@ -49,4 +60,58 @@ void shell_handle_char(char c) {
             tty_print(str, 0xFFFFFF);
         }
     }
-}
\ No newline at end of file
+}
+
+static bool shell_pop_char(char* c) {
+    uint64_t flags = spin_lock_irqsave(&input_lock);
+    bool ok = input_head != input_tail;
+    if (ok) {
+        *c = input_ring[input_head % INPUT_RING_SIZE];
+        input_head++;
+    }
+    spin_unlock_irqrestore(&input_lock, flags);
+    return ok;
+}
+
+bool shell_poll_key(char* c) {
+    return shell_pop_char(c);
+}
+
+static void shell_main(void*) {
+    init_shell();
+    bootchart_shell_ready();
+    for (;;) {
+        char c;
+        wait_event(input_wait, shell_pop_char(&c));
+        shell_process_char(c);
+    }
+}
+
+void shell_start() {
+    spin_lock_init(&input_lock, "shell_input");
+    wait_queue_init(&input_wait, "shell_input");
+    // 固定在 CPU 0：命令里有不少只在 BSP 上才有意义的操作 (端口 I/O、设备初始化)
+    thread* t = thread_create_on(0, "shell", shell_main, nullptr);
+    if (!t) {
+        init_shell();
+        bootchart_shell_ready();
+        return;
+    }
+    __atomic_store_n(&shell_thread, t, __ATOMIC_RELEASE);
+}
+
+void shell_handle_char(char c) {
+    // shell 线程创建失败 (或还没启动) 时退回到在中断里直接处理
+    if (!__atomic_load_n(&shell_thread, __ATOMIC_ACQUIRE)) {
+        shell_process_char(c);
+        return;
+    }
+    uint64_t flags = spin_lock_irqsave(&input_lock);
+    // 环满时丢弃新字符
+    if (input_tail - input_head < INPUT_RING_SIZE) {
+        input_ring[input_tail % INPUT_RING_SIZE] = c;
+        input_tail++;
+    }
+    spin_unlock_irqrestore(&input_lock, flags);
+    wake_up(&input_wait);
+}
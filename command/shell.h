@@ -1,4 +1,8 @@
 #pragma once
 
 void init_shell();
-void shell_handle_char(char c);
\ No newline at end of file
+void shell_handle_char(char c);
+// 创建 shell 线程并打印第一个提示符
+void shell_start();
+// 在 shell 线程里执行的命令不睡眠地取一个按键 (用于“按任意键停止”)，没有输入时返回 false
+bool shell_poll_key(char* c);
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "bootchart.h"
+#include "cpu/percpu.h"
+#include "sched/sched.h"
+#include "sync/spinlock.h"
+#include "time/clock.h"
+#include "drivers/serial.h"
+#include "drivers/tty.h"
+#include "klog.h"
+#include "lib/libc.h"
+
+struct boot_span {
+    const char* name;
+    uint64_t start_tsc;
+    uint64_t end_tsc;           // 0 表示还没结束
+    thread* owner;              // kmain (包括它成为空闲线程之后) 记为空
+    uint16_t depth;
+    uint16_t cpu;
+};
+
+static boot_span spans[BOOTCHART_MAX_SPANS];
+static uint32_t nr_spans = 0;
+static spinlock spans_lock;
+static uint64_t boot_tsc = 0;       // 进入 kmain 时的 TSC
+static uint64_t shell_tsc = 0;
+
+void bootchart_init() {
+    boot_tsc = rdtsc();
+    spin_lock_init(&spans_lock, "bootchart");
+}
+
+static thread* span_owner() {
+    thread* t = current_thread();
+    return t && !t->idle ? t : nullptr;
+}
+
+uint32_t bootchart_begin(const char* name) {
+    uint64_t now = rdtsc();
+    thread* owner = span_owner();
+    uint64_t flags = spin_lock_irqsave(&spans_lock);
+    uint32_t id = BOOTCHART_NONE;
+    if (nr_spans < BOOTCHART_MAX_SPANS) {
+        id = nr_spans++;
+        boot_span* s = &spans[id];
+        s->name = name;
+        s->start_tsc = now;
+        s->end_tsc = 0;
+        s->owner = owner;
+        s->cpu = (uint16_t)smp_processor_id();
+        // 父区间是同一线程里最近开始、还没结束的区间
+        s->depth = 0;
+        for (uint32_t i = id; i-- > 0;) {
+            if (spans[i].owner == owner && !spans[i].end_tsc) {
+                s->depth = spans[i].depth + 1;
+                break;
+            }
+        }
+    }
+    spin_unlock_irqrestore(&spans_lock, flags);
+    return id;
+}
+
+void bootchart_end(uint32_t id) {
+    if (id >= BOOTCHART_MAX_SPANS) return;
+    __atomic_store_n(&spans[id].end_tsc, rdtsc(), __ATOMIC_RELEASE);
+}
+
+static uint64_t tsc_to_us(uint64_t cycles) {
+    return clock_cycles_to_ns(cycles) / 1000;
+}
+
+void bootchart_shell_ready() {
+    uint64_t expected = 0;
+    uint64_t now = rdtsc();
+    if (__atomic_compare_exchange_n(&shell_tsc, &expected, now, false, __ATOMIC_ACQ_REL,
+                                    __ATOMIC_RELAXED)) {
+        pr_info("boot: shell ready %llu ms after kernel entry",
+                (unsigned long long)(tsc_to_us(now - boot_tsc) / 1000));
+    }
+}
+
+// ==========================================================================
+// 输出
+// ==========================================================================
+
+void bootchart_dump() {
+    char line[128];
+    // QEMU 和大多数机器的 TSC 从上电开始计数，入口处的读数大致是固件加引导程序的时间
+    snprintf(line, sizeof(line), "\nFirmware + bootloader (TSC at kernel entry): %llu ms\n",
+             (unsigned long long)(tsc_to_us(boot_tsc) / 1000));
+    tty_print(line, 0x00FFFF);
+    tty_print("   start ms     dur ms  cpu  phase\n", 0xFFFF00);
+
+    uint32_t count = __atomic_load_n(&nr_spans, __ATOMIC_ACQUIRE);
+    uint64_t now = rdtsc();
+    for (uint32_t i = 0; i < count; i++) {
+        const boot_span* s = &spans[i];
+        uint64_t end = __atomic_load_n(&s->end_tsc, __ATOMIC_ACQUIRE);
+        uint64_t start_us = tsc_to_us(s->start_tsc - boot_tsc);
+        uint64_t dur_us = tsc_to_us((end ? end : now) - s->start_tsc);
+        char indent[24];
+        uint32_t depth = s->depth < 10 ? s->depth : 10;
+        memset(indent, ' ', depth * 2);
+        indent[depth * 2] = '\0';
+        snprintf(line, sizeof(line), "%7llu.%03llu %6llu.%03llu  %3u  %s%s%s\n",
+                 (unsigned long long)(start_us / 1000), (unsigned long long)(start_us % 1000),
+                 (unsigned long long)(dur_us / 1000), (unsigned long long)(dur_us % 1000), s->cpu,
+                 indent, s->name, end ? "" : " (running)");
+        // 超过 10ms 的阶段高亮
+        tty_print(line, dur_us >= 10000 ? 0xFF6060 : 0xFFFFFF);
+    }
+
+    uint64_t shell = __atomic_load_n(&shell_tsc, __ATOMIC_ACQUIRE);
+    if (shell) {
+        uint64_t us = tsc_to_us(shell - boot_tsc);
+        snprintf(line, sizeof(line), "Time to shell: %llu.%03llu ms\n", (unsigned long long)(us / 1000),
+                 (unsigned long long)(us % 1000));
+        tty_print(line, 0x00FF00);
+    }
+}
+
+void bootchart_export() {
+    char line[128];
+    int len = snprintf(line, sizeof(line), "bootchart entry %llu\n",
+                       (unsigned long long)tsc_to_us(boot_tsc));
+    serial_write(line, len);
+    uint32_t count = __atomic_load_n(&nr_spans, __ATOMIC_ACQUIRE);
+    for (uint32_t i = 0; i < count; i++) {
+        const boot_span* s = &spans[i];
+        uint64_t end = __atomic_load_n(&s->end_tsc, __ATOMIC_ACQUIRE);
+        // 还没结束的区间耗时记为 -1
+        char dur[24];
+        if (end) {
+            snprintf(dur, sizeof(dur), "%llu", (unsigned long long)tsc_to_us(end - s->start_tsc));
+        } else {
+            strcpy(dur, "-1");
+        }
+        len = snprintf(line, sizeof(line), "bootchart %llu %s %u %u %s\n",
+                       (unsigned long long)tsc_to_us(s->start_tsc - boot_tsc), dur, s->depth, s->cpu,
+                       s->name);
+        serial_write(line, len < (int)sizeof(line) ? len : (int)sizeof(line) - 1);
+    }
+    uint64_t shell = __atomic_load_n(&shell_tsc, __ATOMIC_ACQUIRE);
+    if (shell) {
+        len = snprintf(line, sizeof(line), "bootchart shell %llu\n",
+                       (unsigned long long)tsc_to_us(shell - boot_tsc));
+        serial_write(line, len);
+    }
+    serial_flush();
+}
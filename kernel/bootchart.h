@@ -0,0 +1,26 @@
+#pragma once
+#include <stdint.h>
+
+// ==========================================================================
+// 启动时间线
+// ==========================================================================
+// kmain 的每个初始化步骤用 bootchart_begin/bootchart_end 包起来，记录开始和结束的
+// TSC 读数。同一线程里尚未结束的区间是新区间的父区间，因此可以嵌套；
+// 其他线程 (设备探测任务) 记录的区间各自从第 0 层开始。
+// 时间校准之前就开始记录，显示时再换算成纳秒。
+
+#define BOOTCHART_MAX_SPANS 64
+#define BOOTCHART_NONE      UINT32_MAX
+
+// kmain 的第一步调用，记下内核入口时的 TSC
+void bootchart_init();
+// 开始一个区间，name 必须是静态字符串。区间用完时返回 BOOTCHART_NONE
+uint32_t bootchart_begin(const char* name);
+void bootchart_end(uint32_t id);
+// shell 第一次显示提示符时调用 (只记录第一次)
+void bootchart_shell_ready();
+
+// 各阶段的开始时刻、耗时和到 shell 的总时间
+void bootchart_dump();
+// 同样的数据按行写到串口："bootchart <开始 us> <耗时 us> <层> <cpu> <名字>"
+void bootchart_export();
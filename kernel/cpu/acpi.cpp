@@ -0,0 +1,153 @@
+#include "acpi.h"
+#include "lib/libc.h"
+#include "kernel/klog.h"
+
+// ACPI 表位于前 4GB 内，已经被恒等映射，物理地址可以直接访问
+
+static const acpi_sdt_header* root_sdt = nullptr;
+static bool root_is_xsdt = false;
+static madt_info madt;
+
+static bool acpi_checksum_ok(const void* table, uint32_t length) {
+    const uint8_t* p = (const uint8_t*)table;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < length; i++) sum += p[i];
+    return sum == 0;
+}
+
+// ==========================================================================
+// MADT 解析
+// ==========================================================================
+
+struct madt_table {
+    acpi_sdt_header header;
+    uint32_t lapic_address;
+    uint32_t flags;             // bit 0: PCAT_COMPAT
+} __attribute__((packed));
+
+struct madt_entry_header {
+    uint8_t type;
+    uint8_t length;
+} __attribute__((packed));
+
+static void acpi_parse_madt() {
+    memset(&madt, 0, sizeof(madt));
+    madt.lint_nmi = 0xFF;
+
+    const madt_table* table = (const madt_table*)acpi_find_table("APIC");
+    if (!table) return;
+
+    madt.lapic_address = table->lapic_address;
+    madt.pcat_compat = table->flags & 1;
+
+    const uint8_t* p = (const uint8_t*)table + sizeof(madt_table);
+    const uint8_t* end = (const uint8_t*)table + table->header.length;
+    while (p + sizeof(madt_entry_header) <= end) {
+        const madt_entry_header* e = (const madt_entry_header*)p;
+        if (e->length < 2 || p + e->length > end) break;
+
+        switch (e->type) {
+        case MADT_LAPIC: {
+            uint8_t apic_id = p[3];
+            uint32_t flags = *(const uint32_t*)(p + 4);
+            // bit 0: 已启用，bit 1: 可以上线
+            if ((flags & 3) && madt.cpu_count < ACPI_MAX_CPUS) {
+                madt.cpu_apic_ids[madt.cpu_count++] = apic_id;
+            }
+            break;
+        }
+        case MADT_X2APIC: {
+            uint32_t apic_id = *(const uint32_t*)(p + 4);
+            uint32_t flags = *(const uint32_t*)(p + 8);
+            if ((flags & 3) && madt.cpu_count < ACPI_MAX_CPUS) {
+                madt.cpu_apic_ids[madt.cpu_count++] = apic_id;
+            }
+            break;
+        }
+        case MADT_IOAPIC:
+            if (madt.ioapic_count < ACPI_MAX_IOAPICS) {
+                madt_ioapic* io = &madt.ioapics[madt.ioapic_count++];
+                io->id = p[2];
+                io->address = *(const uint32_t*)(p + 4);
+                io->gsi_base = *(const uint32_t*)(p + 8);
+            }
+            break;
+        case MADT_ISO: {
+            uint8_t source = p[3];
+            if (source < 16) {
+                madt.isa[source].present = true;
+                madt.isa[source].gsi = *(const uint32_t*)(p + 4);
+                madt.isa[source].flags = *(const uint16_t*)(p + 8);
+            }
+            break;
+        }
+        case MADT_LAPIC_NMI:
+            madt.lint_nmi = p[5];
+            break;
+        case MADT_LAPIC_ADDR:
+            madt.lapic_address = *(const uint64_t*)(p + 4);
+            break;
+        default:
+            break;
+        }
+        p += e->length;
+    }
+
+    madt.valid = madt.lapic_address != 0;
+    pr_info("acpi: MADT lapic=0x%llx cpus=%u ioapics=%u",
+            (unsigned long long)madt.lapic_address, madt.cpu_count, madt.ioapic_count);
+}
+
+// ==========================================================================
+// 公共接口
+// ==========================================================================
+
+bool acpi_init(uint64_t rsdp_address) {
+    root_sdt = nullptr;
+    if (!rsdp_address) return false;
+
+    const acpi_rsdp* rsdp = (const acpi_rsdp*)rsdp_address;
+    if (strncmp(rsdp->signature, "RSD PTR ", 8) != 0 || !acpi_checksum_ok(rsdp, 20)) {
+        pr_warn("acpi: bad RSDP at 0x%llx", (unsigned long long)rsdp_address);
+        return false;
+    }
+
+    if (rsdp->revision >= 2 && rsdp->xsdt_address) {
+        root_sdt = (const acpi_sdt_header*)rsdp->xsdt_address;
+        root_is_xsdt = true;
+    } else {
+        root_sdt = (const acpi_sdt_header*)(uint64_t)rsdp->rsdt_address;
+        root_is_xsdt = false;
+    }
+    if (!acpi_checksum_ok(root_sdt, root_sdt->length)) {
+        pr_warn("acpi: root table checksum mismatch");
+        root_sdt = nullptr;
+        return false;
+    }
+
+    acpi_parse_madt();
+    return true;
+}
+
+const acpi_sdt_header* acpi_find_table(const char* signature) {
+    if (!root_sdt) return nullptr;
+
+    uint32_t entry_size = root_is_xsdt ? 8 : 4;
+    uint32_t count = (root_sdt->length - sizeof(acpi_sdt_header)) / entry_size;
+    const uint8_t* entries = (const uint8_t*)root_sdt + sizeof(acpi_sdt_header);
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t addr = root_is_xsdt ? *(const uint64_t*)(entries + i * 8)
+                                     : *(const uint32_t*)(entries + i * 4);
+        const acpi_sdt_header* table = (const acpi_sdt_header*)addr;
+        if (table && strncmp(table->signature, signature, 4) == 0
+            && acpi_checksum_ok(table, table->length)) {
+            return table;
+        }
+    }
+    return nullptr;
+}
+
+const madt_info* acpi_get_madt() {
+    return &madt;
+}
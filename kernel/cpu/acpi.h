@@ -0,0 +1,82 @@
+#pragma once
+#include <stdint.h>
+
+// ==========================================================================
+// ACPI 表查找与 MADT 解析
+// ==========================================================================
+
+struct acpi_rsdp {
+    char signature[8];      // "RSD PTR "
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;       // 0 = ACPI 1.0 (只有 RSDT)，>= 2 时有 XSDT
+    uint32_t rsdt_address;
+    uint32_t length;
+    uint64_t xsdt_address;
+    uint8_t extended_checksum;
+    uint8_t reserved[3];
+} __attribute__((packed));
+
+struct acpi_sdt_header {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed));
+
+// MADT 条目类型
+#define MADT_LAPIC              0
+#define MADT_IOAPIC             1
+#define MADT_ISO                2   // 中断源覆盖 (ISA IRQ -> GSI)
+#define MADT_LAPIC_NMI          4
+#define MADT_LAPIC_ADDR         5
+#define MADT_X2APIC             9
+
+// MPS INTI 标志 (中断源覆盖中的 flags 字段)
+#define MPS_POLARITY_MASK       0x03
+#define MPS_POLARITY_HIGH       0x01
+#define MPS_POLARITY_LOW        0x03
+#define MPS_TRIGGER_MASK        0x0C
+#define MPS_TRIGGER_EDGE        0x04
+#define MPS_TRIGGER_LEVEL       0x0C
+
+#define ACPI_MAX_CPUS           32
+#define ACPI_MAX_IOAPICS        8
+
+struct madt_ioapic {
+    uint8_t id;
+    uint32_t address;
+    uint32_t gsi_base;
+};
+
+struct madt_isa_override {
+    bool present;
+    uint32_t gsi;
+    uint16_t flags;
+};
+
+struct madt_info {
+    bool valid;
+    bool pcat_compat;               // 系统中还存在双 8259 PIC
+    uint64_t lapic_address;
+    uint32_t cpu_count;
+    uint32_t cpu_apic_ids[ACPI_MAX_CPUS];
+    uint32_t ioapic_count;
+    madt_ioapic ioapics[ACPI_MAX_IOAPICS];
+    madt_isa_override isa[16];
+    uint8_t lint_nmi;               // 接到 NMI 的 LINT 引脚 (0/1)，0xFF 表示未声明
+};
+
+// 保存 RSDP 并定位 RSDT/XSDT，失败 (没有 ACPI) 时返回 false
+bool acpi_init(uint64_t rsdp_address);
+
+// 按 4 字节签名查找 ACPI 表 (例如 "APIC"、"HPET")，找不到返回 nullptr
+const acpi_sdt_header* acpi_find_table(const char* signature);
+
+// 解析后的 MADT，没有 MADT 时 valid 为 false
+const madt_info* acpi_get_madt();
@@ -0,0 +1,83 @@
+#include "alternative.h"
+#include "kernel/drivers/tty.h"
+#include "kernel/klog.h"
+#include "lib/libc.h"
+
+// 由 linker.ld 定义的段边界
+extern alt_instr __alt_instructions_start[];
+extern alt_instr __alt_instructions_end[];
+
+#define ALT_MAX_LEN 255
+
+static alternatives_stats stats;
+
+// 逐字节写入：被改写的可能正是 memcpy 自己的入口
+static void text_poke_early(uint8_t* dst, const uint8_t* src, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) dst[i] = src[i];
+}
+
+static bool apply_one(const alt_instr* a) {
+    if (a->replacementlen > a->instrlen) return false;
+    uint8_t insn[ALT_MAX_LEN];
+    const uint8_t* repl = (const uint8_t*)a->replacement;
+    for (uint32_t i = 0; i < a->replacementlen; i++) insn[i] = repl[i];
+    // 替换指令以 call/jmp rel32 开头时，位移是相对替换段的，搬到调用点后要重算
+    if (a->replacementlen >= 5 && (insn[0] == 0xE8 || insn[0] == 0xE9)) {
+        int32_t rel;
+        memcpy(&rel, &insn[1], 4);
+        uint64_t target = a->replacement + 5 + rel;
+        rel = (int32_t)(target - (a->instr + 5));
+        memcpy(&insn[1], &rel, 4);
+    }
+    for (uint32_t i = a->replacementlen; i < a->instrlen; i++) insn[i] = 0x90;
+    text_poke_early((uint8_t*)a->instr, insn, a->instrlen);
+    return true;
+}
+
+void apply_alternatives() {
+    uint64_t flags;
+    asm volatile("pushfq; pop %0; cli" : "=r"(flags) : : "memory");
+    for (alt_instr* a = __alt_instructions_start; a < __alt_instructions_end; a++) {
+        stats.sites++;
+        if (!cpu_has(a->feature)) continue;
+        if (apply_one(a)) {
+            stats.patched++;
+        } else {
+            pr_err("alternatives: replacement longer than site at %p", (void*)a->instr);
+        }
+    }
+    // 修改自身代码后执行一条串行化指令，丢弃可能已经预取的旧指令
+    uint32_t eax = 0, ebx, ecx = 0, edx;
+    asm volatile("cpuid" : "+a"(eax), "=b"(ebx), "+c"(ecx), "=d"(edx) : : "memory");
+    if (flags & (1 << 9)) asm volatile("sti" : : : "memory");
+    pr_info("alternatives: patched %u of %u sites", stats.patched, stats.sites);
+}
+
+void alternatives_get_stats(alternatives_stats* out) {
+    *out = stats;
+}
+
+void alternatives_dump() {
+    char line[96];
+    snprintf(line, sizeof(line), "\nAlternatives: %u of %u sites patched\n", stats.patched, stats.sites);
+    tty_print(line, 0x00FFFF);
+    // 按特性汇总，调用点的特性种类很少
+    uint16_t seen[32];
+    uint32_t nr_seen = 0;
+    for (alt_instr* a = __alt_instructions_start; a < __alt_instructions_end; a++) {
+        bool dup = false;
+        for (uint32_t i = 0; i < nr_seen && !dup; i++) dup = seen[i] == a->feature;
+        if (dup || nr_seen == 32) continue;
+        seen[nr_seen++] = a->feature;
+
+        uint32_t sites = 0;
+        for (alt_instr* b = a; b < __alt_instructions_end; b++) {
+            if (b->feature == a->feature) sites++;
+        }
+        const char* name = cpu_feature_name(a->feature);
+        bool on = cpu_has(a->feature);
+        snprintf(line, sizeof(line), "  %-14s %4u site(s)  %s\n", name ? name : "?", sites,
+                 on ? "patched" : "default");
+        tty_print(line, on ? 0x00FF00 : 0xAAAAAA);
+    }
+}
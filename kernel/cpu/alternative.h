@@ -0,0 +1,56 @@
+#pragma once
+#include <stdint.h>
+#include "cpufeature.h"
+
+// ==========================================================================
+// 指令替换 (alternatives)
+// ==========================================================================
+// 热点代码里按 CPU 特性选择实现时，不在每次调用时判断，而是在调用点原地写下
+// 默认指令序列，并在 .altinstructions 段里登记“有某个特性时换成另一段指令”。
+// 启动时 apply_alternatives 按 boot_cpu_caps 把满足条件的调用点改写一次
+// (替换指令较短时用 NOP 补齐)，之后执行的就是最合适的指令，没有任何分支。
+//
+//   asm volatile(ALTERNATIVE("lfence; rdtsc", "rdtscp", X86_FEATURE_RDTSCP)
+//                : "=a"(lo), "=d"(hi) :: "ecx");
+//
+// 替换指令在复制时只修正以 call/jmp rel32 开头的相对位移，其余指令必须与位置无关。
+// 同一调用点登记多条时按登记顺序应用，后面满足条件的覆盖前面的。
+
+struct alt_instr {
+    uint64_t instr;             // 调用点 (原指令) 地址
+    uint64_t replacement;       // 替换指令地址 (在 .altinstr_replacement 段)
+    uint16_t feature;           // X86_FEATURE_xxx
+    uint8_t instrlen;           // 调用点长度 (原指令加填充)
+    uint8_t replacementlen;
+    uint32_t pad;
+};
+
+#define __alt_stringify(x) #x
+#define alt_stringify(x) __alt_stringify(x)
+
+// GNU as 的比较运算结果为真时是 -1，原指令比替换指令短时补 (替换长度 - 原长度) 个 NOP
+#define ALTERNATIVE(oldinstr, newinstr, feature)                                        \
+    "661:\n\t" oldinstr "\n662:\n\t"                                                    \
+    ".skip -(((665f-664f)-(662b-661b)) > 0) * ((665f-664f)-(662b-661b)), 0x90\n"      \
+    "663:\n\t"                                                                          \
+    ".pushsection .altinstructions, \"a\"\n\t"                                        \
+    ".balign 8\n\t"                                                                     \
+    ".quad 661b, 664f\n\t"                                                              \
+    ".word " alt_stringify(feature) "\n\t"                                              \
+    ".byte 663b-661b, 665f-664f\n\t"                                                    \
+    ".long 0\n\t"                                                                       \
+    ".popsection\n\t"                                                                   \
+    ".pushsection .altinstr_replacement, \"ax\"\n"                                    \
+    "664:\n\t" newinstr "\n665:\n\t"                                                    \
+    ".popsection\n"
+
+struct alternatives_stats {
+    uint32_t sites;             // 登记的调用点
+    uint32_t patched;           // CPU 支持、已经改写的
+};
+
+// 改写所有调用点。只能在 BSP 上、其他 CPU 启动之前调用一次
+void apply_alternatives();
+void alternatives_get_stats(alternatives_stats* stats);
+// 按特性列出登记和已改写的调用点数
+void alternatives_dump();
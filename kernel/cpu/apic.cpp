@@ -0,0 +1,239 @@
+#include "apic.h"
+#include "acpi.h"
+#include "cpufeature.h"
+#include "ports.h"
+#include "kernel/drivers/tty.h"
+#include "kernel/klog.h"
+#include "kernel/sync/spinlock.h"
+
+volatile uint32_t* lapic_mmio = nullptr;
+bool lapic_x2apic_mode = false;
+uint64_t lapic_spurious_count = 0;
+
+#define IA32_APIC_BASE_ENABLE   (1u << 11)
+#define IA32_APIC_BASE_X2APIC   (1u << 10)
+
+
+// ==========================================================================
+// 本地 APIC
+// ==========================================================================
+
+uint32_t lapic_read(uint32_t reg) {
+    if (lapic_x2apic_mode) {
+        return (uint32_t)rdmsr(MSR_X2APIC_BASE + (reg >> 4));
+    }
+    return lapic_mmio[reg / 4];
+}
+
+void lapic_write(uint32_t reg, uint32_t value) {
+    if (lapic_x2apic_mode) {
+        wrmsr(MSR_X2APIC_BASE + (reg >> 4), value);
+    } else {
+        lapic_mmio[reg / 4] = value;
+    }
+}
+
+uint32_t lapic_id() {
+    uint32_t id = lapic_read(LAPIC_REG_ID);
+    return lapic_x2apic_mode ? id : id >> 24;
+}
+
+void lapic_send_ipi(uint32_t apic_id, uint32_t icr) {
+    if (lapic_x2apic_mode) {
+        // x2APIC 的 ICR 是一个 64 位 MSR，目的 ID 在高 32 位，一次写入即发送
+        wrmsr(MSR_X2APIC_BASE + (LAPIC_REG_ICR_LOW >> 4), ((uint64_t)apic_id << 32) | icr);
+        return;
+    }
+    // xAPIC 要写两个寄存器，中间被中断处理函数插进来发 IPI 会改掉目的 ID
+    uint64_t flags = local_irq_save();
+    lapic_write(LAPIC_REG_ICR_HIGH, apic_id << 24);
+    lapic_write(LAPIC_REG_ICR_LOW, icr);
+    while (lapic_read(LAPIC_REG_ICR_LOW) & LAPIC_ICR_PENDING) {
+        asm volatile("pause");
+    }
+    local_irq_restore(flags);
+}
+
+void lapic_send_ipi_all_but_self(uint32_t icr) {
+    if (lapic_x2apic_mode) {
+        wrmsr(MSR_X2APIC_BASE + (LAPIC_REG_ICR_LOW >> 4), icr | LAPIC_ICR_ALL_BUT_SELF);
+        return;
+    }
+    uint64_t flags = local_irq_save();
+    lapic_write(LAPIC_REG_ICR_LOW, icr | LAPIC_ICR_ALL_BUT_SELF);
+    while (lapic_read(LAPIC_REG_ICR_LOW) & LAPIC_ICR_PENDING) {
+        asm volatile("pause");
+    }
+    local_irq_restore(flags);
+}
+
+// 置位 IA32_APIC_BASE 的使能位；x2APIC 需要先处于 xAPIC 使能状态，再置位 EXTD
+static uint64_t lapic_enable(bool x2apic) {
+    uint64_t base = rdmsr(MSR_IA32_APIC_BASE);
+    base |= IA32_APIC_BASE_ENABLE;
+    if (x2apic) {
+        wrmsr(MSR_IA32_APIC_BASE, base);
+        base |= IA32_APIC_BASE_X2APIC;
+    }
+    wrmsr(MSR_IA32_APIC_BASE, base);
+    return base;
+}
+
+// 每个 CPU 各自的本地 APIC 寄存器设置
+static void lapic_setup(const madt_info* madt) {
+    // 任务优先级为 0：接收所有向量
+    lapic_write(LAPIC_REG_TPR, 0);
+    // 屏蔽定时器和 LINT0 (外部 8259 已经不用了)，LINT1 按 MADT 接 NMI
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_REG_LVT_LINT0, madt->lint_nmi == 0 ? LAPIC_LVT_NMI : LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_REG_LVT_LINT1, madt->lint_nmi == 0 ? LAPIC_LVT_MASKED : LAPIC_LVT_NMI);
+    lapic_write(LAPIC_REG_LVT_ERROR, LAPIC_LVT_MASKED);
+    // 清除之前的错误状态 (ESR 需要先写再读)
+    lapic_write(LAPIC_REG_ESR, 0);
+    lapic_read(LAPIC_REG_ESR);
+    // 软件使能，同时设置伪中断向量
+    lapic_write(LAPIC_REG_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+    lapic_eoi();
+}
+
+static bool lapic_init(const madt_info* madt) {
+    if (!cpu_has(X86_FEATURE_APIC)) return false;
+
+    lapic_x2apic_mode = cpu_has(X86_FEATURE_X2APIC);
+    uint64_t base = lapic_enable(lapic_x2apic_mode);
+
+    uint64_t phys = madt->lapic_address ? madt->lapic_address : (base & ~0xFFFull);
+    lapic_mmio = (volatile uint32_t*)phys;
+
+    lapic_setup(madt);
+    return true;
+}
+
+void apic_init_ap() {
+    // 所有 CPU 的本地 APIC 都映射在同一个物理地址，mmio 指针可以共用
+    lapic_enable(lapic_x2apic_mode);
+    lapic_setup(acpi_get_madt());
+}
+
+// ==========================================================================
+// IOAPIC
+// ==========================================================================
+
+#define IOAPIC_REG_ID           0x00
+#define IOAPIC_REG_VERSION      0x01
+#define IOAPIC_REG_REDTBL       0x10
+
+struct ioapic_state {
+    volatile uint32_t* mmio;
+    uint32_t gsi_base;
+    uint32_t gsi_count;
+};
+
+static ioapic_state ioapics[ACPI_MAX_IOAPICS];
+static uint32_t ioapic_count = 0;
+static uint32_t bsp_lapic_id = 0;
+// IOREGSEL/IOWIN 是一对寄存器，设备探测在各个 CPU 上并行打开中断时必须串行化
+static spinlock ioapic_lock;
+
+static uint32_t ioapic_read(const ioapic_state* io, uint32_t reg) {
+    io->mmio[0] = reg;          // IOREGSEL
+    return io->mmio[4];         // IOWIN (偏移 0x10)
+}
+
+static void ioapic_write(const ioapic_state* io, uint32_t reg, uint32_t value) {
+    io->mmio[0] = reg;
+    io->mmio[4] = value;
+}
+
+static ioapic_state* ioapic_for_gsi(uint32_t gsi) {
+    for (uint32_t i = 0; i < ioapic_count; i++) {
+        if (gsi >= ioapics[i].gsi_base && gsi < ioapics[i].gsi_base + ioapics[i].gsi_count) {
+            return &ioapics[i];
+        }
+    }
+    return nullptr;
+}
+
+bool ioapic_route(uint32_t gsi, uint8_t vector, uint32_t flags) {
+    ioapic_state* io = ioapic_for_gsi(gsi);
+    if (!io) return false;
+    uint32_t pin = gsi - io->gsi_base;
+    // 物理目的模式，固定投递到 BSP (调用者可能在 AP 上，不能用 lapic_id())
+    uint64_t irqflags = spin_lock_irqsave(&ioapic_lock);
+    ioapic_write(io, IOAPIC_REG_REDTBL + pin * 2 + 1, bsp_lapic_id << 24);
+    ioapic_write(io, IOAPIC_REG_REDTBL + pin * 2, vector | flags);
+    spin_unlock_irqrestore(&ioapic_lock, irqflags);
+    return true;
+}
+
+uint32_t apic_bsp_id() {
+    return bsp_lapic_id;
+}
+
+void ioapic_set_mask(uint32_t gsi, bool masked) {
+    ioapic_state* io = ioapic_for_gsi(gsi);
+    if (!io) return;
+    uint32_t reg = IOAPIC_REG_REDTBL + (gsi - io->gsi_base) * 2;
+    uint64_t flags = spin_lock_irqsave(&ioapic_lock);
+    uint32_t low = ioapic_read(io, reg);
+    low = masked ? (low | IOAPIC_MASKED) : (low & ~IOAPIC_MASKED);
+    ioapic_write(io, reg, low);
+    spin_unlock_irqrestore(&ioapic_lock, flags);
+}
+
+static void ioapic_init(const madt_info* madt) {
+    spin_lock_init(&ioapic_lock, "ioapic");
+    bsp_lapic_id = lapic_id();
+    ioapic_count = 0;
+    for (uint32_t i = 0; i < madt->ioapic_count; i++) {
+        ioapic_state* io = &ioapics[ioapic_count++];
+        io->mmio = (volatile uint32_t*)(uint64_t)madt->ioapics[i].address;
+        io->gsi_base = madt->ioapics[i].gsi_base;
+        io->gsi_count = ((ioapic_read(io, IOAPIC_REG_VERSION) >> 16) & 0xFF) + 1;
+
+        // 先把所有引脚屏蔽，之后由 irq_unmask 按需打开
+        for (uint32_t pin = 0; pin < io->gsi_count; pin++) {
+            ioapic_write(io, IOAPIC_REG_REDTBL + pin * 2, IOAPIC_MASKED);
+        }
+    }
+}
+
+// ==========================================================================
+// 初始化
+// ==========================================================================
+
+bool apic_init() {
+    const madt_info* madt = acpi_get_madt();
+    if (!madt->valid || madt->ioapic_count == 0) return false;
+    if (!lapic_init(madt)) return false;
+    ioapic_init(madt);
+
+    pr_info("apic: %s id=%u, %u IOAPIC(s)",
+            lapic_x2apic_mode ? "x2APIC" : "xAPIC", lapic_id(), ioapic_count);
+    return true;
+}
+
+void apic_dump() {
+    tty_print("\n--- APIC ---\n", 0xFFFF00);
+    tty_print("Mode: ", 0xFFFFFF);
+    tty_print(lapic_x2apic_mode ? "x2APIC" : "xAPIC", 0x00FFFF);
+    tty_print("  BSP APIC ID: ", 0xFFFFFF);
+    print_dec(lapic_id(), 0x00FFFF);
+    tty_print("  Spurious: ", 0xFFFFFF);
+    print_dec(lapic_spurious_count, 0x00FFFF);
+    tty_print("\n", 0xFFFFFF);
+
+    for (uint32_t i = 0; i < ioapic_count; i++) {
+        const ioapic_state* io = &ioapics[i];
+        for (uint32_t pin = 0; pin < io->gsi_count; pin++) {
+            uint32_t low = ioapic_read(io, IOAPIC_REG_REDTBL + pin * 2);
+            if (low & IOAPIC_MASKED) continue;
+            tty_print("  GSI ", 0xFFFFFF);
+            print_dec(io->gsi_base + pin, 0xFFFFFF);
+            tty_print(" -> vector ", 0xFFFFFF);
+            print_dec(low & 0xFF, 0x00FF00);
+            tty_print((low & IOAPIC_LEVEL) ? " level" : " edge", 0xAAAAAA);
+            tty_print((low & IOAPIC_ACTIVE_LOW) ? "/low\n" : "/high\n", 0xAAAAAA);
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <stdint.h>
+#include "msr.h"
+
+// ==========================================================================
+// 本地 APIC (xAPIC / x2APIC) 与 IOAPIC
+// ==========================================================================
+
+// 本地 APIC 寄存器偏移 (xAPIC MMIO 偏移；x2APIC 下对应 MSR 0x800 + (偏移 >> 4))
+#define LAPIC_REG_ID            0x020
+#define LAPIC_REG_VERSION       0x030
+#define LAPIC_REG_TPR           0x080
+#define LAPIC_REG_EOI           0x0B0
+#define LAPIC_REG_SVR           0x0F0
+#define LAPIC_REG_ESR           0x280
+#define LAPIC_REG_ICR_LOW       0x300
+#define LAPIC_REG_ICR_HIGH      0x310
+#define LAPIC_REG_LVT_TIMER     0x320
+#define LAPIC_REG_LVT_LINT0     0x350
+#define LAPIC_REG_LVT_LINT1     0x360
+#define LAPIC_REG_LVT_ERROR     0x370
+#define LAPIC_REG_TIMER_INIT    0x380
+#define LAPIC_REG_TIMER_CURRENT 0x390
+#define LAPIC_REG_TIMER_DIV     0x3E0
+
+#define LAPIC_SVR_ENABLE        0x100
+#define LAPIC_LVT_MASKED        0x10000
+#define LAPIC_LVT_NMI           0x400
+
+// ICR 低 32 位
+#define LAPIC_ICR_FIXED         (0u << 8)
+#define LAPIC_ICR_INIT          (5u << 8)
+#define LAPIC_ICR_STARTUP       (6u << 8)
+#define LAPIC_ICR_PENDING       (1u << 12)  // 投递状态 (仅 xAPIC)
+#define LAPIC_ICR_ASSERT        (1u << 14)
+#define LAPIC_ICR_LEVEL         (1u << 15)
+#define LAPIC_ICR_ALL_BUT_SELF  (3u << 18)  // 目的简写：除自己以外的所有 CPU
+
+#define LAPIC_SPURIOUS_VECTOR   0xFF
+#define LAPIC_TIMER_VECTOR      0xF0
+#define LAPIC_CALL_VECTOR       0xF1        // 跨 CPU 函数调用
+
+// LVT 定时器模式 (bit 18:17)
+#define LAPIC_TIMER_ONESHOT     (0u << 17)
+#define LAPIC_TIMER_PERIODIC    (1u << 17)
+#define LAPIC_TIMER_TSC_DEADLINE (2u << 17)
+
+// IOAPIC 重定向表项标志
+#define IOAPIC_ACTIVE_LOW       (1u << 13)
+#define IOAPIC_LEVEL            (1u << 15)
+#define IOAPIC_MASKED           (1u << 16)
+
+// EOI 路径上直接访问的状态，供 lapic_eoi() 内联使用
+extern volatile uint32_t* lapic_mmio;
+extern bool lapic_x2apic_mode;
+extern uint64_t lapic_spurious_count;
+
+// 根据 MADT 初始化 BSP 的本地 APIC 和所有 IOAPIC，
+// 没有 APIC 或没有 MADT 时返回 false (调用者应继续使用 8259 PIC)
+bool apic_init();
+
+// AP 上线时调用：按 BSP 选定的模式 (xAPIC/x2APIC) 使能并配置本 CPU 的本地 APIC
+void apic_init_ap();
+
+uint32_t lapic_read(uint32_t reg);
+void lapic_write(uint32_t reg, uint32_t value);
+uint32_t lapic_id();
+// BSP 的 APIC ID：设备中断 (IOAPIC 引脚、MSI/MSI-X) 都发往 BSP，不随调用者所在的 CPU 变化
+uint32_t apic_bsp_id();
+
+// 向 apic_id 发送一个处理器间中断，icr 为 ICR 低 32 位 (投递模式 | 向量)
+void lapic_send_ipi(uint32_t apic_id, uint32_t icr);
+// 用目的简写一次发给除自己以外的所有 CPU (包括没能上线的，调用者自己判断是否安全)
+void lapic_send_ipi_all_but_self(uint32_t icr);
+
+// EOI：x2APIC 下是一次 WRMSR，xAPIC 下是一次 MMIO 写
+static inline void lapic_eoi() {
+    if (lapic_x2apic_mode) {
+        wrmsr(MSR_X2APIC_BASE + (LAPIC_REG_EOI >> 4), 0);
+    } else {
+        lapic_mmio[LAPIC_REG_EOI / 4] = 0;
+    }
+}
+
+// 把 GSI 路由到指定向量 (发往 BSP)，flags 为 IOAPIC_* 组合
+bool ioapic_route(uint32_t gsi, uint8_t vector, uint32_t flags);
+void ioapic_set_mask(uint32_t gsi, bool masked);
+
+// 打印 APIC 模式和所有已启用的重定向表项
+void apic_dump();
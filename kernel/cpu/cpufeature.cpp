@@ -0,0 +1,176 @@
+#include "cpufeature.h"
+#include "msr.h"
+#include "kernel/drivers/tty.h"
+#include "kernel/klog.h"
+#include "lib/libc.h"
+
+uint32_t boot_cpu_caps[NCAPINTS];
+
+static uint32_t max_leaf = 0;
+static uint32_t max_ext_leaf = 0;
+static cpu_xsave_info xsave_info;
+
+struct feature_name {
+    uint16_t feature;
+    const char* name;
+};
+
+static const feature_name feature_names[] = {
+    { X86_FEATURE_FPU, "fpu" },             { X86_FEATURE_VME, "vme" },
+    { X86_FEATURE_DE, "de" },               { X86_FEATURE_PSE, "pse" },
+    { X86_FEATURE_TSC, "tsc" },             { X86_FEATURE_MSR, "msr" },
+    { X86_FEATURE_PAE, "pae" },             { X86_FEATURE_MCE, "mce" },
+    { X86_FEATURE_CX8, "cx8" },             { X86_FEATURE_APIC, "apic" },
+    { X86_FEATURE_SEP, "sep" },             { X86_FEATURE_MTRR, "mtrr" },
+    { X86_FEATURE_PGE, "pge" },             { X86_FEATURE_MCA, "mca" },
+    { X86_FEATURE_CMOV, "cmov" },           { X86_FEATURE_PAT, "pat" },
+    { X86_FEATURE_PSE36, "pse36" },         { X86_FEATURE_CLFLUSH, "clflush" },
+    { X86_FEATURE_MMX, "mmx" },             { X86_FEATURE_FXSR, "fxsr" },
+    { X86_FEATURE_SSE, "sse" },             { X86_FEATURE_SSE2, "sse2" },
+    { X86_FEATURE_SS, "ss" },               { X86_FEATURE_HT, "ht" },
+
+    { X86_FEATURE_SSE3, "sse3" },           { X86_FEATURE_PCLMULQDQ, "pclmulqdq" },
+    { X86_FEATURE_MONITOR, "monitor" },     { X86_FEATURE_VMX, "vmx" },
+    { X86_FEATURE_EST, "est" },             { X86_FEATURE_SSSE3, "ssse3" },
+    { X86_FEATURE_FMA, "fma" },             { X86_FEATURE_CX16, "cx16" },
+    { X86_FEATURE_PCID, "pcid" },           { X86_FEATURE_SSE4_1, "sse4_1" },
+    { X86_FEATURE_SSE4_2, "sse4_2" },       { X86_FEATURE_X2APIC, "x2apic" },
+    { X86_FEATURE_MOVBE, "movbe" },         { X86_FEATURE_POPCNT, "popcnt" },
+    { X86_FEATURE_TSC_DEADLINE, "tsc_deadline" }, { X86_FEATURE_AES, "aes" },
+    { X86_FEATURE_XSAVE, "xsave" },         { X86_FEATURE_OSXSAVE, "osxsave" },
+    { X86_FEATURE_AVX, "avx" },             { X86_FEATURE_F16C, "f16c" },
+    { X86_FEATURE_RDRAND, "rdrand" },       { X86_FEATURE_HYPERVISOR, "hypervisor" },
+
+    { X86_FEATURE_FSGSBASE, "fsgsbase" },   { X86_FEATURE_TSC_ADJUST, "tsc_adjust" },
+    { X86_FEATURE_BMI1, "bmi1" },           { X86_FEATURE_HLE, "hle" },
+    { X86_FEATURE_AVX2, "avx2" },           { X86_FEATURE_SMEP, "smep" },
+    { X86_FEATURE_BMI2, "bmi2" },           { X86_FEATURE_ERMS, "erms" },
+    { X86_FEATURE_INVPCID, "invpcid" },     { X86_FEATURE_RTM, "rtm" },
+    { X86_FEATURE_AVX512F, "avx512f" },     { X86_FEATURE_RDSEED, "rdseed" },
+    { X86_FEATURE_ADX, "adx" },             { X86_FEATURE_SMAP, "smap" },
+    { X86_FEATURE_CLFLUSHOPT, "clflushopt" }, { X86_FEATURE_CLWB, "clwb" },
+    { X86_FEATURE_SHA_NI, "sha_ni" },
+
+    { X86_FEATURE_UMIP, "umip" },           { X86_FEATURE_PKU, "pku" },
+    { X86_FEATURE_WAITPKG, "waitpkg" },     { X86_FEATURE_VAES, "vaes" },
+    { X86_FEATURE_VPCLMULQDQ, "vpclmulqdq" }, { X86_FEATURE_RDPID, "rdpid" },
+
+    { X86_FEATURE_FSRM, "fsrm" },           { X86_FEATURE_MD_CLEAR, "md_clear" },
+    { X86_FEATURE_SERIALIZE, "serialize" }, { X86_FEATURE_HYBRID_CPU, "hybrid" },
+    { X86_FEATURE_SPEC_CTRL, "spec_ctrl" }, { X86_FEATURE_ARCH_CAPS, "arch_capabilities" },
+
+    { X86_FEATURE_XSAVEOPT, "xsaveopt" },   { X86_FEATURE_XSAVEC, "xsavec" },
+    { X86_FEATURE_XGETBV1, "xgetbv1" },     { X86_FEATURE_XSAVES, "xsaves" },
+
+    { X86_FEATURE_SYSCALL, "syscall" },     { X86_FEATURE_NX, "nx" },
+    { X86_FEATURE_PDPE1GB, "pdpe1gb" },     { X86_FEATURE_RDTSCP, "rdtscp" },
+    { X86_FEATURE_LM, "lm" },
+
+    { X86_FEATURE_LAHF_LM, "lahf_lm" },     { X86_FEATURE_SVM, "svm" },
+    { X86_FEATURE_ABM, "abm" },             { X86_FEATURE_SSE4A, "sse4a" },
+    { X86_FEATURE_PREFETCHW, "prefetchw" }, { X86_FEATURE_TOPOEXT, "topoext" },
+
+    { X86_FEATURE_INVARIANT_TSC, "invariant_tsc" },
+};
+
+static const char* const word_names[NCAPINTS] = {
+    "1.EDX", "1.ECX", "7.0.EBX", "7.0.ECX", "7.0.EDX", "D.1.EAX",
+    "80000001.EDX", "80000001.ECX", "80000007.EDX",
+};
+
+void cpu_features_init() {
+    uint32_t eax, ebx, ecx, edx;
+    memset(boot_cpu_caps, 0, sizeof(boot_cpu_caps));
+
+    cpuid(0, 0, &eax, &ebx, &ecx, &edx);
+    max_leaf = eax;
+    cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+    boot_cpu_caps[CPUID_1_EDX] = edx;
+    boot_cpu_caps[CPUID_1_ECX] = ecx;
+
+    if (max_leaf >= 7) {
+        cpuid(7, 0, &eax, &ebx, &ecx, &edx);
+        boot_cpu_caps[CPUID_7_0_EBX] = ebx;
+        boot_cpu_caps[CPUID_7_0_ECX] = ecx;
+        boot_cpu_caps[CPUID_7_0_EDX] = edx;
+    }
+    if (max_leaf >= 0xD && cpu_has(X86_FEATURE_XSAVE)) {
+        cpuid(0xD, 0, &eax, &ebx, &ecx, &edx);
+        xsave_info.xcr0_supported = ((uint64_t)edx << 32) | eax;
+        xsave_info.max_size = ecx;
+        cpuid(0xD, 1, &eax, &ebx, &ecx, &edx);
+        boot_cpu_caps[CPUID_D_1_EAX] = eax;
+    }
+
+    cpuid(0x80000000, 0, &eax, &ebx, &ecx, &edx);
+    // 不支持扩展叶的 CPU 会把这里当成最大基本叶返回
+    max_ext_leaf = eax >= 0x80000000 ? eax : 0;
+    if (max_ext_leaf >= 0x80000001) {
+        cpuid(0x80000001, 0, &eax, &ebx, &ecx, &edx);
+        boot_cpu_caps[CPUID_8000_0001_EDX] = edx;
+        boot_cpu_caps[CPUID_8000_0001_ECX] = ecx;
+    }
+    if (max_ext_leaf >= 0x80000007) {
+        cpuid(0x80000007, 0, &eax, &ebx, &ecx, &edx);
+        boot_cpu_caps[CPUID_8000_0007_EDX] = edx;
+    }
+
+    pr_info("cpu: max leaf 0x%x/0x%x%s%s%s%s%s", max_leaf, max_ext_leaf,
+            cpu_has(X86_FEATURE_AVX2) ? ", avx2" : "", cpu_has(X86_FEATURE_ERMS) ? ", erms" : "",
+            cpu_has(X86_FEATURE_FSRM) ? ", fsrm" : "", cpu_has(X86_FEATURE_RDTSCP) ? ", rdtscp" : "",
+            cpu_has(X86_FEATURE_INVARIANT_TSC) ? ", invariant tsc" : "");
+}
+
+const char* cpu_feature_name(uint32_t feature) {
+    for (size_t i = 0; i < sizeof(feature_names) / sizeof(feature_names[0]); i++) {
+        if (feature_names[i].feature == feature) return feature_names[i].name;
+    }
+    return nullptr;
+}
+
+uint32_t cpu_max_leaf() {
+    return max_leaf;
+}
+
+uint32_t cpu_max_ext_leaf() {
+    return max_ext_leaf;
+}
+
+const cpu_xsave_info* cpu_get_xsave_info() {
+    return &xsave_info;
+}
+
+void cpu_features_dump() {
+    char line[96];
+    snprintf(line, sizeof(line), "\nCPUID max leaf 0x%x, max extended leaf 0x%x\n", max_leaf, max_ext_leaf);
+    tty_print(line, 0xFFFFFF);
+    for (uint32_t word = 0; word < NCAPINTS; word++) {
+        snprintf(line, sizeof(line), "%-13s", word_names[word]);
+        tty_print(line, 0xFFFF00);
+        uint32_t column = 13;
+        for (uint32_t bit = 0; bit < 32; bit++) {
+            uint32_t feature = word * 32 + bit;
+            if (!cpu_has(feature)) continue;
+            const char* name = cpu_feature_name(feature);
+            // 没有登记名字的位按编号显示
+            if (!name) {
+                snprintf(line, sizeof(line), "bit%u", bit);
+                name = line;
+            }
+            uint32_t len = (uint32_t)strlen(name) + 1;
+            if (column + len > 80) {
+                tty_print("\n             ", 0xFFFFFF);
+                column = 13;
+            }
+            tty_print(" ", 0xFFFFFF);
+            tty_print(name, 0x00FF00);
+            column += len;
+        }
+        tty_print("\n", 0xFFFFFF);
+    }
+    if (cpu_has(X86_FEATURE_XSAVE)) {
+        snprintf(line, sizeof(line), "XSAVE: components 0x%llx, area up to %u bytes\n",
+                 (unsigned long long)xsave_info.xcr0_supported, xsave_info.max_size);
+        tty_print(line, 0xFFFFFF);
+    }
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include <stdint.h>
+
+// ==========================================================================
+// CPU 特性表
+// ==========================================================================
+// 启动时在 BSP 上把各个 CPUID 特性叶读一遍，存进 boot_cpu_caps，之后各模块
+// 用 cpu_has(X86_FEATURE_xxx) 查询，不再各自执行 cpuid (虚拟机里 cpuid 会陷出，
+// 一次要上千个周期)。假定所有 CPU 的特性相同。
+// 特性编号 = 字号 * 32 + 位号，写成纯数字表达式，alternative.h 的内联汇编里
+// 也能直接使用。
+
+#define CPUID_1_EDX         0
+#define CPUID_1_ECX         1
+#define CPUID_7_0_EBX       2
+#define CPUID_7_0_ECX       3
+#define CPUID_7_0_EDX       4
+#define CPUID_D_1_EAX       5
+#define CPUID_8000_0001_EDX 6
+#define CPUID_8000_0001_ECX 7
+#define CPUID_8000_0007_EDX 8
+#define NCAPINTS            9
+
+// CPUID 1 EDX
+#define X86_FEATURE_FPU             ( 0*32 +  0)
+#define X86_FEATURE_VME             ( 0*32 +  1)
+#define X86_FEATURE_DE              ( 0*32 +  2)
+#define X86_FEATURE_PSE             ( 0*32 +  3)
+#define X86_FEATURE_TSC             ( 0*32 +  4)
+#define X86_FEATURE_MSR             ( 0*32 +  5)
+#define X86_FEATURE_PAE             ( 0*32 +  6)
+#define X86_FEATURE_MCE             ( 0*32 +  7)
+#define X86_FEATURE_CX8             ( 0*32 +  8)
+#define X86_FEATURE_APIC            ( 0*32 +  9)
+#define X86_FEATURE_SEP             ( 0*32 + 11)
+#define X86_FEATURE_MTRR            ( 0*32 + 12)
+#define X86_FEATURE_PGE             ( 0*32 + 13)
+#define X86_FEATURE_MCA             ( 0*32 + 14)
+#define X86_FEATURE_CMOV            ( 0*32 + 15)
+#define X86_FEATURE_PAT             ( 0*32 + 16)
+#define X86_FEATURE_PSE36           ( 0*32 + 17)
+#define X86_FEATURE_CLFLUSH         ( 0*32 + 19)
+#define X86_FEATURE_MMX             ( 0*32 + 23)
+#define X86_FEATURE_FXSR            ( 0*32 + 24)
+#define X86_FEATURE_SSE             ( 0*32 + 25)
+#define X86_FEATURE_SSE2            ( 0*32 + 26)
+#define X86_FEATURE_SS              ( 0*32 + 27)
+#define X86_FEATURE_HT              ( 0*32 + 28)
+
+// CPUID 1 ECX
+#define X86_FEATURE_SSE3            ( 1*32 +  0)
+#define X86_FEATURE_PCLMULQDQ       ( 1*32 +  1)
+#define X86_FEATURE_MONITOR         ( 1*32 +  3)
+#define X86_FEATURE_VMX             ( 1*32 +  5)
+#define X86_FEATURE_EST             ( 1*32 +  7)
+#define X86_FEATURE_SSSE3           ( 1*32 +  9)
+#define X86_FEATURE_FMA             ( 1*32 + 12)
+#define X86_FEATURE_CX16            ( 1*32 + 13)
+#define X86_FEATURE_PCID            ( 1*32 + 17)
+#define X86_FEATURE_SSE4_1          ( 1*32 + 19)
+#define X86_FEATURE_SSE4_2          ( 1*32 + 20)
+#define X86_FEATURE_X2APIC          ( 1*32 + 21)
+#define X86_FEATURE_MOVBE           ( 1*32 + 22)
+#define X86_FEATURE_POPCNT          ( 1*32 + 23)
+#define X86_FEATURE_TSC_DEADLINE    ( 1*32 + 24)
+#define X86_FEATURE_AES             ( 1*32 + 25)
+#define X86_FEATURE_XSAVE           ( 1*32 + 26)
+#define X86_FEATURE_OSXSAVE         ( 1*32 + 27)
+#define X86_FEATURE_AVX             ( 1*32 + 28)
+#define X86_FEATURE_F16C            ( 1*32 + 29)
+#define X86_FEATURE_RDRAND          ( 1*32 + 30)
+#define X86_FEATURE_HYPERVISOR      ( 1*32 + 31)
+
+// CPUID 7.0 EBX
+#define X86_FEATURE_FSGSBASE        ( 2*32 +  0)
+#define X86_FEATURE_TSC_ADJUST      ( 2*32 +  1)
+#define X86_FEATURE_BMI1            ( 2*32 +  3)
+#define X86_FEATURE_HLE             ( 2*32 +  4)
+#define X86_FEATURE_AVX2            ( 2*32 +  5)
+#define X86_FEATURE_SMEP            ( 2*32 +  7)
+#define X86_FEATURE_BMI2            ( 2*32 +  8)
+#define X86_FEATURE_ERMS            ( 2*32 +  9)  // rep movsb/stosb 对任意长度都快
+#define X86_FEATURE_INVPCID         ( 2*32 + 10)
+#define X86_FEATURE_RTM             ( 2*32 + 11)
+#define X86_FEATURE_AVX512F         ( 2*32 + 16)
+#define X86_FEATURE_RDSEED          ( 2*32 + 18)
+#define X86_FEATURE_ADX             ( 2*32 + 19)
+#define X86_FEATURE_SMAP            ( 2*32 + 20)
+#define X86_FEATURE_CLFLUSHOPT      ( 2*32 + 23)
+#define X86_FEATURE_CLWB            ( 2*32 + 24)
+#define X86_FEATURE_SHA_NI          ( 2*32 + 29)
+
+// CPUID 7.0 ECX
+#define X86_FEATURE_UMIP            ( 3*32 +  2)
+#define X86_FEATURE_PKU             ( 3*32 +  3)
+#define X86_FEATURE_WAITPKG         ( 3*32 +  5)
+#define X86_FEATURE_VAES            ( 3*32 +  9)
+#define X86_FEATURE_VPCLMULQDQ      ( 3*32 + 10)
+#define X86_FEATURE_RDPID           ( 3*32 + 22)
+
+// CPUID 7.0 EDX
+#define X86_FEATURE_FSRM            ( 4*32 +  4)  // 短 rep movsb 也快
+#define X86_FEATURE_MD_CLEAR        ( 4*32 + 10)
+#define X86_FEATURE_SERIALIZE       ( 4*32 + 14)
+#define X86_FEATURE_HYBRID_CPU      ( 4*32 + 15)
+#define X86_FEATURE_SPEC_CTRL       ( 4*32 + 26)
+#define X86_FEATURE_ARCH_CAPS       ( 4*32 + 29)
+
+// CPUID 0Dh.1 EAX
+#define X86_FEATURE_XSAVEOPT        ( 5*32 +  0)
+#define X86_FEATURE_XSAVEC          ( 5*32 +  1)
+#define X86_FEATURE_XGETBV1         ( 5*32 +  2)
+#define X86_FEATURE_XSAVES          ( 5*32 +  3)
+
+// CPUID 80000001h EDX
+#define X86_FEATURE_SYSCALL         ( 6*32 + 11)
+#define X86_FEATURE_NX              ( 6*32 + 20)
+#define X86_FEATURE_PDPE1GB         ( 6*32 + 26)
+#define X86_FEATURE_RDTSCP          ( 6*32 + 27)
+#define X86_FEATURE_LM              ( 6*32 + 29)
+
+// CPUID 80000001h ECX
+#define X86_FEATURE_LAHF_LM         ( 7*32 +  0)
+#define X86_FEATURE_SVM             ( 7*32 +  2)
+#define X86_FEATURE_ABM             ( 7*32 +  5)  // lzcnt
+#define X86_FEATURE_SSE4A           ( 7*32 +  6)
+#define X86_FEATURE_PREFETCHW       ( 7*32 +  8)
+#define X86_FEATURE_TOPOEXT         ( 7*32 + 22)
+
+// CPUID 80000007h EDX
+#define X86_FEATURE_INVARIANT_TSC   ( 8*32 +  8)  // TSC 频率不随 P/C 状态变化
+
+extern uint32_t boot_cpu_caps[NCAPINTS];
+
+static inline bool cpu_has(uint32_t feature) {
+    return boot_cpu_caps[feature / 32] & (1u << (feature % 32));
+}
+
+struct cpu_xsave_info {
+    uint64_t xcr0_supported;    // CPUID 0Dh.0 EDX:EAX，可以在 XCR0 里打开的状态分量
+    uint32_t max_size;          // 打开所有分量时 XSAVE 区域的大小
+};
+
+// 读取所有特性叶 (kmain 里最先调用)
+void cpu_features_init();
+// 特性名，没有名字的编号返回 nullptr
+const char* cpu_feature_name(uint32_t feature);
+uint32_t cpu_max_leaf();
+uint32_t cpu_max_ext_leaf();
+const cpu_xsave_info* cpu_get_xsave_info();
+// 按特性叶分组打印检测到的特性
+void cpu_features_dump();
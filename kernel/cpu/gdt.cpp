@@ -0,0 +1,54 @@
+#include "gdt.h"
+#include "percpu.h"
+
+#define GDT_ENTRIES 6
+
+struct gdt_ptr64 {
+    uint16_t limit;
+    uint64_t base;
+} __attribute__((packed));
+
+struct cpu_gdt {
+    uint64_t entries[GDT_ENTRIES];
+    tss64 tss;
+};
+
+static per_cpu<cpu_gdt> gdts;
+
+// 与 gdt_asm.asm 中的静态 GDT 保持一致
+#define GDT_DESC_KERNEL_CODE 0x00209A0000000000ull  // P=1 DPL=0 代码段，L=1
+#define GDT_DESC_KERNEL_DATA 0x0000920000000000ull  // P=1 DPL=0 可写数据段
+#define GDT_DESC_USER_DATA   0x0000F20000000000ull  // P=1 DPL=3 可写数据段
+
+#define TSS_TYPE_AVAILABLE   0x89                   // P=1，64 位可用 TSS
+
+static void gdt_set_tss(cpu_gdt* g) {
+    uint64_t base = (uint64_t)&g->tss;
+    uint64_t limit = sizeof(tss64) - 1;
+    uint64_t low = (limit & 0xFFFF)
+                 | ((base & 0xFFFFFF) << 16)
+                 | ((uint64_t)TSS_TYPE_AVAILABLE << 40)
+                 | (((limit >> 16) & 0xF) << 48)
+                 | (((base >> 24) & 0xFF) << 56);
+    g->entries[GDT_TSS / 8] = low;
+    g->entries[GDT_TSS / 8 + 1] = base >> 32;
+}
+
+void gdt_init_cpu(uint32_t cpu, uint64_t ist_stack_top) {
+    cpu_gdt* g = &gdts.on(cpu);
+    g->entries[0] = 0;
+    g->entries[GDT_KERNEL_CODE / 8] = GDT_DESC_KERNEL_CODE;
+    g->entries[GDT_KERNEL_DATA / 8] = GDT_DESC_KERNEL_DATA;
+    g->entries[GDT_USER_DATA / 8] = GDT_DESC_USER_DATA;
+
+    g->tss = tss64();
+    g->tss.ist[IST_DOUBLE_FAULT - 1] = ist_stack_top;
+    // I/O 位图偏移超出段界限：用户态没有任何端口权限
+    g->tss.iomap_base = sizeof(tss64);
+    gdt_set_tss(g);
+
+    gdt_ptr64 ptr = { sizeof(g->entries) - 1, (uint64_t)g->entries };
+    asm volatile("lgdt %0" :: "m"(ptr) : "memory");
+    // 选择子布局不变，CS/DS/SS 的隐藏部分仍然有效；GS 不能重新加载 (见 percpu.h)
+    asm volatile("ltr %w0" :: "r"((uint16_t)GDT_TSS) : "memory");
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <stdint.h>
+
+// ==========================================================================
+// 每 CPU 的 GDT 与 TSS
+// ==========================================================================
+// 引导早期由 gdt_asm.asm 的 init_gdt 加载一张共享的静态 GDT；每个 CPU 上线时
+// 换成自己的一份，多出一个指向本 CPU TSS 的描述符。选择子布局与静态 GDT 一致，
+// 所以切换时不需要重新加载 CS/DS/SS。
+
+#define GDT_KERNEL_CODE     0x08
+#define GDT_KERNEL_DATA     0x10
+#define GDT_USER_DATA       0x18
+#define GDT_TSS             0x20    // 64 位 TSS 描述符占两个槽位
+
+// IST 槽位 (1~7)；0 表示沿用当前栈
+#define IST_DOUBLE_FAULT    1
+#define IST_STACK_SIZE      4096
+
+struct tss64 {
+    uint32_t reserved0;
+    uint64_t rsp[3];
+    uint64_t reserved1;
+    uint64_t ist[7];
+    uint64_t reserved2;
+    uint16_t reserved3;
+    uint16_t iomap_base;
+} __attribute__((packed));
+
+// 构造并加载 cpu 的 GDT 和 TSS，ist_stack_top 为双重错误栈的栈顶
+void gdt_init_cpu(uint32_t cpu, uint64_t ist_stack_top);
@@ -63,6 +63,6 @@ init_gdt:
   mov ds, ax
   mov es, ax
   mov fs, ax
-  mov gs, ax
+  ; 不重新加载 GS：kmain 已经把 GS 基址指向 BSP 的每 CPU 控制块 (见 percpu.h)
   mov ss, ax
   ret
@@ -19,4 +19,10 @@ struct idt_ptr_t {
 } __attribute__((packed));
 
 // 初始化 IDT
-void init_idt();
\ No newline at end of file
+void init_idt();
+
+// 在当前 CPU 上加载同一张 IDT (AP 上线时使用)
+void idt_load_cpu();
+
+// 让向量 num 在 TSS 的第 ist 个 IST 栈上执行；所有 CPU 共用 IDT，各自的 TSS 提供栈
+void idt_set_ist(uint8_t num, uint8_t ist);
@@ -0,0 +1,95 @@
+#include "irq.h"
+#include "isr.h"
+#include "acpi.h"
+#include "ports.h"
+#include "kernel/drivers/tty.h"
+#include "kernel/klog.h"
+
+bool irq_apic_active = false;
+
+// 屏蔽两片 8259 的全部中断线；切到 IOAPIC 后它们只会制造重复中断
+static void pic_disable() {
+    outb(0x21, 0xFF);
+    outb(0xA1, 0xFF);
+}
+
+void irq_init(uint64_t rsdp) {
+    irq_apic_active = false;
+    if (!acpi_init(rsdp)) {
+        pr_notice("irq: no ACPI tables, using 8259 PIC");
+        return;
+    }
+    pic_disable();
+    if (!apic_init()) {
+        pr_notice("irq: APIC unavailable, falling back to 8259 PIC");
+        return;
+    }
+    irq_apic_active = true;
+}
+
+bool irq_using_apic() {
+    return irq_apic_active;
+}
+
+// 把 MPS INTI 标志换算成 IOAPIC 重定向表项标志；"符合总线规范" 的取值由 bus_default 决定
+static uint32_t irq_flags_from_mps(uint16_t mps, uint32_t bus_default) {
+    uint32_t flags = bus_default;
+    uint16_t polarity = mps & MPS_POLARITY_MASK;
+    uint16_t trigger = mps & MPS_TRIGGER_MASK;
+    if (polarity == MPS_POLARITY_HIGH) flags &= ~IOAPIC_ACTIVE_LOW;
+    else if (polarity == MPS_POLARITY_LOW) flags |= IOAPIC_ACTIVE_LOW;
+    if (trigger == MPS_TRIGGER_EDGE) flags &= ~IOAPIC_LEVEL;
+    else if (trigger == MPS_TRIGGER_LEVEL) flags |= IOAPIC_LEVEL;
+    return flags;
+}
+
+static void irq_route(uint8_t irq, uint32_t bus_default) {
+    const madt_info* madt = acpi_get_madt();
+    uint32_t gsi = irq;
+    uint32_t flags = bus_default;
+    if (irq < 16 && madt->isa[irq].present) {
+        gsi = madt->isa[irq].gsi;
+        flags = irq_flags_from_mps(madt->isa[irq].flags, bus_default);
+    }
+    if (!ioapic_route(gsi, IRQ_VECTOR_BASE + irq, flags)) {
+        pr_warn("irq: no IOAPIC pin for IRQ %u (GSI %u)", irq, gsi);
+    }
+}
+
+void irq_unmask(uint8_t irq) {
+    if (!irq_apic_active) {
+        pic_unmask_irq(irq);
+        // 从片上的中断需要主片的级联线 IRQ2 同时打开
+        if (irq >= 8) pic_unmask_irq(2);
+        return;
+    }
+    irq_route(irq, 0);
+}
+
+void irq_unmask_pci(uint8_t line) {
+    if (!irq_apic_active) {
+        irq_unmask(line);
+        return;
+    }
+    irq_route(line, IOAPIC_LEVEL | IOAPIC_ACTIVE_LOW);
+}
+
+void irq_mask(uint8_t irq) {
+    if (!irq_apic_active) {
+        uint16_t port = irq < 8 ? 0x21 : 0xA1;
+        outb(port, inb(port) | (1 << (irq & 7)));
+        return;
+    }
+    const madt_info* madt = acpi_get_madt();
+    uint32_t gsi = (irq < 16 && madt->isa[irq].present) ? madt->isa[irq].gsi : irq;
+    ioapic_set_mask(gsi, true);
+}
+
+void irq_dump() {
+    if (irq_apic_active) {
+        apic_dump();
+    } else {
+        pic_dump_masks();
+    }
+    isr_dump_vectors();
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <stdint.h>
+#include "apic.h"
+#include "pic.h"
+
+// ==========================================================================
+// 硬件中断线管理
+// ==========================================================================
+// 驱动只和 ISA IRQ 号 / PCI 中断线打交道，这里决定它们经由 IOAPIC
+// 还是退回到 8259 PIC。IRQ n 始终投递到向量 IRQ_VECTOR_BASE + n，
+// 所以 isr_handler 的分发不受中断控制器影响。
+
+#define IRQ_VECTOR_BASE 32
+
+extern bool irq_apic_active;
+
+// 解析 ACPI、尝试启用 LAPIC/IOAPIC；失败时保持 PIC 模式。必须在 pic_remap 之后调用
+void irq_init(uint64_t rsdp);
+
+// 打开一条 ISA 中断 (按 MADT 中断源覆盖换算 GSI 和触发方式，默认边沿/高电平)
+void irq_unmask(uint8_t irq);
+// 打开一条 PCI INTx 中断线 (没有覆盖项时按电平/低有效处理)
+void irq_unmask_pci(uint8_t line);
+void irq_mask(uint8_t irq);
+
+// 中断处理结束：APIC 模式下是一次寄存器写，PIC 模式下是 1~2 次端口写
+static inline void irq_eoi(uint8_t irq) {
+    if (irq_apic_active) {
+        lapic_eoi();
+    } else {
+        pic_send_eoi(irq);
+    }
+}
+
+bool irq_using_apic();
+void irq_dump();
@@ -1,76 +1,401 @@
 #include "isr.h"
 #include "kernel/drivers/tty.h"
-#include "kernel/drivers/keyboard.h"
-#include "kernel/boot.h" // 需要全局 boot_info
-#include <stivale.h>
-#include "pic.h"
-#include "ports.h"
+#include "irq.h"
 #include "kernel/panic.h"
-#include "kernel/drivers/ethernet/e1000.h"
-#include "kernel/drivers/ethernet/virtio_net.h"
+#include "kernel/klog.h"
+#include "kernel/tracepoint.h"
+#include "kernel/softirq.h"
+#include "kernel/sync/spinlock.h"
+#include "kernel/sync/rcu.h"
+#include "kernel/sched/sched.h"
+#include "kernel/time/clock.h"
+#include "smp.h"
+#include "lib/libc.h"
 
 // 外部声明：从 tty.h 中获取
 extern void print_hex(uint64_t value, uint32_t color);
 
 // 全局变量
-static uint64_t tick = 0;
 
-// 核心修改：将所有 ISR 蹦床函数的声明放在全局作用域，由 idt.cpp 提供 
-// isr_handler 不直接调用 isrXX，所以这里不需要声明它们。
-// 它只关心 regs->int_no。
+// 中断结束时需要的 EOI 方式
+enum irq_eoi_kind : uint8_t {
+    IRQ_EOI_NONE,       // CPU 异常、LAPIC 伪中断
+    IRQ_EOI_LEGACY,     // ISA/PCI 线中断：由 irq_eoi 决定发给 PIC 还是 LAPIC
+    IRQ_EOI_LAPIC,      // 只可能经由 LAPIC 投递的向量 (MSI、IPI 等)
+};
 
-extern "C" void isr_handler(registers_t* regs) {
-    //  1. 处理 CPU 异常 (0-31) 
-    if (regs->int_no < 32) {
-        if (regs->int_no == 3) { // Breakpoint
-            kernel_panic(regs, "Breakpoint exception (int 3) triggered.");
+// 共享向量上的一个处理函数
+struct irq_action {
+    irq_handler_t handler;
+    void* ctx;
+    irq_action* next;
+};
+
+struct irq_vector {
+    irq_action* entry;          // isr_handler 唯一的间接调用目标 (RCU 发布，处理函数与参数一起切换)
+    irq_action* actions;        // 已登记的处理函数 (为空表示还在使用默认处理函数)
+    irq_action chain;           // 共享时 entry 指向这里：{isr_chain_dispatch, 本表项}
+    uint32_t action_count;
+    irq_eoi_kind eoi;
+    uint32_t unhandled_streak;  // 连续无人认领的次数，用于发现中断风暴
+    uint64_t unhandled;
+};
+
+// 一条电平触发的线连续这么多次无人认领就把它屏蔽，避免卡死在中断里
+#define IRQ_STORM_LIMIT 10000
+
+#define IRQ_MAX_ACTIONS 64
+
+static irq_vector irq_vectors[256];
+static irq_action irq_action_pool[IRQ_MAX_ACTIONS];
+static uint32_t irq_action_used = 0;
+// 串行化登记；分发路径不拿这把锁
+static spinlock irq_vectors_lock;
+
+struct irq_cpu_stats {
+    uint64_t total;
+    uint64_t count[256];
+    irq_latency latency[256 - IRQSTAT_FIRST_VECTOR];
+};
+
+static per_cpu<irq_cpu_stats> irq_stats;
+
+// 不加 lfence：处理函数前后各读一次，误差只有几十个周期，换来的是分发路径上没有序列化指令
+static inline uint64_t irqstat_cycles() {
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void irqstat_account(irq_latency* lat, uint64_t cycles) {
+    uint32_t b = 0;
+    if (cycles >> IRQSTAT_MIN_SHIFT) {
+        b = 63 - __builtin_clzll(cycles) - (IRQSTAT_MIN_SHIFT - 1);
+        if (b >= IRQSTAT_BUCKETS) b = IRQSTAT_BUCKETS - 1;
+    }
+    lat->hist[b]++;
+    uint32_t c = cycles > UINT32_MAX ? UINT32_MAX : (uint32_t)cycles;
+    if (c > lat->max_cycles) lat->max_cycles = c;
+}
+
+static uint64_t vector_count(uint32_t vector) {
+    uint64_t total = 0;
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) total += irq_stats.on(cpu).count[vector];
+    return total;
+}
+
+// ==========================================================================
+// 默认处理函数
+// ==========================================================================
+
+static irq_return_t isr_exception(registers_t* regs, void*) {
+    if (regs->int_no == 3) { // Breakpoint
+        // 追踪点改写期间临时放下的 int3
+        if (tracepoint_poke_int3(regs)) return IRQ_HANDLED;
+        kernel_panic(regs, "Breakpoint exception (int 3) triggered.");
+    }
+    tty_print("Received CPU Exception: ", 0xFF0000);
+    print_hex(regs->int_no, 0xFF0000);
+    tty_print(" - Halting.\n", 0xFF0000);
+    kernel_panic(regs, "Unhandled CPU Exception.");
+    return IRQ_HANDLED;
+}
+
+// 没有任何驱动登记的向量：只计数，不再直接停机
+static irq_return_t isr_unexpected(registers_t* regs, void*) {
+    irq_vector* v = &irq_vectors[regs->int_no];
+    if (v->unhandled == 0) {
+        pr_warn("isr: unexpected interrupt on vector %llu", (unsigned long long)regs->int_no);
+    }
+    return IRQ_NONE;
+}
+
+// LAPIC 伪中断：不能发送 EOI，只计数
+static irq_return_t isr_lapic_spurious(registers_t*, void*) {
+    lapic_spurious_count++;
+    return IRQ_HANDLED;
+}
+
+// 共享向量：依次询问每个处理函数，只要有一个认领就算已处理
+static irq_return_t isr_chain_dispatch(registers_t* regs, void* ctx) {
+    irq_vector* v = (irq_vector*)ctx;
+    irq_return_t ret = IRQ_NONE;
+    for (irq_action* a = rcu_dereference(v->actions); a; a = rcu_dereference(a->next)) {
+        if (a->handler(regs, a->ctx) == IRQ_HANDLED) ret = IRQ_HANDLED;
+    }
+    return ret;
+}
+
+static irq_action default_exception = { isr_exception, nullptr, nullptr };
+static irq_action default_unexpected = { isr_unexpected, nullptr, nullptr };
+static irq_action default_spurious = { isr_lapic_spurious, nullptr, nullptr };
+
+// ==========================================================================
+// 登记
+// ==========================================================================
+
+void isr_init_table() {
+    spin_lock_init(&irq_vectors_lock, "irq_vectors");
+    for (int i = 0; i < 256; i++) {
+        irq_vector* v = &irq_vectors[i];
+        if (i < 32) {
+            v->eoi = IRQ_EOI_NONE;
+        } else if (i < IRQ_VECTOR_BASE + 16) {
+            v->eoi = IRQ_EOI_LEGACY;
+        } else if (i == LAPIC_SPURIOUS_VECTOR) {
+            v->eoi = IRQ_EOI_NONE;
+        } else {
+            v->eoi = IRQ_EOI_LAPIC;
+        }
+        if (v->actions) continue;
+
+        if (i < 32) {
+            v->entry = &default_exception;
+        } else if (i == LAPIC_SPURIOUS_VECTOR) {
+            v->entry = &default_spurious;
         } else {
-            tty_print("Received CPU Exception: ", 0xFF0000);
-            print_hex(regs->int_no, 0xFF0000);
-            tty_print(" - Halting.\n", 0xFF0000);
-            kernel_panic(regs, "Unhandled CPU Exception.");
+            v->entry = &default_unexpected;
         }
     }
-    //  2. 处理硬件中断 (32-47) 
-    else if (regs->int_no >= 32 && regs->int_no < 48) {
-        // IRQ0: PIT (中断号 32)
-        if (regs->int_no == 32) { 
-            tick++;
-            extern bool cursor_visible; 
-            if (tick % 500 == 0) {
-                cursor_visible = !cursor_visible;
-            }
-        } 
-        // IRQ1: Keyboard (中断号 33)
-        else if (regs->int_no == 33) {
-            uint8_t scancode = inb(0x60);
-            keyboard_handle_scancode(scancode);
+}
+
+bool register_irq_handler(uint8_t vector, irq_handler_t fn, void* ctx) {
+    if (!fn || vector < 32 || vector == LAPIC_SPURIOUS_VECTOR) return false;
+
+    uint64_t flags = spin_lock_irqsave(&irq_vectors_lock);
+    if (irq_action_used >= IRQ_MAX_ACTIONS) {
+        spin_unlock_irqrestore(&irq_vectors_lock, flags);
+        pr_err("isr: out of irq actions, vector %u not registered", vector);
+        return false;
+    }
+    irq_action* a = &irq_action_pool[irq_action_used++];
+    a->handler = fn;
+    a->ctx = ctx;
+    a->next = nullptr;
+
+    // 动作节点初始化完成后才发布；已发布的节点从不释放，旧读者继续使用也是安全的
+    irq_vector* v = &irq_vectors[vector];
+    if (!v->actions) {
+        // 独占向量：直接调用处理函数，不经过链表
+        rcu_assign_pointer(v->actions, a);
+        rcu_assign_pointer(v->entry, a);
+    } else {
+        irq_action* tail = v->actions;
+        while (tail->next) tail = tail->next;
+        rcu_assign_pointer(tail->next, a);
+        if (v->entry != &v->chain) {
+            v->chain.handler = isr_chain_dispatch;
+            v->chain.ctx = v;
+            rcu_assign_pointer(v->entry, &v->chain);
         }
-        // IRQ10: E1000 Network Card (中断号 42)
-        else if (regs->int_no == 42) {
-            tty_print("INT: ", 0xFFFFFF); print_hex(regs->int_no, 0xFFFFFF); tty_print("\n", 0xFFFFFF);
-            tty_print("E1000 Interrupt hit! Calling handler.\n", 0xFF00FF);
-            e1000_handle_interrupt(); // < 这是对 e1000.h 中声明函数的调用
-        } 
-        else if (regs->int_no == 43) {
-            // VirtIO 中断处理函数内部会读取并清除中断状态，非常干净
-            virtio_net_handle_interrupt(); 
+    }
+    v->action_count++;
+    v->unhandled_streak = 0;
+    spin_unlock_irqrestore(&irq_vectors_lock, flags);
+    return true;
+}
+
+int irq_alloc_vector(irq_handler_t fn, void* ctx) {
+    for (int i = IRQ_DYNAMIC_VECTOR_BASE; i < IRQ_DYNAMIC_VECTOR_END; i++) {
+        if (irq_vectors[i].actions) continue;
+        return register_irq_handler(i, fn, ctx) ? i : -1;
+    }
+    return -1;
+}
+
+void irq_get_vector_stats(uint8_t vector, irq_vector_stats* stats) {
+    const irq_vector* v = &irq_vectors[vector];
+    stats->count = vector_count(vector);
+    stats->unhandled = v->unhandled;
+    stats->handlers = v->action_count;
+}
+
+void isr_dump_vectors() {
+    tty_print("\n--- Vectors ---\n", 0xFFFF00);
+    for (int i = 32; i < 256; i++) {
+        const irq_vector* v = &irq_vectors[i];
+        uint64_t count = vector_count(i);
+        if (!v->actions && count == 0) continue;
+        tty_print("  vector ", 0xFFFFFF);
+        print_dec(i, 0x00FF00);
+        tty_print(": ", 0xFFFFFF);
+        print_dec(count, 0x00FFFF);
+        tty_print(" irqs, ", 0xFFFFFF);
+        print_dec(v->unhandled, v->unhandled ? 0xFF8800 : 0x00FFFF);
+        tty_print(" unhandled, ", 0xFFFFFF);
+        print_dec(v->action_count, 0x00FFFF);
+        tty_print(v->action_count > 1 ? " handlers (shared)\n" : " handler(s)\n", 0xAAAAAA);
+    }
+}
+
+// ==========================================================================
+// 分发
+// ==========================================================================
+
+extern "C" void isr_handler(registers_t* regs) {
+    cpu_local* cpu = this_cpu();
+    cpu->irq_nesting++;
+    registers_t* old_regs = cpu->irq_regs;
+    cpu->irq_regs = regs;
+    // 打断了空闲中的 CPU：处理期间退出 RCU 扩展静止状态
+    bool from_idle = rcu_irq_enter();
+    uint8_t vector = regs->int_no & 0xFF;
+    irq_vector* v = &irq_vectors[vector];
+    irq_cpu_stats* st = &irq_stats.on(cpu->cpu_id);
+    st->total++;
+    st->count[vector]++;
+
+    irq_action* entry = rcu_dereference(v->entry);
+    uint64_t start = irqstat_cycles();
+    irq_return_t ret = entry->handler(regs, entry->ctx);
+    if (vector >= IRQSTAT_FIRST_VECTOR) {
+        irqstat_account(&st->latency[vector - IRQSTAT_FIRST_VECTOR], irqstat_cycles() - start);
+    }
+    if (ret == IRQ_NONE) {
+        // 向量是全局的，多个 CPU 可能同时收到同一个向量
+        __atomic_add_fetch(&v->unhandled, 1, __ATOMIC_RELAXED);
+        // 电平触发的线无人认领会立刻再次触发，超过阈值后屏蔽它
+        if (__atomic_add_fetch(&v->unhandled_streak, 1, __ATOMIC_RELAXED) == IRQ_STORM_LIMIT && v->eoi == IRQ_EOI_LEGACY) {
+            irq_mask(regs->int_no - IRQ_VECTOR_BASE);
+            pr_err("isr: IRQ %llu disabled after %u unhandled interrupts",
+                   (unsigned long long)(regs->int_no - IRQ_VECTOR_BASE), IRQ_STORM_LIMIT);
         }
-        // 如果是其他 IRQ，可以打印未知 IRQ 信息
-        else {
-            tty_print("Unhandled IRQ: ", 0xFFFF00);
-            print_hex(regs->int_no - 32, 0xFFFF00);
-            tty_print("\n", 0xFFFF00);
+    } else {
+        v->unhandled_streak = 0;
+    }
+
+    //  只在这里发送一次 EOI (APIC 模式下是一次寄存器写)
+    if (v->eoi == IRQ_EOI_LEGACY) {
+        irq_eoi(regs->int_no - IRQ_VECTOR_BASE);
+    } else if (v->eoi == IRQ_EOI_LAPIC) {
+        lapic_eoi();
+    }
+
+    // 最外层中断返回前执行挂起的软中断 (EOI 已发，软中断期间允许中断嵌套)
+    if (cpu->irq_nesting == 1 && softirq_pending()) do_softirq();
+
+    if (from_idle) rcu_irq_exit();
+    cpu->irq_regs = old_regs;
+    cpu->irq_nesting--;
+
+    // 被打断的是开着中断的线程上下文：在这里切换，iretq 回到的就是新线程
+    if (cpu->irq_nesting == 0 && cpu->need_resched && (regs->rflags & RFLAGS_IF)) {
+        preempt_schedule_irq();
+    }
+}
+
+// ==========================================================================
+// 统计输出
+// ==========================================================================
+
+uint64_t irq_cpu_total(uint32_t cpu) {
+    return __atomic_load_n(&irq_stats.on(cpu).total, __ATOMIC_RELAXED);
+}
+
+void irq_get_cpu_vector_stats(uint32_t cpu, uint8_t vector, uint64_t* count, irq_latency* lat) {
+    const irq_cpu_stats* st = &irq_stats.on(cpu);
+    *count = st->count[vector];
+    if (vector >= IRQSTAT_FIRST_VECTOR) {
+        *lat = st->latency[vector - IRQSTAT_FIRST_VECTOR];
+    } else {
+        memset(lat, 0, sizeof(*lat));
+    }
+}
+
+static const char* vector_name(uint32_t vector, char* buf, size_t size) {
+    if (vector < 32) {
+        snprintf(buf, size, "exception");
+    } else if (vector < IRQ_VECTOR_BASE + 16) {
+        snprintf(buf, size, "IRQ%u", vector - IRQ_VECTOR_BASE);
+    } else if (vector == LAPIC_TIMER_VECTOR) {
+        snprintf(buf, size, "lapic-timer");
+    } else if (vector == LAPIC_CALL_VECTOR) {
+        snprintf(buf, size, "call-ipi");
+    } else if (vector == LAPIC_SPURIOUS_VECTOR) {
+        snprintf(buf, size, "spurious");
+    } else {
+        snprintf(buf, size, "msi");
+    }
+    return buf;
+}
+
+// 直方图里第一个累计数达到 total * pct / 100 的格子的上界 (周期)
+static uint64_t latency_percentile(const irq_latency* lat, uint64_t total, uint32_t pct) {
+    uint64_t target = (total * pct + 99) / 100;
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < IRQSTAT_BUCKETS; b++) {
+        seen += lat->hist[b];
+        if (seen >= target) {
+            // 最后一格不封顶，用最大值代替上界
+            return b == IRQSTAT_BUCKETS - 1 ? lat->max_cycles : 1ull << (b + IRQSTAT_MIN_SHIFT);
         }
+    }
+    return lat->max_cycles;
+}
 
-        //  核心：只在这里发送一次 EOI 
-        pic_send_eoi(regs->int_no - 32); 
+static void format_cycles(char* buf, size_t size, uint64_t cycles) {
+    uint64_t ns = clock_cycles_to_ns(cycles);
+    if (ns < 10000) {
+        snprintf(buf, size, "%lluns", (unsigned long long)ns);
+    } else {
+        snprintf(buf, size, "%lluus", (unsigned long long)(ns / 1000));
     }
-    //  3. 处理其他未知的/自定义中断 
-    else {
-        tty_print("Received Unknown Interrupt: ", 0xFFFFFF);
-        print_hex(regs->int_no, 0xFFFFFF);
-        tty_print(" - Halting.\n", 0xFFFFFF);
-        kernel_panic(regs, "Unknown Interrupt.");
+}
+
+void isr_dump_irqstat() {
+    // 频率按两次调用之间的增量计算，第一次调用时是自启动以来的平均值
+    static uint64_t last_counts[256];
+    static uint64_t last_ns = 0;
+    uint64_t now = clock_monotonic_ns();
+    uint64_t elapsed = now - last_ns;
+    if (elapsed == 0) elapsed = 1;
+
+    char line[160];
+    snprintf(line, sizeof(line), "\nInterrupts over the last %llu ms (latency = handler time, bucket upper bound)\n",
+             (unsigned long long)(elapsed / 1000000));
+    tty_print(line, 0x00FFFF);
+    tty_print("Vec  Source            total       /s      p50      p99      max  per CPU\n", 0xFFFF00);
+
+    char name[16], p50[16], p99[16], max[16];
+    for (uint32_t vector = 0; vector < 256; vector++) {
+        uint64_t total = 0;
+        irq_latency merged;
+        memset(&merged, 0, sizeof(merged));
+        for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+            uint64_t count;
+            irq_latency lat;
+            irq_get_cpu_vector_stats(cpu, (uint8_t)vector, &count, &lat);
+            total += count;
+            for (uint32_t b = 0; b < IRQSTAT_BUCKETS; b++) merged.hist[b] += lat.hist[b];
+            if (lat.max_cycles > merged.max_cycles) merged.max_cycles = lat.max_cycles;
+        }
+        if (total == 0) continue;
+
+        uint64_t rate = (total - last_counts[vector]) * 1000000000ull / elapsed;
+        last_counts[vector] = total;
+        uint64_t timed = 0;
+        for (uint32_t b = 0; b < IRQSTAT_BUCKETS; b++) timed += merged.hist[b];
+        if (timed) {
+            format_cycles(p50, sizeof(p50), latency_percentile(&merged, timed, 50));
+            format_cycles(p99, sizeof(p99), latency_percentile(&merged, timed, 99));
+            format_cycles(max, sizeof(max), merged.max_cycles);
+        } else {
+            snprintf(p50, sizeof(p50), "-");
+            snprintf(p99, sizeof(p99), "-");
+            snprintf(max, sizeof(max), "-");
+        }
+        snprintf(line, sizeof(line), "%3u  %-12s %10llu %8llu %8s %8s %8s ", vector,
+                 vector_name(vector, name, sizeof(name)), (unsigned long long)total,
+                 (unsigned long long)rate, p50, p99, max);
+        tty_print(line, 0xFFFFFF);
+
+        for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+            uint64_t count = irq_stats.on(cpu).count[vector];
+            if (!count) continue;
+            snprintf(line, sizeof(line), " %u:%llu", cpu, (unsigned long long)count);
+            tty_print(line, 0xAAAAAA);
+        }
+        tty_print("\n", 0xFFFFFF);
     }
-}
\ No newline at end of file
+    last_ns = now;
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <stdint.h>
+#include "percpu.h"
 
 // 这个结构体精确地匹配了我们在 isr.asm 中压栈的寄存器顺序
 struct registers_t {
@@ -10,4 +11,82 @@ struct registers_t {
 };
 
 // 声明我们的 C++ 处理器，它会被汇编调用
-extern "C" void isr_handler(registers_t* regs);
\ No newline at end of file
+extern "C" void isr_handler(registers_t* regs);
+
+// cpu 自启动以来进入 isr_handler 的次数 (含异常)。每个 CPU 只增加自己的计数
+uint64_t irq_cpu_total(uint32_t cpu);
+
+// 本 CPU 是否处于硬件中断/异常处理上下文中 (嵌套深度在 cpu_local 里，由 isr_handler 维护)
+static inline bool in_interrupt() {
+    uint32_t nesting;
+    asm volatile("movl %%gs:%c1, %0" : "=r"(nesting) : "i"(offsetof(cpu_local, irq_nesting)));
+    return nesting != 0;
+}
+
+// 本 CPU 最内层中断被打断时的寄存器现场 (中断处理函数和软中断里有效，否则为空)
+static inline registers_t* get_irq_regs() {
+    registers_t* regs;
+    asm volatile("movq %%gs:%c1, %0" : "=r"(regs) : "i"(offsetof(cpu_local, irq_regs)));
+    return regs;
+}
+
+// ==========================================================================
+// 中断向量分发表
+// ==========================================================================
+// isr_handler 按向量号查表，每次中断只做一次间接调用。同一向量上登记多个
+// 处理函数 (共享的 PCI INTx 线) 时，表项改指向链式分发函数，依次询问每个处理函数。
+// 表项和处理函数链都用 rcu_assign_pointer 发布，分发路径不加锁；硬件中断处理
+// 本身就是 RCU 读侧临界区。
+
+enum irq_return_t {
+    IRQ_NONE = 0,       // 不是本设备产生的中断
+    IRQ_HANDLED = 1,
+};
+
+typedef irq_return_t (*irq_handler_t)(registers_t* regs, void* ctx);
+
+// 动态分配的向量区间 (MSI/MSI-X 等)；0xF0 以上留给本地 APIC 自身的中断
+#define IRQ_DYNAMIC_VECTOR_BASE 48
+#define IRQ_DYNAMIC_VECTOR_END  0xF0
+
+// 每个向量的统计
+struct irq_vector_stats {
+    uint64_t count;         // 进入次数
+    uint64_t unhandled;     // 所有处理函数都返回 IRQ_NONE 的次数
+    uint32_t handlers;      // 已登记的处理函数数量
+};
+
+// 填充默认表项 (异常、未预期中断、LAPIC 伪中断)，由 init_idt 调用；
+// 在此之前登记的处理函数会被保留
+void isr_init_table();
+
+// 在 vector 上登记处理函数；已有处理函数时自动转为共享链。失败返回 false
+bool register_irq_handler(uint8_t vector, irq_handler_t fn, void* ctx);
+// 分配一个空闲的动态向量并登记处理函数，用尽时返回 -1
+int irq_alloc_vector(irq_handler_t fn, void* ctx);
+
+// count 是所有 CPU 的合计
+void irq_get_vector_stats(uint8_t vector, irq_vector_stats* stats);
+// 打印有过中断或登记了处理函数的向量
+void isr_dump_vectors();
+
+// ==========================================================================
+// 每 CPU 的中断统计
+// ==========================================================================
+// 分发路径按 CPU 记录每个向量的次数，并用 TSC 测量处理函数本身的耗时 (不含 EOI
+// 和软中断)，记入 log2 直方图。只写本 CPU 的数据，不用原子操作，也不读 lfence
+// 序列化的 TSC，每次中断多花两次 rdtsc 和几次加法。异常向量只计次数。
+
+#define IRQSTAT_FIRST_VECTOR    32
+#define IRQSTAT_BUCKETS         16
+#define IRQSTAT_MIN_SHIFT       7   // 第 0 格是 [0, 2^7) 个周期，第 i 格 [2^(i+6), 2^(i+7))，最后一格不封顶
+
+struct irq_latency {
+    uint32_t hist[IRQSTAT_BUCKETS];
+    uint32_t max_cycles;
+};
+
+// 取 cpu 上 vector 的次数和耗时直方图 (vector < IRQSTAT_FIRST_VECTOR 时 lat 清零)
+void irq_get_cpu_vector_stats(uint32_t cpu, uint8_t vector, uint64_t* count, irq_latency* lat);
+// 每个有过中断的向量：各 CPU 次数、距上次调用以来的频率、p50/p99/最大耗时
+void isr_dump_irqstat();
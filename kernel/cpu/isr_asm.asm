@@ -3,26 +3,6 @@
 ; 声明我们将要调用的 C++ 通用处理器
 extern isr_handler
 
-;  宏定义：用于生成 ISR 存根 
-; ISR 无错误码版本
-%macro ISR_NO_ERR_CODE 1
-[global isr%1]
-isr%1:
-    cli          ; 关中断，防止嵌套
-    push byte 0  ; 压入一个假的错误码，保持堆栈对齐
-    push byte %1 ; 压入中断号
-    jmp isr_common_stub
-%endmacro
-
-; ISR 有错误码版本 (CPU会自动压入一个错误码)
-%macro ISR_ERR_CODE 1
-[global isr%1]
-isr%1:
-    cli
-    push byte %1 ; 只需压入中断号
-    jmp isr_common_stub
-%endmacro
-
 ;  通用存根 
 ; 所有 ISR 都会跳转到这里
 isr_common_stub:
@@ -66,41 +46,28 @@ isr_common_stub:
     add rsp, 16 ; 清理中断号和错误码
     iretq        ; 中断返回 (重要！不是 ret)
 
-;  生成前32个 ISR (用于 CPU 异常) 
-ISR_NO_ERR_CODE 0
-ISR_NO_ERR_CODE 1
-ISR_NO_ERR_CODE 2
-ISR_NO_ERR_CODE 3
-ISR_NO_ERR_CODE 4
-ISR_NO_ERR_CODE 5
-ISR_NO_ERR_CODE 6
-ISR_NO_ERR_CODE 7
-ISR_ERR_CODE    8
-ISR_NO_ERR_CODE 9
-ISR_ERR_CODE    10
-ISR_ERR_CODE    11
-ISR_ERR_CODE    12
-ISR_ERR_CODE    13
-ISR_ERR_CODE    14
-ISR_NO_ERR_CODE 15
-ISR_NO_ERR_CODE 16
-ISR_ERR_CODE    17
-ISR_NO_ERR_CODE 18
-ISR_NO_ERR_CODE 19
-ISR_NO_ERR_CODE 20
+;  生成全部 256 个 ISR 存根
+; CPU 会自动压入错误码的异常：#DF(8) #TS(10) #NP(11) #SS(12) #GP(13) #PF(14) #AC(17) #CP(21) #VC(29) #SX(30)
+%assign vec 0
+%rep 256
+global isr%+vec
+isr%+vec:
+    cli
+%if !(vec == 8 || (vec >= 10 && vec <= 14) || vec == 17 || vec == 21 || vec == 29 || vec == 30)
+    push qword 0    ; 假的错误码，保持堆栈布局一致
+%endif
+    push qword vec  ; 中断号
+    jmp isr_common_stub
+%assign vec vec + 1
+%endrep
 
-ISR_NO_ERR_CODE 21
-ISR_NO_ERR_CODE 22
-ISR_NO_ERR_CODE 23
-ISR_NO_ERR_CODE 24
-ISR_NO_ERR_CODE 25
-ISR_NO_ERR_CODE 26
-ISR_NO_ERR_CODE 27
-ISR_NO_ERR_CODE 28
-ISR_NO_ERR_CODE 29
-ISR_NO_ERR_CODE 30
-ISR_NO_ERR_CODE 31
-ISR_NO_ERR_CODE 32  ; IRQ0: Programmable Interval Timer
-ISR_NO_ERR_CODE 33 ; IRQ1: Keyboard
-ISR_NO_ERR_CODE 42  ; IRQ10: E1000 Network Card
-ISR_NO_ERR_CODE 43  ; IRQ11: VirtIO Network Card
+;  存根地址表，idt.cpp 用它循环填写 IDT
+section .rodata
+[global isr_stub_table]
+align 8
+isr_stub_table:
+%assign vec 0
+%rep 256
+    dq isr%+vec
+%assign vec vec + 1
+%endrep
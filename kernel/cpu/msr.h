@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+#include "alternative.h"
+
+// 常用 MSR
+#define MSR_IA32_APIC_BASE      0x1B
+#define MSR_IA32_TSC_DEADLINE   0x6E0
+#define MSR_X2APIC_BASE         0x800  // x2APIC 寄存器 = 0x800 + (xAPIC 偏移 >> 4)
+
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    asm volatile ("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    asm volatile ("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)) : "memory");
+}
+
+static inline void cpuid(uint32_t leaf, uint32_t subleaf,
+                         uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx) {
+    asm volatile ("cpuid"
+                  : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                  : "a"(leaf), "c"(subleaf));
+}
+
+// 读取时间戳计数器；lfence 保证之前的指令都已完成，避免乱序执行让读数提前。
+// 支持 RDTSCP 时启动时换成 rdtscp (本身就等之前的指令完成，少一条指令)
+static inline uint64_t rdtsc() {
+    uint32_t lo, hi;
+    asm volatile (ALTERNATIVE("lfence; rdtsc", "rdtscp", X86_FEATURE_RDTSCP)
+                  : "=a"(lo), "=d"(hi) :: "ecx", "memory");
+    return ((uint64_t)hi << 32) | lo;
+}
@@ -1,6 +1,12 @@
 #include "pci.h"
 #include "ports.h" // 需要 inb/outb/inl/outl
 #include "kernel/drivers/tty.h" // 需要 tty_print/print_hex
+#include "irq.h"
+#include "kernel/sync/spinlock.h"
+
+// 0xCF8/0xCFC 是一对端口：地址和数据之间被别的 CPU 插进来就会读写错设备。
+// 启动探测和 shell 命令可能同时访问配置空间
+static spinlock pci_config_lock;
 
 // 辅助函数：生成 PCI 配置地址
 static uint32_t pci_get_address(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset) {
@@ -9,8 +15,11 @@ static uint32_t pci_get_address(uint8_t bus, uint8_t device, uint8_t function, u
 
 // 读取 PCI 配置空间中的 DWORD
 uint32_t pci_read_dword(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset) {
+    uint64_t flags = spin_lock_irqsave(&pci_config_lock);
     outl(PCI_CONFIG_ADDRESS, pci_get_address(bus, device, function, offset));
-    return inl(PCI_CONFIG_DATA);
+    uint32_t value = inl(PCI_CONFIG_DATA);
+    spin_unlock_irqrestore(&pci_config_lock, flags);
+    return value;
 }
 
 // 辅助函数：根据 Class Code 打印设备类型
@@ -91,11 +100,154 @@ void pci_scan_bus(void (*callback)(uint8_t bus, uint8_t device, uint8_t function
 }
 
 void pci_write_dword(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset, uint32_t value) {
+    uint64_t flags = spin_lock_irqsave(&pci_config_lock);
     outl(PCI_CONFIG_ADDRESS, pci_get_address(bus, device, function, offset));
     outl(PCI_CONFIG_DATA, value);
+    spin_unlock_irqrestore(&pci_config_lock, flags);
 }
 
 void pci_init() {
-    // 不需要额外的初始化，直接调用 pci_scan_bus 即可
+    spin_lock_init(&pci_config_lock, "pci_config");
+}
+
+
+// ==========================================================================
+// Capability 链表
+// ==========================================================================
+
+uint8_t pci_find_capability(uint8_t bus, uint8_t device, uint8_t function, uint8_t cap_id) {
+    // 状态寄存器 bit 4 表示 capability 链表存在
+    uint32_t status = pci_read_dword(bus, device, function, 0x04) >> 16;
+    if (!(status & (1 << 4))) return 0;
+
+    uint8_t offset = pci_read_dword(bus, device, function, 0x34) & 0xFC;
+    for (int guard = 0; offset != 0 && guard < 48; guard++) {
+        uint32_t header = pci_read_dword(bus, device, function, offset);
+        if ((header & 0xFF) == cap_id) return offset;
+        offset = (header >> 8) & 0xFC;
+    }
+    return 0;
+}
+
+uint64_t pci_read_bar(uint8_t bus, uint8_t device, uint8_t function, int bar) {
+    uint32_t low = pci_read_dword(bus, device, function, 0x10 + bar * 4);
+    if (low & 1) return low & 0xFFFFFFFC; // I/O 空间 BAR
+    uint64_t addr = low & 0xFFFFFFF0;
+    if ((low & 0x6) == 0x4 && bar < 5) {
+        addr |= (uint64_t)pci_read_dword(bus, device, function, 0x10 + (bar + 1) * 4) << 32;
+    }
+    return addr;
+}
+
+// 配置空间只能按 DWORD 访问，16 位寄存器需要读-改-写
+static uint16_t pci_read_word(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset) {
+    return (uint16_t)(pci_read_dword(bus, device, function, offset & 0xFC) >> ((offset & 2) * 8));
+}
+
+static void pci_write_word(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset, uint16_t value) {
+    uint32_t shift = (offset & 2) * 8;
+    uint32_t dword = pci_read_dword(bus, device, function, offset & 0xFC);
+    dword = (dword & ~(0xFFFFu << shift)) | ((uint32_t)value << shift);
+    pci_write_dword(bus, device, function, offset & 0xFC, dword);
+}
+
+static void pci_disable_intx(uint8_t bus, uint8_t device, uint8_t function) {
+    uint16_t command = pci_read_word(bus, device, function, 0x04);
+    pci_write_word(bus, device, function, 0x04, command | PCI_COMMAND_INTX_DISABLE);
+}
+
+// ==========================================================================
+// MSI 向量分配
+// ==========================================================================
+
+int pci_msi_alloc_vector(irq_handler_t handler, void* ctx) {
+    if (!irq_using_apic()) return -1;
+    return irq_alloc_vector(handler, ctx);
+}
+
+// 消息地址：发往 BSP 的 LAPIC，物理目的模式；消息数据：固定投递、边沿触发。
+// 驱动可能在 AP 上的探测线程里初始化，所以不能用 lapic_id()
+static uint32_t pci_msi_address() {
+    return 0xFEE00000 | (apic_bsp_id() << 12);
 }
 
+bool pci_enable_msi(uint8_t bus, uint8_t device, uint8_t function, uint8_t vector) {
+    uint8_t cap = pci_find_capability(bus, device, function, PCI_CAP_ID_MSI);
+    if (!cap || !irq_using_apic()) return false;
+
+    uint16_t control = pci_read_word(bus, device, function, cap + 2);
+    bool is_64bit = control & (1 << 7);
+
+    pci_write_dword(bus, device, function, cap + 4, pci_msi_address());
+    if (is_64bit) {
+        pci_write_dword(bus, device, function, cap + 8, 0);
+        pci_write_word(bus, device, function, cap + 12, vector);
+    } else {
+        pci_write_word(bus, device, function, cap + 8, vector);
+    }
+
+    // 只申请一条消息 (MME = 0)，然后置位 MSI Enable
+    control &= ~(7 << 4);
+    control |= 1;
+    pci_write_word(bus, device, function, cap + 2, control);
+    pci_disable_intx(bus, device, function);
+    return true;
+}
+
+// ==========================================================================
+// MSI-X
+// ==========================================================================
+
+#define MSIX_CONTROL_ENABLE        (1 << 15)
+#define MSIX_CONTROL_FUNCTION_MASK (1 << 14)
+#define MSIX_ENTRY_VECTOR_MASKED   1
+
+bool pci_msix_init(uint8_t bus, uint8_t device, uint8_t function, pci_msix* msix) {
+    uint8_t cap = pci_find_capability(bus, device, function, PCI_CAP_ID_MSIX);
+    if (!cap || !irq_using_apic()) return false;
+
+    uint16_t control = pci_read_word(bus, device, function, cap + 2);
+    uint32_t table_info = pci_read_dword(bus, device, function, cap + 4);
+    uint64_t bar = pci_read_bar(bus, device, function, table_info & 7);
+    if (!bar) return false;
+
+    msix->bus = bus;
+    msix->device = device;
+    msix->function = function;
+    msix->cap = cap;
+    msix->table_size = (control & 0x7FF) + 1;
+    msix->table = (volatile uint32_t*)(bar + (table_info & ~7u));
+    return true;
+}
+
+void pci_msix_enable(pci_msix* msix) {
+    // 先整体屏蔽再打开，配置表项期间不会有中断漏进来
+    uint16_t control = pci_read_word(msix->bus, msix->device, msix->function, msix->cap + 2);
+    control |= MSIX_CONTROL_ENABLE | MSIX_CONTROL_FUNCTION_MASK;
+    pci_write_word(msix->bus, msix->device, msix->function, msix->cap + 2, control);
+
+    for (uint16_t i = 0; i < msix->table_size; i++) {
+        msix->table[i * 4 + 3] |= MSIX_ENTRY_VECTOR_MASKED;
+    }
+
+    control &= ~MSIX_CONTROL_FUNCTION_MASK;
+    pci_write_word(msix->bus, msix->device, msix->function, msix->cap + 2, control);
+    pci_disable_intx(msix->bus, msix->device, msix->function);
+}
+
+void pci_msix_disable(pci_msix* msix) {
+    uint16_t control = pci_read_word(msix->bus, msix->device, msix->function, msix->cap + 2);
+    pci_write_word(msix->bus, msix->device, msix->function, msix->cap + 2, control & ~MSIX_CONTROL_ENABLE);
+    uint16_t command = pci_read_word(msix->bus, msix->device, msix->function, 0x04);
+    pci_write_word(msix->bus, msix->device, msix->function, 0x04, command & ~PCI_COMMAND_INTX_DISABLE);
+}
+
+bool pci_msix_set_vector(pci_msix* msix, uint16_t entry, uint8_t vector) {
+    if (entry >= msix->table_size) return false;
+    volatile uint32_t* e = &msix->table[entry * 4];
+    e[0] = pci_msi_address();
+    e[1] = 0;
+    e[2] = vector;
+    e[3] &= ~MSIX_ENTRY_VECTOR_MASKED;
+    return true;
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <stdint.h>
+#include "isr.h"
 
 // PCI 配置空间 I/O 端口
 #define PCI_CONFIG_ADDRESS 0xCF8
@@ -20,7 +21,7 @@
 #define VIRTIO_VENDOR_ID 0x1AF4
 
 // PCI 函数声明
-void pci_init(); // 初始化 PCI 扫描
+void pci_init(); // 初始化配置空间访问锁，要在其他 CPU 访问 PCI 之前调用
 void pci_scan_bus(void (*callback)(uint8_t bus, uint8_t device, uint8_t function, uint16_t vendor_id, uint16_t device_id));
 
 // 读取 PCI 配置空间中的 DWORD (32位)
@@ -32,3 +33,41 @@ void pci_print_device_type(uint8_t class_code, uint8_t subclass_code, uint8_t pr
 uint32_t pci_read_dword(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset);
 // 写入 PCI 配置空间中的 DWORD (32位)
 void pci_write_dword(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset, uint32_t value);
+
+// ==========================================================================
+// Capability 链表与 MSI / MSI-X
+// ==========================================================================
+
+#define PCI_COMMAND_INTX_DISABLE (1 << 10)
+
+#define PCI_CAP_ID_MSI  0x05
+#define PCI_CAP_ID_MSIX 0x11
+
+// 在 capability 链表中查找指定 ID，返回配置空间偏移，找不到返回 0
+uint8_t pci_find_capability(uint8_t bus, uint8_t device, uint8_t function, uint8_t cap_id);
+
+// 读取 BAR (自动处理 64 位 BAR)，返回去掉标志位的基地址
+uint64_t pci_read_bar(uint8_t bus, uint8_t device, uint8_t function, int bar);
+
+// 从动态向量区间分配一个 MSI 向量并登记处理函数 (需要 LAPIC)，
+// 失败 (APIC 未启用或向量用尽) 返回 -1
+int pci_msi_alloc_vector(irq_handler_t handler, void* ctx);
+
+// 启用单消息 MSI，把中断发往 vector；成功时同时屏蔽 INTx
+bool pci_enable_msi(uint8_t bus, uint8_t device, uint8_t function, uint8_t vector);
+
+struct pci_msix {
+    uint8_t bus, device, function;
+    uint8_t cap;                 // capability 在配置空间中的偏移
+    uint16_t table_size;         // 表项数量
+    volatile uint32_t* table;    // MSI-X 表 (每项 4 个 DWORD)
+};
+
+// 解析 MSI-X capability 并映射表，设备不支持时返回 false
+bool pci_msix_init(uint8_t bus, uint8_t device, uint8_t function, pci_msix* msix);
+// 打开 MSI-X (所有表项先保持屏蔽)，同时屏蔽 INTx
+void pci_msix_enable(pci_msix* msix);
+// 关闭 MSI-X 并恢复 INTx
+void pci_msix_disable(pci_msix* msix);
+// 把表项 entry 指向 vector 并解除屏蔽
+bool pci_msix_set_vector(pci_msix* msix, uint16_t entry, uint8_t vector);
@@ -0,0 +1,103 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "acpi.h"
+
+// ==========================================================================
+// 每 CPU 数据
+// ==========================================================================
+// 每个 CPU 的 IA32_GS_BASE 指向自己的 cpu_local 控制块，%gs:0 是控制块自身的
+// 地址，所以取本 CPU 编号只需要一条 mov，不需要读 LAPIC ID 再查表。
+// BSP 在 kmain 的第一条语句里设置 GS 基址，此后任何代码都可以安全调用
+// smp_processor_id()；AP 在 ap_main 里加载 GDT 之后立即设置。
+// 注意：重新加载 GS 段寄存器会把 GS 基址清零，内核里任何地方都不应再写 GS。
+
+#define MAX_CPUS ACPI_MAX_CPUS
+#define CACHE_LINE_SIZE 64
+
+#define MSR_GS_BASE         0xC0000101
+#define MSR_KERNEL_GS_BASE  0xC0000102
+
+struct thread;
+struct registers_t;
+
+struct alignas(CACHE_LINE_SIZE) cpu_local {
+    cpu_local* self;            // %gs:0
+    uint32_t cpu_id;            // 逻辑编号，BSP 为 0
+    uint32_t apic_id;
+    volatile bool online;
+    uint64_t stack_top;         // 启动栈栈顶 (BSP 使用引导程序提供的栈，记为 0)
+    uint64_t ist_stack_top;     // 双重错误专用栈
+    uint64_t online_ns;         // 上线时刻 (单调时钟)
+    volatile uint32_t irq_nesting;      // 硬件中断嵌套深度，由 isr_handler 维护
+    volatile uint32_t preempt_count;    // 禁止抢占的嵌套深度 (RCU 读侧临界区和自旋锁也计在这里)
+    thread* current;                    // 正在运行的线程
+    volatile bool need_resched;         // 调度器要求尽快切换 (其他 CPU 也会写)
+    registers_t* irq_regs;              // 最内层中断保存的现场，不在中断里时为空
+};
+
+extern cpu_local cpu_locals[MAX_CPUS];
+
+static inline uint32_t smp_processor_id() {
+    uint32_t id;
+    asm volatile("movl %%gs:%c1, %0" : "=r"(id) : "i"(offsetof(cpu_local, cpu_id)));
+    return id;
+}
+
+static inline cpu_local* this_cpu() {
+    cpu_local* self;
+    asm volatile("movq %%gs:%c1, %0" : "=r"(self) : "i"(offsetof(cpu_local, self)));
+    return self;
+}
+
+// 读侧临界区的标记：一次 %gs: 相对的加减，不涉及原子操作和共享缓存行
+static inline void preempt_disable() {
+    asm volatile("incl %%gs:%c0" :: "i"(offsetof(cpu_local, preempt_count)) : "memory", "cc");
+}
+
+// 计数回到 0 且有切换请求时立即让出 CPU (中断上下文和关中断时不切换)
+void preempt_schedule();
+
+static inline void preempt_enable() {
+    asm volatile("decl %%gs:%c0" :: "i"(offsetof(cpu_local, preempt_count)) : "memory", "cc");
+    bool resched;
+    asm volatile("movb %%gs:%c1, %0" : "=q"(resched) : "i"(offsetof(cpu_local, need_resched)));
+    if (resched) preempt_schedule();
+}
+
+// 只减计数，不检查切换请求 (调度器自己持锁切换时使用)
+static inline void preempt_enable_no_resched() {
+    asm volatile("decl %%gs:%c0" :: "i"(offsetof(cpu_local, preempt_count)) : "memory", "cc");
+}
+
+static inline uint32_t preempt_count() {
+    uint32_t count;
+    asm volatile("movl %%gs:%c1, %0" : "=r"(count) : "i"(offsetof(cpu_local, preempt_count)));
+    return count;
+}
+
+// 把当前 CPU 的 GS 基址指向 cpu_locals[cpu]
+void percpu_setup(uint32_t cpu, uint32_t apic_id);
+
+// ==========================================================================
+// 类型化的每 CPU 变量
+// ==========================================================================
+// 每个 CPU 一份 T，各自独占缓存行，避免不同 CPU 写相邻变量时互相失效。
+//   static per_cpu<foo> foos;
+//   foos->x++;            // 本 CPU 的副本
+//   foos.on(cpu).x;       // 指定 CPU 的副本 (统计、远程检查)
+// 本 CPU 副本只在不会迁移的上下文里使用 (关中断、中断处理函数或者绑定在该 CPU 上)。
+
+template <typename T>
+class per_cpu {
+    struct alignas(CACHE_LINE_SIZE) slot {
+        T value;
+    };
+    slot slots[MAX_CPUS];
+
+public:
+    T& get() { return slots[smp_processor_id()].value; }
+    T& on(uint32_t cpu) { return slots[cpu].value; }
+    const T& on(uint32_t cpu) const { return slots[cpu].value; }
+    T* operator->() { return &get(); }
+};
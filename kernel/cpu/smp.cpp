@@ -0,0 +1,304 @@
+#include "smp.h"
+#include "gdt.h"
+#include "idt.h"
+#include "irq.h"
+#include "kernel/mem/pmm.h"
+#include "kernel/time/clock.h"
+#include "kernel/drivers/tty.h"
+#include "kernel/klog.h"
+#include "kernel/sync/rcu.h"
+#include "kernel/sched/sched.h"
+#include "kernel/sched/idle.h"
+#include "kernel/time/tick.h"
+#include "kernel/softirq.h"
+#include "lib/libc.h"
+
+cpu_local cpu_locals[MAX_CPUS];
+
+// 与 smp_trampoline.asm 末尾的参数区逐字节对应
+struct trampoline_params {
+    uint64_t cr0;
+    uint64_t cr3;
+    uint64_t cr4;
+    uint64_t efer;
+    uint64_t stack_top;
+    uint64_t entry;
+    uint64_t cpu;
+    uint32_t pm32_offset;       // 以下三项初始为相对跳板起点的偏移，复制后加上基址
+    uint16_t pm32_selector;
+    uint16_t pad0;
+    uint32_t lm64_offset;
+    uint16_t lm64_selector;
+    uint16_t pad1;
+    uint16_t gdt_limit;
+    uint32_t gdt_base;
+    uint16_t pad2;
+} __attribute__((packed));
+
+extern "C" const uint8_t smp_trampoline_start[];
+extern "C" const uint8_t smp_trampoline_params[];
+extern "C" const uint8_t smp_trampoline_end[];
+
+#define MSR_EFER            0xC0000080
+#define LOW_MEMORY_END      0x100000    // SIPI 只能指向 1MiB 以下
+#define AP_BOOT_TIMEOUT_MS  100
+#define VECTOR_DOUBLE_FAULT 8
+
+enum cpu_boot_state : uint8_t {
+    CPU_ABSENT,
+    CPU_ONLINE,
+    CPU_NO_MEMORY,
+    CPU_TIMEOUT,
+};
+
+static const char* const state_names[] = { "absent", "online", "no memory", "timeout" };
+
+static cpu_boot_state cpu_states[MAX_CPUS];
+static uint64_t boot_latency_ns[MAX_CPUS];
+static uint32_t possible_cpus = 1;
+static volatile uint32_t online_count = 1;
+static uint64_t trampoline_base = 0;
+
+// 所有 AP 共用一份跳板参数。AP 进入 ap_main 时把状态从等待改成已启动，表示已经
+// 用完参数；BSP 超时时改成放弃，之后才到达的 AP 看到放弃就停机，不会再上线，
+// BSP 也不再启动后面的 AP，参数不会在慢 AP 还在读时被改写
+enum ap_boot_ack : uint32_t {
+    AP_BOOT_WAITING,
+    AP_BOOT_STARTED,
+    AP_BOOT_ABANDONED,
+};
+static volatile uint32_t ap_boot_ack = AP_BOOT_WAITING;
+
+static inline uint64_t read_cr0() { uint64_t v; asm volatile("mov %%cr0, %0" : "=r"(v)); return v; }
+static inline uint64_t read_cr3() { uint64_t v; asm volatile("mov %%cr3, %0" : "=r"(v)); return v; }
+static inline uint64_t read_cr4() { uint64_t v; asm volatile("mov %%cr4, %0" : "=r"(v)); return v; }
+
+void percpu_setup(uint32_t cpu, uint32_t apic_id) {
+    cpu_local* c = &cpu_locals[cpu];
+    c->self = c;
+    c->cpu_id = cpu;
+    c->apic_id = apic_id;
+    // BSP 从这里开始就在运行；AP 要等本地 APIC 也设置好之后才标记在线
+    if (cpu == 0) c->online = true;
+    wrmsr(MSR_GS_BASE, (uint64_t)c);
+}
+
+// ==========================================================================
+// AP 入口
+// ==========================================================================
+
+extern "C" void ap_main(uint32_t cpu) {
+    uint32_t expected = AP_BOOT_WAITING;
+    if (!__atomic_compare_exchange_n(&ap_boot_ack, &expected, AP_BOOT_STARTED, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        // BSP 已经按超时放弃了这个 CPU
+        for (;;) asm volatile("cli; hlt");
+    }
+    cpu_local* c = &cpu_locals[cpu];
+    gdt_init_cpu(cpu, c->ist_stack_top);
+    idt_load_cpu();
+    percpu_setup(cpu, c->apic_id);
+    apic_init_ap();
+    // 当前上下文成为本 CPU 的空闲线程；有 LAPIC 定时器时本 CPU 也有自己的节拍
+    sched_init_ap(cpu);
+    tick_init_ap();
+
+    c->online_ns = clock_monotonic_ns();
+    __atomic_store_n(&c->online, true, __ATOMIC_RELEASE);
+
+    // 空闲循环：有线程可运行时切换过去，否则交给空闲调节器，深度空闲期间对 RCU 而言是静止的
+    for (;;) {
+        if (softirq_pending()) do_softirq();
+        asm volatile("cli");
+        if (need_resched()) {
+            asm volatile("sti");
+            schedule();
+            continue;
+        }
+        if (softirq_pending()) {
+            asm volatile("sti");
+            continue;
+        }
+        cpu_idle();
+    }
+}
+
+// ==========================================================================
+// 启动
+// ==========================================================================
+
+// 在低 1MiB 的可用内存里找一页放跳板 (buddy 不管理这部分内存，不会被别人占用)
+static uint64_t smp_find_trampoline_page(stivale_struct* boot_info) {
+    uint64_t size = smp_trampoline_end - smp_trampoline_start;
+    stivale_mmap_entry* mmap = (stivale_mmap_entry*)boot_info->memory_map_addr;
+    for (uint64_t i = 0; i < boot_info->memory_map_entries; i++) {
+        if (mmap[i].type != STIVALE_MMAP_USABLE) continue;
+        // 跳过第 0 页：SIPI 向量 0 无效，而且那里是实模式中断向量表
+        uint64_t base = mmap[i].base < PAGE_SIZE ? PAGE_SIZE : mmap[i].base;
+        base = (base + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+        uint64_t end = mmap[i].base + mmap[i].length;
+        if (base + PAGE_SIZE <= LOW_MEMORY_END && base + size <= end) return base;
+    }
+    return 0;
+}
+
+static trampoline_params* smp_install_trampoline(uint64_t base) {
+    uint64_t size = smp_trampoline_end - smp_trampoline_start;
+    memcpy((void*)base, smp_trampoline_start, size);
+
+    trampoline_params* p = (trampoline_params*)(base + (smp_trampoline_params - smp_trampoline_start));
+    p->pm32_offset += (uint32_t)base;
+    p->lm64_offset += (uint32_t)base;
+    p->gdt_base += (uint32_t)base;
+    p->cr0 = read_cr0();
+    p->cr3 = read_cr3();
+    p->cr4 = read_cr4();
+    p->efer = rdmsr(MSR_EFER);
+    p->entry = (uint64_t)ap_main;
+    return p;
+}
+
+static bool smp_boot_ap(uint32_t cpu, uint32_t apic_id, volatile trampoline_params* params) {
+    cpu_local* c = &cpu_locals[cpu];
+    c->cpu_id = cpu;
+    c->apic_id = apic_id;
+
+    void* stack = buddy_alloc(SMP_AP_STACK_SIZE);
+    void* ist = buddy_alloc(IST_STACK_SIZE);
+    if (!stack || !ist) {
+        if (stack) buddy_free(stack, SMP_AP_STACK_SIZE);
+        if (ist) buddy_free(ist, IST_STACK_SIZE);
+        cpu_states[cpu] = CPU_NO_MEMORY;
+        pr_err("smp: no memory for CPU %u stacks", cpu);
+        return false;
+    }
+    c->stack_top = (uint64_t)stack + SMP_AP_STACK_SIZE;
+    c->ist_stack_top = (uint64_t)ist + IST_STACK_SIZE;
+    __atomic_store_n(&ap_boot_ack, AP_BOOT_WAITING, __ATOMIC_RELEASE);
+    params->stack_top = c->stack_top;
+    params->cpu = cpu;
+
+    // INIT，等待 10ms，再发两次 SIPI (第二次只是为了防止第一次丢失，已在运行的 AP 会忽略)
+    uint64_t start = clock_monotonic_ns();
+    lapic_send_ipi(apic_id, LAPIC_ICR_INIT | LAPIC_ICR_ASSERT | LAPIC_ICR_LEVEL);
+    mdelay(10);
+    for (int i = 0; i < 2; i++) {
+        lapic_send_ipi(apic_id, LAPIC_ICR_STARTUP | (uint32_t)(trampoline_base >> 12));
+        udelay(200);
+    }
+
+    uint64_t deadline = start + AP_BOOT_TIMEOUT_MS * 1000000ull;
+    while (!__atomic_load_n(&c->online, __ATOMIC_ACQUIRE)) {
+        uint32_t expected = AP_BOOT_WAITING;
+        // 已经进入 ap_main 的 AP 在运行内核代码，只是还没做完初始化，继续等
+        if (clock_monotonic_ns() > deadline &&
+            __atomic_compare_exchange_n(&ap_boot_ack, &expected, AP_BOOT_ABANDONED, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            // 再发一次 INIT 把它停在等待 SIPI 的状态。栈不回收：AP 可能正在跳板里用它
+            lapic_send_ipi(apic_id, LAPIC_ICR_INIT | LAPIC_ICR_ASSERT | LAPIC_ICR_LEVEL);
+            cpu_states[cpu] = CPU_TIMEOUT;
+            pr_err("smp: CPU %u (APIC %u) did not come online", cpu, apic_id);
+            return false;
+        }
+        asm volatile("pause");
+    }
+    boot_latency_ns[cpu] = c->online_ns - start;
+    cpu_states[cpu] = CPU_ONLINE;
+    online_count++;
+    return true;
+}
+
+void smp_init(stivale_struct* boot_info) {
+    cpu_local* bsp = &cpu_locals[0];
+
+    // BSP 也换成自己的 GDT 和 TSS，双重错误在独立的栈上处理
+    void* ist = buddy_alloc(IST_STACK_SIZE);
+    bsp->ist_stack_top = ist ? (uint64_t)ist + IST_STACK_SIZE : 0;
+    gdt_init_cpu(0, bsp->ist_stack_top);
+    if (ist) idt_set_ist(VECTOR_DOUBLE_FAULT, IST_DOUBLE_FAULT);
+
+    bsp->online_ns = clock_monotonic_ns();
+    cpu_states[0] = CPU_ONLINE;
+    smp_call_init();
+
+    const madt_info* madt = acpi_get_madt();
+    if (!irq_using_apic() || !madt->valid) {
+        pr_info("smp: no local APIC, running on the boot CPU only");
+        return;
+    }
+    bsp->apic_id = lapic_id();
+
+    // 跳板在 32 位模式下加载 CR3，页表必须在 4GiB 以下
+    if (read_cr3() >> 32) {
+        pr_warn("smp: page tables above 4GiB, APs not started");
+        return;
+    }
+    trampoline_base = smp_find_trampoline_page(boot_info);
+    if (!trampoline_base) {
+        pr_warn("smp: no free page below 1MiB for the AP trampoline");
+        return;
+    }
+    volatile trampoline_params* params = smp_install_trampoline(trampoline_base);
+
+    uint32_t next = 1;
+    bool stopped = false;
+    for (uint32_t i = 0; i < madt->cpu_count && next < MAX_CPUS; i++) {
+        uint32_t apic_id = madt->cpu_apic_ids[i];
+        if (apic_id == bsp->apic_id) continue;
+        possible_cpus++;
+        if (stopped) {
+            cpu_locals[next++].apic_id = apic_id;
+            continue;
+        }
+        uint32_t cpu = next++;
+        // 超时的 AP 也许还在跳板里读参数，不能改写它们去启动下一个
+        if (!smp_boot_ap(cpu, apic_id, params) && cpu_states[cpu] == CPU_TIMEOUT) {
+            pr_warn("smp: not starting the remaining APs");
+            stopped = true;
+        }
+    }
+    pr_info("smp: %u of %u CPUs online", online_count, possible_cpus);
+}
+
+uint32_t smp_possible_cpus() {
+    return possible_cpus;
+}
+
+uint32_t smp_online_cpus() {
+    return online_count;
+}
+
+bool cpu_online(uint32_t cpu) {
+    return cpu < MAX_CPUS && __atomic_load_n(&cpu_locals[cpu].online, __ATOMIC_ACQUIRE);
+}
+
+void smp_dump() {
+    tty_print("\n--- CPUs ---\n", 0xFFFF00);
+    tty_print("Online: ", 0xFFFFFF);
+    print_dec(online_count, 0x00FF00);
+    tty_print(" / ", 0xFFFFFF);
+    print_dec(possible_cpus, 0x00FFFF);
+    if (trampoline_base) {
+        tty_print("  Trampoline: ", 0xFFFFFF);
+        print_hex(trampoline_base, 0x00FFFF);
+    }
+    tty_print("\n", 0xFFFFFF);
+
+    for (uint32_t cpu = 0; cpu < possible_cpus; cpu++) {
+        const cpu_local* c = &cpu_locals[cpu];
+        tty_print("  CPU ", 0xFFFFFF);
+        print_dec(cpu, 0x00FF00);
+        tty_print(cpu == 0 ? " (BSP)" : "      ", 0xAAAAAA);
+        tty_print("  APIC ", 0xFFFFFF);
+        print_dec(c->apic_id, 0x00FFFF);
+        tty_print("  ", 0xFFFFFF);
+        tty_print(state_names[cpu_states[cpu]], cpu_states[cpu] == CPU_ONLINE ? 0x00FF00 : 0xFF8800);
+        if (cpu != 0 && cpu_states[cpu] == CPU_ONLINE) {
+            tty_print("  boot ", 0xFFFFFF);
+            print_dec(boot_latency_ns[cpu] / 1000, 0x00FFFF);
+            tty_print(" us  stack ", 0xFFFFFF);
+            print_hex(c->stack_top, 0xAAAAAA);
+        }
+        tty_print(cpu == smp_processor_id() ? "  <- current\n" : "\n", 0xAAAAAA);
+    }
+}
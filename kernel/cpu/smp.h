@@ -0,0 +1,73 @@
+#pragma once
+#include <stdint.h>
+#include <stivale.h>
+#include "percpu.h"
+
+// ==========================================================================
+// 多处理器
+// ==========================================================================
+// BSP 按 MADT 中列出的 LAPIC ID 逐个用 INIT-SIPI-SIPI 唤醒 AP。逻辑编号按
+// 唤醒顺序分配 (BSP 为 0)，与 APIC ID 无关。AP 上线后加载自己的 GDT/TSS、
+// 共用的 IDT，设置 GS 基址和本地 APIC，然后停在 hlt 里等待中断。
+
+#define SMP_AP_STACK_SIZE   16384
+
+// 建立 BSP 的 GDT/TSS 并启动所有 AP；需要 buddy 分配器和已校准的时钟
+void smp_init(stivale_struct* boot_info);
+
+uint32_t smp_possible_cpus();   // MADT 中可用的 CPU 数
+uint32_t smp_online_cpus();
+bool cpu_online(uint32_t cpu);
+
+// 打印每个 CPU 的状态
+void smp_dump();
+
+// ==========================================================================
+// 跨 CPU 函数调用
+// ==========================================================================
+// 每个 CPU 有一个无锁的调用队列 (单链表栈，发送方 CAS 压入，接收方一次取走整条链)。
+// 只有把队列从空变为非空的那次压入才发 IPI，之后压入的请求搭同一个 IPI 的便车；
+// 接收方在 LAPIC_CALL_VECTOR 中断里按提交顺序执行整条链。
+// 发给所有其他在线 CPU 且它们都需要 IPI 时，用一次“除自己以外”的广播代替逐个发送。
+//
+// 被调用的函数在目标 CPU 的中断上下文里执行 (关中断)，必须短小且不能睡眠。
+// wait 为 true 时等到所有目标执行完毕才返回；等待期间会处理发给本 CPU 的调用，
+// 两个 CPU 互相同步调用不会死锁。
+
+typedef void (*smp_call_func_t)(void* info);
+
+#define CSD_LOCKED  (1u << 0)       // 已入队，尚未执行完
+#define CSD_WAIT    (1u << 1)       // 发送方在等：执行完才解锁，而不是执行前
+
+struct call_single_data {
+    call_single_data* next;
+    smp_call_func_t func;
+    void* info;
+    volatile uint32_t flags;
+};
+
+// 登记调用中断的处理函数，由 smp_init 调用
+void smp_call_init();
+
+// 在 cpu 上执行 func(info)；cpu 是自己时直接在关中断下调用。目标不在线返回 false
+bool smp_call_function_single(uint32_t cpu, smp_call_func_t func, void* info, bool wait);
+// 调用者自带 csd 的异步版本：func/info 由调用者填好，csd 解锁前不能复用。
+// 多个 csd 连续发往同一 CPU 时只会产生一个 IPI
+bool smp_call_function_single_async(uint32_t cpu, call_single_data* csd);
+// 在除自己以外的所有在线 CPU 上执行，返回目标 CPU 数
+uint32_t smp_call_function(smp_call_func_t func, void* info, bool wait);
+// 在所有在线 CPU (包括自己) 上执行
+void on_each_cpu(smp_call_func_t func, void* info, bool wait);
+
+struct smp_call_stats {
+    uint64_t queued;            // 入队的调用
+    uint64_t ipis;              // 实际发出的单播 IPI
+    uint64_t broadcasts;        // 广播 IPI
+    uint64_t handled;           // 在本 CPU 上执行的调用
+    uint64_t interrupts;        // 收到的调用中断 (一次可能执行多个调用)
+};
+
+void smp_call_get_stats(uint32_t cpu, smp_call_stats* stats);
+void smp_call_dump();
+// 测量到每个 CPU 的 IPI 往返延迟、广播延迟和合并效果，结果直接打印
+void smp_call_benchmark();
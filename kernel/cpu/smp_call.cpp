@@ -0,0 +1,312 @@
+#include "smp.h"
+#include "apic.h"
+#include "isr.h"
+#include "kernel/sync/spinlock.h"
+#include "kernel/time/clock.h"
+#include "kernel/drivers/tty.h"
+#include "lib/libc.h"
+
+// ==========================================================================
+// 每 CPU 状态
+// ==========================================================================
+
+struct call_queue {
+    call_single_data* volatile first;   // 待执行的调用，后入队的在前
+    smp_call_stats stats;               // 发送方计数记在发送方，接收方计数记在接收方
+};
+
+// smp_call_function / 不等待的 smp_call_function_single 使用的 csd，
+// 每个发送方对每个目标各一个，复用前要等上一次的调用执行完
+struct call_function_data {
+    call_single_data csd[MAX_CPUS];
+};
+
+static per_cpu<call_queue> call_queues;
+static per_cpu<call_function_data> call_data;
+static bool broadcast_enabled = true;
+
+// ==========================================================================
+// 队列
+// ==========================================================================
+
+// 压入目标 CPU 的队列；返回 true 表示队列原来是空的，需要发 IPI
+static bool call_enqueue(uint32_t cpu, call_single_data* csd) {
+    call_queue* q = &call_queues.on(cpu);
+    call_single_data* head = __atomic_load_n(&q->first, __ATOMIC_RELAXED);
+    do {
+        csd->next = head;
+    } while (!__atomic_compare_exchange_n(&q->first, &head, csd, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    return head == nullptr;
+}
+
+static inline void csd_unlock(call_single_data* csd) {
+    __atomic_fetch_and(&csd->flags, ~CSD_LOCKED, __ATOMIC_RELEASE);
+}
+
+// 执行本 CPU 队列里的全部调用 (关中断下调用)
+static void call_flush_queue() {
+    call_queue* q = &call_queues.get();
+    call_single_data* list = __atomic_exchange_n(&q->first, nullptr, __ATOMIC_ACQUIRE);
+    if (!list) return;
+
+    // 链表是后进先出，反转后按提交顺序执行
+    call_single_data* ordered = nullptr;
+    while (list) {
+        call_single_data* next = list->next;
+        list->next = ordered;
+        ordered = list;
+        list = next;
+    }
+
+    while (ordered) {
+        call_single_data* csd = ordered;
+        // 解锁之后发送方可能立即复用 csd，需要的字段先取出来
+        ordered = csd->next;
+        smp_call_func_t func = csd->func;
+        void* info = csd->info;
+        if (csd->flags & CSD_WAIT) {
+            func(info);
+            csd_unlock(csd);
+        } else {
+            csd_unlock(csd);
+            func(info);
+        }
+        q->stats.handled++;
+    }
+}
+
+// 等 csd 执行完；期间处理发给自己的调用，两个 CPU 同时互相调用时不会死锁
+static void csd_lock_wait(call_single_data* csd) {
+    while (__atomic_load_n(&csd->flags, __ATOMIC_ACQUIRE) & CSD_LOCKED) {
+        call_flush_queue();
+        cpu_relax();
+    }
+}
+
+static irq_return_t call_ipi_irq(registers_t*, void*) {
+    call_queues->stats.interrupts++;
+    call_flush_queue();
+    return IRQ_HANDLED;
+}
+
+void smp_call_init() {
+    register_irq_handler(LAPIC_CALL_VECTOR, call_ipi_irq, nullptr);
+}
+
+// ==========================================================================
+// 发起调用
+// ==========================================================================
+
+static void call_send_ipi(uint32_t cpu) {
+    lapic_send_ipi(cpu_locals[cpu].apic_id, LAPIC_ICR_FIXED | LAPIC_CALL_VECTOR);
+    call_queues->stats.ipis++;
+}
+
+static void call_run_local(smp_call_func_t func, void* info) {
+    uint64_t flags = local_irq_save();
+    func(info);
+    local_irq_restore(flags);
+}
+
+bool smp_call_function_single_async(uint32_t cpu, call_single_data* csd) {
+    if (!cpu_online(cpu)) return false;
+    uint64_t flags = local_irq_save();
+    if (cpu == smp_processor_id()) {
+        csd->flags = 0;
+        csd->func(csd->info);
+        local_irq_restore(flags);
+        return true;
+    }
+    csd->flags = CSD_LOCKED;
+    call_queues->stats.queued++;
+    if (call_enqueue(cpu, csd)) call_send_ipi(cpu);
+    local_irq_restore(flags);
+    return true;
+}
+
+bool smp_call_function_single(uint32_t cpu, smp_call_func_t func, void* info, bool wait) {
+    if (!cpu_online(cpu)) return false;
+    if (cpu == smp_processor_id()) {
+        call_run_local(func, info);
+        return true;
+    }
+
+    call_single_data on_stack;
+    uint64_t flags = local_irq_save();
+    call_single_data* csd = &on_stack;
+    if (!wait) {
+        csd = &call_data->csd[cpu];
+        csd_lock_wait(csd);
+    }
+    csd->func = func;
+    csd->info = info;
+    csd->flags = CSD_LOCKED | (wait ? CSD_WAIT : 0);
+    call_queues->stats.queued++;
+    if (call_enqueue(cpu, csd)) call_send_ipi(cpu);
+    if (wait) csd_lock_wait(csd);
+    local_irq_restore(flags);
+    return true;
+}
+
+uint32_t smp_call_function(smp_call_func_t func, void* info, bool wait) {
+    uint64_t flags = local_irq_save();
+    uint32_t self = smp_processor_id();
+    call_function_data* cfd = &call_data.get();
+
+    uint32_t targets = 0, ipi_count = 0;
+    uint64_t need_ipi = 0;
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (cpu == self || !cpu_online(cpu)) continue;
+        call_single_data* csd = &cfd->csd[cpu];
+        csd_lock_wait(csd);
+        csd->func = func;
+        csd->info = info;
+        csd->flags = CSD_LOCKED | (wait ? CSD_WAIT : 0);
+        if (call_enqueue(cpu, csd)) {
+            need_ipi |= 1ull << cpu;
+            ipi_count++;
+        }
+        targets++;
+    }
+    call_queues->stats.queued += targets;
+
+    if (need_ipi) {
+        // 所有 CPU 都在线而且每个目标都需要 IPI 时，一次广播代替逐个发送；
+        // 有没能上线的 CPU 时不能用，广播会打到它们身上
+        if (broadcast_enabled && ipi_count == targets &&
+            smp_online_cpus() == smp_possible_cpus()) {
+            lapic_send_ipi_all_but_self(LAPIC_ICR_FIXED | LAPIC_CALL_VECTOR);
+            call_queues->stats.broadcasts++;
+        } else {
+            for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+                if (need_ipi & (1ull << cpu)) call_send_ipi(cpu);
+            }
+        }
+    }
+
+    if (wait) {
+        for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+            if (cpu != self && cpu_online(cpu)) csd_lock_wait(&cfd->csd[cpu]);
+        }
+    }
+    local_irq_restore(flags);
+    return targets;
+}
+
+void on_each_cpu(smp_call_func_t func, void* info, bool wait) {
+    uint64_t flags = local_irq_save();
+    smp_call_function(func, info, wait);
+    func(info);
+    local_irq_restore(flags);
+}
+
+// ==========================================================================
+// 统计与测试
+// ==========================================================================
+
+void smp_call_get_stats(uint32_t cpu, smp_call_stats* stats) {
+    *stats = call_queues.on(cpu).stats;
+}
+
+void smp_call_dump() {
+    tty_print("\nCPU     queued      ipis  broadcast    handled  interrupts\n", 0xFFFF00);
+    char line[80];
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (!cpu_online(cpu)) continue;
+        const smp_call_stats* s = &call_queues.on(cpu).stats;
+        snprintf(line, sizeof(line), "%3u %10llu %9llu %10llu %10llu %11llu\n", cpu,
+                 (unsigned long long)s->queued, (unsigned long long)s->ipis,
+                 (unsigned long long)s->broadcasts, (unsigned long long)s->handled,
+                 (unsigned long long)s->interrupts);
+        tty_print(line, 0xFFFFFF);
+    }
+}
+
+#define BENCH_ROUNDS    1000
+#define BENCH_BURST     64
+
+static void bench_nop(void*) {
+}
+
+static void bench_count(void* info) {
+    __atomic_fetch_add((volatile uint32_t*)info, 1, __ATOMIC_RELAXED);
+}
+
+static void bench_print(const char* label, uint64_t min, uint64_t total, uint64_t max) {
+    char line[80];
+    snprintf(line, sizeof(line), "  %-16s min %6llu  avg %6llu  max %7llu ns\n", label,
+             (unsigned long long)clock_cycles_to_ns(min),
+             (unsigned long long)clock_cycles_to_ns(total / BENCH_ROUNDS),
+             (unsigned long long)clock_cycles_to_ns(max));
+    tty_print(line, 0xFFFFFF);
+}
+
+static void bench_broadcast(const char* label) {
+    uint64_t min = UINT64_MAX, max = 0, total = 0;
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        uint64_t start = rdtsc();
+        smp_call_function(bench_nop, nullptr, true);
+        uint64_t cycles = rdtsc() - start;
+        total += cycles;
+        if (cycles < min) min = cycles;
+        if (cycles > max) max = cycles;
+    }
+    bench_print(label, min, total, max);
+}
+
+void smp_call_benchmark() {
+    uint32_t self = smp_processor_id();
+    if (smp_online_cpus() < 2) {
+        tty_print("\nOnly one CPU online, nothing to measure.\n", 0xFF8800);
+        return;
+    }
+    tty_print("\nIPI round trip (synchronous call, ", 0xFFFF00);
+    print_dec(BENCH_ROUNDS, 0x00FFFF);
+    tty_print(" rounds)\n", 0xFFFF00);
+
+    char label[24];
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (cpu == self || !cpu_online(cpu)) continue;
+        uint64_t min = UINT64_MAX, max = 0, total = 0;
+        for (int i = 0; i < BENCH_ROUNDS; i++) {
+            uint64_t start = rdtsc();
+            smp_call_function_single(cpu, bench_nop, nullptr, true);
+            uint64_t cycles = rdtsc() - start;
+            total += cycles;
+            if (cycles < min) min = cycles;
+            if (cycles > max) max = cycles;
+        }
+        snprintf(label, sizeof(label), "CPU %u", cpu);
+        bench_print(label, min, total, max);
+    }
+
+    bench_broadcast("all, broadcast");
+    broadcast_enabled = false;
+    bench_broadcast("all, unicast");
+    broadcast_enabled = true;
+
+    // 合并：连续发往同一 CPU 的异步调用只有第一个需要 IPI
+    uint32_t target = self == 0 ? 1 : 0;
+    while (!cpu_online(target)) target++;
+    static call_single_data burst[BENCH_BURST];
+    volatile uint32_t done = 0;
+    uint64_t ipis_before = call_queues->stats.ipis;
+    uint64_t flags = local_irq_save();
+    for (int i = 0; i < BENCH_BURST; i++) {
+        csd_lock_wait(&burst[i]);
+        burst[i].func = bench_count;
+        burst[i].info = (void*)&done;
+        smp_call_function_single_async(target, &burst[i]);
+    }
+    local_irq_restore(flags);
+    while (done < BENCH_BURST) cpu_relax();
+
+    tty_print("  Burst of ", 0xFFFFFF);
+    print_dec(BENCH_BURST, 0x00FFFF);
+    tty_print(" async calls to CPU ", 0xFFFFFF);
+    print_dec(target, 0x00FF00);
+    tty_print(": ", 0xFFFFFF);
+    print_dec(call_queues->stats.ipis - ipis_before, 0x00FF00);
+    tty_print(" IPIs\n", 0xFFFFFF);
+}
@@ -0,0 +1,116 @@
+; AP 启动跳板
+; BSP 把 smp_trampoline_start..smp_trampoline_end 复制到低 1MiB 内一个 4K 对齐的
+; 空闲页 (页号即 SIPI 向量)，填好末尾的参数区后发送 INIT-SIPI-SIPI。
+; AP 从实模式开始执行：实模式 -> 保护模式 -> 长模式，沿用 BSP 的页表和控制寄存器，
+; 最后切到参数区给出的栈，调用 ap_main(cpu)。
+; 代码与复制的位置无关：实模式下 DS = CS，之后用 ebx/rbx 保存跳板基址；
+; 几个远跳转目标和 GDTR 基址在参数区里以相对偏移给出，由 BSP 加上基址。
+
+; 参数区偏移，与 smp.cpp 中的 trampoline_params 保持一致
+P_CR0   equ 0
+P_CR3   equ 8
+P_CR4   equ 16
+P_EFER  equ 24
+P_STACK equ 32
+P_ENTRY equ 40
+P_CPU   equ 48
+P_PM32  equ 56      ; m16:32 远指针
+P_LM64  equ 64      ; m16:32 远指针
+P_GDTR  equ 72
+
+%define P_OFF(x) (smp_trampoline_params - smp_trampoline_start + (x))
+
+CR4_PCIDE equ (1 << 17)
+EFER_LMA  equ (1 << 10)
+MSR_EFER  equ 0xC0000080
+
+section .rodata
+align 16
+
+global smp_trampoline_start
+global smp_trampoline_params
+global smp_trampoline_end
+
+[bits 16]
+smp_trampoline_start:
+  cli
+  cld
+  mov ax, cs
+  mov ds, ax
+  movzx ebx, ax
+  shl ebx, 4                    ; ebx = 跳板物理基址
+  o32 lgdt [P_OFF(P_GDTR)]
+  mov eax, cr0
+  or eax, 1                     ; PE
+  mov cr0, eax
+  o32 jmp far [P_OFF(P_PM32)]
+
+[bits 32]
+tramp_pm32:
+  mov ax, 0x10
+  mov ds, ax
+  mov es, ax
+  mov ss, ax
+
+  ; 与 BSP 相同的 CR4 (PAE、OSFXSR 等)；PCIDE 只能在长模式下置位
+  mov eax, [ebx + P_OFF(P_CR4)]
+  and eax, ~CR4_PCIDE
+  mov cr4, eax
+
+  mov eax, [ebx + P_OFF(P_CR3)]
+  mov cr3, eax
+
+  ; LME/NXE/SCE 照抄 BSP；LMA 由处理器在开启分页时自己置位
+  mov ecx, MSR_EFER
+  mov eax, [ebx + P_OFF(P_EFER)]
+  and eax, ~EFER_LMA
+  xor edx, edx
+  wrmsr
+
+  ; 开启分页 (同时带上 WP/NE/MP 等 BSP 的设置)，进入兼容模式
+  mov eax, [ebx + P_OFF(P_CR0)]
+  mov cr0, eax
+  jmp far [ebx + P_OFF(P_LM64)]
+
+[bits 64]
+tramp_lm64:
+  mov ebx, ebx                  ; 模式切换后高 32 位未定义，清零
+  mov ax, 0x10
+  mov ds, ax
+  mov es, ax
+  mov ss, ax
+
+  mov rax, [rbx + P_OFF(P_CR4)]
+  mov cr4, rax
+
+  mov rsp, [rbx + P_OFF(P_STACK)]
+  xor ebp, ebp
+  mov edi, [rbx + P_OFF(P_CPU)]
+  mov rax, [rbx + P_OFF(P_ENTRY)]
+  call rax
+.hang:
+  cli
+  hlt
+  jmp .hang
+
+; 选择子与内核 GDT 一致 (0x08 代码、0x10 数据)，进入 ap_main 后不必重新加载 CS
+align 16
+tramp_gdt:
+  dq 0
+  dq 0x00209A0000000000         ; 0x08 64 位代码段
+  dq 0x00CF92000000FFFF         ; 0x10 平坦 4GiB 数据段
+  dq 0x00CF9A000000FFFF         ; 0x18 32 位代码段
+tramp_gdt_end:
+
+align 8
+smp_trampoline_params:
+  times 7 dq 0                  ; cr0 cr3 cr4 efer stack entry cpu
+  dd tramp_pm32 - smp_trampoline_start
+  dw 0x18, 0
+  dd tramp_lm64 - smp_trampoline_start
+  dw 0x08, 0
+  dw tramp_gdt_end - tramp_gdt - 1
+  dd tramp_gdt - smp_trampoline_start
+  dw 0
+
+smp_trampoline_end:
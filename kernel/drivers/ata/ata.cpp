@@ -1,8 +1,21 @@
 #include "ata.h"
 #include "kernel/cpu/ports.h"
+#include "kernel/cpu/isr.h"
+#include "kernel/cpu/irq.h"
 #include "kernel/drivers/tty.h"
 #include "lib/libc.h"
 
+// 等待驱动器的上限 (原来的轮询循环大约也是这个量级)
+#define ATA_TIMEOUT_NS      1000000000ull
+// 发命令前等 BSY 清零时的轮询间隔
+#define ATA_POLL_NS         10000ull
+
+static async_event ata_irq_event;       // IRQ14
+static async_event ata_idle_event;      // 通道空闲
+static volatile bool ata_irq_pending = false;
+static volatile bool ata_channel_busy = false;
+static ata_stats stats;
+
 //  辅助函数 
 
 // 等待 BSY 位清零，带有超时机制
@@ -35,32 +48,121 @@ static bool ata_read_buffer(uint16_t* buffer, size_t words) {
     return true;
 }
 
+static void ata_issue_read(uint64_t lba, uint8_t num_sectors) {
+    outb(ATA_MASTER_DRIVE_SEL, 0xE0);
+    outb(ATA_MASTER_SECTOR_COUNT, num_sectors);
+    outb(ATA_MASTER_LBA_LOW, (uint8_t)lba);
+    outb(ATA_MASTER_LBA_MID, (uint8_t)(lba >> 8));
+    outb(ATA_MASTER_LBA_HIGH, (uint8_t)(lba >> 16));
+    outb(ATA_MASTER_COMMAND_PORT, ATA_CMD_READ_PIO);
+}
+
+// IRQ14：读状态端口同时清除驱动器的中断请求，剩下的交给等待中的请求
+static irq_return_t ata_irq(registers_t*, void*) {
+    inb(ATA_MASTER_STATUS_PORT);
+    stats.irqs++;
+    __atomic_store_n(&ata_irq_pending, true, __ATOMIC_RELEASE);
+    async_event_signal(&ata_irq_event);
+    return IRQ_HANDLED;
+}
+
 //  公共接口函数 
-void ata_init() {
+bool ata_init() {
+    async_event_init(&ata_irq_event, "ata_irq");
+    async_event_init(&ata_idle_event, "ata_idle");
+    register_irq_handler(IRQ_VECTOR_BASE + ATA_IRQ, ata_irq, nullptr);
+
     // 我们可以尝试识别一下硬盘
     outb(ATA_MASTER_DRIVE_SEL, 0xA0); // Select master drive
     outb(ATA_MASTER_COMMAND_PORT, ATA_CMD_IDENTIFY);
     if (inb(ATA_MASTER_STATUS_PORT) == 0) {
         tty_print("\nATA: No drive found.", 0xFF6060);
-        return;
+        return false;
     }
+    // 清除 nIEN，让驱动器在扇区就绪时发中断
+    outb(ATA_MASTER_DEV_CTRL, 0x00);
     tty_print("\nATA driver initialized.", 0x4EC9B0);
+    return true;
 }
 
-bool ata_read_sectors(uint8_t drive, uint64_t lba, uint8_t num_sectors, void* buffer) {
-    if (drive > 1) return false;
+// ==========================================================================
+// 异步读
+// ==========================================================================
+
+static bool ata_claim() {
+    return !__atomic_exchange_n(&ata_channel_busy, true, __ATOMIC_ACQUIRE);
+}
+
+static void ata_release() {
+    __atomic_store_n(&ata_channel_busy, false, __ATOMIC_RELEASE);
+    async_event_signal(&ata_idle_event);
+}
+
+static async_status ata_read_fn(async_task* t) {
+    ata_request* req = async_entry(t, ata_request, task);
+    ASYNC_BEGIN(t);
+
+    ASYNC_AWAIT(t, &ata_idle_event, ata_claim());
+    // 上一条命令刚结束时 BSY 很快清零，这里只是兜底
+    ASYNC_POLL_TIMEOUT(t, !(inb(ATA_MASTER_ALT_STATUS) & ATA_SR_BSY), ATA_POLL_NS, ATA_TIMEOUT_NS);
+    if (t->timed_out) {
+        stats.timeouts++;
+        ata_release();
+        ASYNC_RETURN(t);
+    }
+
+    __atomic_store_n(&ata_irq_pending, false, __ATOMIC_RELEASE);
+    ata_issue_read(req->lba, req->num_sectors);
+
+    for (req->sector = 0; req->sector < req->num_sectors; req->sector++) {
+        ASYNC_AWAIT_TIMEOUT(t, &ata_irq_event, __atomic_load_n(&ata_irq_pending, __ATOMIC_ACQUIRE),
+                            ATA_TIMEOUT_NS);
+        if (t->timed_out) {
+            // 中断丢了但数据已经就绪时照常读取
+            if ((inb(ATA_MASTER_ALT_STATUS) & (ATA_SR_BSY | ATA_SR_DRQ)) != ATA_SR_DRQ) {
+                stats.timeouts++;
+                ata_release();
+                ASYNC_RETURN(t);
+            }
+            stats.lost_irqs++;
+        }
+        // 先清标志再取数据：取完这个扇区后驱动器才会为下一个扇区发中断
+        __atomic_store_n(&ata_irq_pending, false, __ATOMIC_RELEASE);
+
+        uint8_t status = inb(ATA_MASTER_STATUS_PORT);
+        if ((status & ATA_SR_ERR) || !(status & ATA_SR_DRQ)) {
+            ata_release();
+            ASYNC_RETURN(t);
+        }
+        uint16_t* words = (uint16_t*)((uintptr_t)req->buffer + req->sector * 512);
+        for (int i = 0; i < 256; i++) {
+            words[i] = inw(ATA_MASTER_DATA_PORT);
+        }
+    }
+
+    req->ok = true;
+    ata_release();
+    ASYNC_END(t);
+}
 
+void ata_read_sectors_async(ata_request* req, void (*done)(async_task* t)) {
+    req->ok = false;
+    req->sector = 0;
+    stats.async_reads++;
+    async_spawn(nullptr, &req->task, ata_read_fn, done);
+}
+
+void ata_get_stats(ata_stats* out) {
+    *out = stats;
+}
+
+static bool ata_read_polled(uint64_t lba, uint8_t num_sectors, void* buffer) {
     if (ata_wait_bsy()) {
         tty_print("ATA: Drive busy timeout!", 0xFF0000);
         return false;
     }
 
-    outb(ATA_MASTER_DRIVE_SEL, 0xE0);
-    outb(ATA_MASTER_SECTOR_COUNT, num_sectors);
-    outb(ATA_MASTER_LBA_LOW, (uint8_t)lba);
-    outb(ATA_MASTER_LBA_MID, (uint8_t)(lba >> 8));
-    outb(ATA_MASTER_LBA_HIGH, (uint8_t)(lba >> 16));
-    outb(ATA_MASTER_COMMAND_PORT, ATA_CMD_READ_PIO);
+    ata_issue_read(lba, num_sectors);
 
     for (uint8_t i = 0; i < num_sectors; i++) {
         if (ata_wait_bsy()) {
@@ -80,4 +182,31 @@ bool ata_read_sectors(uint8_t drive, uint64_t lba, uint8_t num_sectors, void* bu
     }
 
     return true;
+}
+
+bool ata_read_sectors(uint8_t drive, uint64_t lba, uint8_t num_sectors, void* buffer) {
+    if (drive > 1) return false;
+
+    // 可以睡眠的线程交给执行器，等中断期间 CPU 让给别的线程
+    if (async_can_block()) {
+        ata_request req;
+        req.drive = drive;
+        req.lba = lba;
+        req.num_sectors = num_sectors;
+        req.buffer = buffer;
+        ata_read_sectors_async(&req, nullptr);
+        async_wait(&req.task);
+        if (!req.ok) tty_print("ATA: async read failed!", 0xFF0000);
+        return req.ok;
+    }
+
+    // 启动阶段、空闲线程或原子上下文里照旧轮询；这里不能等，通道被占用时直接失败
+    if (!ata_claim()) {
+        tty_print("ATA: channel busy!", 0xFF0000);
+        return false;
+    }
+    stats.polled_reads++;
+    bool ok = ata_read_polled(lba, num_sectors, buffer);
+    ata_release();
+    return ok;
 }
\ No newline at end of file
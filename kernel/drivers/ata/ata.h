@@ -1,6 +1,7 @@
 #pragma once
 #include <stdint.h>
 #include <stddef.h> // for size_t
+#include "kernel/sched/async.h"
 
 // ATA 端口定义 (PIO 模式)
 #define ATA_MASTER_DATA_PORT    0x1F0
@@ -12,6 +13,9 @@
 #define ATA_MASTER_DRIVE_SEL    0x1F6
 #define ATA_MASTER_COMMAND_PORT 0x1F7
 #define ATA_MASTER_STATUS_PORT  0x1F7
+#define ATA_MASTER_ALT_STATUS   0x3F6   // 读：备用状态 (不清除中断)
+#define ATA_MASTER_DEV_CTRL     0x3F6   // 写：设备控制 (bit1 = nIEN)
+#define ATA_IRQ                 14
 
 // ATA 命令
 #define ATA_CMD_READ_PIO    0x20
@@ -24,8 +28,37 @@
 #define ATA_SR_ERR  0x01 // Error
 #define ATA_SR_DRQ  0x08
 
-// 初始化 ATA 驱动
-void ata_init();
+// 初始化 ATA 驱动，没有找到主盘时返回 false
+bool ata_init();
 
 // 读取扇区
 bool ata_read_sectors(uint8_t drive, uint64_t lba, uint8_t num_sectors, void* buffer);
+
+// ==========================================================================
+// 异步读
+// ==========================================================================
+// 每个扇区就绪时驱动器发 IRQ14，请求在异步执行器上等中断，不在状态端口上空转。
+// 同一通道一次只执行一条命令，其余请求在执行器上排队等待。
+
+struct ata_request {
+    async_task task;
+    uint8_t drive;
+    uint8_t num_sectors;
+    uint8_t sector;         // 已读完的扇区数
+    bool ok;
+    uint64_t lba;
+    void* buffer;
+};
+
+// 提交到默认执行器；完成后 req->ok 给出结果，done 可以为空
+void ata_read_sectors_async(ata_request* req, void (*done)(async_task* t));
+
+struct ata_stats {
+    uint64_t irqs;
+    uint64_t async_reads;
+    uint64_t polled_reads;
+    uint64_t lost_irqs;     // 等中断超时但数据已就绪
+    uint64_t timeouts;
+};
+
+void ata_get_stats(ata_stats* stats);
@@ -0,0 +1,159 @@
+#include "console.h"
+#include "serial.h"
+#include "kernel/cpu/ports.h"
+#include "kernel/cpu/percpu.h"
+#include "kernel/sync/spinlock.h"
+#include "lib/libc.h"
+
+// ==========================================================================
+// 控制台多路复用
+// ==========================================================================
+// tty_print 的输出按 console_sinks 分发：帧缓冲由 tty 自己绘制，
+// 串口和 debugcon 在这里处理。无头运行 (-nographic) 时关闭帧缓冲，
+// 省掉逐像素绘制字形和滚屏 memmove 的开销。
+
+static uint32_t console_sinks = CONSOLE_FB;
+static bool debugcon_ok = false;
+
+static spinlock console_spin;
+static volatile int32_t console_owner = -1;   // 持锁的 CPU，-1 表示空闲
+static uint32_t console_depth = 0;             // 持锁 CPU 上的重入层数
+
+// QEMU/Bochs 的 debugcon 在读 0xE9 时会返回 0xE9，借此判断它是否存在
+static bool debugcon_detect() {
+    return inb(DEBUGCON_PORT) == DEBUGCON_PORT;
+}
+
+// 在命令行中查找 "console=" 参数，解析逗号分隔的输出目标列表
+static uint32_t console_parse_cmdline(const char* cmdline, bool* found) {
+    *found = false;
+    if (!cmdline) return 0;
+
+    const char* p = cmdline;
+    while (*p) {
+        if (strncmp(p, "console=", 8) == 0 && (p == cmdline || p[-1] == ' ')) {
+            *found = true;
+            p += 8;
+            uint32_t sinks = 0;
+            while (*p && *p != ' ') {
+                const char* name = p;
+                while (*p && *p != ' ' && *p != ',') p++;
+                size_t len = (size_t)(p - name);
+                if (len == 2 && strncmp(name, "fb", 2) == 0) sinks |= CONSOLE_FB;
+                else if (len == 6 && strncmp(name, "serial", 6) == 0) sinks |= CONSOLE_SERIAL;
+                else if (len == 8 && strncmp(name, "debugcon", 8) == 0) sinks |= CONSOLE_DEBUGCON;
+                if (*p == ',') p++;
+            }
+            return sinks;
+        }
+        p++;
+    }
+    return 0;
+}
+
+void console_init(const char* cmdline) {
+    spin_lock_init(&console_spin, "console");
+    bool found;
+    uint32_t sinks = console_parse_cmdline(cmdline, &found);
+    if (!found) {
+        sinks = CONSOLE_FB | CONSOLE_SERIAL;
+    }
+
+    if ((sinks & CONSOLE_SERIAL) && !serial_init()) {
+        sinks &= ~CONSOLE_SERIAL;
+    }
+    debugcon_ok = debugcon_detect();
+    if (!debugcon_ok) {
+        sinks &= ~CONSOLE_DEBUGCON;
+    }
+    // 至少保留一个输出，避免什么都看不到
+    if (sinks == 0) {
+        sinks = CONSOLE_FB;
+    }
+    console_sinks = sinks;
+}
+
+uint32_t console_get_sinks() {
+    return console_sinks;
+}
+
+void console_set_sinks(uint32_t sinks) {
+    if (!serial_present()) sinks &= ~CONSOLE_SERIAL;
+    if (!debugcon_ok) sinks &= ~CONSOLE_DEBUGCON;
+    if (sinks == 0) sinks = CONSOLE_FB;
+    console_sinks = sinks;
+}
+
+bool console_fb_enabled() {
+    return console_sinks & CONSOLE_FB;
+}
+
+// 写入 debugcon：一条 rep outsb 送出整段数据
+static void debugcon_write(const char* str, size_t len) {
+    asm volatile("rep outsb" : "+S"(str), "+c"(len) : "d"((uint16_t)DEBUGCON_PORT) : "memory");
+}
+
+void console_write(const char* str, size_t len) {
+    uint32_t sinks = console_sinks;
+    if (!(sinks & (CONSOLE_SERIAL | CONSOLE_DEBUGCON))) return;
+
+    // 串口终端需要 "\r\n"，退格需要 "\b \b" 才能擦掉字符，这里按段转换
+    size_t start = 0;
+    for (size_t i = 0; i <= len; i++) {
+        const char* special = nullptr;
+        if (i < len) {
+            if (str[i] == '\n') special = "\r\n";
+            else if (str[i] == '\b') special = "\b \b";
+            else continue;
+        }
+        if (i > start) {
+            if (sinks & CONSOLE_SERIAL) serial_write(str + start, i - start);
+            if (sinks & CONSOLE_DEBUGCON) debugcon_write(str + start, i - start);
+        }
+        if (special) {
+            size_t slen = strlen(special);
+            if (sinks & CONSOLE_SERIAL) serial_write(special, slen);
+            // debugcon 通常重定向到文件，保留原始换行即可
+            if (sinks & CONSOLE_DEBUGCON) debugcon_write(str + i, 1);
+        }
+        start = i + 1;
+    }
+}
+
+void console_flush() {
+    if (console_sinks & CONSOLE_SERIAL) serial_flush();
+}
+
+// ==========================================================================
+// 控制台锁
+// ==========================================================================
+
+uint64_t console_lock() {
+    uint64_t flags = local_irq_save();
+    int32_t cpu = (int32_t)smp_processor_id();
+    // 只有本 CPU 会把 owner 写成自己的编号，读到自己说明是重入
+    if (__atomic_load_n(&console_owner, __ATOMIC_RELAXED) == cpu) {
+        console_depth++;
+        return flags;
+    }
+    spin_lock(&console_spin);
+    __atomic_store_n(&console_owner, cpu, __ATOMIC_RELAXED);
+    console_depth = 1;
+    return flags;
+}
+
+void console_unlock(uint64_t flags) {
+    if (--console_depth == 0) {
+        __atomic_store_n(&console_owner, -1, __ATOMIC_RELAXED);
+        spin_unlock(&console_spin);
+    }
+    local_irq_restore(flags);
+}
+
+void console_panic_unlock() {
+    console_depth = 0;
+    __atomic_store_n(&console_owner, -1, __ATOMIC_RELAXED);
+    // 不能再调 spin_lock_init：它会把锁重复登记到 lockstat 链表
+    __atomic_store_n(&console_spin.value, 0, __ATOMIC_RELEASE);
+    serial_panic_unlock();
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// 控制台输出目标 (可以任意组合)
+#define CONSOLE_FB       (1 << 0) // 帧缓冲 (逐像素绘制字形，最慢)
+#define CONSOLE_SERIAL   (1 << 1) // COM1 串口 (中断驱动的发送环)
+#define CONSOLE_DEBUGCON (1 << 2) // QEMU/Bochs 的 0xE9 调试端口 (最快)
+
+// debugcon 的 I/O 端口
+#define DEBUGCON_PORT 0xE9
+
+// 根据内核命令行初始化输出目标，例如 "console=serial,debugcon"。
+// 未指定时默认为帧缓冲 + 串口 (若串口存在)。
+void console_init(const char* cmdline);
+
+uint32_t console_get_sinks();
+void console_set_sinks(uint32_t sinks);
+
+// 帧缓冲是否启用 (tty 据此决定是否绘制字形)
+bool console_fb_enabled();
+
+// 把文本写到除帧缓冲以外的所有输出目标 (串口/debugcon)
+void console_write(const char* str, size_t len);
+
+// panic 等场景下同步刷新串口发送环
+void console_flush();
+
+// 控制台锁：帧缓冲光标、字形缓存和 UTF-8 解码状态都是全局的，多个 CPU 同时输出
+// 会互相破坏。tty_print/tty_putc/print 和每条日志的输出都在锁内进行；同一 CPU 上
+// 可以重入 (print_hex 调用 tty_print、panic 打断正在输出的代码)。关中断持有
+uint64_t console_lock();
+void console_unlock(uint64_t flags);
+// panic 时强制释放控制台锁和串口锁，之后的输出由 panic 的 CPU 独占
+void console_panic_unlock();
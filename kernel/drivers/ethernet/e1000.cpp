@@ -4,7 +4,13 @@
 #include "kernel/drivers/tty.h"
 #include "kernel/mem/pmm.h" // 需要 pmm_alloc_page
 #include "lib/libc.h" // 需要 memcpy
+#include "kernel/klog.h"
+#include "kernel/tracepoint.h"
 #include "idt.h"
+#include "irq.h"
+#include "kernel/time/clock.h"
+#include "kernel/softirq.h"
+#include "kernel/workqueue.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -30,6 +36,18 @@ static uint8_t* tx_buffers[NUM_TX_DESC];
 static uint16_t rx_cur;
 static uint16_t tx_cur;
 
+// 硬件中断只读 ICR (读即确认) 并调度下半部：收包在 tasklet 里，链路变化在工作队列里
+#define E1000_RX_BUDGET 16      // 一次 tasklet 最多处理的包数，剩下的重新调度
+static tasklet rx_tasklet;
+static work_struct link_work;
+static void e1000_rx_poll(void*);
+static void e1000_link_changed(work_struct*);
+
+// 热路径上的追踪点，默认关闭 (shell: trace on <name>)
+DEFINE_TRACEPOINT(e1000_tx);
+DEFINE_TRACEPOINT(e1000_rx);
+DEFINE_TRACEPOINT(e1000_irq);
+
 // MAC地址
 const uint8_t* e1000_get_mac_address() {
     return e1000_mac_addr;
@@ -45,6 +63,11 @@ static void e1000_write_reg(uint32_t reg, uint32_t val) {
     e1000_mmio_base[reg / 4] = val;
 }
 
+// MSI 向量和 INTx 线共用同一个处理函数；INTx 线可能与其他设备共享
+static irq_return_t e1000_irq(registers_t*, void*) {
+    return e1000_handle_interrupt() ? IRQ_HANDLED : IRQ_NONE;
+}
+
 // 初始化 E1000 网卡
 void e1000_init(uint8_t pci_bus, uint8_t pci_device, uint8_t pci_function) {
     // 1. 读取 PCI 配置空间信息和 MMIO 基地址
@@ -63,16 +86,26 @@ void e1000_init(uint8_t pci_bus, uint8_t pci_device, uint8_t pci_function) {
     pci_command |= (1 << 1); // Memory Space Enable
     pci_write_dword(pci_bus, pci_device, pci_function, 0x04, pci_command);
 
-    // 3. 设置 PCI Interrupt Line 寄存器 (关键)
-    pci_write_dword(pci_bus, pci_device, pci_function, 0x3C, 10); // IRQ 10
+    tasklet_init(&rx_tasklet, e1000_rx_poll, nullptr);
+    work_init(&link_work, e1000_link_changed);
 
-    // 调试打印
-    tty_print("E1000 MMIO @ 0x", 0xFFFFFF); print_hex((uint64_t)e1000_mmio_base, 0x00FFFF); tty_print("\n", 0x00FFFF);
-    tty_print("E1000 PCI Interrupt Line set to: 0x", 0xFFFFFF); print_hex(pci_read_dword(pci_bus, pci_device, pci_function, 0x3C), 0x00FFFF); tty_print("\n", 0x00FFFF);
+    // 3. 优先使用 MSI (82574 等型号支持)，否则设置 PCI Interrupt Line 寄存器走 INTx
+    int msi_vector = -1;
+    if (pci_find_capability(pci_bus, pci_device, pci_function, PCI_CAP_ID_MSI)) {
+        msi_vector = pci_msi_alloc_vector(e1000_irq, nullptr);
+    }
+    if (msi_vector >= 0 && pci_enable_msi(pci_bus, pci_device, pci_function, msi_vector)) {
+        pr_info("e1000: using MSI vector %d", msi_vector);
+    } else {
+        pci_write_dword(pci_bus, pci_device, pci_function, 0x3C, 10); // IRQ 10
+        register_irq_handler(IRQ_VECTOR_BASE + 10, e1000_irq, nullptr);
+        pr_debug("e1000: MMIO @ %p, PCI interrupt line 0x%X", (const void*)e1000_mmio_base,
+                 pci_read_dword(pci_bus, pci_device, pci_function, 0x3C));
+    }
 
     // 4. E1000 网卡复位
     e1000_write_reg(E1000_REG_CTRL, 0x04000000); // RST bit (Bit 26)
-    for(volatile int i = 0; i < 1000000; i++); // 忙等待
+    mdelay(5); // 等待复位完成
     e1000_write_reg(E1000_REG_CTRL, 0); // Clear RST bit
     e1000_read_reg(E1000_REG_CTRL); // 再次读取确保生效
 
@@ -86,9 +119,8 @@ void e1000_init(uint8_t pci_bus, uint8_t pci_device, uint8_t pci_function) {
     e1000_mac_addr[0] = (ra_low >> 0) & 0xFF; e1000_mac_addr[1] = (ra_low >> 8) & 0xFF;
     e1000_mac_addr[2] = (ra_low >> 16) & 0xFF; e1000_mac_addr[3] = (ra_low >> 24) & 0xFF;
     e1000_mac_addr[4] = (ra_high >> 0) & 0xFF; e1000_mac_addr[5] = (ra_high >> 8) & 0xFF;
-    tty_print("E1000 MAC: ", 0xFFFFFF);
-    for (int i = 0; i < 6; i++) { print_hex(e1000_mac_addr[i], 0x00FF00); if (i < 5) tty_print(":", 0x00FF00); }
-    tty_print("\n", 0x00FF00);
+    pr_info("e1000: MAC %02X:%02X:%02X:%02X:%02X:%02X", e1000_mac_addr[0], e1000_mac_addr[1],
+            e1000_mac_addr[2], e1000_mac_addr[3], e1000_mac_addr[4], e1000_mac_addr[5]);
 
     // 7. 配置接收地址寄存器 (RAR[0]) 和 MAC 地址过滤器
     // 这是 E1000 接收数据包的基础：它必须知道自己的 MAC 地址
@@ -98,7 +130,7 @@ void e1000_init(uint8_t pci_bus, uint8_t pci_device, uint8_t pci_function) {
     // 8. 初始化接收环形缓冲区
     rx_cur = 0;
     uintptr_t rx_ring_phys = (uintptr_t)buddy_alloc(sizeof(uintptr_t));
-    tty_print("RX Ring @ 0x", 0xFFFFFF); print_hex(rx_ring_phys, 0x00FFFF); tty_print("\n", 0x00FFFF);
+    pr_debug("e1000: RX ring @ 0x%llX", (unsigned long long)rx_ring_phys);
     for (int i = 0; i < NUM_RX_DESC; i++) {
         rx_descs[i] = (struct e1000_rx_desc*)((uintptr_t)rx_ring_phys + i * sizeof(struct e1000_rx_desc));
         rx_buffers[i] = (uint8_t*)buddy_alloc(sizeof(uint8_t));
@@ -115,7 +147,7 @@ void e1000_init(uint8_t pci_bus, uint8_t pci_device, uint8_t pci_function) {
     // 9. 初始化发送环形缓冲区 (类似接收)
     tx_cur = 0;
     uintptr_t tx_ring_phys = (uintptr_t)buddy_alloc(sizeof(uintptr_t));
-    tty_print("TX Ring @ 0x", 0xFFFFFF); print_hex(tx_ring_phys, 0x00FFFF); tty_print("\n", 0x00FFFF);
+    pr_debug("e1000: TX ring @ 0x%llX", (unsigned long long)tx_ring_phys);
     for (int i = 0; i < NUM_TX_DESC; i++) {
         tx_descs[i] = (struct e1000_tx_desc*)((uintptr_t)tx_ring_phys + i * sizeof(struct e1000_tx_desc));
         tx_buffers[i] = (uint8_t*)buddy_alloc(sizeof(uintptr_t));
@@ -162,12 +194,12 @@ void e1000_init(uint8_t pci_bus, uint8_t pci_device, uint8_t pci_function) {
     // 13. 再次清除所有挂起的中断
     e1000_read_reg(E1000_REG_ICR); 
 
-    tty_print("E1000 initialized.\n", 0x00FF00);
+    pr_info("e1000: initialized");
 }
 
 bool e1000_send_packet(const uint8_t* data, uint16_t len) {
     if (len == 0 || len > 2048) { // E1000 缓冲区通常最大 2KB
-        tty_print("E1000: Invalid packet length (0 or >2048).\n", 0xFF0000);
+        pr_err("e1000: invalid packet length %u", len);
         return false;
     }
 
@@ -176,7 +208,7 @@ bool e1000_send_packet(const uint8_t* data, uint16_t len) {
     
     // 检查描述符是否空闲 (DD 位是否设置，表示设备已处理完)
     if (!(desc->status & (1 << 0))) { // Descriptor Done (DD) is bit 0
-        tty_print("E1000: TX descriptor not ready!\n", 0xFF6060);
+        pr_warn("e1000: TX descriptor not ready");
         return false;
     }
 
@@ -193,87 +225,87 @@ bool e1000_send_packet(const uint8_t* data, uint16_t len) {
     tx_cur = (tx_cur + 1) % NUM_TX_DESC;
     e1000_write_reg(E1000_REG_TDH, tx_cur);
 
-    tty_print("E1000: Packet sent. Len=", 0x00FF00); print_hex(len, 0x00FF00); tty_print("\n", 0x00FF00);
+    trace(e1000_tx, "len=%u tail=%u", len, tx_cur);
     return true;
 }
 
-void e1000_handle_interrupt() {
-    // 1. 读取 ICR 寄存器，获取中断原因。
-    //    读取 ICR 会清除一些中断位。
+// 收包下半部：rx_cur 只在这里修改，同一 tasklet 不会并发运行，不需要加锁
+static void e1000_rx_poll(void*) {
+    // RDH 指向网卡当前正在处理的描述符，追上它说明所有待处理的包都处理完了
+    uint16_t current_rdh = e1000_read_reg(E1000_REG_RDH); // 硬件的头指针
+    uint32_t budget = E1000_RX_BUDGET;
+
+    while (rx_cur != current_rdh) {
+        struct e1000_rx_desc* desc = rx_descs[rx_cur];
+
+        // 检查描述符的 DD (Descriptor Done) 位
+        if (!(desc->status & (1 << 0))) { // DD bit is 0, not yet done by hardware
+            break; // 如果这个描述符还没处理完，就停止
+        }
+        if (budget-- == 0) {
+            // 预算用完：让出软中断，稍后继续
+            tasklet_schedule(&rx_tasklet);
+            break;
+        }
+
+        uint16_t len = desc->length;
+        uint8_t* packet_data = rx_buffers[rx_cur];
+
+        //  识别以太网帧类型 (EtherType) 
+        uint16_t eth_type = (packet_data[12] << 8) | packet_data[13];
+        trace(e1000_rx, "len=%u ethertype=0x%04X", len, eth_type);
+
+        if (eth_type == 0x0806) { // ARP 协议
+            uint16_t arp_opcode = (packet_data[20] << 8) | packet_data[21];
+            const uint8_t* sha = packet_data + 22;
+            const uint8_t* spa = packet_data + 28;
+            pr_info("e1000: ARP %s from %02X:%02X:%02X:%02X:%02X:%02X (%u.%u.%u.%u)",
+                 arp_opcode == 0x0002 ? "reply" : "request",
+                 sha[0], sha[1], sha[2], sha[3], sha[4], sha[5],
+                 spa[0], spa[1], spa[2], spa[3]);
+        } else if (eth_type != 0x0800) { // 既不是 ARP 也不是 IPv4
+            pr_debug("e1000: unknown EtherType 0x%04X", eth_type);
+        }
+
+        // 清除描述符状态，准备好再次接收
+        desc->status = 0; // 清除描述符的 DD 位
+        rx_cur = (rx_cur + 1) % NUM_RX_DESC;
+        // 每次处理一个描述符就更新硬件 RDT 寄存器
+        e1000_write_reg(E1000_REG_RDT, rx_cur);
+    }
+}
+
+static void e1000_link_changed(work_struct*) {
+    uint32_t status = e1000_read_reg(E1000_REG_STATUS);
+    pr_notice("e1000: link %s", (status & (1 << 1)) ? "up" : "down");
+}
+
+bool e1000_handle_interrupt() {
+    // 1. 读取 ICR 寄存器，获取中断原因。读取 ICR 会清除这些位，相当于确认中断
     uint32_t icr = e1000_read_reg(E1000_REG_ICR);
     
     // 如果没有中断原因，直接返回
-    if (icr == 0) return;
+    if (icr == 0) return false;
 
-    tty_print("E1000 Interrupt hit! ICR = 0x", 0xFF00FF); print_hex(icr, 0xFF00FF); tty_print("\n", 0xFF00FF); // 关键调试信息
+    // 中断上下文里只写日志环，真正的屏幕输出由空闲循环完成
+    trace(e1000_irq, "ICR=0x%X", icr);
 
-    // 2. 处理接收中断 (RXT 或 RXDMT0)
+    // 2. 接收中断 (RXT 或 RXDMT0)：交给 tasklet
     if (icr & ((1 << 0) | (1 << 1))) { // RXT (bit 0) or RXDMT0 (bit 1)
-        tty_print("  E1000 Handler: RX Interrupts active.\n", 0x00FF00); // 调试信息
-        
-        // 核心：处理所有挂起的接收描述符
-        // RDH 指向网卡当前正在处理的描述符，RDT 是我们驱动的尾指针
-        // 当 RDH 追上 RDT 时，说明所有待处理的包都处理完了
-        uint16_t current_rdh = e1000_read_reg(E1000_REG_RDH); // 硬件的头指针
-
-        // 循环处理，直到我们的软件尾指针追上硬件头指针
-        while (rx_cur != current_rdh) {
-            struct e1000_rx_desc* desc = rx_descs[rx_cur];
-            
-            // 检查描述符的 DD (Descriptor Done) 位
-            if (!(desc->status & (1 << 0))) { // DD bit is 0, not yet done by hardware
-                break; // 如果这个描述符还没处理完，就停止
-            }
-            
-            uint16_t len = desc->length;
-            uint8_t* packet_data = rx_buffers[rx_cur];
-
-            tty_print("  Received Packet Len: ", 0x00FFFF); print_hex(len, 0x00FFFF); tty_print("\n", 0x00FFFF);
-            
-            //  识别以太网帧类型 (EtherType) 
-            uint16_t eth_type = (packet_data[12] << 8) | packet_data[13];
-            tty_print("  EtherType: 0x", 0xFFFFFF); print_hex(eth_type, 0x00FF00); tty_print("\n", 0x00FF00);
-
-            if (eth_type == 0x0806) { // ARP 协议
-                tty_print("  ARP Packet Detected!\n", 0x00FF00);
-                tty_print("  Sender MAC: ", 0xFFFFFF);
-                for(int i=0; i<6; i++) { print_hex(packet_data[22+i], 0x00FF00); if(i<5) tty_print(":", 0x00FF00); } tty_print("\n", 0x00FF00);
-                tty_print("  Sender IP:  ", 0xFFFFFF);
-                for(int i=0; i<4; i++) { print_hex(packet_data[28+i], 0x00FF00); if(i<3) tty_print(".", 0x00FF00); } tty_print("\n", 0x00FF00);
-
-                uint16_t arp_opcode = (packet_data[20] << 8) | packet_data[21];
-                if (arp_opcode == 0x0002) {
-                    tty_print("  ARP Response from Gateway!\n", 0x00FF00);
-                }
-            } else if (eth_type == 0x0800) { // IPv4 协议
-                tty_print("  IPv4 Packet Detected!\n", 0x00FF00);
-            } else {
-                tty_print("  Unknown EtherType.\n", 0xFF6060);
-            }
-
-            // 清除描述符状态，准备好再次接收
-            desc->status = 0; // 清除描述符的 DD 位
-            rx_cur = (rx_cur + 1) % NUM_RX_DESC;
-            // 每次处理一个描述符就更新硬件 RDT 寄存器
-            e1000_write_reg(E1000_REG_RDT, rx_cur); 
-        }
-        tty_print("  E1000 Handler: RX Processing finished.\n", 0x00FF00);
+        tasklet_schedule(&rx_tasklet);
     }
     
-    // 3. 处理发送中断 (TXQE 或 TXDW)
-    if (icr & ((1 << 4) | (1 << 5))) { // TXQE (bit 4) or TXDW (bit 5)
-        tty_print("E1000: TX Interrupts active.\n", 0x00FF00);
-        // 通常这里不需要特别处理，只是确认发送完成，描述符的 DD 位会在发送包时被检查
-    }
+    // 3. 发送中断 (TXQE 或 TXDW) 不需要处理，描述符的 DD 位会在发送包时被检查
 
-    // 4. 处理链路状态改变中断 (LSC)
+    // 4. 链路状态改变 (LSC)：读状态并打印放到线程上下文
     if (icr & (1 << 6)) { // LSC: Link Status Change
-        tty_print("E1000: Link status changed.\n", 0xFFFFFF);
+        schedule_work(&link_work);
     }
     
     // 5. 再次读取 ICR 确保清除所有挂起的中断
     // 某些 E1000 型号需要再次读取 ICR 来确认中断清除
     e1000_read_reg(E1000_REG_ICR); 
+    return true;
 }
 
 // 外部声明，让 e1000.cpp 能用
@@ -50,8 +50,8 @@ void e1000_init(uint8_t pci_bus, uint8_t pci_device, uint8_t pci_function);
 //  新增：发送数据包 
 bool e1000_send_packet(const uint8_t* data, uint16_t len);
 
-//  新增：处理网卡中断 
-void e1000_handle_interrupt();
+// 硬件中断处理：读 ICR 确认中断并调度下半部，ICR 为 0 (中断不是本网卡产生的) 时返回 false
+bool e1000_handle_interrupt();
 
 // 获取网卡MAC地址
 const uint8_t* e1000_get_mac_address();
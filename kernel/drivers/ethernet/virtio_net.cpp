@@ -3,9 +3,13 @@
 
 #include "kernel/drivers/tty.h"
 #include "kernel/mem/pmm.h"
-#include "kernel/cpu/pic.h"
+#include "kernel/cpu/irq.h"
 #include "lib/libc.h"
-#include "timer.h"
+#include "kernel/klog.h"
+#include "kernel/tracepoint.h"
+#include "kernel/time/clock.h"
+#include "kernel/softirq.h"
+#include "kernel/workqueue.h"
 
 static uintptr_t pci_bars[6] = {0}; 
 static uint8_t virtio_net_irq = 0;
@@ -30,6 +34,13 @@ static struct virtq* virtq_alloc(uint16_t q_idx, uint16_t num_descs);
 static void virtq_free(struct virtq* q);
 static int virtq_add_buf(struct virtq* q, void* buf, uint32_t len, uint16_t flags);
 static void virtq_kick(struct virtq* q);
+static void virtq_recycle(struct virtq* q, uint16_t desc_idx);
+
+// MSI-X 中断处理函数 (配置变更 / RX / TX 各一个向量)
+static irq_return_t virtio_net_msix_config(registers_t* regs, void* ctx);
+static irq_return_t virtio_net_msix_rx(registers_t* regs, void* ctx);
+static irq_return_t virtio_net_msix_tx(registers_t* regs, void* ctx);
+static irq_return_t virtio_net_intx(registers_t* regs, void* ctx);
 
 // VirtIO 网卡 MMIO 基址和 MAC 地址
 static volatile uint8_t* virtio_net_mmio_base = nullptr;
@@ -39,6 +50,24 @@ static uint8_t virtio_net_mac_addr[6] = {0};
 static struct virtq* rx_q = nullptr;
 static struct virtq* tx_q = nullptr;
 
+// 下半部：硬件中断只确认并调度，收包和回收发送描述符在 tasklet 里，配置变更在工作队列里
+#define VIRTIO_NET_RX_BUDGET 16     // 一次 tasklet 最多处理的包数，剩下的重新调度
+static tasklet rx_tasklet;
+static tasklet tx_tasklet;
+static work_struct config_work;
+static void virtio_net_rx_poll(void*);
+static void virtio_net_tx_complete(void*);
+static void virtio_net_config_changed(work_struct*);
+
+// 发送环回收出空位时通知等待的异步发送
+static async_event tx_space_event;
+
+// 热路径上的追踪点，默认关闭 (shell: trace on <name>)
+DEFINE_TRACEPOINT(virtq_kick);
+DEFINE_TRACEPOINT(virtio_net_tx);
+DEFINE_TRACEPOINT(virtio_net_rx);
+DEFINE_TRACEPOINT(virtio_net_irq);
+
 // ==========================================================================
 // VirtIO PCI Capability 寻址 (核心重写)
 // ==========================================================================
@@ -124,6 +153,7 @@ static struct virtq* virtq_alloc(uint16_t q_idx, uint16_t num_descs) {
     //  3. 初始化结构体和队列 (其余逻辑不变) 
     q->num = num_descs;
     q->queue_idx = q_idx;
+    spin_lock_init(&q->lock, q_idx == 0 ? "virtq-rx" : "virtq-tx");
     // ... (初始化 free_head, next 指针等) ...
     for (int i = 0; i < num_descs - 1; i++) {
         q->desc[i].next = i + 1;
@@ -134,8 +164,7 @@ static struct virtq* virtq_alloc(uint16_t q_idx, uint16_t num_descs) {
 
     //  2. 检查队列是否已被启用 (正确检查点) 
     if (virtio_read_cap_16(common_cfg_ptr, 0x1C /* queue_enable */)) {
-        tty_print("VirtIO FATAL: Queue #", 0xFF0000); print_hex(q_idx, 0xFF0000);
-        tty_print(" is already enabled before setup!\n", 0xFF0000);
+        pr_err("virtio-net: queue #%u is already enabled before setup", q_idx);
         buddy_free(q, sizeof(struct virtq));
         return nullptr;
     }
@@ -147,6 +176,8 @@ static struct virtq* virtq_alloc(uint16_t q_idx, uint16_t num_descs) {
         q->num = num_descs;
     }
 
+    q->num_free = q->num;
+
     //  4. 【关键】设置最终使用的队列大小 
     virtio_write_cap_16(common_cfg_ptr, 0x18 /* queue_size (write as final size) */, num_descs);
 
@@ -160,7 +191,7 @@ static struct virtq* virtq_alloc(uint16_t q_idx, uint16_t num_descs) {
     q->mmio_base_ptr = notify_cfg_ptr;
     q->notify_off_multiplier = virtio_notify_multiplier; 
 
-    tty_print("VirtIO: Successfully allocated Queue #", 0x00FF00); print_hex(q_idx, 0x00FF00); tty_print("\n", 0x00FF00);
+    pr_debug("virtio-net: allocated queue #%u (%u descriptors)", q_idx, q->num);
     return q;
 }
 
@@ -171,8 +202,15 @@ static void virtq_free(struct virtq* q) {
 
 // virtq_add_buf (添加缓冲区到队列)
 static int virtq_add_buf(struct virtq* q, void* buf, uint32_t len, uint16_t flags) {
+    uint64_t irq_flags = spin_lock_irqsave(&q->lock);
+    if (q->num_free == 0) {
+        spin_unlock_irqrestore(&q->lock, irq_flags);
+        return -1;
+    }
+
     //  1. 从空闲链表中获取一个描述符 
     uint16_t head_idx = q->free_head;
+    q->num_free--;
 
     //  2. 填充描述符 
     struct virtq_desc* desc = &q->desc[head_idx];
@@ -189,39 +227,80 @@ static int virtq_add_buf(struct virtq* q, void* buf, uint32_t len, uint16_t flag
     //  5. 增加可用环的索引，让设备看到这个新添加的条目 
     q->avail->idx++;
 
+    spin_unlock_irqrestore(&q->lock, irq_flags);
     return 0;
 }
 
+// 把设备用完的描述符放回空闲链表 (调用者持有 q->lock)
+static void virtq_recycle(struct virtq* q, uint16_t desc_idx) {
+    q->desc[desc_idx].next = q->free_head;
+    q->free_head = desc_idx;
+    q->num_free++;
+}
+
 // virtq_kick (通知设备)
 static void virtq_kick(struct virtq* q) {
     //  核心修正：使用乘数计算正确的字节偏移量 
     uint32_t final_byte_offset = q->queue_notify_off * q->notify_off_multiplier;
 
-    // (可以保留之前的日志用于验证)
-    tty_print("VirtIO Kick: Notifying Queue #", 0x00FFFF);
-    print_hex(q->queue_idx, 0x00FFFF);
-    tty_print(" at MMIO address 0x", 0x00FFFF);
-    print_hex((uint64_t)(q->mmio_base_ptr + final_byte_offset), 0x00FFFF);
-    tty_print("\n", 0x00FFFF);
+    // 每次敲门铃都会经过这里，只留一个默认关闭的追踪点
+    trace(virtq_kick, "queue=%u notify=%p avail=%u", q->queue_idx,
+          (const void*)(q->mmio_base_ptr + final_byte_offset), q->avail->idx);
     
     // 向正确计算出的地址写入队列索引
     virtio_write_cap_16(notify_cfg_ptr, final_byte_offset, q->queue_idx);
 };
 
 
-static inline void io_delay_us(uint32_t us) {
-    // 经验值：QEMU/KVM环境下约3000次循环=1ms
-    // 调整系数：us * 3 = 微秒数对应的循环次数
-    for (volatile uint32_t i = 0; i < us * 3; i++) {
-        asm volatile("outb %%al, $0x80" : : "a"(0)); // 使用端口0x80制造延迟
+// ==========================================================================
+// MSI-X 向量绑定
+// ==========================================================================
+
+#define VIRTIO_MSI_NO_VECTOR    0xFFFF
+#define VIRTIO_MSIX_CONFIG      0   // MSI-X 表项 0：配置变更
+#define VIRTIO_MSIX_RX          1   // 表项 1：接收队列
+#define VIRTIO_MSIX_TX          2   // 表项 2：发送队列
+
+static pci_msix virtio_msix;
+static bool virtio_use_msix = false;
+
+// 为配置变更、RX、TX 各分配一个向量并写入 MSI-X 表
+static bool virtio_net_setup_msix(uint8_t pci_bus, uint8_t pci_device, uint8_t pci_function) {
+    if (!pci_msix_init(pci_bus, pci_device, pci_function, &virtio_msix) || virtio_msix.table_size < 3) {
+        return false;
+    }
+    int config_vec = pci_msi_alloc_vector(virtio_net_msix_config, nullptr);
+    int rx_vec = pci_msi_alloc_vector(virtio_net_msix_rx, nullptr);
+    int tx_vec = pci_msi_alloc_vector(virtio_net_msix_tx, nullptr);
+    if (config_vec < 0 || rx_vec < 0 || tx_vec < 0) return false;
+
+    pci_msix_enable(&virtio_msix);
+    pci_msix_set_vector(&virtio_msix, VIRTIO_MSIX_CONFIG, config_vec);
+    pci_msix_set_vector(&virtio_msix, VIRTIO_MSIX_RX, rx_vec);
+    pci_msix_set_vector(&virtio_msix, VIRTIO_MSIX_TX, tx_vec);
+
+    // 配置变更中断使用表项 0，设备不接受时读回 NO_VECTOR
+    virtio_write_cap_16(common_cfg_ptr, 0x10 /* msix_config */, VIRTIO_MSIX_CONFIG);
+    if (virtio_read_cap_16(common_cfg_ptr, 0x10) == VIRTIO_MSI_NO_VECTOR) {
+        pci_msix_disable(&virtio_msix);
+        return false;
     }
+    pr_info("virtio-net: MSI-X vectors config=%d rx=%d tx=%d", config_vec, rx_vec, tx_vec);
+    return true;
+}
+
+// 在启用队列之前把它绑定到 MSI-X 表项
+static bool virtio_net_bind_queue_vector(uint16_t q_idx, uint16_t entry) {
+    virtio_write_cap_16(common_cfg_ptr, 0x16 /* queue_select */, q_idx);
+    virtio_write_cap_16(common_cfg_ptr, 0x1A /* queue_msix_vector */, entry);
+    return virtio_read_cap_16(common_cfg_ptr, 0x1A) != VIRTIO_MSI_NO_VECTOR;
 }
 
 // ==========================================================================
 // VirtIO 初始化流程
 // ==========================================================================
 void virtio_net_init(uint8_t pci_bus, uint8_t pci_device, uint8_t pci_function) {
-    tty_print("VirtIO Net: Initializing...\n", 0xFFFFFF);
+    pr_info("virtio-net: initializing %02x:%02x.%x", pci_bus, pci_device, pci_function);
 
     // 1. 获取 PCI BAR0 MMIO 基地址 (不变)
     uint32_t bar0 = pci_read_dword(pci_bus, pci_device, pci_function, 0x10);
@@ -243,7 +322,7 @@ void virtio_net_init(uint8_t pci_bus, uint8_t pci_device, uint8_t pci_function)
     }
 
     virtio_net_mmio_base = (volatile uint8_t*)((uintptr_t)pci_bars[0]); 
-    tty_print("VirtIO MMIO @ 0x", 0xFFFFFF); print_hex((uint64_t)virtio_net_mmio_base, 0x00FFFF); tty_print("\n", 0x00FFFF);
+    pr_debug("virtio-net: BAR0 MMIO @ %p", (const void*)virtio_net_mmio_base);
 
     // 2. 扫描 PCI Capabilities，找到各个配置块的 MMIO 指针
     uint8_t cap_ptr_offset = pci_read_dword(pci_bus, pci_device, pci_function, 0x34) & 0xFF; // Capability Pointer
@@ -270,18 +349,16 @@ void virtio_net_init(uint8_t pci_bus, uint8_t pci_device, uint8_t pci_function)
             if (cap_bar_idx < 6 && pci_bars[cap_bar_idx] != 0) {
                 volatile uint8_t* base_ptr_for_cap = (volatile uint8_t*)(pci_bars[cap_bar_idx] + cap_offset_in_bar);
 
+                pr_debug("virtio-net: capability type %u @ %p", cfg_type, (const void*)base_ptr_for_cap);
                 switch (cfg_type) {
-                    case VIRTIO_PCI_CAP_COMMON_CFG: tty_print("  Found Common Cfg @ 0x", 0xFFFFFF); print_hex((uint64_t)base_ptr_for_cap, 0x00FFFF); tty_print("\n", 0x00FFFF); common_cfg_ptr = base_ptr_for_cap; break;
+                    case VIRTIO_PCI_CAP_COMMON_CFG: common_cfg_ptr = base_ptr_for_cap; break;
                     case VIRTIO_PCI_CAP_NOTIFY_CFG:
-                        tty_print("  Found Notify Cfg @ 0x", 0xFFFFFF);
-                        print_hex((uint64_t)base_ptr_for_cap, 0x00FFFF);
-                        tty_print("\n", 0x00FFFF); 
                         notify_cfg_ptr = base_ptr_for_cap;
                         virtio_notify_multiplier = pci_read_dword(pci_bus, pci_device, pci_function, cap_ptr_offset + 16);
                     break;  
-                    case VIRTIO_PCI_CAP_ISR_CFG:    tty_print("  Found ISR Cfg @ 0x", 0xFFFFFF); print_hex((uint64_t)base_ptr_for_cap, 0x00FFFF); tty_print("\n", 0x00FFFF); isr_cfg_ptr = base_ptr_for_cap; break;
-                    case VIRTIO_PCI_CAP_DEVICE_CFG: tty_print("  Found Device Cfg @ 0x", 0xFFFFFF); print_hex((uint64_t)base_ptr_for_cap, 0x00FFFF); tty_print("\n", 0x00FFFF); device_cfg_ptr = base_ptr_for_cap; break;
-                    case VIRTIO_PCI_CAP_PCI_CFG:    tty_print("  Found PCI Cfg @ 0x", 0xFFFFFF); print_hex((uint64_t)base_ptr_for_cap, 0x00FFFF); tty_print("\n", 0x00FFFF); pci_cfg_ptr = base_ptr_for_cap; break;
+                    case VIRTIO_PCI_CAP_ISR_CFG:    isr_cfg_ptr = base_ptr_for_cap; break;
+                    case VIRTIO_PCI_CAP_DEVICE_CFG: device_cfg_ptr = base_ptr_for_cap; break;
+                    case VIRTIO_PCI_CAP_PCI_CFG:    pci_cfg_ptr = base_ptr_for_cap; break;
                 }
             }
         }
@@ -289,36 +366,35 @@ void virtio_net_init(uint8_t pci_bus, uint8_t pci_device, uint8_t pci_function)
     }
     
     if (!common_cfg_ptr || !notify_cfg_ptr || !isr_cfg_ptr || !device_cfg_ptr) {
-        tty_print("VirtIO: Missing crucial capabilities!\n", 0xFF0000);
+        pr_err("virtio-net: missing crucial capabilities");
         return;
     }
     
     // 3. 设备复位 (通过 common_cfg_ptr 访问)
-    tty_print("VirtIO: Resetting device...\n", 0xFFFFFF);
+    pr_debug("virtio-net: resetting device");
     virtio_write_cap_8(common_cfg_ptr, 0x14 /* device_status */, 0);
+    // 复位最多要等一秒：在探测线程里睡眠让出 CPU，不能睡眠时才忙等
+    bool can_sleep = async_can_block();
     int timeout = 1000; 
     while (virtio_read_cap_8(common_cfg_ptr, 0x14 /* device_status */) != 0 && timeout-- > 0) {
-        io_delay_us(1000);
+        if (can_sleep) msleep(1);
+        else udelay(1000);
     }
     if (timeout <= 0) {
-        tty_print("VirtIO: Device reset timed out!\n", 0xFF0000);
+        pr_err("virtio-net: device reset timed out");
         return;
     }
-    tty_print("VirtIO: Device reset complete.\n", 0x00FF00);
+    pr_debug("virtio-net: device reset complete");
     
     // 4. 设置驱动状态: Acknowledge, Driver
     uint8_t status = 0;
     status |= VIRTIO_STATUS_ACKNOWLEDGE;
     virtio_write_cap_8(common_cfg_ptr, 0x14 /* device_status */, status);
-    tty_print("VirtIO: Set ACKNOWLEDGE. Status=0x", 0xFFFFFF);
-    print_hex(virtio_read_cap_8(common_cfg_ptr, 0x14), 0xFFFFFF);
-    tty_print("\n", 0xFFFFFF);
+    pr_debug("virtio-net: set ACKNOWLEDGE, status=0x%02X", virtio_read_cap_8(common_cfg_ptr, 0x14));
     
     status |= VIRTIO_STATUS_DRIVER;
     virtio_write_cap_8(common_cfg_ptr, 0x14 /* device_status */, status);
-    tty_print("VirtIO: Set DRIVER. Status=0x", 0xFFFFFF);
-    print_hex(virtio_read_cap_8(common_cfg_ptr, 0x14), 0xFFFFFF);
-    tty_print("\n", 0xFFFFFF);
+    pr_debug("virtio-net: set DRIVER, status=0x%02X", virtio_read_cap_8(common_cfg_ptr, 0x14));
 
     // 5. 读取设备特性并协商 (Feature Negotiation)
     virtio_write_cap_32(common_cfg_ptr, 0x00 /* device_feature_select */, 0); // 选择低 32 位
@@ -343,31 +419,30 @@ void virtio_net_init(uint8_t pci_bus, uint8_t pci_device, uint8_t pci_function)
     // 再次检查，确认设备接受了我们的特性
     status |= VIRTIO_STATUS_FEATURES_OK;
     virtio_write_cap_8(common_cfg_ptr, 0x14 /* device_status */, status);
-    tty_print("VirtIO: Set FEATURES_OK. Status=0x", 0xFFFFFF); 
-    print_hex(virtio_read_cap_8(common_cfg_ptr, 0x14), 0xFFFFFF);
-    tty_print("\n", 0xFFFFFF);
+    pr_debug("virtio-net: set FEATURES_OK, status=0x%02X", virtio_read_cap_8(common_cfg_ptr, 0x14));
 
     if (!(virtio_read_cap_8(common_cfg_ptr, 0x14 /* device_status */) & VIRTIO_STATUS_FEATURES_OK)) {
-        tty_print("VirtIO: Features *NOT* accepted by device! Device cleared the bit.\n", 0xFF0000);
+        pr_err("virtio-net: features NOT accepted by device (FEATURES_OK cleared)");
         return;
     }
-    tty_print("VirtIO: Feature negotiation complete.\n", 0x00FF00);
+    pr_debug("virtio-net: feature negotiation complete, features=0x%llX", (unsigned long long)driver_features);
 
     // 7. 获取 MAC 地址 (通过 device_cfg_ptr 访问)
     if (driver_features & (1ULL << 5) /* VIRTIO_NET_F_MAC */) {
         for (int i = 0; i < 6; i++) {
             virtio_net_mac_addr[i] = virtio_read_cap_8(device_cfg_ptr, i);
         }
-        tty_print("VirtIO MAC: ", 0xFFFFFF);
-        for (int i = 0; i < 6; i++) {
-            print_hex(virtio_net_mac_addr[i], 0x00FF00);
-            if (i < 5) tty_print(":", 0x00FF00);
-        }
-        tty_print("\n", 0x00FF00);
+        const uint8_t* m = virtio_net_mac_addr;
+        pr_info("virtio-net: MAC %02X:%02X:%02X:%02X:%02X:%02X", m[0], m[1], m[2], m[3], m[4], m[5]);
      } else {
-        tty_print("VirtIO: MAC address feature not supported.\n", 0xFF6060);
+        pr_warn("virtio-net: MAC address feature not supported");
     }
 
+    tasklet_init(&rx_tasklet, virtio_net_rx_poll, nullptr);
+    tasklet_init(&tx_tasklet, virtio_net_tx_complete, nullptr);
+    async_event_init(&tx_space_event, "virtio_tx_space");
+    work_init(&config_work, virtio_net_config_changed);
+
     // 8. 分配并初始化 Virtqueue
     //    这里需要将 common_cfg_ptr 和 notify_cfg_ptr 传递给 
     
@@ -375,11 +450,21 @@ void virtio_net_init(uint8_t pci_bus, uint8_t pci_device, uint8_t pci_function)
     tx_q = virtq_alloc(1, NUM_TX_DESC);
 
     if (!rx_q || !tx_q) {
-        tty_print("VirtIO: Failed to allocate virtqueues.\n", 0xFF0000);
+        pr_err("virtio-net: failed to allocate virtqueues");
         virtio_write_cap_8(common_cfg_ptr, 0x14, VIRTIO_STATUS_FAILED);
         return;
     }
 
+    // 8.5 每个队列使用独立的 MSI-X 向量，失败时退回 INTx
+    virtio_use_msix = virtio_net_setup_msix(pci_bus, pci_device, pci_function);
+    if (virtio_use_msix && (!virtio_net_bind_queue_vector(0, VIRTIO_MSIX_RX)
+                            || !virtio_net_bind_queue_vector(1, VIRTIO_MSIX_TX))) {
+        pr_warn("virtio-net: device rejected queue MSI-X vectors, using INTx");
+        virtio_write_cap_16(common_cfg_ptr, 0x10 /* msix_config */, VIRTIO_MSI_NO_VECTOR);
+        pci_msix_disable(&virtio_msix);
+        virtio_use_msix = false;
+    }
+
     // 9. 填充接收队列
     for (int i = 0; i < NUM_RX_DESC; i++) {
         rx_q->buffers[i] = (uint8_t*)buddy_alloc(sizeof(uint8_t)); // 分配缓冲区
@@ -392,32 +477,31 @@ void virtio_net_init(uint8_t pci_bus, uint8_t pci_device, uint8_t pci_function)
     // Common Config: Queue Enable 0x0E
     virtio_write_cap_16(common_cfg_ptr, 0x16 /* queue_select */, 0);
     virtio_write_cap_16(common_cfg_ptr, 0x1C /* queue_enable */, 1);
-    tty_print("VirtIO: RX Queue #0 enabled.\n", 0x00FF00);
+    pr_debug("virtio-net: RX queue #0 enabled");
 
     // 启用 TX 队列 (Queue 1)
     virtio_write_cap_16(common_cfg_ptr, 0x16 /* queue_select */, 1);
     virtio_write_cap_16(common_cfg_ptr, 0x1C /* queue_enable */, 1);
-    tty_print("VirtIO: TX Queue #1 enabled.\n", 0x00FF00);
+    pr_debug("virtio-net: TX queue #1 enabled");
 
     // 11. 完成设备初始化
     status |= VIRTIO_STATUS_DRIVER_OK;
     virtio_write_cap_8(common_cfg_ptr, 0x14 /* device_status */, status);
-    tty_print("VirtIO: Set DRIVER_OK. Final Status=0x", 0x00FF00); 
-    print_hex(virtio_read_cap_8(common_cfg_ptr, 0x14), 0x00FF00); 
-    tty_print("\n", 0x00FF00);
+    pr_debug("virtio-net: set DRIVER_OK, final status=0x%02X", virtio_read_cap_8(common_cfg_ptr, 0x14));
 
-    // 12. 读取并保存 IRQ 中断号
+    if (virtio_use_msix) {
+        pr_info("virtio-net: initialized, using MSI-X");
+        return;
+    }
+
+    // 12. 没有 MSI-X：读取并保存 IRQ 中断号
     // PCI 配置空间的 0x3C 偏移量是 Interrupt Line 寄存器
     uint32_t pci_irq_pin = pci_read_dword(pci_bus, pci_device, pci_function, 0x3C);
     virtio_net_irq = (uint8_t)(pci_irq_pin & 0xFF);
-    tty_print("VirtIO: IRQ Line = ", 0xFFFFFF); 
-    print_hex(virtio_net_irq, 0xFFFFFF);
-    tty_print("\n", 0xFFFFFF);
-
-    tty_print("VirtIO Net initialized successfully!\n", 0x00FF00);
-
-    pic_unmask_irq(virtio_net_irq);
-    tty_print("VirtIO: Unmasked IRQ ", 0xFFFFFF); print_hex(virtio_net_irq, 0xFFFFFF); tty_print(" in PIC.\n", 0xFFFFFF);
+    register_irq_handler(IRQ_VECTOR_BASE + virtio_net_irq, virtio_net_intx, nullptr);
+    irq_unmask_pci(virtio_net_irq);
+    pr_info("virtio-net: initialized, IRQ %u unmasked (%s)", virtio_net_irq,
+            irq_using_apic() ? "IOAPIC" : "PIC");
 
 }
 
@@ -426,18 +510,14 @@ const uint8_t* virtio_net_get_mac_address() {
     return virtio_net_mac_addr;
 }
 
-// 发送数据包
-bool virtio_net_send_packet(const uint8_t* data, uint16_t len) {
-    if (len == 0 || len > 1514) {
-        return false;
-    }
-
+// 入队一个发送包：0 成功，-1 发送环已满，-2 其他错误
+static int virtio_net_queue_tx(const uint8_t* data, uint16_t len) {
     //    这个缓冲区需要包含 VirtIO Net Header (10 bytes) 和数据包本身。
     uint16_t total_len = 10 + len;
     uint8_t* tx_buffer = (uint8_t*)buddy_alloc(sizeof(uint8_t)); // 或者用 kmalloc(total_len)
     if (!tx_buffer) {
-        tty_print("VirtIO TX: Failed to allocate buffer for sending!\n", 0xFF0000);
-        return false;
+        pr_err("virtio-net: failed to allocate TX buffer");
+        return -2;
     }
     
     // 2. 准备缓冲区内容
@@ -447,9 +527,8 @@ bool virtio_net_send_packet(const uint8_t* data, uint16_t len) {
     // 3. 将这个**新分配的**缓冲区添加到发送队列
     //    这里的 flags 必须是 0 (设备只读)
     if (virtq_add_buf(tx_q, tx_buffer, total_len, 0) != 0) {
-        tty_print("VirtIO TX: Failed to add buffer to virtqueue. Queue full?\n", 0xFF0000);
         buddy_free(tx_buffer, sizeof(uint8_t)); // 释放我们分配的内存
-        return false;
+        return -1;
     }
 
     // 4. 通知设备
@@ -457,63 +536,150 @@ bool virtio_net_send_packet(const uint8_t* data, uint16_t len) {
 
     // 当设备确认发送完成后，再调用 pmm_free_page(tx_buffer) 来释放它。
     // 这需要在 virtq_desc 和中断处理中添加一些逻辑来跟踪和释放它。
-    tty_print("VirtIO: Packet sent. Len=", 0x00FF00); print_hex(len, 0x00FF00); tty_print("\n", 0x00FF00);
-    return true;
+    trace(virtio_net_tx, "len=%u avail=%u", len, tx_q->avail->idx);
+    return 0;
 }
 
+static async_status virtio_net_tx_fn(async_task* t) {
+    virtio_net_tx_request* req = async_entry(t, virtio_net_tx_request, task);
+    ASYNC_BEGIN(t);
+    if (!tx_q || req->len == 0 || req->len > 1514) ASYNC_RETURN(t);
+    for (;;) {
+        ASYNC_AWAIT_TIMEOUT(t, &tx_space_event, __atomic_load_n(&tx_q->num_free, __ATOMIC_ACQUIRE) != 0,
+                            VIRTIO_NET_TX_TIMEOUT_NS);
+        if (t->timed_out) {
+            pr_err("virtio-net: timed out waiting for TX ring space");
+            ASYNC_RETURN(t);
+        }
+        // 空位可能被别的发送者抢走，那就接着等
+        int ret = virtio_net_queue_tx(req->data, req->len);
+        if (ret == 0) req->ok = true;
+        if (ret != -1) break;
+    }
+    ASYNC_END(t);
+}
 
-// 处理 VirtIO 网卡中断
-void virtio_net_handle_interrupt() {
-    // 1. 读取并立即打印 ISR 状态寄存器 (这会清除设备的中断状态)
-    uint8_t isr_status = virtio_read_cap_8(isr_cfg_ptr, 0);
-    tty_print("\n--- VirtIO IRQ HIT! ---\n", 0xFFFF00);
-    tty_print("  ISR Status Register: 0b", 0xFFFFFF);
-    for (int i = 7; i >= 0; i--) { tty_print((isr_status & (1 << i)) ? "1" : "0", 0xFFFFFF); }
-    tty_print("\n", 0xFFFFFF);
+void virtio_net_send_async(virtio_net_tx_request* req, void (*done)(async_task* t)) {
+    req->ok = false;
+    async_spawn(nullptr, &req->task, virtio_net_tx_fn, done);
+}
 
-    // 2. 只有在“队列更新”位被设置时才继续
-    if (isr_status & 0x01) { // VIRTIO_PCI_ISR_QUEUE
-        // 3. 在处理任何事情之前，先打印两个队列的“设备索引”
-        uint16_t tx_device_idx = tx_q->used->idx;
-        uint16_t rx_device_idx = rx_q->used->idx;
-        tty_print("  Device state before processing:\n", 0xFFFFFF);
-        tty_print("    TX used->idx: ", 0xFFFFFF); print_hex(tx_device_idx, 0xFFFFFF); 
-        tty_print(" (Driver expects: ", 0xFFFFFF); print_hex(tx_q->used_idx, 0xFFFFFF); tty_print(")\n", 0xFFFFFF);
-        tty_print("    RX used->idx: ", 0xFFFFFF); print_hex(rx_device_idx, 0xFFFFFF);
-        tty_print(" (Driver expects: ", 0xFFFFFF); print_hex(rx_q->used_idx, 0xFFFFFF); tty_print(")\n", 0xFFFFFF);
-
-        // 4. 处理发送完成的队列 (TX)
-        while (tx_q->used_idx != tx_device_idx) {
-            struct virtq_used_elem* used_elem = &tx_q->used->ring[tx_q->used_idx % tx_q->num];
-            uint16_t desc_idx = used_elem->id;
-            
-            tty_print(" VirtIO: TX packet acknowledged. Desc=", 0x00FF00); print_hex(desc_idx, 0x00FF00); tty_print("\n", 0x00FF00);
-            
-            // 重要：在这里释放为发送而分配的缓冲区
-            // pmm_free_page( (void*)tx_q->desc[desc_idx].addr ); // 暂缓实现
+// 发送数据包
+bool virtio_net_send_packet(const uint8_t* data, uint16_t len) {
+    if (len == 0 || len > 1514) {
+        return false;
+    }
 
-            // 将描述符重新加入空闲链表
-            tx_q->desc[desc_idx].next = tx_q->free_head;
-            tx_q->free_head = desc_idx;
-            tx_q->used_idx++;
-        }
+    int ret = virtio_net_queue_tx(data, len);
+    if (ret == -1 && async_can_block()) {
+        // 发送环满：等设备回收出空位，期间不占 CPU
+        virtio_net_tx_request req;
+        req.data = data;
+        req.len = len;
+        virtio_net_send_async(&req, nullptr);
+        async_wait(&req.task);
+        return req.ok;
+    }
+    if (ret == -1) pr_err("virtio-net: TX queue full");
+    return ret == 0;
+}
 
-        // 5. 处理已接收数据的队列 (RX)
-        while (rx_q->used_idx != rx_device_idx) {
-            struct virtq_used_elem* used_elem = &rx_q->used->ring[rx_q->used_idx % rx_q->num];
-            uint16_t desc_idx = used_elem->id;
-            uint32_t len = used_elem->len;
-            uint8_t* packet_data = rx_q->buffers[desc_idx];
-            
-            tty_print("  > VirtIO: RX packet received! Desc=", 0x00FFFF); print_hex(desc_idx, 0x00FFFF); 
-            tty_print(" Len=", 0x00FFFF); print_hex(len, 0x00FFFF); tty_print("\n", 0x00FFFF);
 
-            int16_t eth_type = (packet_data[10 + 12] << 8) | packet_data[10 + 13];
-            tty_print("  EtherType: 0x", 0xFFFFFF); print_hex(eth_type, 0x00FF00); tty_print("\n", 0x00FF00);
-            
-            // 将这个刚刚用完的缓冲区，重新放回接收队列，以便接收下一个包
-            virtq_add_buf(rx_q, rx_q->buffers[desc_idx], PAGE_SIZE, VIRTQ_DESC_F_WRITE);
-            rx_q->used_idx++;
+// ==========================================================================
+// 中断处理
+// ==========================================================================
+// 使用 MSI-X 时配置变更、RX、TX 各有独立向量，处理函数直接知道要做什么；
+// 只有退回 INTx 时才需要读 ISR 状态寄存器来区分中断来源。
+
+// 回收设备已经发送完成的 TX 描述符
+static void virtio_net_tx_complete(void*) {
+    uint64_t flags = spin_lock_irqsave(&tx_q->lock);
+    uint16_t tx_device_idx = tx_q->used->idx;
+    bool freed = tx_q->used_idx != tx_device_idx;
+    while (tx_q->used_idx != tx_device_idx) {
+        struct virtq_used_elem* used_elem = &tx_q->used->ring[tx_q->used_idx % tx_q->num];
+        uint16_t desc_idx = used_elem->id;
+
+        // 重要：在这里释放为发送而分配的缓冲区
+        // pmm_free_page( (void*)tx_q->desc[desc_idx].addr ); // 暂缓实现
+
+        virtq_recycle(tx_q, desc_idx);
+        tx_q->used_idx++;
+    }
+    spin_unlock_irqrestore(&tx_q->lock, flags);
+    if (freed) async_event_signal(&tx_space_event);
+}
+
+// 处理已接收的数据包，并把缓冲区重新挂回 RX 队列。只在 rx_tasklet 里运行，不会并发
+static void virtio_net_rx_poll(void*) {
+    uint16_t rx_device_idx = rx_q->used->idx;
+    uint32_t budget = VIRTIO_NET_RX_BUDGET;
+    bool refilled = false;
+    while (rx_q->used_idx != rx_device_idx) {
+        if (budget-- == 0) {
+            // 预算用完：让出软中断，稍后继续
+            tasklet_schedule(&rx_tasklet);
+            break;
         }
+        struct virtq_used_elem* used_elem = &rx_q->used->ring[rx_q->used_idx % rx_q->num];
+        uint16_t desc_idx = used_elem->id;
+        uint32_t len = used_elem->len;
+        uint8_t* packet_data = rx_q->buffers[desc_idx];
+
+        uint16_t eth_type = (packet_data[10 + 12] << 8) | packet_data[10 + 13];
+        trace(virtio_net_rx, "desc=%u len=%u ethertype=0x%04X", desc_idx, len, eth_type);
+
+        // 将这个刚刚用完的缓冲区，重新放回接收队列，以便接收下一个包。
+        // 先归还描述符：它成为空闲链表头，add_buf 取回的正是同一个描述符，buffers[] 的对应关系不变
+        uint64_t flags = spin_lock_irqsave(&rx_q->lock);
+        virtq_recycle(rx_q, desc_idx);
+        spin_unlock_irqrestore(&rx_q->lock, flags);
+        virtq_add_buf(rx_q, rx_q->buffers[desc_idx], PAGE_SIZE, VIRTQ_DESC_F_WRITE);
+        rx_q->used_idx++;
+        refilled = true;
+    }
+    // 补回的缓冲区一次性通知设备
+    if (refilled) virtq_kick(rx_q);
+}
+
+static void virtio_net_config_changed(work_struct*) {
+    pr_notice("virtio-net: device configuration changed");
+}
+
+static irq_return_t virtio_net_msix_config(registers_t*, void*) {
+    schedule_work(&config_work);
+    return IRQ_HANDLED;
+}
+
+static irq_return_t virtio_net_msix_rx(registers_t*, void*) {
+    trace(virtio_net_irq, "msix rx used %u/%u", rx_q->used->idx, rx_q->used_idx);
+    tasklet_schedule(&rx_tasklet);
+    return IRQ_HANDLED;
+}
+
+static irq_return_t virtio_net_msix_tx(registers_t*, void*) {
+    trace(virtio_net_irq, "msix tx used %u/%u", tx_q->used->idx, tx_q->used_idx);
+    tasklet_schedule(&tx_tasklet);
+    return IRQ_HANDLED;
+}
+
+static irq_return_t virtio_net_intx(registers_t*, void*) {
+    return virtio_net_handle_interrupt() ? IRQ_HANDLED : IRQ_NONE;
+}
+
+// 处理 VirtIO 网卡 INTx 中断 (没有 MSI-X 时使用)
+bool virtio_net_handle_interrupt() {
+    // 1. 读取 ISR 状态寄存器 (这会清除设备的中断状态，相当于确认中断)
+    uint8_t isr_status = virtio_read_cap_8(isr_cfg_ptr, 0);
+
+    // 2. 只有在“队列更新”位被设置时才继续
+    if (isr_status & 0x01) { // VIRTIO_PCI_ISR_QUEUE
+        trace(virtio_net_irq, "isr=0x%02X tx used %u/%u rx used %u/%u",
+             isr_status, tx_q->used->idx, tx_q->used_idx, rx_q->used->idx, rx_q->used_idx);
+        tasklet_schedule(&tx_tasklet);
+        tasklet_schedule(&rx_tasklet);
+    } else if (isr_status & 0x02) { // VIRTIO_PCI_ISR_CONFIG
+        schedule_work(&config_work);
     }
+    return isr_status != 0;
 }
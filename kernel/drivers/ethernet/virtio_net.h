@@ -1,6 +1,8 @@
 #pragma once
 #include <stdint.h>
 #include <stddef.h>
+#include "kernel/sync/spinlock.h"
+#include "kernel/sched/async.h"
 
 // VirtIO PCI 配置空间偏移
 #define VIRTIO_PCI_CAP_COMMON_CFG 1 // Common configuration (virtio 1.0)
@@ -61,7 +63,10 @@ struct virtq {
     struct virtq_used  *used;
     uint16_t num;
     uint16_t queue_idx;
+    // 保护 free_head 和可用环：发送路径在普通上下文，回收与 RX 补充在中断里
+    spinlock lock;
     uint16_t free_head;
+    uint16_t num_free;      // 空闲链表里的描述符数
     volatile uint8_t* mmio_base_ptr;
     uint32_t queue_notify_off;
     uint32_t notify_off_multiplier;
@@ -74,11 +79,21 @@ struct virtq {
 // 初始化 virtio 网卡
 void virtio_net_init(uint8_t pci_bus, uint8_t pci_device, uint8_t pci_function);
 
-// 发送数据包
+// 发送数据包；发送环满时可以睡眠的线程等待空位 (最多 VIRTIO_NET_TX_TIMEOUT_NS)，其他上下文直接失败
 bool virtio_net_send_packet(const uint8_t* data, uint16_t len);
 
-// 处理 virtio 网卡中断
-void virtio_net_handle_interrupt();
+// 异步发送：在执行器上等发送环有空位再入队。data 在完成前必须保持有效
+#define VIRTIO_NET_TX_TIMEOUT_NS 100000000ull
+struct virtio_net_tx_request {
+    async_task task;
+    const uint8_t* data;
+    uint16_t len;
+    bool ok;
+};
+void virtio_net_send_async(virtio_net_tx_request* req, void (*done)(async_task* t));
+
+// virtio 网卡 INTx 中断：读 ISR 状态确认中断并调度下半部，ISR 状态为 0 (不是本设备) 时返回 false
+bool virtio_net_handle_interrupt();
 
 // 获取 MAC 地址
 const uint8_t* virtio_net_get_mac_address();
\ No newline at end of file
@@ -0,0 +1,268 @@
+#include "fb.h"
+#include "lib/libc.h"
+
+// ==========================================================================
+// 像素格式描述
+// ==========================================================================
+// 每个格式是一个只含静态成员的结构体：from_rgb() 负责颜色转换 (每次调用
+// 只做一次)，store() 负责把像素写入显存。渲染模板以它为参数实例化，
+// 编译器在每个实例里都能把 bytes/store 内联成固定宽度的写入。
+
+struct fmt_xrgb8888 {
+    static constexpr uint32_t bytes = 4;
+    static uint32_t from_rgb(uint32_t c) { return c & 0xFFFFFF; }
+    static void store(uint8_t* p, uint32_t v) { *(uint32_t*)p = v; }
+};
+
+struct fmt_xbgr8888 {
+    static constexpr uint32_t bytes = 4;
+    static uint32_t from_rgb(uint32_t c) {
+        return ((c & 0xFF) << 16) | (c & 0xFF00) | ((c >> 16) & 0xFF);
+    }
+    static void store(uint8_t* p, uint32_t v) { *(uint32_t*)p = v; }
+};
+
+struct fmt_rgb888 {
+    static constexpr uint32_t bytes = 3;
+    static uint32_t from_rgb(uint32_t c) { return c & 0xFFFFFF; }
+    static void store(uint8_t* p, uint32_t v) {
+        p[0] = (uint8_t)v;
+        p[1] = (uint8_t)(v >> 8);
+        p[2] = (uint8_t)(v >> 16);
+    }
+};
+
+struct fmt_bgr888 {
+    static constexpr uint32_t bytes = 3;
+    static uint32_t from_rgb(uint32_t c) { return fmt_xbgr8888::from_rgb(c); }
+    static void store(uint8_t* p, uint32_t v) { fmt_rgb888::store(p, v); }
+};
+
+struct fmt_rgb565 {
+    static constexpr uint32_t bytes = 2;
+    static uint32_t from_rgb(uint32_t c) {
+        uint32_t r = (c >> 16) & 0xFF, g = (c >> 8) & 0xFF, b = c & 0xFF;
+        return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+    }
+    static void store(uint8_t* p, uint32_t v) { *(uint16_t*)p = (uint16_t)v; }
+};
+
+struct fmt_rgb555 {
+    static constexpr uint32_t bytes = 2;
+    static uint32_t from_rgb(uint32_t c) {
+        uint32_t r = (c >> 16) & 0xFF, g = (c >> 8) & 0xFF, b = c & 0xFF;
+        return ((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3);
+    }
+    static void store(uint8_t* p, uint32_t v) { *(uint16_t*)p = (uint16_t)v; }
+};
+
+// ==========================================================================
+// 帧缓冲状态
+// ==========================================================================
+
+static uint8_t* fb_base = nullptr;
+static uint32_t fb_pitch = 0;   // 每行字节数，直接用于地址计算，不再除以 4
+static uint32_t fb_w = 0;
+static uint32_t fb_h = 0;
+
+static inline uint8_t* fb_row(uint32_t y) {
+    return fb_base + (size_t)y * fb_pitch;
+}
+
+// ==========================================================================
+// 渲染模板
+// ==========================================================================
+// 以下函数的参数都已经裁剪到屏幕内，像素值也已经是硬件格式。
+
+template <typename F>
+struct fb_renderer {
+    static uint32_t map_color(uint32_t rgb) { return F::from_rgb(rgb); }
+
+    static void put_pixel(uint32_t x, uint32_t y, uint32_t pixel) {
+        F::store(fb_row(y) + x * F::bytes, pixel);
+    }
+
+    static void fill_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t pixel) {
+        for (uint32_t row = 0; row < h; row++) {
+            uint8_t* p = fb_row(y + row) + x * F::bytes;
+            for (uint32_t col = 0; col < w; col++, p += F::bytes) {
+                F::store(p, pixel);
+            }
+        }
+    }
+
+    template <bool Opaque>
+    static void glyph(const uint32_t* rows, uint32_t width, uint32_t cw, uint32_t ch,
+                      uint32_t x, uint32_t y, uint32_t fg, uint32_t bg) {
+        for (uint32_t row = 0; row < ch; row++) {
+            uint32_t bits = rows[row];
+            uint8_t* p = fb_row(y + row) + x * F::bytes;
+            for (uint32_t col = 0; col < cw; col++, p += F::bytes) {
+                if ((bits >> (width - 1 - col)) & 1) {
+                    F::store(p, fg);
+                } else if (Opaque) {
+                    F::store(p, bg);
+                }
+            }
+        }
+    }
+
+    // 把字形光栅化到线性缓冲区 (行距 width * bytes)，供字形缓存直接 blit
+    static void raster(const uint32_t* rows, uint32_t width, uint32_t height,
+                       uint32_t fg, uint32_t bg, uint8_t* out) {
+        uint8_t* p = out;
+        for (uint32_t row = 0; row < height; row++) {
+            uint32_t bits = rows[row];
+            for (uint32_t col = 0; col < width; col++, p += F::bytes) {
+                F::store(p, ((bits >> (width - 1 - col)) & 1) ? fg : bg);
+            }
+        }
+    }
+};
+
+// 每种格式一张操作表，fb_init() 只在这里做一次选择
+struct fb_ops {
+    const char* name;
+    uint32_t (*map_color)(uint32_t rgb);
+    void (*put_pixel)(uint32_t x, uint32_t y, uint32_t pixel);
+    void (*fill_rect)(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t pixel);
+    void (*glyph)(const uint32_t* rows, uint32_t width, uint32_t cw, uint32_t ch,
+                  uint32_t x, uint32_t y, uint32_t fg, uint32_t bg);
+    void (*glyph_opaque)(const uint32_t* rows, uint32_t width, uint32_t cw, uint32_t ch,
+                         uint32_t x, uint32_t y, uint32_t fg, uint32_t bg);
+    void (*raster)(const uint32_t* rows, uint32_t width, uint32_t height,
+                   uint32_t fg, uint32_t bg, uint8_t* out);
+    uint32_t bytes;
+};
+
+#define FB_OPS(fmt, label) {                                   \
+    label,                                                     \
+    fb_renderer<fmt>::map_color,                               \
+    fb_renderer<fmt>::put_pixel,                               \
+    fb_renderer<fmt>::fill_rect,                               \
+    fb_renderer<fmt>::glyph<false>,                            \
+    fb_renderer<fmt>::glyph<true>,                             \
+    fb_renderer<fmt>::raster,                                  \
+    fmt::bytes,                                                \
+}
+
+// 下标与 enum fb_format 一一对应
+static const fb_ops fb_ops_table[] = {
+    { "none", nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, 0 },
+    FB_OPS(fmt_xrgb8888, "XRGB8888"),
+    FB_OPS(fmt_xbgr8888, "XBGR8888"),
+    FB_OPS(fmt_rgb888,   "RGB888"),
+    FB_OPS(fmt_bgr888,   "BGR888"),
+    FB_OPS(fmt_rgb565,   "RGB565"),
+    FB_OPS(fmt_rgb555,   "RGB555"),
+};
+
+static fb_format fb_fmt = FB_FORMAT_NONE;
+static const fb_ops* ops = &fb_ops_table[FB_FORMAT_NONE];
+
+// ==========================================================================
+// 初始化
+// ==========================================================================
+
+// 命令行中是否有 "fb_format=bgr"
+static bool fb_cmdline_bgr(const char* cmdline) {
+    if (!cmdline) return false;
+    for (const char* p = cmdline; *p; p++) {
+        if (strncmp(p, "fb_format=bgr", 13) == 0 && (p == cmdline || p[-1] == ' ')) {
+            return p[13] == '\0' || p[13] == ' ';
+        }
+    }
+    return false;
+}
+
+bool fb_init(stivale_struct* info) {
+    fb_fmt = FB_FORMAT_NONE;
+    ops = &fb_ops_table[FB_FORMAT_NONE];
+    if (!info || !info->framebuffer_addr) return false;
+
+    bool bgr = fb_cmdline_bgr((const char*)info->cmdline);
+    switch (info->framebuffer_bpp) {
+        case 32: fb_fmt = bgr ? FB_FORMAT_XBGR8888 : FB_FORMAT_XRGB8888; break;
+        case 24: fb_fmt = bgr ? FB_FORMAT_BGR888 : FB_FORMAT_RGB888; break;
+        case 16: fb_fmt = FB_FORMAT_RGB565; break;
+        case 15: fb_fmt = FB_FORMAT_RGB555; break;
+        default: return false;
+    }
+
+    fb_base = (uint8_t*)info->framebuffer_addr;
+    fb_pitch = info->framebuffer_pitch;
+    fb_w = info->framebuffer_width;
+    fb_h = info->framebuffer_height;
+    ops = &fb_ops_table[fb_fmt];
+    return true;
+}
+
+fb_format fb_get_format() { return fb_fmt; }
+const char* fb_format_name() { return ops->name; }
+uint32_t fb_width() { return fb_w; }
+uint32_t fb_height() { return fb_h; }
+uint32_t fb_bytes_per_pixel() { return ops->bytes; }
+
+// ==========================================================================
+// 公共绘制接口：裁剪 + 颜色转换各做一次，然后进入特化的像素循环
+// ==========================================================================
+
+uint32_t fb_map_color(uint32_t rgb) {
+    if (fb_fmt == FB_FORMAT_NONE) return 0;
+    return ops->map_color(rgb);
+}
+
+void fb_put_pixel(uint32_t x, uint32_t y, uint32_t rgb) {
+    if (fb_fmt == FB_FORMAT_NONE || x >= fb_w || y >= fb_h) return;
+    ops->put_pixel(x, y, ops->map_color(rgb));
+}
+
+void fb_fill_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t rgb) {
+    if (fb_fmt == FB_FORMAT_NONE || x >= fb_w || y >= fb_h) return;
+    if (w > fb_w - x) w = fb_w - x;
+    if (h > fb_h - y) h = fb_h - y;
+    ops->fill_rect(x, y, w, h, ops->map_color(rgb));
+}
+
+void fb_clear(uint32_t rgb) {
+    fb_fill_rect(0, 0, fb_w, fb_h, rgb);
+}
+
+void fb_draw_glyph(const uint32_t* rows, uint32_t width, uint32_t height,
+                   uint32_t x, uint32_t y, uint32_t fg, uint32_t bg, bool opaque) {
+    if (fb_fmt == FB_FORMAT_NONE || width == 0 || width > 32 || x >= fb_w || y >= fb_h) return;
+    uint32_t cw = width < fb_w - x ? width : fb_w - x;
+    uint32_t ch = height < fb_h - y ? height : fb_h - y;
+    uint32_t fg_px = ops->map_color(fg);
+    if (opaque) {
+        ops->glyph_opaque(rows, width, cw, ch, x, y, fg_px, ops->map_color(bg));
+    } else {
+        ops->glyph(rows, width, cw, ch, x, y, fg_px, 0);
+    }
+}
+
+void fb_render_glyph(const uint32_t* rows, uint32_t width, uint32_t height,
+                     uint32_t fg, uint32_t bg, uint8_t* out) {
+    if (fb_fmt == FB_FORMAT_NONE || width == 0 || width > 32) return;
+    ops->raster(rows, width, height, ops->map_color(fg), ops->map_color(bg), out);
+}
+
+void fb_blit(const uint8_t* src, uint32_t width, uint32_t height, uint32_t x, uint32_t y) {
+    if (fb_fmt == FB_FORMAT_NONE || x >= fb_w || y >= fb_h) return;
+    uint32_t src_pitch = width * ops->bytes;
+    uint32_t cw = width < fb_w - x ? width : fb_w - x;
+    uint32_t ch = height < fb_h - y ? height : fb_h - y;
+    for (uint32_t row = 0; row < ch; row++) {
+        memcpy(fb_row(y + row) + x * ops->bytes, src + row * src_pitch, cw * ops->bytes);
+    }
+}
+
+void fb_scroll(uint32_t pixels, uint32_t bg) {
+    if (fb_fmt == FB_FORMAT_NONE) return;
+    if (pixels >= fb_h) {
+        fb_clear(bg);
+        return;
+    }
+    memmove(fb_base, fb_row(pixels), (size_t)(fb_h - pixels) * fb_pitch);
+    ops->fill_rect(0, fb_h - pixels, fb_w, pixels, ops->map_color(bg));
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stivale.h>
+
+// ==========================================================================
+// 帧缓冲像素管线
+// ==========================================================================
+// 每种像素格式都有一套在编译期特化的绘制函数 (fb.cpp 中的模板)，
+// fb_init() 根据 framebuffer_bpp 只选择一次，之后每个绘制操作只有一次
+// 间接调用，像素循环内部没有格式判断、没有除法。
+// 对外接口的颜色一律是 0xRRGGBB，每次调用只转换一次到硬件像素格式。
+
+enum fb_format {
+    FB_FORMAT_NONE = 0,
+    FB_FORMAT_XRGB8888, // 32 bpp，内存中为 B G R X (最常见)
+    FB_FORMAT_XBGR8888, // 32 bpp，内存中为 R G B X
+    FB_FORMAT_RGB888,   // 24 bpp，内存中为 B G R
+    FB_FORMAT_BGR888,   // 24 bpp，内存中为 R G B
+    FB_FORMAT_RGB565,   // 16 bpp
+    FB_FORMAT_RGB555,   // 15 bpp (每像素占 16 位)
+};
+
+// stivale1 不提供颜色掩码，按 bpp 推断默认格式；
+// 红蓝互换的硬件可以在命令行中用 "fb_format=bgr" 覆盖。
+bool fb_init(stivale_struct* info);
+
+fb_format fb_get_format();
+const char* fb_format_name();
+uint32_t fb_width();
+uint32_t fb_height();
+uint32_t fb_bytes_per_pixel();
+
+// 把 0xRRGGBB 转换成当前格式的像素值
+uint32_t fb_map_color(uint32_t rgb);
+
+void fb_put_pixel(uint32_t x, uint32_t y, uint32_t rgb);
+void fb_fill_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t rgb);
+void fb_clear(uint32_t rgb);
+
+// 绘制单色位图字形：rows[r] 的第 (width - 1 - col) 位为 1 表示该像素是笔画。
+// opaque 为 true 时同时用 bg 填充背景，省掉先清空再描字的第二遍写入。
+void fb_draw_glyph(const uint32_t* rows, uint32_t width, uint32_t height,
+                   uint32_t x, uint32_t y, uint32_t fg, uint32_t bg, bool opaque);
+
+// 把字形按当前像素格式光栅化到 out (width * height * fb_bytes_per_pixel() 字节)，
+// 之后可以用 fb_blit 逐行拷贝到屏幕，用于字形缓存
+void fb_render_glyph(const uint32_t* rows, uint32_t width, uint32_t height,
+                     uint32_t fg, uint32_t bg, uint8_t* out);
+void fb_blit(const uint8_t* src, uint32_t width, uint32_t height, uint32_t x, uint32_t y);
+
+// 整屏向上滚动 pixels 行，并用 bg 填充底部空出的区域
+void fb_scroll(uint32_t pixels, uint32_t bg);
@@ -0,0 +1,331 @@
+#include "font.h"
+#include "fb.h"
+#include "tty.h"
+#include "kernel/mem/pmm.h"
+#include "lib/libc.h"
+
+// ==========================================================================
+// PSF2 字体
+// ==========================================================================
+
+static const psf2_header* psf = nullptr;
+static const uint8_t* psf_glyphs = nullptr;
+static uint32_t psf_row_bytes = 0;
+
+// BMP 码点 -> 字形下标的两级稀疏表：高 8 位选页，低 8 位选项。
+// 只为字体里真正出现的页分配内存，0xFFFF 表示没有对应字形。
+#define FONT_MAP_PAGES   256
+#define FONT_MAP_NONE    0xFFFF
+static uint16_t* font_map[FONT_MAP_PAGES];
+static uint8_t* map_chunk = nullptr;
+static uint32_t map_chunk_left = 0;
+
+static uint16_t* font_map_page(uint32_t page) {
+    if (font_map[page]) return font_map[page];
+
+    uint32_t page_bytes = 256 * sizeof(uint16_t);
+    if (map_chunk_left < page_bytes) {
+        map_chunk = (uint8_t*)buddy_alloc(PAGE_SIZE);
+        if (!map_chunk) return nullptr;
+        map_chunk_left = PAGE_SIZE;
+    }
+    uint16_t* entries = (uint16_t*)map_chunk;
+    map_chunk += page_bytes;
+    map_chunk_left -= page_bytes;
+    for (int i = 0; i < 256; i++) entries[i] = FONT_MAP_NONE;
+    font_map[page] = entries;
+    return entries;
+}
+
+// 解码一个 UTF-8 字符，非法序列返回 U+FFFD 并前进一个字节
+static uint32_t utf8_next(const uint8_t** pp, const uint8_t* end) {
+    const uint8_t* p = *pp;
+    uint8_t c = *p++;
+    uint32_t cp;
+    int extra;
+    if (c < 0x80)      { cp = c;        extra = 0; }
+    else if (c < 0xC0) { *pp = p; return 0xFFFD; }
+    else if (c < 0xE0) { cp = c & 0x1F; extra = 1; }
+    else if (c < 0xF0) { cp = c & 0x0F; extra = 2; }
+    else               { cp = c & 0x07; extra = 3; }
+
+    for (int i = 0; i < extra; i++) {
+        if (p >= end || (*p & 0xC0) != 0x80) {
+            *pp = *pp + 1;
+            return 0xFFFD;
+        }
+        cp = (cp << 6) | (*p++ & 0x3F);
+    }
+    *pp = p;
+    return cp;
+}
+
+// 解析字形数据之后的 Unicode 表：每个字形是若干 UTF-8 字符，
+// 0xFE 之后是组合序列 (这里忽略)，0xFF 结束当前字形
+static void psf_parse_unicode(const uint8_t* p, const uint8_t* end) {
+    uint32_t glyph = 0;
+    bool in_sequence = false;
+    while (p < end && glyph < psf->num_glyphs) {
+        uint8_t c = *p;
+        if (c == 0xFF) {
+            glyph++;
+            in_sequence = false;
+            p++;
+            continue;
+        }
+        if (c == 0xFE) {
+            in_sequence = true;
+            p++;
+            continue;
+        }
+        uint32_t cp = utf8_next(&p, end);
+        if (in_sequence || cp > 0xFFFF || glyph >= FONT_MAP_NONE) continue;
+
+        uint16_t* page = font_map_page(cp >> 8);
+        if (!page) return;
+        if (page[cp & 0xFF] == FONT_MAP_NONE) {
+            page[cp & 0xFF] = (uint16_t)glyph;
+        }
+    }
+}
+
+static bool psf_load(const uint8_t* begin, const uint8_t* end) {
+    if ((uint64_t)(end - begin) < sizeof(psf2_header)) return false;
+    const psf2_header* hdr = (const psf2_header*)begin;
+    if (hdr->magic != PSF2_MAGIC) return false;
+    if (hdr->width == 0 || hdr->width > FONT_MAX_WIDTH) return false;
+    if (hdr->height == 0 || hdr->height > FONT_MAX_HEIGHT) return false;
+
+    uint32_t row_bytes = (hdr->width + 7) / 8;
+    if (hdr->bytes_per_glyph < row_bytes * hdr->height) return false;
+    uint64_t glyph_end = (uint64_t)hdr->header_size + (uint64_t)hdr->num_glyphs * hdr->bytes_per_glyph;
+    if (glyph_end > (uint64_t)(end - begin)) return false;
+
+    psf = hdr;
+    psf_glyphs = begin + hdr->header_size;
+    psf_row_bytes = row_bytes;
+
+    if (hdr->flags & PSF2_HAS_UNICODE) {
+        psf_parse_unicode(begin + glyph_end, end);
+    } else {
+        // 没有 Unicode 表时，字形下标就是码点
+        uint32_t count = hdr->num_glyphs < 256 ? hdr->num_glyphs : 256;
+        uint16_t* page = font_map_page(0);
+        if (!page) return false;
+        for (uint32_t i = 0; i < count; i++) page[i] = (uint16_t)i;
+    }
+    return true;
+}
+
+// 查找码点对应的字形下标
+static uint32_t psf_lookup(uint32_t cp) {
+    if (cp > 0xFFFF) return FONT_MAP_NONE;
+    uint16_t* page = font_map[cp >> 8];
+    return page ? page[cp & 0xFF] : FONT_MAP_NONE;
+}
+
+// ==========================================================================
+// 公共接口
+// ==========================================================================
+
+bool font_is_psf() { return psf != nullptr; }
+uint32_t font_width() { return psf ? psf->width : 9; }
+uint32_t font_height() { return psf ? psf->height : 16; }
+
+void font_glyph_rows(uint32_t codepoint, uint32_t* rows) {
+    if (!psf) {
+        tty_glyph_rows(codepoint < 128 ? (char)codepoint : '?', rows);
+        return;
+    }
+
+    uint32_t index = psf_lookup(codepoint);
+    if (index == FONT_MAP_NONE) index = psf_lookup(0xFFFD);
+    if (index == FONT_MAP_NONE) index = psf_lookup('?');
+    if (index == FONT_MAP_NONE || index >= psf->num_glyphs) index = 0;
+
+    // PSF2 每行按字节对齐、高位在左，转换成第 (width-1-col) 位对应第 col 列
+    const uint8_t* glyph = psf_glyphs + index * psf->bytes_per_glyph;
+    uint32_t shift = psf_row_bytes * 8 - psf->width;
+    for (uint32_t row = 0; row < psf->height; row++) {
+        uint32_t bits = 0;
+        for (uint32_t b = 0; b < psf_row_bytes; b++) {
+            bits = (bits << 8) | glyph[row * psf_row_bytes + b];
+        }
+        rows[row] = bits >> shift;
+    }
+}
+
+// ==========================================================================
+// LRU 字形缓存
+// ==========================================================================
+// 槽位用下标串成双向链表 (头部最近使用、尾部最久未用)，另有按
+// (码点, 前景色, 背景色) 哈希的单链表用于查找。未命中时复用尾部槽位。
+
+struct glyph_slot {
+    uint32_t codepoint;
+    uint32_t fg;
+    uint32_t bg;
+    bool used;
+    int16_t prev;
+    int16_t next;
+    int16_t hash_next;
+    uint8_t* pixels;
+};
+
+static glyph_slot slots[FONT_CACHE_SLOTS];
+static int16_t buckets[FONT_CACHE_BUCKETS];
+static int16_t lru_head = -1;
+static int16_t lru_tail = -1;
+static bool cache_ready = false;
+static uint32_t cache_used = 0;
+static uint64_t cache_hits = 0;
+static uint64_t cache_misses = 0;
+static uint64_t cache_evictions = 0;
+
+static inline uint32_t glyph_hash(uint32_t cp, uint32_t fg, uint32_t bg) {
+    uint32_t h = cp * 0x9E3779B1u ^ fg * 0x85EBCA6Bu ^ bg * 0xC2B2AE35u;
+    return (h ^ (h >> 16)) & (FONT_CACHE_BUCKETS - 1);
+}
+
+static void lru_unlink(int16_t i) {
+    if (slots[i].prev >= 0) slots[slots[i].prev].next = slots[i].next;
+    else lru_head = slots[i].next;
+    if (slots[i].next >= 0) slots[slots[i].next].prev = slots[i].prev;
+    else lru_tail = slots[i].prev;
+}
+
+static void lru_push_front(int16_t i) {
+    slots[i].prev = -1;
+    slots[i].next = lru_head;
+    if (lru_head >= 0) slots[lru_head].prev = i;
+    lru_head = i;
+    if (lru_tail < 0) lru_tail = i;
+}
+
+static void hash_remove(int16_t i) {
+    uint32_t b = glyph_hash(slots[i].codepoint, slots[i].fg, slots[i].bg);
+    int16_t* link = &buckets[b];
+    while (*link >= 0) {
+        if (*link == i) {
+            *link = slots[i].hash_next;
+            return;
+        }
+        link = &slots[*link].hash_next;
+    }
+}
+
+static bool font_cache_init() {
+    cache_ready = false;
+    uint32_t bpp = fb_bytes_per_pixel();
+    if (bpp == 0) return false;
+
+    // 每个槽位保存一个已光栅化的字形，按 buddy 的最大块 (64KB) 成批分配
+    uint32_t slot_bytes = font_width() * font_height() * bpp;
+    uint32_t chunk_bytes = 65536;
+    uint32_t per_chunk = chunk_bytes / slot_bytes;
+    uint8_t* chunk = nullptr;
+    uint32_t left = 0;
+
+    for (int i = 0; i < FONT_CACHE_BUCKETS; i++) buckets[i] = -1;
+    lru_head = lru_tail = -1;
+    for (int16_t i = 0; i < FONT_CACHE_SLOTS; i++) {
+        if (left == 0) {
+            chunk = (uint8_t*)buddy_alloc(chunk_bytes);
+            if (!chunk) return false;
+            left = per_chunk;
+        }
+        slots[i].pixels = chunk;
+        slots[i].used = false;
+        slots[i].hash_next = -1;
+        chunk += slot_bytes;
+        left--;
+        lru_push_front(i);
+    }
+    cache_used = 0;
+    cache_ready = true;
+    return true;
+}
+
+void font_draw(uint32_t codepoint, uint32_t x, uint32_t y, uint32_t fg, uint32_t bg) {
+    uint32_t w = font_width();
+    uint32_t h = font_height();
+    uint32_t rows[FONT_MAX_HEIGHT];
+
+    if (!cache_ready) {
+        font_glyph_rows(codepoint, rows);
+        fb_draw_glyph(rows, w, h, x, y, fg, bg, true);
+        return;
+    }
+
+    uint32_t b = glyph_hash(codepoint, fg, bg);
+    for (int16_t i = buckets[b]; i >= 0; i = slots[i].hash_next) {
+        if (slots[i].codepoint == codepoint && slots[i].fg == fg && slots[i].bg == bg) {
+            cache_hits++;
+            if (lru_head != i) {
+                lru_unlink(i);
+                lru_push_front(i);
+            }
+            fb_blit(slots[i].pixels, w, h, x, y);
+            return;
+        }
+    }
+
+    // 未命中：复用最久未使用的槽位
+    cache_misses++;
+    int16_t victim = lru_tail;
+    if (slots[victim].used) {
+        hash_remove(victim);
+        cache_evictions++;
+    } else {
+        cache_used++;
+    }
+    lru_unlink(victim);
+
+    font_glyph_rows(codepoint, rows);
+    fb_render_glyph(rows, w, h, fg, bg, slots[victim].pixels);
+    slots[victim].codepoint = codepoint;
+    slots[victim].fg = fg;
+    slots[victim].bg = bg;
+    slots[victim].used = true;
+    slots[victim].hash_next = buckets[b];
+    buckets[b] = victim;
+    lru_push_front(victim);
+
+    fb_blit(slots[victim].pixels, w, h, x, y);
+}
+
+void font_get_stats(font_cache_stats* out) {
+    out->hits = cache_hits;
+    out->misses = cache_misses;
+    out->evictions = cache_evictions;
+    out->used = cache_used;
+    out->capacity = cache_ready ? FONT_CACHE_SLOTS : 0;
+}
+
+// ==========================================================================
+// 初始化
+// ==========================================================================
+
+bool font_init(stivale_struct* info) {
+    bool loaded = false;
+    if (info && info->modules) {
+        // 优先使用 MODULE_STRING=font 的模块，否则取第一个带 PSF2 魔数的模块
+        const stivale_module* font_mod = nullptr;
+        const stivale_module* mod = (const stivale_module*)info->modules;
+        for (uint64_t i = 0; i < info->module_count && mod; i++) {
+            const uint8_t* begin = (const uint8_t*)mod->begin;
+            bool is_psf = mod->end - mod->begin >= 4 && *(const uint32_t*)begin == PSF2_MAGIC;
+            if (is_psf && strcmp(mod->string, "font") == 0) {
+                font_mod = mod;
+                break;
+            }
+            if (is_psf && !font_mod) font_mod = mod;
+            mod = (const stivale_module*)mod->next;
+        }
+        if (font_mod) {
+            loaded = psf_load((const uint8_t*)font_mod->begin, (const uint8_t*)font_mod->end);
+        }
+    }
+    font_cache_init();
+    return loaded;
+}
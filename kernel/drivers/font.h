@@ -0,0 +1,56 @@
+#pragma once
+#include <stdint.h>
+#include <stivale.h>
+
+// ==========================================================================
+// 字体与字形缓存
+// ==========================================================================
+// 默认使用 tty.cpp 中内置的 9x16 ASCII 字体。若 Limine 以模块形式加载了
+// PSF2 字体 (MODULE_STRING=font)，则改用它并按其 Unicode 表查找字形，
+// 这样中文等非 ASCII 字符也能显示。
+//
+// 字形在第一次绘制时才光栅化为当前帧缓冲像素格式，按 (码点, 前景色, 背景色)
+// 存入有界的 LRU 缓存，之后重复出现的字符只需逐行 memcpy。
+
+#define PSF2_MAGIC          0x864AB572
+#define PSF2_HAS_UNICODE    0x01
+
+struct psf2_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t flags;
+    uint32_t num_glyphs;
+    uint32_t bytes_per_glyph;
+    uint32_t height;
+    uint32_t width;
+} __attribute__((packed));
+
+#define FONT_MAX_WIDTH      32
+#define FONT_MAX_HEIGHT     32
+#define FONT_CACHE_SLOTS    128  // 缓存的字形数量上限
+#define FONT_CACHE_BUCKETS  256  // 哈希桶数量 (2 的幂)
+
+// 在引导模块中查找 PSF2 字体并分配字形缓存，必须在 buddy_init 之后调用。
+// 没有字体模块时仍然会为内置字体建立缓存，返回值表示是否加载了 PSF2 字体。
+bool font_init(stivale_struct* info);
+
+bool font_is_psf();
+uint32_t font_width();
+uint32_t font_height();
+
+// 取得码点对应的行位图 (rows 至少 FONT_MAX_HEIGHT 项)，缺失的字形回退为 U+FFFD 或 '?'
+void font_glyph_rows(uint32_t codepoint, uint32_t* rows);
+
+// 在 (x, y) 处以不透明背景绘制一个字符，优先走字形缓存
+void font_draw(uint32_t codepoint, uint32_t x, uint32_t y, uint32_t fg, uint32_t bg);
+
+// 字形缓存统计
+struct font_cache_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint32_t used;
+    uint32_t capacity;
+};
+void font_get_stats(font_cache_stats* out);
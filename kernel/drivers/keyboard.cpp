@@ -2,6 +2,9 @@
 #include "tty.h"
 #include <stivale.h>
 #include "command/shell.h"
+#include "kernel/cpu/isr.h"
+#include "kernel/cpu/irq.h"
+#include "kernel/cpu/ports.h"
 
 #define CMD_BUFFER_SIZE 256
 char cmd_buffer[CMD_BUFFER_SIZE];
@@ -39,10 +42,17 @@ const char scancode_to_char_upper[] = {
     0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0
 };
 
+// IRQ1：从 8042 数据端口取出扫描码
+static irq_return_t keyboard_irq(registers_t*, void*) {
+    keyboard_handle_scancode(inb(0x60));
+    return IRQ_HANDLED;
+}
+
 void init_keyboard() {
     // 初始化键盘状态
     shift_pressed = false;
     caps_lock = false;
+    register_irq_handler(IRQ_VECTOR_BASE + 1, keyboard_irq, nullptr);
 }
 
 void keyboard_handle_scancode(uint8_t scancode) {
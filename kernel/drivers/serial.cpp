@@ -0,0 +1,142 @@
+#include "serial.h"
+#include "kernel/cpu/ports.h"
+#include "kernel/cpu/isr.h"
+#include "kernel/cpu/irq.h"
+#include "kernel/sync/spinlock.h"
+#include "command/shell.h"
+
+// ==========================================================================
+// 16550 UART (COM1) 驱动
+// ==========================================================================
+// 输出先进入一个软件发送环，每次 THRE (发送保持寄存器空) 中断一次性
+// 向硬件 FIFO 填入 16 个字节，调用者不必逐字节等待 UART。
+
+#define SERIAL_FIFO_DEPTH 16
+#define SERIAL_TX_RING_SIZE 4096 // 必须是 2 的幂
+
+static bool serial_ok = false;
+static char tx_ring[SERIAL_TX_RING_SIZE];
+static volatile uint32_t tx_head = 0; // 生产者写入位置
+static volatile uint32_t tx_tail = 0; // 消费者 (中断) 读取位置
+// 保护发送环和 IER：任何 CPU 都可能写串口，THRE 中断在 BSP 上消费
+static spinlock tx_lock;
+
+static inline uint8_t serial_in(uint16_t reg) {
+    return inb(SERIAL_COM1_PORT + reg);
+}
+
+static inline void serial_out(uint16_t reg, uint8_t val) {
+    outb(SERIAL_COM1_PORT + reg, val);
+}
+
+// 从发送环向硬件 FIFO 填充最多 16 字节。必须在关中断状态下调用。
+// 发送环为空时关闭 THRE 中断，否则保持开启等待下一次 FIFO 变空。
+static void serial_fill_fifo() {
+    int n = 0;
+    while (tx_tail != tx_head && n < SERIAL_FIFO_DEPTH) {
+        serial_out(SERIAL_REG_DATA, tx_ring[tx_tail & (SERIAL_TX_RING_SIZE - 1)]);
+        tx_tail++;
+        n++;
+    }
+    uint8_t ier = SERIAL_IER_RX_AVAIL;
+    if (tx_tail != tx_head) ier |= SERIAL_IER_THR_EMPTY;
+    serial_out(SERIAL_REG_IER, ier);
+}
+
+static irq_return_t serial_irq(registers_t*, void*) {
+    return serial_handle_interrupt() ? IRQ_HANDLED : IRQ_NONE;
+}
+
+bool serial_init() {
+    serial_out(SERIAL_REG_IER, 0x00);    // 先关闭所有 UART 中断
+    serial_out(SERIAL_REG_LCR, 0x80);    // DLAB=1，设置波特率除数
+    serial_out(SERIAL_REG_DATA, 0x01);   // 除数低字节: 115200 baud
+    serial_out(SERIAL_REG_IER, 0x00);    // 除数高字节
+    serial_out(SERIAL_REG_LCR, 0x03);    // 8 位数据，无校验，1 位停止位
+    serial_out(SERIAL_REG_IIR, 0xC7);    // 开启 FIFO，清空收发 FIFO，14 字节接收阈值
+
+    // 回环自检：写入一个字节并读回，确认 UART 真实存在
+    serial_out(SERIAL_REG_MCR, 0x1E);
+    serial_out(SERIAL_REG_DATA, 0xAE);
+    if (serial_in(SERIAL_REG_DATA) != 0xAE) {
+        serial_ok = false;
+        return false;
+    }
+
+    // 正常模式: DTR | RTS | OUT2 (OUT2 必须置位，否则中断不会送到 PIC)
+    serial_out(SERIAL_REG_MCR, 0x0B);
+    serial_out(SERIAL_REG_IER, SERIAL_IER_RX_AVAIL);
+    spin_lock_init(&tx_lock, "serial_tx");
+    tx_head = tx_tail = 0;
+    serial_ok = true;
+    register_irq_handler(IRQ_VECTOR_BASE + SERIAL_COM1_IRQ, serial_irq, nullptr);
+    return true;
+}
+
+bool serial_present() {
+    return serial_ok;
+}
+
+void serial_write(const char* data, size_t len) {
+    if (!serial_ok) return;
+
+    uint64_t flags = spin_lock_irqsave(&tx_lock);
+    for (size_t i = 0; i < len; i++) {
+        if (tx_head - tx_tail == SERIAL_TX_RING_SIZE) {
+            // 发送环已满：轮询等待 FIFO 变空，腾出 16 字节的空间
+            while (!(serial_in(SERIAL_REG_LSR) & SERIAL_LSR_THR_EMPTY)) {
+                asm volatile("pause");
+            }
+            serial_fill_fifo();
+        }
+        tx_ring[tx_head & (SERIAL_TX_RING_SIZE - 1)] = data[i];
+        tx_head++;
+    }
+    // 如果硬件当前空闲，直接启动发送；否则等 THRE 中断继续
+    if (serial_in(SERIAL_REG_LSR) & SERIAL_LSR_THR_EMPTY) {
+        serial_fill_fifo();
+    } else {
+        serial_out(SERIAL_REG_IER, SERIAL_IER_RX_AVAIL | SERIAL_IER_THR_EMPTY);
+    }
+    spin_unlock_irqrestore(&tx_lock, flags);
+}
+
+void serial_flush() {
+    if (!serial_ok) return;
+
+    uint64_t flags = spin_lock_irqsave(&tx_lock);
+    while (tx_tail != tx_head) {
+        while (!(serial_in(SERIAL_REG_LSR) & SERIAL_LSR_THR_EMPTY)) {
+            asm volatile("pause");
+        }
+        serial_fill_fifo();
+    }
+    spin_unlock_irqrestore(&tx_lock, flags);
+}
+
+bool serial_handle_interrupt() {
+    if (!serial_ok) return false;
+    // IIR bit 0 为 1 表示 UART 没有挂起的中断 (COM1/COM3 可能共用一条线)
+    if (serial_in(SERIAL_REG_IIR) & 0x01) return false;
+
+    // 接收：把串口输入交给 shell，这样无头运行时也能输入命令
+    while (serial_in(SERIAL_REG_LSR) & SERIAL_LSR_DATA_READY) {
+        char c = (char)serial_in(SERIAL_REG_DATA);
+        if (c == '\r') c = '\n';
+        if (c == 0x7F) c = '\b';
+        shell_handle_char(c);
+    }
+
+    // 发送：FIFO 已空，继续填充
+    spin_lock(&tx_lock);
+    if (serial_in(SERIAL_REG_LSR) & SERIAL_LSR_THR_EMPTY) {
+        serial_fill_fifo();
+    }
+    spin_unlock(&tx_lock);
+    return true;
+}
+
+void serial_panic_unlock() {
+    // 持锁的 CPU 可能已经停下来，不再等它
+    __atomic_store_n(&tx_lock.value, 0, __ATOMIC_RELEASE);
+}
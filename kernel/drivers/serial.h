@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// COM1 端口与中断线
+#define SERIAL_COM1_PORT 0x3F8
+#define SERIAL_COM1_IRQ  4
+
+// 16550 UART 寄存器偏移
+#define SERIAL_REG_DATA  0 // RBR / THR (DLAB=0)，DLL (DLAB=1)
+#define SERIAL_REG_IER   1 // 中断使能，DLM (DLAB=1)
+#define SERIAL_REG_IIR   2 // 中断标识 (读) / FIFO 控制 FCR (写)
+#define SERIAL_REG_LCR   3 // 线路控制
+#define SERIAL_REG_MCR   4 // Modem 控制
+#define SERIAL_REG_LSR   5 // 线路状态
+
+#define SERIAL_LSR_DATA_READY 0x01
+#define SERIAL_LSR_THR_EMPTY  0x20
+
+#define SERIAL_IER_RX_AVAIL   0x01
+#define SERIAL_IER_THR_EMPTY  0x02
+
+// 初始化 COM1 (115200 8N1，开启 16 字节 FIFO)，成功检测到 UART 时返回 true
+bool serial_init();
+
+// 串口是否存在并已初始化
+bool serial_present();
+
+// 将数据放入发送环，由 THRE 中断异步送出；环满时退化为轮询发送
+void serial_write(const char* data, size_t len);
+
+// 轮询方式把发送环中的数据全部送出 (panic 等关中断场景使用)
+void serial_flush();
+
+// panic 时强制释放发送环锁 (持锁的 CPU 可能再也不会释放它)
+void serial_panic_unlock();
+
+// IRQ4 处理函数 (serial_init 成功时登记)，UART 没有挂起的中断时返回 false
+bool serial_handle_interrupt();
@@ -1,4 +1,7 @@
 #include "tty.h"
+#include "console.h"
+#include "fb.h"
+#include "font.h"
 #include "kernel/boot.h" // 需要全局的 boot_info
 #include "lib/libc.h"
 #include <stdint.h>
@@ -529,32 +532,13 @@ const unsigned char console_tty_9x16[] = {
 // 底层绘制函数 (Private-like Functions)
 // ==========================================================================
 
-// 在指定像素坐标处绘制一个像素点
-static void put_pixel(uint32_t x, uint32_t y, uint32_t color) {
-    // 检查边界，防止写入屏幕外内存
-    if (!boot_info || x >= boot_info->framebuffer_width || y >= boot_info->framebuffer_height) {
-    return;
-    }
-    // 计算像素在帧缓冲中的地址并写入颜色
-    uint32_t* fb_addr = (uint32_t*)boot_info->framebuffer_addr;
-    uint32_t pitch_in_pixels = boot_info->framebuffer_pitch / 4;
-    fb_addr[y * pitch_in_pixels + x] = color;
-}
-
-// 在指定像素坐标处，根据字体数据绘制一个字符
-static void putchar_at(char c, uint32_t x, uint32_t y, uint32_t color) {
+// 把 9x16 字体中的一个字形展开为 fb_draw_glyph 使用的行位图
+// (每行 16 位小端存储，第 8 位对应最左列)
+void tty_glyph_rows(char c, uint32_t rows[16]) {
     if ((unsigned char)c >= 128) { c = '?'; }
-
     const unsigned char* glyph = console_tty_9x16 + ((unsigned char)c * 32);
-
     for (uint32_t row = 0; row < 16; row++) {
-    uint16_t row_data = *(uint16_t*)(glyph + row * 2);
-    for (uint32_t col = 0; col < 9; col++) {
-        // 只绘制笔画，不填充背景
-        if ((row_data >> (8 - col)) & 1) {
-        put_pixel(x + col, y + row, color);
-        }
-    }
+    rows[row] = *(const uint16_t*)(glyph + row * 2) & 0x1FF;
     }
 }
 
@@ -565,6 +549,10 @@ static void putchar_at(char c, uint32_t x, uint32_t y, uint32_t color) {
 // 初始化 TTY 系统
 void tty_init(stivale_struct* boot_info_ptr) {
     boot_info = boot_info_ptr;
+    // 根据 bpp 只选择一次像素管线；不支持的格式直接关闭帧缓冲输出
+    if (!fb_init(boot_info_ptr)) {
+    console_set_sinks(console_get_sinks() & ~CONSOLE_FB);
+    }
     cursor_x = 10;
     cursor_y = 0;
     current_bg_color = 0x1E1E1E;
@@ -572,63 +560,126 @@ void tty_init(stivale_struct* boot_info_ptr) {
 }
 
 void tty_clear() {
-    for (uint32_t y = 0; y < boot_info->framebuffer_height; y++) {
-    for (uint32_t x = 0; x < boot_info->framebuffer_width; x++) {
-        put_pixel(x, y, current_bg_color);
-    }
-    }
+    uint64_t flags = console_lock();
+    if (console_fb_enabled()) fb_clear(current_bg_color);
     cursor_x = 10;
     cursor_y = 0;
+    console_unlock(flags);
 }
 
-// 在当前光标位置处理并打印一个字符
-void tty_putc(char c, uint32_t color) {
-    if (c == '\n') {
+// 字符单元尺寸取决于当前字体 (内置 9x16 或 PSF2 模块)
+uint32_t tty_cell_width() { return font_width(); }
+uint32_t tty_cell_height() { return font_height(); }
+uint32_t tty_line_height() { return font_height() + 2; }
+
+// 在帧缓冲的当前光标位置处理并绘制一个字符
+static void fb_putc(uint32_t cp, uint32_t color) {
+    uint32_t cw = tty_cell_width();
+    uint32_t ch = tty_cell_height();
+    uint32_t line = tty_line_height();
+
+    if (cp == '\n') {
     cursor_x = 10;
-    cursor_y += 18;
-    } else if (c == '\b') {
+    cursor_y += line;
+    } else if (cp == '\b') {
     if (cursor_x > 10) {
-        cursor_x -= 9;
-        for (uint32_t row = 0; row < 16; row++) {
-        for (uint32_t col = 0; col < 9; col++) {
-            put_pixel(cursor_x + col, cursor_y + row, current_bg_color);
-        }
-        }
+        cursor_x -= cw;
+        fb_fill_rect(cursor_x, cursor_y, cw, ch, current_bg_color);
     }
     } else {
     // 自动换行
-    if (cursor_x + 9 > boot_info->framebuffer_width) {
+    if (cursor_x + cw > boot_info->framebuffer_width) {
         cursor_x = 10;
-        cursor_y += 18;
+        cursor_y += line;
     }
     // 写入前判断是否需要滚动
-    if (cursor_y + 16 > boot_info->framebuffer_height - 1) {
-        uint32_t scroll_height = 18;
-        uint8_t* fb = (uint8_t*)boot_info->framebuffer_addr;
-        size_t bytes_to_move = (boot_info->framebuffer_height - scroll_height) * boot_info->framebuffer_pitch;
-        memmove(fb, fb + scroll_height * boot_info->framebuffer_pitch, bytes_to_move);
-        uint32_t* last_row = (uint32_t*)(fb + (boot_info->framebuffer_height - scroll_height) * boot_info->framebuffer_pitch);
-        for (size_t i = 0; i < (scroll_height * boot_info->framebuffer_pitch / 4); i++) {
-        last_row[i] = current_bg_color;
-        }
-        cursor_y = boot_info->framebuffer_height - scroll_height;
+    if (cursor_y + ch > boot_info->framebuffer_height - 1u) {
+        fb_scroll(line, current_bg_color);
+        cursor_y = boot_info->framebuffer_height - line;
         cursor_x = 10;
     }
 
-    // 写字符
-    for (uint32_t row = 0; row < 16; row++)
-        for (uint32_t col = 0; col < 9; col++)
-        put_pixel(cursor_x + col, cursor_y + row, current_bg_color);
-    putchar_at(c, cursor_x, cursor_y, color);
-    cursor_x += 9;
+    // 写字符 (背景和笔画一遍写完，重复字符走字形缓存)
+    font_draw(cp, cursor_x, cursor_y, color, current_bg_color);
+    cursor_x += cw;
+    }
+}
+
+// ==========================================================================
+// UTF-8 流式解码
+// ==========================================================================
+// tty_putc 可能逐字节收到多字节字符 (例如串口输入)，所以解码状态跨调用保留。
+
+static uint32_t utf8_cp = 0;
+static uint32_t utf8_need = 0;
+
+// 送入一个字节，得到完整码点时返回 true
+static bool utf8_feed(uint8_t c, uint32_t* out) {
+    if (utf8_need > 0) {
+    if ((c & 0xC0) == 0x80) {
+        utf8_cp = (utf8_cp << 6) | (c & 0x3F);
+        if (--utf8_need == 0) {
+        *out = utf8_cp;
+        return true;
+        }
+        return false;
+    }
+    // 序列被打断：先输出替换字符，再把当前字节当作新字符处理
+    utf8_need = 0;
+    *out = 0xFFFD;
+    return true;
+    }
+
+    if (c < 0x80) {
+    *out = c;
+    return true;
+    } else if (c >= 0xC0 && c < 0xE0) {
+    utf8_cp = c & 0x1F;
+    utf8_need = 1;
+    } else if (c >= 0xE0 && c < 0xF0) {
+    utf8_cp = c & 0x0F;
+    utf8_need = 2;
+    } else if (c >= 0xF0 && c < 0xF8) {
+    utf8_cp = c & 0x07;
+    utf8_need = 3;
+    } else {
+    *out = 0xFFFD;
+    return true;
     }
+    return false;
 }
 
-// 在当前光标位置打印一个字符串
+static void fb_put_byte(uint8_t c, uint32_t color) {
+    uint32_t cp;
+    bool interrupted = utf8_need > 0 && (c & 0xC0) != 0x80;
+    if (utf8_feed(c, &cp)) {
+    fb_putc(cp, color);
+    if (interrupted && utf8_feed(c, &cp)) {
+        fb_putc(cp, color);
+    }
+    }
+}
+
+// 在当前光标位置处理并打印一个字符
+void tty_putc(char c, uint32_t color) {
+    uint64_t flags = console_lock();
+    console_write(&c, 1);
+    if (console_fb_enabled()) {
+    fb_put_byte((uint8_t)c, color);
+    }
+    console_unlock(flags);
+}
+
+// 在当前光标位置打印一个字符串 (UTF-8)。整个字符串在控制台锁内输出，不会和其他 CPU 的输出交错
 void tty_print(const char* str, uint32_t color) {
+    uint64_t flags = console_lock();
+    console_write(str, strlen(str));
+    if (console_fb_enabled()) {
     for (int i = 0; str[i] != '\0'; i++) {
-    tty_putc(str[i], color);
+        fb_put_byte((uint8_t)str[i], color);
+    }
     }
+    console_unlock(flags);
 }
 
 // 打印十六进制数
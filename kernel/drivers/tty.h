@@ -5,6 +5,10 @@
 extern const unsigned char console_tty_9x16[];
 
 void tty_init(stivale_struct* boot_info);
+void tty_glyph_rows(char c, uint32_t rows[16]);
+uint32_t tty_cell_width();
+uint32_t tty_cell_height();
+uint32_t tty_line_height();
 void print_hex(uint64_t value, uint32_t color);
 void print_dec(uint64_t value, uint32_t color);
 void tty_print(const char* str, uint32_t color);
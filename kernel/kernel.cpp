@@ -7,17 +7,39 @@
 #include "kernel/drivers/tty.h"
 #include "mem/pmm.h"
 #include "command/shell.h"
+#include "klog.h"
+#include "kernel/drivers/console.h"
+#include "kernel/drivers/serial.h"
+#include "kernel/drivers/fb.h"
+#include "kernel/drivers/font.h"
+#include "lib/libc.h"
 
 // ================== CPU/中断/定时器/PCI/驱动头文件 ==================
 #include "cpu/idt.h"
 #include "cpu/isr.h"
 #include "cpu/pic.h"
-#include "cpu/pit.h"
+#include "cpu/irq.h"
 #include "cpu/pci.h"
+#include "cpu/smp.h"
+#include "cpu/cpufeature.h"
+#include "cpu/alternative.h"
 #include "kernel/drivers/keyboard.h"
 #include "kernel/drivers/ata/ata.h"
 #include "kernel/drivers/ethernet/e1000.h"
 #include "kernel/drivers/ethernet/virtio_net.h"
+#include "kernel/time/clock.h"
+#include "kernel/time/clockevent.h"
+#include "kernel/time/tick.h"
+#include "kernel/time/timer_wheel.h"
+#include "softirq.h"
+#include "workqueue.h"
+#include "sync/rcu.h"
+#include "sched/sched.h"
+#include "sched/taskpool.h"
+#include "sched/async.h"
+#include "sched/idle.h"
+#include "bootchart.h"
+#include "probe.h"
 
 // ================== 版本号与全局变量 ==================
 const char* KERNEL_VERSION = "1.4.0-dirty+";
@@ -43,114 +65,216 @@ static struct stivale_header_tag stivale_hdr = {
 };
 
 // ================== 内核图形/字符输出相关函数 ==================
+// 具体的像素格式由 fb.cpp 在 tty_init 时选定，这里只是薄封装
 void put_pixel(uint32_t x, uint32_t y, uint32_t color) {
-    if (!boot_info || x >= boot_info->framebuffer_width || y >= boot_info->framebuffer_height) return;
-    uint32_t* fb_addr = (uint32_t*)boot_info->framebuffer_addr;
-    uint32_t pitch_in_pixels = boot_info->framebuffer_pitch / 4;
-    fb_addr[y * pitch_in_pixels + x] = color;
+    fb_put_pixel(x, y, color);
 }
 
 void putchar_at(char c, uint32_t x, uint32_t y, uint32_t color) {
     if ((unsigned char)c >= 128) return;
-    const unsigned char* glyph = console_tty_9x16 + ((unsigned char)c * 32);
-    for (uint32_t row = 0; row < 16; row++) {
-        uint16_t row_data = *(uint16_t*)(glyph + row * 2);
-        for (uint32_t col = 0; col < 9; col++) {
-            if ((row_data >> (8 - col)) & 1) {
-                put_pixel(x + col, y + row, color);
-            }
-        }
-    }
+    uint32_t rows[FONT_MAX_HEIGHT];
+    font_glyph_rows((unsigned char)c, rows);
+    fb_draw_glyph(rows, font_width(), font_height(), x, y, color, 0, false);
 }
 
 void draw_rect(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t color) {
-    for (uint32_t i = 0; i < height; i++) {
-        for (uint32_t j = 0; j < width; j++) {
-            put_pixel(x + j, y + i, color);
-        }
-    }
+    fb_fill_rect(x, y, width, height, color);
 }
 
 void print(const char* str, uint32_t color) {
+    uint64_t flags = console_lock();
+    console_write(str, strlen(str));
+    if (!console_fb_enabled()) {
+        console_unlock(flags);
+        return;
+    }
+    uint32_t cw = tty_cell_width();
+    uint32_t ch = tty_cell_height();
+    uint32_t line = tty_line_height();
     // 1. 在开始任何操作前，用背景色擦除当前的光标
-    draw_rect(cursor_x, cursor_y, 9, 16, current_bg_color);
+    draw_rect(cursor_x, cursor_y, cw, ch, current_bg_color);
     for (int i = 0; str[i] != '\0'; i++) {
         char c = str[i];
         if (c == '\n') {
-            cursor_y += 18;
+            cursor_y += line;
             cursor_x = 10;
         } else if (c == '\b') {
             if (cursor_x > 10) {
-                cursor_x -= 9;
+                cursor_x -= cw;
                 // 用背景色擦除退格位置的字符
-                draw_rect(cursor_x, cursor_y, 9, 16, current_bg_color);
+                draw_rect(cursor_x, cursor_y, cw, ch, current_bg_color);
             }
         } else {
             putchar_at(c, cursor_x, cursor_y, color);
-            cursor_x += 9;
+            cursor_x += cw;
         }
 
         // 自动换行
-        if (boot_info && (cursor_x + 9 > (uint32_t)(boot_info->framebuffer_width - 10))) {
-            cursor_y += 18;
+        if (boot_info && (cursor_x + cw > (uint32_t)(boot_info->framebuffer_width - 10))) {
+            cursor_y += line;
             cursor_x = 10;
         }
     }
     // 结尾重绘光标
     uint32_t cursor_draw_color = cursor_visible ? 0xFFFFFF : current_bg_color;
-    draw_rect(cursor_x, cursor_y, 9, 16, cursor_draw_color);
+    draw_rect(cursor_x, cursor_y, cw, ch, cursor_draw_color);
+    console_unlock(flags);
+}
+
+// ================== 启动探测任务 ==================
+// 设备初始化拆成探测任务 (见 probe.h)：ATA 和 PCI 扫描互不依赖，各在一个线程里运行；
+// 读 MBR 要等 ATA，virtio 网卡由 PCI 扫描发现时登记，等扫描结束后再初始化
+
+struct pci_location {
+    uint8_t bus, device, function;
+};
+
+static uint32_t pci_probe = PROBE_NONE;
+static pci_location virtio_net_location;
+static bool virtio_net_found = false;
+
+static bool probe_ata(void*) {
+    bool ok = ata_init();
+    irq_unmask(ATA_IRQ);
+    return ok;
+}
+
+static bool probe_mbr(void*) {
+    uint8_t mbr_buffer[512]; // 512字节的缓冲区
+    if (!ata_read_sectors(0, 0, 1, mbr_buffer)) { // master drive, LBA 0, 1 sector
+        pr_err("MBR read failed");
+        return false;
+    }
+    uint16_t mbr_signature = (uint16_t)mbr_buffer[510] | ((uint16_t)mbr_buffer[511] << 8);
+    pr_info("MBR read successful, signature 0x%04x", mbr_signature);
+    return true;
+}
+
+// virtio 网卡复位最多要等一秒，放在自己的任务里，不拖住 PCI 扫描
+static bool probe_virtio_net(void* arg) {
+    const pci_location* loc = (const pci_location*)arg;
+    virtio_net_init(loc->bus, loc->device, loc->function);
+    return true;
 }
 
-// ================== PCI 设备回调示例 ==================
 void my_pci_device_callback(uint8_t bus, uint8_t device, uint8_t function, uint16_t vendor_id, uint16_t device_id) {
     if (vendor_id == 0x8086 && (device_id == 0x100E || device_id == 0x100F || device_id == 0x10D3)) {
         tty_print("  Found Intel E1000 Network Card! (Old)\n", 0x0A);
     }
-    //  新增：识别 VirtIO 网卡 
-    if (vendor_id == 0x1AF4 && (device_id == 0x1000 || device_id == 0x1041)) {
+    //  新增：识别 VirtIO 网卡 (驱动只支持一块)
+    if (vendor_id == 0x1AF4 && (device_id == 0x1000 || device_id == 0x1041) && !virtio_net_found) {
         tty_print("  Found VirtIO Network Card!\n", 0x00FF00);
-        virtio_net_init(bus, device, function);
+        virtio_net_found = true;
+        virtio_net_location = { bus, device, function };
+        uint32_t id = probe_create("virtio-net", probe_virtio_net, &virtio_net_location);
+        probe_depends(id, pci_probe);
+        probe_submit(id);
     }
 }
 
+static bool probe_pci(void*) {
+    pci_scan_bus(my_pci_device_callback);
+    return true;
+}
+
+// ================== 光标闪烁 ==================
+#define CURSOR_BLINK_MS 500
+
+static timer_list cursor_timer;
+
+// 每 500ms 翻转一次光标；按上一次的到期时间推进，不会累积误差
+static void cursor_blink(timer_list* timer) {
+    cursor_visible = !cursor_visible;
+    mod_timer(timer, timer->expires + msecs_to_jiffies(CURSOR_BLINK_MS));
+}
+
 // ================== 内核主入口 ==================
 extern "C" void kmain(struct stivale_struct *stivale_struct) {
+    // GS 基址指向 BSP 的每 CPU 控制块，此后 smp_processor_id() 才可用
+    percpu_setup(0, 0);
+    // 记下内核入口的 TSC，之后每个初始化步骤都记一个区间 (bootchart 命令查看)
+    bootchart_init();
+    uint32_t phase = bootchart_begin("console");
+    // 先根据命令行选择输出目标 (帧缓冲/串口/debugcon)，无头运行时可以完全跳过绘制
+    console_init((const char*)stivale_struct->cmdline);
     tty_init(stivale_struct);
+    bootchart_end(phase);
     // 关键第一步：将引导信息保存到全局变量
     boot_info = stivale_struct;
+    // 读取 CPU 特性表，并按特性一次性改写 memcpy/memset/rdtsc 等热点代码
+    phase = bootchart_begin("cpu features");
+    cpu_features_init();
+    apply_alternatives();
+    bootchart_end(phase);
 
     uint32_t white = 0xE0E0E0;
     uint32_t green = 0x4EC9B0;
     uint32_t blue  = 0x569CD6;
 
     // 清空屏幕
-    for (uint32_t y = 0; y < boot_info->framebuffer_height; y++) {
-        for (uint32_t x = 0; x < boot_info->framebuffer_width; x++) {
-            put_pixel(x, y, current_bg_color);
-        }
+    if (console_fb_enabled()) {
+        phase = bootchart_begin("fb clear");
+        fb_clear(current_bg_color);
+        bootchart_end(phase);
     }
 
     tty_print("Kernel loaded!\n", 0xFFFFFF);
 
     // 初始化 GDT
     print("Initializing GDT...", white);
+    phase = bootchart_begin("gdt");
     init_gdt();
+    bootchart_end(phase);
     print("\nGDT loaded.\n", green);
 
     // 初始化 IDT
     print("Initializing IDT...", white);
+    phase = bootchart_begin("idt");
     init_idt();
+    bootchart_end(phase);
     print("\nIDT loaded.\n", green);
 
     // 初始化 PIC
     print("Remapping PIC...", white);
+    phase = bootchart_begin("pic");
     pic_remap(32, 40);
+    bootchart_end(phase);
     print("\nPIC remapped.\n", green);
 
-    // 初始化 PIT
-    print("Initializing PIT...", white);
-    init_pit(1000);
-    print("\nPIT at 1000Hz.\n", green);
+    // 解析 ACPI MADT，启用 LAPIC/IOAPIC；失败时继续使用 PIC
+    print("Initializing interrupt controller...", white);
+    phase = bootchart_begin("irq controller");
+    irq_init(boot_info->rsdp);
+    bootchart_end(phase);
+    print(irq_using_apic() ? "\nIOAPIC routing active.\n" : "\nUsing legacy PIC.\n", green);
+
+    // RCU 和 tasklet 软中断要在时钟事件开始产生节拍之前登记
+    phase = bootchart_begin("softirq/rcu");
+    softirq_init();
+    rcu_init();
+    bootchart_end(phase);
+
+    // 用 HPET/PIT 校准 TSC，之后所有延迟和时间戳都基于它
+    print("Calibrating TSC...", white);
+    phase = bootchart_begin("tsc calibration");
+    clock_init();
+    bootchart_end(phase);
+    print("\nTSC clocksource ready.\n", green);
+
+    // 时钟事件设备：优先 LAPIC TSC-deadline，空闲时停掉周期节拍
+    print("Initializing clockevents...", white);
+    phase = bootchart_begin("clockevents");
+    bool tick_ok = tick_init();
+    bootchart_end(phase);
+    if (tick_ok) {
+        print("\nTickless timer on ", green);
+        print(clockevents_device()->name, green);
+        print(".\n", green);
+        timer_setup(&cursor_timer, cursor_blink);
+        mod_timer(&cursor_timer, jiffies + msecs_to_jiffies(CURSOR_BLINK_MS));
+    } else {
+        print("\nNo clockevent device!\n", 0xFF0000);
+    }
 
     // 开启中断
     print("Enabling interrupts (STI)...", white);
@@ -158,54 +282,106 @@ extern "C" void kmain(struct stivale_struct *stivale_struct) {
     print("\nInterrupts enabled.\n", green);
 
     print("Initializing Buddy...", white);
+    phase = bootchart_begin("buddy");
     buddy_init(boot_info);
+    bootchart_end(phase);
     print("\nBuddy ready.\n", green);
 
+    // 线程栈来自 buddy 分配器；kmain 从这里开始就是 CPU 0 的空闲线程
+    phase = bootchart_begin("sched");
+    sched_init();
+    // AP 上线前确定深度空闲用 MWAIT 还是 hlt
+    idle_init();
+    bootchart_end(phase);
+
+    // 每个 CPU 的 GDT/TSS，并用 INIT-SIPI-SIPI 唤醒 MADT 中的其余 CPU
+    print("Starting application processors...", white);
+    phase = bootchart_begin("smp");
+    smp_init(boot_info);
+    bootchart_end(phase);
+    print("\n", white);
+    print_dec(smp_online_cpus(), green);
+    print(" CPU(s) online.\n", green);
+
+    // 每个在线 CPU 一个工作线程，parallel_for 等在它们之间窃取任务
+    phase = bootchart_begin("kthreads");
+    taskpool_init();
+    // 软中断超出预算时的 ksoftirqd 线程和系统工作队列，驱动初始化之前就要准备好
+    ksoftirqd_init();
+    workqueue_init();
+    async_init();
+    bootchart_end(phase);
+
+    // 字形缓存需要 buddy 分配器；若引导时带了 PSF2 字体模块则切换到 Unicode 字体
+    phase = bootchart_begin("font");
+    bool font_ok = font_init(boot_info);
+    bootchart_end(phase);
+    if (font_ok) {
+        print("PSF2 Unicode font loaded.\n", green);
+    }
+
     // 初始化 Keyboard
     print("Initializing Keyboard...", white);
+    phase = bootchart_begin("keyboard");
     init_keyboard();
-    pic_unmask_irq(1);
-    pic_unmask_irq(2);
+    irq_unmask(1);
+    bootchart_end(phase);
     print("\nKeyboard ready.\n", green);
 
-    pic_unmask_irq(10);
+    // 串口发送环靠 THRE 中断推进，同时接收串口输入
+    if (serial_present()) {
+        irq_unmask(SERIAL_COM1_IRQ);
+        print("Serial console on COM1.\n", green);
+    }
+
+    irq_unmask_pci(10);
 
     tty_print("Scrolling: ", 0xFFFF00);
     tty_print("FB Height=", 0xFFFFFF);
     print_hex(boot_info->framebuffer_height, 0xFFFFFF);
     tty_print(" Pitch=", 0xFFFFFF); 
     print_hex(boot_info->framebuffer_pitch, 0xFFFFFF);
-    tty_print(" Scroll=", 0xFFFFFF); 
+    tty_print(" Format=", 0xFFFFFF);
+    tty_print(fb_format_name(), 0xFFFFFF);
     
-    tty_print("\nInitializing ATA driver...", 0xFFFFFF);
-    ata_init();
-    tty_print("\nATA driver ready.\n", 0x4EC9B0);
-
-    tty_print("Reading MBR (LBA 0)...", 0xFFFFFF);
-    uint8_t mbr_buffer[512]; // 512字节的缓冲区
-    if (ata_read_sectors(0, 0, 1, mbr_buffer)) { // master drive, LBA 0, 1 sector
-        uint16_t mbr_signature = (uint16_t)mbr_buffer[510] | ((uint16_t)mbr_buffer[511] << 8);
-        tty_print("\nMBR read successful. Signature: 0x", 0x00FF00);
-        print_hex(mbr_signature, 0x00FFFF); // 打印整个 16 位的签名
-        tty_print("\n", 0x00FFFF);
-    } else {
-        tty_print("MBR read failed!\n", 0xFF0000);
-    }
-
-    tty_print("Initializing PCI bus...\n", 0xFFFFFF);
+    // 设备探测在各自的线程里并行进行，不等它们结束就进入 shell (probe 命令查看进度)
+    tty_print("\nStarting device probes...\n", 0xFFFFFF);
     pci_init();
-    pci_scan_bus(my_pci_device_callback);
-    tty_print("PCI bus scan done.\n", 0x4EC9B0);
+    probe_init();
+    uint32_t ata_probe = probe_create("ata", probe_ata, nullptr);
+    uint32_t mbr_probe = probe_create("mbr", probe_mbr, nullptr);
+    probe_depends(mbr_probe, ata_probe);
+    pci_probe = probe_create("pci scan", probe_pci, nullptr);
+    probe_submit(ata_probe);
+    probe_submit(mbr_probe);
+    probe_submit(pci_probe);
 
     print("[System ready.]\n", blue);
 
-    init_shell();
+    shell_start();
 
-    pic_dump_masks();
+    irq_dump();
     
     bool last_cursor_state = !cursor_visible; // 强制第一次循环时重绘
 
      for (;;) {
-        asm ("hlt"); // 等待下一次中断
+        // 空闲时把中断处理函数写入日志环的内容刷到屏幕上
+        klog_drain();
+        // 在普通上下文里触发的软中断 (没有经过中断返回路径) 在这里执行
+        if (softirq_pending()) do_softirq();
+        // 关中断后再检查一次，避免在检查和 hlt 之间到来的日志要等到下一次中断
+        asm volatile ("cli");
+        // 有线程就绪：切过去，回到空闲线程时再继续
+        if (need_resched()) {
+            asm volatile ("sti");
+            schedule();
+            continue;
+        }
+        if (klog_pending() || softirq_pending()) {
+            asm volatile ("sti");
+            continue;
+        }
+        // 先短暂轮询，再停掉节拍进入 MWAIT/hlt，直到下一次中断或唤醒
+        cpu_idle();
     }
 }
\ No newline at end of file
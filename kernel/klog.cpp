@@ -0,0 +1,138 @@
+#include "klog.h"
+#include "drivers/tty.h"
+#include "drivers/console.h"
+#include "lib/libc.h"
+#include "cpu/isr.h"
+#include "cpu/smp.h"
+#include "time/clock.h"
+#include <stdarg.h>
+
+// ==========================================================================
+// 无锁日志环形缓冲区
+// ==========================================================================
+// 写者通过原子 fetch_add 领取一个全局序号，序号对环大小取模得到槽位。
+// 写完正文后再以 release 语义写入 seq 字段“提交”这条记录；
+// 读者只认 seq == 序号+1 的槽位，并在拷贝后重新检查 seq，以发现被覆盖的记录。
+// 整个写路径没有锁、不关中断，也不做任何帧缓冲操作。
+
+static klog_record klog_ring[KLOG_RING_SIZE];
+static volatile uint64_t klog_head = 0;       // 下一个待分配的序号
+static uint64_t klog_console_seq = 0;         // 下一条待输出到控制台的序号
+static volatile bool klog_draining = false;   // 防止输出过程被重入
+
+static inline uint64_t klog_clock() {
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline uint8_t klog_cpu_id() {
+    return (uint8_t)smp_processor_id();
+}
+
+void klog(int level, const char* fmt, ...) {
+    uint64_t seq = __atomic_fetch_add(&klog_head, 1, __ATOMIC_RELAXED);
+    klog_record* rec = &klog_ring[seq & (KLOG_RING_SIZE - 1)];
+
+    // 先把槽位标记为“写入中”，防止读者读到新旧混杂的内容
+    __atomic_store_n(&rec->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    rec->timestamp = klog_clock();
+    rec->level = (uint8_t)level;
+    rec->cpu = klog_cpu_id();
+
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(rec->text, KLOG_TEXT_SIZE, fmt, ap);
+    va_end(ap);
+    rec->len = (uint16_t)(len < KLOG_TEXT_SIZE ? len : KLOG_TEXT_SIZE - 1);
+
+    __atomic_store_n(&rec->seq, seq + 1, __ATOMIC_RELEASE);
+
+    // 普通上下文直接输出；中断上下文留给空闲循环，避免拉长中断延迟
+    if (!in_interrupt()) {
+        klog_drain();
+    }
+}
+
+// 读取序号为 seq 的记录。返回 1 表示成功，0 表示仍在写入中，-1 表示已被覆盖
+static int klog_read(uint64_t seq, klog_record* out) {
+    const klog_record* rec = &klog_ring[seq & (KLOG_RING_SIZE - 1)];
+    uint64_t s = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+    if (s != seq + 1) {
+        return (s > seq + 1) ? -1 : 0;
+    }
+    memcpy(out, (const void*)rec, sizeof(klog_record));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&rec->seq, __ATOMIC_RELAXED) != seq + 1) {
+        return -1; // 拷贝期间被新的写者覆盖
+    }
+    return 1;
+}
+
+static uint32_t klog_level_color(uint8_t level) {
+    if (level <= KLOG_ERR)     return 0xFF6060;
+    if (level == KLOG_WARNING) return 0xFFFF00;
+    if (level == KLOG_NOTICE)  return 0x00FFFF;
+    if (level == KLOG_INFO)    return 0xFFFFFF;
+    return 0xAAAAAA;
+}
+
+static void klog_emit(const klog_record* rec) {
+    // 记录里存原始 TSC (写入路径最便宜)，输出时才按校准结果换算成秒
+    char prefix[32];
+    uint64_t us = clock_cycles_to_ns(rec->timestamp) / 1000;
+    snprintf(prefix, sizeof(prefix), "[%5llu.%06llu] ",
+             (unsigned long long)(us / 1000000), (unsigned long long)(us % 1000000));
+    // 前缀、正文和换行一起输出，不会被其他 CPU 的输出插进来
+    uint64_t flags = console_lock();
+    tty_print(prefix, 0x808080);
+    tty_print(rec->text, klog_level_color(rec->level));
+    if (rec->len == 0 || rec->text[rec->len - 1] != '\n') {
+        tty_print("\n", 0xFFFFFF);
+    }
+    console_unlock(flags);
+}
+
+bool klog_pending() {
+    return klog_console_seq != __atomic_load_n(&klog_head, __ATOMIC_ACQUIRE);
+}
+
+void klog_drain() {
+    if (__atomic_exchange_n(&klog_draining, true, __ATOMIC_ACQUIRE)) return;
+
+    klog_record rec;
+    for (;;) {
+        uint64_t head = __atomic_load_n(&klog_head, __ATOMIC_ACQUIRE);
+        if (klog_console_seq == head) break;
+
+        // 生产者跑得太快，最旧的记录已经被覆盖
+        if (head - klog_console_seq > KLOG_RING_SIZE) {
+            uint64_t lost = head - KLOG_RING_SIZE - klog_console_seq;
+            klog_console_seq = head - KLOG_RING_SIZE;
+            char msg[48];
+            snprintf(msg, sizeof(msg), "[klog] %llu messages dropped\n", (unsigned long long)lost);
+            tty_print(msg, 0xFFFF00);
+            continue;
+        }
+
+        int r = klog_read(klog_console_seq, &rec);
+        if (r == 0) break; // 写者还没提交，下次再来
+        if (r > 0) klog_emit(&rec);
+        klog_console_seq++;
+    }
+
+    __atomic_store_n(&klog_draining, false, __ATOMIC_RELEASE);
+}
+
+void klog_dump() {
+    uint64_t head = __atomic_load_n(&klog_head, __ATOMIC_ACQUIRE);
+    uint64_t seq = head > KLOG_RING_SIZE ? head - KLOG_RING_SIZE : 0;
+    klog_record rec;
+    for (; seq < head; seq++) {
+        if (klog_read(seq, &rec) > 0) {
+            klog_emit(&rec);
+        }
+    }
+}
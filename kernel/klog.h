@@ -0,0 +1,63 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// 日志级别 (数值越小越严重，与 Linux printk 保持一致)
+#define KLOG_EMERG   0
+#define KLOG_ALERT   1
+#define KLOG_CRIT    2
+#define KLOG_ERR     3
+#define KLOG_WARNING 4
+#define KLOG_NOTICE  5
+#define KLOG_INFO    6
+#define KLOG_DEBUG   7
+
+// 环形缓冲区容量 (必须是 2 的幂) 以及单条记录的正文长度
+#define KLOG_RING_SIZE   512
+#define KLOG_TEXT_SIZE   104
+
+// 编译期日志级别：高于此级别的 pr_xxx() 调用连同格式串一起被编译器丢弃。
+// 可以用 make KLOG_LEVEL=7 (即 -DKLOG_COMPILE_LEVEL=7) 打开调试输出。
+#ifndef KLOG_COMPILE_LEVEL
+#define KLOG_COMPILE_LEVEL KLOG_INFO
+#endif
+
+// 一条日志记录，正好 128 字节
+struct klog_record {
+    volatile uint64_t seq; // 已提交时为 序号+1，写入中为 0
+    uint64_t timestamp;    // 写入时的 TSC
+    uint8_t  level;
+    uint8_t  cpu;
+    uint16_t len;
+    uint32_t reserved;
+    char     text[KLOG_TEXT_SIZE];
+};
+
+// 写入一条日志。无锁，可以在中断处理函数等任意上下文中调用。
+// 在中断上下文中只写日志环，由空闲循环稍后输出；在普通上下文中立即输出到控制台。
+void klog(int level, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// 分级日志宏。if constexpr 保证被关闭的级别不会生成任何代码，
+// 但参数仍然会做类型检查，不会因为关掉某个级别而悄悄烂掉。
+#define klog_at(level, ...) do {                          \
+        if constexpr ((level) <= KLOG_COMPILE_LEVEL)      \
+            klog((level), __VA_ARGS__);                   \
+    } while (0)
+
+#define pr_emerg(...)   klog_at(KLOG_EMERG, __VA_ARGS__)
+#define pr_alert(...)   klog_at(KLOG_ALERT, __VA_ARGS__)
+#define pr_crit(...)    klog_at(KLOG_CRIT, __VA_ARGS__)
+#define pr_err(...)     klog_at(KLOG_ERR, __VA_ARGS__)
+#define pr_warn(...)    klog_at(KLOG_WARNING, __VA_ARGS__)
+#define pr_notice(...)  klog_at(KLOG_NOTICE, __VA_ARGS__)
+#define pr_info(...)    klog_at(KLOG_INFO, __VA_ARGS__)
+#define pr_debug(...)   klog_at(KLOG_DEBUG, __VA_ARGS__)
+
+// 是否还有尚未输出到控制台的日志
+bool klog_pending();
+
+// 把尚未输出的日志刷到控制台 (由空闲循环调用，也用于 panic 前的同步刷新)
+void klog_drain();
+
+// 打印环形缓冲区中仍然保留的全部日志 (dmesg)
+void klog_dump();
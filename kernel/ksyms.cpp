@@ -0,0 +1,48 @@
+#include "ksyms.h"
+
+// 由链接脚本和生成的 ksyms.asm 提供
+extern char __kernel_text_start[];
+extern char __kernel_text_end[];
+extern const uint64_t __ksym_count;
+extern const uint64_t __ksym_addrs[];
+extern const uint32_t __ksym_offsets[];
+extern const char __ksym_names[];
+
+bool kernel_text_contains(uint64_t addr) {
+    return addr >= (uint64_t)__kernel_text_start && addr < (uint64_t)__kernel_text_end;
+}
+
+uint32_t ksym_count() {
+    return (uint32_t)__ksym_count;
+}
+
+uint32_t ksym_index(uint64_t addr) {
+    uint32_t count = ksym_count();
+    if (!count || !kernel_text_contains(addr) || addr < __ksym_addrs[0]) return KSYM_NONE;
+    // 二分查找最后一个 __ksym_addrs[i] <= addr
+    uint32_t lo = 0, hi = count;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (__ksym_addrs[mid] <= addr) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+const char* ksym_name(uint32_t index) {
+    return index < ksym_count() ? &__ksym_names[__ksym_offsets[index]] : "?";
+}
+
+uint64_t ksym_addr(uint32_t index) {
+    return index < ksym_count() ? __ksym_addrs[index] : 0;
+}
+
+const char* ksym_lookup(uint64_t addr, uint64_t* offset) {
+    uint32_t index = ksym_index(addr);
+    if (index == KSYM_NONE) return nullptr;
+    if (offset) *offset = addr - __ksym_addrs[index];
+    return ksym_name(index);
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+
+// ==========================================================================
+// 内核符号表
+// ==========================================================================
+// 链接时由 tools/gen_ksyms.sh 从 nm 的输出生成，只收录代码段里的函数，按地址
+// 升序排列。剖析器、崩溃信息用它把指令地址翻译成函数名。C++ 函数名已经还原
+// (demangle) 并去掉了参数列表，重载函数会显示成同一个名字。
+
+#define KSYM_NONE UINT32_MAX
+
+// addr 是否落在内核代码段里
+bool kernel_text_contains(uint64_t addr);
+
+uint32_t ksym_count();
+// 包含 addr 的函数的编号 (地址不大于 addr 的最后一个符号)，找不到时返回 KSYM_NONE
+uint32_t ksym_index(uint64_t addr);
+const char* ksym_name(uint32_t index);
+uint64_t ksym_addr(uint32_t index);
+
+// 找到时返回函数名并把 addr 相对函数起点的偏移写入 offset，否则返回 nullptr
+const char* ksym_lookup(uint64_t addr, uint64_t* offset);
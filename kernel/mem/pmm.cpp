@@ -2,6 +2,7 @@
 #include "kernel/boot.h"
 #include "tty.h"
 #include "lib/libc.h"
+#include "kernel/sync/spinlock.h"
 
 //  外部依赖 
 extern void print(const char* str, uint32_t color);
@@ -9,9 +10,14 @@ extern void print(const char* str, uint32_t color);
 #define PAGE_SIZE 4096
 #define MAX_ORDER 16   // 最大块阶数，比如 2^16 = 64KB
 #define MIN_ORDER 12   // 最小块阶数，比如 2^12 = 4KB (页大小)
+#define BUDDY_LOW_RESERVED 0x100000
 
 MemoryBlock* free_list[MAX_ORDER - MIN_ORDER + 1];  // 每阶空闲块链表
 
+// 保护 free_list 和 buddy 统计；分配既来自普通上下文也来自中断处理函数，
+// 而且所有 CPU 共用一个分配器，用 MCS 锁避免争抢时缓存行来回颠簸
+static mcs_lock buddy_lock;
+
 //  全局 PMM 变量 
 uint8_t* pmm_bitmap = nullptr;
 uint64_t total_pages = 0;
@@ -216,6 +222,7 @@ void buddy_init(stivale_struct* boot_info) {
 
     // 清空空闲链表
     memset(free_list, 0, sizeof(free_list));
+    mcs_lock_init(&buddy_lock, "buddy");
 
     // 遍历所有可用的内存区域
     for (uint64_t i = 0; i < boot_info->memory_map_entries; i++) {
@@ -224,6 +231,14 @@ void buddy_init(stivale_struct* boot_info) {
         uintptr_t current = (uintptr_t)mmap[i].base;
         uint64_t remaining = mmap[i].length;
 
+        // 低 1MiB 留给 AP 启动跳板 (SIPI 只能指向 1MiB 以下，见 smp.cpp)
+        if (current < BUDDY_LOW_RESERVED) {
+            uint64_t skip = BUDDY_LOW_RESERVED - current;
+            if (skip >= remaining) continue;
+            current += skip;
+            remaining -= skip;
+        }
+
         // 对当前可用区域分配为buddy块
         while (remaining >= PAGE_SIZE) {
             // 找到当前剩余大小下最大的 order
@@ -252,6 +267,8 @@ void buddy_init(stivale_struct* boot_info) {
 // 分配内存块
 void* buddy_alloc(uint64_t size) {
     int order = get_order(size);
+    mcs_node node;
+    uint64_t flags = mcs_spin_lock_irqsave(&buddy_lock, &node);
     for (int i = order; i <= MAX_ORDER; i++) {
         if (free_list[i - MIN_ORDER] != nullptr) {
             // 找到合适阶的块
@@ -269,9 +286,11 @@ void* buddy_alloc(uint64_t size) {
             // 更新使用统计
             buddy_used_pages += size_for_order(order) / PAGE_SIZE;
             
+            mcs_spin_unlock_irqrestore(&buddy_lock, &node, flags);
             return (void*)block;
         }
     }
+    mcs_spin_unlock_irqrestore(&buddy_lock, &node, flags);
     print("Buddy: No free block found for size ", 0xFF0000);
     // 无空闲块
     return nullptr;
@@ -280,7 +299,9 @@ void* buddy_alloc(uint64_t size) {
 // 释放内存块
 void buddy_free(void* addr, uint64_t size) {
     uint8_t order = get_order(size);
-    
+    mcs_node node;
+    uint64_t flags = mcs_spin_lock_irqsave(&buddy_lock, &node);
+
     // 更新使用统计
     buddy_used_pages -= size_for_order(order) / PAGE_SIZE;
     
@@ -296,6 +317,7 @@ void buddy_free(void* addr, uint64_t size) {
             MemoryBlock* block = (MemoryBlock*)addr;
             block->next = free_list[order - MIN_ORDER];
             free_list[order - MIN_ORDER] = block;
+            mcs_spin_unlock_irqrestore(&buddy_lock, &node, flags);
             return;
         }
         // 找到伙伴，移除它
@@ -311,4 +333,5 @@ void buddy_free(void* addr, uint64_t size) {
     MemoryBlock* block = (MemoryBlock*)addr;
     block->next = free_list[MAX_ORDER - MIN_ORDER];
     free_list[MAX_ORDER - MIN_ORDER] = block;
+    mcs_spin_unlock_irqrestore(&buddy_lock, &node, flags);
 }
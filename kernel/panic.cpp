@@ -1,6 +1,9 @@
 #include "panic.h"
 #include "drivers/tty.h"
 #include "boot.h"
+#include "klog.h"
+#include "drivers/console.h"
+#include "ksyms.h"
 
 // 外部依赖
 extern uint32_t current_bg_color;
@@ -9,6 +12,8 @@ __attribute__((noreturn))
 void kernel_panic(registers_t* regs, const char* message) {
     // 1. 关闭中断，防止进一步的混乱
     asm volatile("cli");
+    // 其他 CPU 可能正持有控制台锁，强制接管输出
+    console_panic_unlock();
 
     // 2. 用醒目的颜色清空屏幕
     current_bg_color = 0xAA0000; // 深红色
@@ -26,11 +31,25 @@ void kernel_panic(registers_t* regs, const char* message) {
         tty_print("  RAX=", 0xFFFFFF); print_hex(regs->rax, 0x00FFFF);
         tty_print("  RBX=", 0xFFFFFF); print_hex(regs->rbx, 0x00FFFF);
         tty_print("\n  RIP=", 0xFFFFFF); print_hex(regs->rip, 0x00FFFF);
+        uint64_t offset;
+        const char* sym = ksym_lookup(regs->rip, &offset);
+        if (sym) {
+            tty_print(" <", 0xFFFFFF); tty_print(sym, 0x00FF00);
+            tty_print("+", 0xFFFFFF); print_hex(offset, 0x00FF00); tty_print(">", 0xFFFFFF);
+        }
         tty_print("   CS=", 0xFFFFFF); print_hex(regs->cs, 0x00FFFF);
         tty_print(" RFLAGS=", 0xFFFFFF); print_hex(regs->rflags, 0x00FFFF);
     }
+
+    // 5. 把还没来得及输出的内核日志同步刷出来，方便定位问题
+    if (klog_pending()) {
+        tty_print("\n\nPending kernel log:\n", 0xFFFFFF);
+        klog_drain();
+    }
+    // 中断已关闭，串口发送环只能轮询送出
+    console_flush();
     
-    // 5. 永久停机
+    // 6. 永久停机
     for (;;) {
         asm volatile("hlt");
     }
@@ -0,0 +1,364 @@
+#include "perf.h"
+#include "ksyms.h"
+#include "cpu/isr.h"
+#include "cpu/smp.h"
+#include "sched/sched.h"
+#include "sync/rcu.h"
+#include "mem/pmm.h"
+#include "drivers/serial.h"
+#include "drivers/tty.h"
+#include "klog.h"
+#include "lib/libc.h"
+
+// 一个样本正好两条缓存行
+struct perf_sample {
+    uint32_t depth;
+    uint32_t tid;
+    uint64_t ip[PERF_MAX_DEPTH];   // ip[0] 是被打断的指令，其余是返回地址
+};
+
+// 单生产者 (本 CPU 的节拍中断) 单消费者 (shell 线程) 的环，整个占一个 64KB 的伙伴块
+#define PERF_RING_BYTES     65536
+#define PERF_RING_SLOTS     ((PERF_RING_BYTES - 64) / sizeof(perf_sample))
+
+struct perf_ring {
+    volatile uint64_t head;     // 生产者写
+    volatile uint64_t tail;     // 消费者写
+    volatile uint64_t dropped;
+    uint8_t pad[40];
+    perf_sample slots[PERF_RING_SLOTS];
+};
+
+static_assert(sizeof(perf_ring) <= PERF_RING_BYTES, "perf ring must fit in one buddy block");
+
+// 合并后的调用栈：syms[0] 是叶子函数
+struct perf_stack {
+    uint32_t count;
+    uint32_t depth;
+    uint32_t syms[PERF_MAX_DEPTH];
+};
+
+#define PERF_STACK_TABLE_BYTES  65536
+#define PERF_STACK_SLOTS        (PERF_STACK_TABLE_BYTES / sizeof(perf_stack))
+// 每个函数的计数表最多占一个 64KB 的伙伴块
+#define PERF_MAX_SYMS           (65536 / sizeof(uint32_t))
+
+static per_cpu<perf_ring*> rings;
+static volatile bool perf_enabled = false;
+
+// 以下只由 shell 线程访问
+static perf_stack* stack_table = nullptr;
+static uint32_t* self_counts = nullptr;     // 样本落在该函数本身
+static uint32_t* total_counts = nullptr;    // 该函数出现在调用栈上 (含子调用)
+static uint32_t nr_syms = 0;
+static uint64_t count_bytes = 0;            // 两张计数表各自的分配大小
+static uint64_t collected = 0;
+static uint64_t unknown_samples = 0;        // 叶子地址不在符号表里
+static uint64_t nr_stacks = 0;
+static uint64_t stacks_lost = 0;
+static uint64_t dropped_total = 0;
+
+// ==========================================================================
+// 采样
+// ==========================================================================
+
+// 沿 rbp 链回溯被打断线程的栈。只接受落在该线程栈内、8 字节对齐、严格向栈底
+// 递增的帧指针，返回地址必须在内核代码段里，栈被破坏时也不会读到栈外
+static uint32_t perf_walk(const registers_t* regs, uint64_t* ips) {
+    uint32_t depth = 0;
+    ips[depth++] = regs->rip;
+
+    uint64_t lo = regs->userrsp;
+    uint64_t hi;
+    thread* t = current_thread();
+    if (t && !t->idle) {
+        uint64_t base = (uint64_t)t;
+        hi = base + THREAD_STACK_SIZE;
+        if (lo < base + sizeof(thread) || lo >= hi) return depth;
+    } else {
+        // 空闲线程跑在启动栈上；BSP 的启动栈由引导程序提供，不知道栈顶，按线程栈大小估计
+        uint64_t top = this_cpu()->stack_top;
+        hi = top ? top : lo + THREAD_STACK_SIZE;
+        if (lo >= hi) return depth;
+    }
+
+    uint64_t fp = regs->rbp;
+    while (depth < PERF_MAX_DEPTH) {
+        if (fp < lo || fp > hi - 16 || (fp & 7)) break;
+        const uint64_t* frame = (const uint64_t*)fp;
+        uint64_t ret = frame[1];
+        if (!kernel_text_contains(ret)) break;
+        ips[depth++] = ret;
+        uint64_t next = frame[0];
+        if (next <= fp) break;
+        fp = next;
+    }
+    return depth;
+}
+
+void perf_tick() {
+    if (!__atomic_load_n(&perf_enabled, __ATOMIC_ACQUIRE)) return;
+    registers_t* regs = get_irq_regs();
+    if (!regs) return;
+    // 中断处理函数本身是 RCU 读侧临界区，perf_stop 等一个宽限期后才释放环
+    perf_ring* ring = rcu_dereference(rings.get());
+    if (!ring) return;
+
+    uint64_t head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= PERF_RING_SLOTS) {
+        ring->dropped++;
+        return;
+    }
+    perf_sample* s = &ring->slots[head % PERF_RING_SLOTS];
+    thread* t = current_thread();
+    s->tid = t ? t->tid : 0;
+    s->depth = perf_walk(regs, s->ip);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+// ==========================================================================
+// 合并
+// ==========================================================================
+
+static uint32_t stack_hash(const uint32_t* syms, uint32_t depth) {
+    uint32_t h = 2166136261u;
+    for (uint32_t i = 0; i < depth; i++) {
+        h = (h ^ syms[i]) * 16777619u;
+    }
+    return h ^ depth;
+}
+
+static bool same_stack(const perf_stack* st, const uint32_t* syms, uint32_t depth) {
+    if (st->depth != depth) return false;
+    for (uint32_t i = 0; i < depth; i++) {
+        if (st->syms[i] != syms[i]) return false;
+    }
+    return true;
+}
+
+static void account_stack(const uint32_t* syms, uint32_t depth) {
+    uint32_t slot = stack_hash(syms, depth) % PERF_STACK_SLOTS;
+    for (uint32_t probe = 0; probe < PERF_STACK_SLOTS; probe++) {
+        perf_stack* st = &stack_table[slot];
+        if (!st->count) {
+            st->count = 1;
+            st->depth = depth;
+            memcpy(st->syms, syms, depth * sizeof(uint32_t));
+            nr_stacks++;
+            return;
+        }
+        if (same_stack(st, syms, depth)) {
+            st->count++;
+            return;
+        }
+        slot = (slot + 1) % PERF_STACK_SLOTS;
+    }
+    stacks_lost++;
+}
+
+static void account_sample(const perf_sample* s) {
+    uint32_t syms[PERF_MAX_DEPTH];
+    uint32_t depth = s->depth < PERF_MAX_DEPTH ? s->depth : PERF_MAX_DEPTH;
+    for (uint32_t i = 0; i < depth; i++) {
+        // 返回地址指向 call 的下一条指令，减 1 落回 call 所在的函数 (call 可能是函数的最后一条指令)
+        uint64_t ip = i == 0 ? s->ip[i] : s->ip[i] - 1;
+        syms[i] = ksym_index(ip);
+    }
+    collected++;
+    if (!depth) return;
+
+    if (syms[0] < nr_syms) {
+        self_counts[syms[0]]++;
+    } else {
+        unknown_samples++;
+    }
+    // 递归调用的函数在一个样本里只计一次
+    for (uint32_t i = 0; i < depth; i++) {
+        if (syms[i] >= nr_syms) continue;
+        bool seen = false;
+        for (uint32_t j = 0; j < i && !seen; j++) seen = syms[j] == syms[i];
+        if (!seen) total_counts[syms[i]]++;
+    }
+    account_stack(syms, depth);
+}
+
+static void drain_ring(perf_ring* ring) {
+    uint64_t tail = ring->tail;
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    while (tail != head) {
+        account_sample(&ring->slots[tail % PERF_RING_SLOTS]);
+        tail++;
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+}
+
+void perf_collect() {
+    if (!stack_table) return;
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        perf_ring* ring = rings.on(cpu);
+        if (ring) drain_ring(ring);
+    }
+}
+
+// ==========================================================================
+// 启停
+// ==========================================================================
+
+static void free_tables() {
+    if (stack_table) buddy_free(stack_table, PERF_STACK_TABLE_BYTES);
+    if (self_counts) buddy_free(self_counts, count_bytes);
+    if (total_counts) buddy_free(total_counts, count_bytes);
+    stack_table = nullptr;
+    self_counts = total_counts = nullptr;
+}
+
+static bool alloc_tables() {
+    free_tables();
+    nr_syms = ksym_count();
+    if (nr_syms > PERF_MAX_SYMS) {
+        pr_warn("perf: %u symbols, only the first %u are counted", nr_syms, (uint32_t)PERF_MAX_SYMS);
+        nr_syms = PERF_MAX_SYMS;
+    }
+    count_bytes = (uint64_t)(nr_syms ? nr_syms : 1) * sizeof(uint32_t);
+    stack_table = (perf_stack*)buddy_alloc(PERF_STACK_TABLE_BYTES);
+    self_counts = (uint32_t*)buddy_alloc(count_bytes);
+    total_counts = (uint32_t*)buddy_alloc(count_bytes);
+    if (!stack_table || !self_counts || !total_counts) {
+        free_tables();
+        return false;
+    }
+    memset(stack_table, 0, PERF_STACK_TABLE_BYTES);
+    memset(self_counts, 0, count_bytes);
+    memset(total_counts, 0, count_bytes);
+    collected = unknown_samples = nr_stacks = stacks_lost = dropped_total = 0;
+    return true;
+}
+
+bool perf_running() {
+    return __atomic_load_n(&perf_enabled, __ATOMIC_ACQUIRE);
+}
+
+bool perf_start() {
+    if (perf_running()) return true;
+    if (!ksym_count()) pr_warn("perf: kernel symbol table is empty");
+    if (!alloc_tables()) {
+        pr_err("perf: no memory for the stack table");
+        return false;
+    }
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (!cpu_online(cpu)) continue;
+        perf_ring* ring = (perf_ring*)buddy_alloc(PERF_RING_BYTES);
+        if (!ring) {
+            pr_err("perf: no memory for the sample ring of CPU %u", cpu);
+            continue;
+        }
+        ring->head = ring->tail = ring->dropped = 0;
+        rcu_assign_pointer(rings.on(cpu), ring);
+    }
+    __atomic_store_n(&perf_enabled, true, __ATOMIC_RELEASE);
+    return true;
+}
+
+void perf_stop() {
+    if (!perf_running()) return;
+    __atomic_store_n(&perf_enabled, false, __ATOMIC_RELEASE);
+    perf_ring* detached[MAX_CPUS];
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        detached[cpu] = rings.on(cpu);
+        rcu_assign_pointer(rings.on(cpu), (perf_ring*)nullptr);
+    }
+    // 等所有 CPU 上正在执行的 perf_tick 结束
+    synchronize_rcu();
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (!detached[cpu]) continue;
+        drain_ring(detached[cpu]);
+        dropped_total += detached[cpu]->dropped;
+        buddy_free(detached[cpu], PERF_RING_BYTES);
+    }
+}
+
+void perf_get_stats(perf_stats* stats) {
+    uint64_t dropped = dropped_total;
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        perf_ring* ring = rings.on(cpu);
+        if (ring) dropped += ring->dropped;
+    }
+    stats->samples = collected;
+    stats->dropped = dropped;
+    stats->stacks = nr_stacks;
+    stats->stacks_lost = stacks_lost;
+}
+
+// ==========================================================================
+// 输出
+// ==========================================================================
+
+static void format_percent(char* buf, size_t size, uint64_t part, uint64_t whole) {
+    uint64_t bp = whole ? part * 10000 / whole : 0;     // 万分之一
+    snprintf(buf, size, "%3llu.%02llu%%", (unsigned long long)(bp / 100), (unsigned long long)(bp % 100));
+}
+
+void perf_print_top(uint32_t n) {
+    perf_stats st;
+    perf_get_stats(&st);
+    char line[128];
+    snprintf(line, sizeof(line), "Samples: %llu  unknown: %llu  dropped: %llu  stacks: %llu\n\n",
+             (unsigned long long)st.samples, (unsigned long long)unknown_samples,
+             (unsigned long long)st.dropped, (unsigned long long)st.stacks);
+    tty_print(line, 0x00FFFF);
+    tty_print("   Self   Total   Samples  Symbol\n", 0xFFFF00);
+    if (!self_counts || !collected) return;
+
+    // 每轮选出独占样本最多、且排在上一名之后的函数；n 很小，不需要排序整个表
+    uint32_t last_count = UINT32_MAX;
+    uint32_t last_index = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        uint32_t best = KSYM_NONE;
+        for (uint32_t i = 0; i < nr_syms; i++) {
+            uint32_t c = self_counts[i];
+            if (!c) continue;
+            // 按 (次数降序, 编号升序) 排，已经列出的跳过
+            if (c > last_count || (c == last_count && i <= last_index && k > 0)) continue;
+            if (best == KSYM_NONE || c > self_counts[best]) best = i;
+        }
+        if (best == KSYM_NONE) break;
+        last_count = self_counts[best];
+        last_index = best;
+
+        char self_pct[16], total_pct[16];
+        format_percent(self_pct, sizeof(self_pct), self_counts[best], collected);
+        format_percent(total_pct, sizeof(total_pct), total_counts[best], collected);
+        snprintf(line, sizeof(line), "%7s %7s %9u  %s\n", self_pct, total_pct, self_counts[best],
+                 ksym_name(best));
+        tty_print(line, 0xFFFFFF);
+    }
+}
+
+static void folded_append(char* buf, size_t size, size_t* len, const char* s) {
+    while (*s && *len + 1 < size) buf[(*len)++] = *s++;
+    buf[*len] = '\0';
+}
+
+uint64_t perf_write_folded() {
+    if (!stack_table) return 0;
+    uint64_t lines = 0;
+    char buf[1024];
+    for (uint32_t slot = 0; slot < PERF_STACK_SLOTS; slot++) {
+        const perf_stack* st = &stack_table[slot];
+        if (!st->count) continue;
+        size_t len = 0;
+        buf[0] = '\0';
+        // 折叠栈从根写到叶
+        for (uint32_t i = st->depth; i-- > 0;) {
+            uint32_t sym = st->syms[i];
+            folded_append(buf, sizeof(buf), &len, sym < nr_syms ? ksym_name(sym) : "[unknown]");
+            if (i) folded_append(buf, sizeof(buf), &len, ";");
+        }
+        char count[24];
+        snprintf(count, sizeof(count), " %u\n", st->count);
+        folded_append(buf, sizeof(buf), &len, count);
+        serial_write(buf, len);
+        lines++;
+    }
+    return lines;
+}
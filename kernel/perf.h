@@ -0,0 +1,38 @@
+#pragma once
+#include <stdint.h>
+
+// ==========================================================================
+// 采样剖析器
+// ==========================================================================
+// 每个 CPU 的节拍中断里取一次被打断处的调用栈 (沿 rbp 链回溯，最多 PERF_MAX_DEPTH
+// 层)，写入本 CPU 的采样环；shell 线程定期把各环里的样本取出，用内核符号表
+// 翻译成函数名后按调用栈合并计数。节拍是 1000Hz，空闲停掉节拍的 CPU 采样也随之
+// 变少，空闲时间主要落在 cpu_idle 上。
+// perf_start/perf_stop/perf_collect 和所有查询只能在同一个线程 (shell) 里调用。
+
+#define PERF_MAX_DEPTH  15      // 每个样本记录的栈帧数 (含被打断的指令)
+
+// 节拍中断里调用
+void perf_tick();
+
+// 分配采样环并开始采样，清空之前的统计。内存不足时返回 false
+bool perf_start();
+// 停止采样，取出剩余样本并释放采样环；统计结果保留到下次 perf_start
+void perf_stop();
+bool perf_running();
+// 把各 CPU 采样环里的样本并入统计
+void perf_collect();
+
+struct perf_stats {
+    uint64_t samples;       // 已并入统计的样本
+    uint64_t dropped;       // 采样环满时丢掉的样本
+    uint64_t stacks;        // 不同调用栈的数量
+    uint64_t stacks_lost;   // 调用栈表满后只计入函数统计的样本
+};
+
+void perf_get_stats(perf_stats* stats);
+// 按独占样本数列出前 n 个函数 (独占%、含子调用%、样本数)
+void perf_print_top(uint32_t n);
+// 以折叠栈格式 ("根;...;叶 次数"，每行一个调用栈) 写到串口，可以直接生成火焰图。
+// 返回写出的行数
+uint64_t perf_write_folded();
@@ -0,0 +1,209 @@
+#include "probe.h"
+#include "bootchart.h"
+#include "cpu/percpu.h"
+#include "sched/sched.h"
+#include "sync/spinlock.h"
+#include "time/clock.h"
+#include "drivers/tty.h"
+#include "klog.h"
+#include "lib/libc.h"
+
+struct probe_task {
+    const char* name;
+    probe_fn fn;
+    void* arg;
+    uint32_t deps[PROBE_MAX_DEPS];
+    uint32_t nr_deps;
+    volatile probe_state state;
+    uint32_t cpu;
+    bool inline_run;            // 线程创建失败，在提交者的上下文里运行
+    uint64_t start_ns;
+    uint64_t end_ns;
+};
+
+static probe_task tasks[PROBE_MAX];
+static uint32_t nr_tasks = 0;
+static spinlock probe_lock;
+static wait_queue probe_wait_queue;
+
+static const char* const state_names[] = { "new", "pending", "running", "done", "failed", "skipped" };
+
+void probe_init() {
+    spin_lock_init(&probe_lock, "probe");
+    wait_queue_init(&probe_wait_queue, "probe");
+}
+
+uint32_t probe_create(const char* name, probe_fn fn, void* arg) {
+    uint64_t flags = spin_lock_irqsave(&probe_lock);
+    uint32_t id = PROBE_NONE;
+    if (nr_tasks < PROBE_MAX) {
+        id = nr_tasks;
+        probe_task* t = &tasks[id];
+        memset(t, 0, sizeof(*t));
+        t->name = name;
+        t->fn = fn;
+        t->arg = arg;
+        t->state = PROBE_NEW;
+        // 最后再发布：probe_find/probe_dump 不加锁遍历前 nr_tasks 项
+        __atomic_store_n(&nr_tasks, id + 1, __ATOMIC_RELEASE);
+    }
+    spin_unlock_irqrestore(&probe_lock, flags);
+    if (id == PROBE_NONE) pr_err("probe: task table full, %s not registered", name);
+    return id;
+}
+
+bool probe_depends(uint32_t id, uint32_t dep) {
+    if (id >= nr_tasks || dep >= nr_tasks || id == dep) return false;
+    probe_task* t = &tasks[id];
+    if (t->state != PROBE_NEW || t->nr_deps >= PROBE_MAX_DEPS) return false;
+    t->deps[t->nr_deps++] = dep;
+    return true;
+}
+
+static bool probe_finished(probe_state state) {
+    return state == PROBE_DONE || state == PROBE_FAILED || state == PROBE_SKIPPED;
+}
+
+// 在锁内扫描等待中的任务：依赖都成功的标记为运行并放进 ready，有依赖没成功的
+// 标记为跳过。跳过会让依赖它的任务也跳过，所以一直扫到没有变化为止
+static uint32_t collect_ready(uint32_t* ready, bool* skipped) {
+    uint32_t nr_ready = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (uint32_t i = 0; i < nr_tasks; i++) {
+            probe_task* t = &tasks[i];
+            if (t->state != PROBE_PENDING) continue;
+            bool all_done = true;
+            bool blocked = false;
+            for (uint32_t d = 0; d < t->nr_deps; d++) {
+                probe_state s = tasks[t->deps[d]].state;
+                if (s == PROBE_FAILED || s == PROBE_SKIPPED) blocked = true;
+                else if (s != PROBE_DONE) all_done = false;
+            }
+            if (blocked) {
+                t->state = PROBE_SKIPPED;
+                *skipped = true;
+                changed = true;
+            } else if (all_done) {
+                t->state = PROBE_RUNNING;
+                ready[nr_ready++] = i;
+            }
+        }
+    }
+    return nr_ready;
+}
+
+static void probe_launch(uint32_t id);
+
+static void probe_kick() {
+    uint32_t ready[PROBE_MAX];
+    bool skipped = false;
+    uint64_t flags = spin_lock_irqsave(&probe_lock);
+    uint32_t nr_ready = collect_ready(ready, &skipped);
+    spin_unlock_irqrestore(&probe_lock, flags);
+    if (skipped) wake_up(&probe_wait_queue);
+    for (uint32_t i = 0; i < nr_ready; i++) probe_launch(ready[i]);
+}
+
+static void probe_run(probe_task* t) {
+    t->cpu = smp_processor_id();
+    t->start_ns = clock_monotonic_ns();
+    uint32_t span = bootchart_begin(t->name);
+    bool ok = t->fn(t->arg);
+    bootchart_end(span);
+    t->end_ns = clock_monotonic_ns();
+    if (!ok) pr_warn("probe: %s failed", t->name);
+    __atomic_store_n(&t->state, ok ? PROBE_DONE : PROBE_FAILED, __ATOMIC_RELEASE);
+    wake_up(&probe_wait_queue);
+    // 依赖本任务的任务现在可能就绪了
+    probe_kick();
+}
+
+static void probe_thread(void* arg) {
+    probe_run((probe_task*)arg);
+    thread_exit();
+}
+
+static void probe_launch(uint32_t id) {
+    probe_task* t = &tasks[id];
+    char name[THREAD_NAME_LEN];
+    snprintf(name, sizeof(name), "probe/%s", t->name);
+    if (!thread_create(name, probe_thread, t)) {
+        // 没有线程可用时退回到顺序执行，至少设备还能初始化
+        t->inline_run = true;
+        probe_run(t);
+    }
+}
+
+void probe_submit(uint32_t id) {
+    if (id >= nr_tasks) return;
+    uint64_t flags = spin_lock_irqsave(&probe_lock);
+    bool submitted = tasks[id].state == PROBE_NEW;
+    if (submitted) tasks[id].state = PROBE_PENDING;
+    spin_unlock_irqrestore(&probe_lock, flags);
+    if (submitted) probe_kick();
+}
+
+probe_state probe_get_state(uint32_t id) {
+    if (id >= nr_tasks) return PROBE_SKIPPED;
+    return __atomic_load_n(&tasks[id].state, __ATOMIC_ACQUIRE);
+}
+
+uint32_t probe_find(const char* name) {
+    uint32_t n = __atomic_load_n(&nr_tasks, __ATOMIC_ACQUIRE);
+    for (uint32_t i = 0; i < n; i++) {
+        if (strcmp(tasks[i].name, name) == 0) return i;
+    }
+    return PROBE_NONE;
+}
+
+bool probe_wait(uint32_t id) {
+    if (id >= nr_tasks) return false;
+    if (!probe_finished(probe_get_state(id))) {
+        wait_event(probe_wait_queue, probe_finished(probe_get_state(id)));
+    }
+    return probe_get_state(id) == PROBE_DONE;
+}
+
+// ==========================================================================
+// 统计
+// ==========================================================================
+
+void probe_dump() {
+    uint32_t n = __atomic_load_n(&nr_tasks, __ATOMIC_ACQUIRE);
+    char line[128];
+    snprintf(line, sizeof(line), "\nBoot probes: %u\n", n);
+    tty_print(line, 0x00FFFF);
+    tty_print("Task            State    CPU    Start ms    Time ms  Depends on\n", 0xFFFF00);
+    bool any_inline = false;
+    for (uint32_t i = 0; i < n; i++) {
+        const probe_task* t = &tasks[i];
+        probe_state state = probe_get_state(i);
+        char deps[48] = "-";
+        size_t len = 0;
+        for (uint32_t d = 0; d < t->nr_deps && len < sizeof(deps); d++) {
+            len += snprintf(deps + len, sizeof(deps) - len, "%s%s", d ? ", " : "", tasks[t->deps[d]].name);
+        }
+
+        uint32_t color = 0xFFFFFF;
+        if (state == PROBE_FAILED || state == PROBE_SKIPPED) color = 0xFF6060;
+        else if (state == PROBE_RUNNING || state == PROBE_PENDING) color = 0xFFD700;
+
+        any_inline |= t->inline_run;
+        if (t->start_ns) {
+            uint64_t end = t->end_ns ? t->end_ns : clock_monotonic_ns();
+            uint64_t dur_us = (end - t->start_ns) / 1000;
+            uint64_t start_us = t->start_ns / 1000;
+            snprintf(line, sizeof(line), "%-15s %-8s %3u%s %6llu.%03llu %6llu.%03llu  %s\n", t->name,
+                     state_names[state], t->cpu, t->inline_run ? "*" : " ",
+                     (unsigned long long)(start_us / 1000), (unsigned long long)(start_us % 1000),
+                     (unsigned long long)(dur_us / 1000), (unsigned long long)(dur_us % 1000), deps);
+        } else {
+            snprintf(line, sizeof(line), "%-15s %-8s %3s  %10s %10s  %s\n", t->name, state_names[state], "-",
+                     "-", "-", deps);
+        }
+        tty_print(line, color);
+    }
+    if (any_inline) tty_print("* no thread available, ran synchronously\n", 0x808080);
+}
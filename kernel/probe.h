@@ -0,0 +1,48 @@
+#pragma once
+#include <stdint.h>
+
+// ==========================================================================
+// 启动时的设备探测
+// ==========================================================================
+// 设备初始化拆成若干探测任务，任务之间用 probe_depends 声明依赖：
+//
+//   uint32_t ata = probe_create("ata", probe_ata, nullptr);
+//   uint32_t mbr = probe_create("mbr", probe_mbr, nullptr);
+//   probe_depends(mbr, ata);
+//   probe_submit(ata);
+//   probe_submit(mbr);
+//
+// 提交后依赖都已完成的任务立即在自己的内核线程里运行 (落在负载最轻的 CPU 上)，
+// 否则等最后一个依赖完成时再启动。互不依赖的任务并行执行，kmain 提交完就进入
+// shell，不等慢设备。探测函数可以睡眠；依赖失败或被跳过的任务不会运行。
+// 任务也可以在别的探测函数里创建 (例如 PCI 扫描发现设备时)。
+
+#define PROBE_MAX       16
+#define PROBE_MAX_DEPS  4
+#define PROBE_NONE      0xFFFFFFFFu
+
+enum probe_state {
+    PROBE_NEW,          // 已创建，还在设置依赖
+    PROBE_PENDING,      // 已提交，等依赖完成
+    PROBE_RUNNING,
+    PROBE_DONE,
+    PROBE_FAILED,       // 探测函数返回 false
+    PROBE_SKIPPED,      // 有依赖没有成功
+};
+
+// 返回设备是否可用
+typedef bool (*probe_fn)(void* arg);
+
+void probe_init();
+// name 必须是静态字符串。任务表满时返回 PROBE_NONE
+uint32_t probe_create(const char* name, probe_fn fn, void* arg);
+// id 在 dep 成功完成后才运行。只能在 probe_submit 之前调用
+bool probe_depends(uint32_t id, uint32_t dep);
+void probe_submit(uint32_t id);
+probe_state probe_get_state(uint32_t id);
+// 按名字查找任务，找不到返回 PROBE_NONE
+uint32_t probe_find(const char* name);
+// 等任务结束，返回是否成功。只能在可以睡眠的线程里调用
+bool probe_wait(uint32_t id);
+// 列出所有任务的状态、依赖、所在 CPU 和耗时
+void probe_dump();
@@ -0,0 +1,244 @@
+#include "async.h"
+#include "kernel/cpu/isr.h"
+#include "kernel/drivers/tty.h"
+#include "kernel/klog.h"
+#include "lib/libc.h"
+
+// 执行器里有锁和等待队列 (登记在 lockstat 里)，登记后不再注销
+#define MAX_ASYNC_EXECUTORS 4
+
+static async_executor default_executor;
+static async_executor* executors[MAX_ASYNC_EXECUTORS];
+static uint32_t nr_executors = 0;
+static spinlock executors_lock;
+// async_wait 的等待者：任何任务完成时唤醒一次，各自检查自己等的任务
+static wait_queue done_wait;
+static bool async_ready = false;
+
+// ==========================================================================
+// 执行器
+// ==========================================================================
+
+static void ready_unlink(async_executor* ex, async_task* t) {
+    async_task** pp = &ex->ready_head;
+    async_task* prev = nullptr;
+    while (*pp && *pp != t) {
+        prev = *pp;
+        pp = &(*pp)->next;
+    }
+    if (!*pp) return;
+    *pp = t->next;
+    if (ex->ready_tail == t) ex->ready_tail = prev;
+}
+
+void async_wake(async_task* t) {
+    async_executor* ex = t->ex;
+    uint64_t flags = spin_lock_irqsave(&ex->lock);
+    bool queued = !(t->flags & (ASYNC_QUEUED | ASYNC_FINISHED));
+    if (queued) {
+        t->flags |= ASYNC_QUEUED;
+        t->next = nullptr;
+        if (ex->ready_tail) {
+            ex->ready_tail->next = t;
+        } else {
+            ex->ready_head = t;
+        }
+        ex->ready_tail = t;
+        ex->wakeups++;
+    }
+    spin_unlock_irqrestore(&ex->lock, flags);
+    if (queued) wake_up(&ex->wait);
+}
+
+static void finish_task(async_executor* ex, async_task* t) {
+    uint64_t flags = spin_lock_irqsave(&ex->lock);
+    // 运行期间可能又被事件或定时器放回了就绪队列
+    if (t->flags & ASYNC_QUEUED) ready_unlink(ex, t);
+    t->flags = ASYNC_FINISHED;
+    ex->completed++;
+    spin_unlock_irqrestore(&ex->lock, flags);
+
+    // 定时器只在本 CPU 上启动，软中断里的回调不会和这里同时运行
+    hrtimer_cancel(&t->timer);
+    async_event_finish(t);
+    if (t->done) t->done(t);
+    __atomic_or_fetch(&t->flags, ASYNC_COMPLETE, __ATOMIC_RELEASE);
+    wake_up(&done_wait);
+}
+
+static void executor_thread(void* arg) {
+    async_executor* ex = (async_executor*)arg;
+    for (;;) {
+        wait_event(ex->wait, __atomic_load_n(&ex->ready_head, __ATOMIC_ACQUIRE) != nullptr);
+
+        uint64_t flags = spin_lock_irqsave(&ex->lock);
+        async_task* t = ex->ready_head;
+        if (t) {
+            ex->ready_head = t->next;
+            if (!ex->ready_head) ex->ready_tail = nullptr;
+            // 运行前清除：运行期间到来的唤醒会让任务再被调用一次
+            t->flags &= ~ASYNC_QUEUED;
+        }
+        spin_unlock_irqrestore(&ex->lock, flags);
+        if (!t) continue;
+
+        ex->polls++;
+        if (t->fn(t) == ASYNC_DONE) finish_task(ex, t);
+    }
+}
+
+bool async_executor_init(async_executor* ex, const char* name, int cpu) {
+    uint64_t flags = spin_lock_irqsave(&executors_lock);
+    bool slot = nr_executors < MAX_ASYNC_EXECUTORS;
+    if (slot) executors[nr_executors++] = ex;
+    spin_unlock_irqrestore(&executors_lock, flags);
+    if (!slot) {
+        pr_err("async: no free slot for %s", name);
+        return false;
+    }
+
+    strncpy(ex->name, name, THREAD_NAME_LEN - 1);
+    spin_lock_init(&ex->lock, "async_executor");
+    wait_queue_init(&ex->wait, "async_ready");
+    ex->ready_head = ex->ready_tail = nullptr;
+
+    char thread_name[THREAD_NAME_LEN];
+    snprintf(thread_name, sizeof(thread_name), "async/%s", name);
+    ex->worker = thread_create_on(cpu, thread_name, executor_thread, ex);
+    if (!ex->worker) {
+        pr_err("async: cannot start %s", thread_name);
+        return false;
+    }
+    return true;
+}
+
+void async_init() {
+    spin_lock_init(&executors_lock, "async_executors");
+    wait_queue_init(&done_wait, "async_done");
+    if (async_executor_init(&default_executor, "default", -1)) {
+        __atomic_store_n(&async_ready, true, __ATOMIC_RELEASE);
+    }
+}
+
+async_executor* async_default_executor() {
+    return __atomic_load_n(&async_ready, __ATOMIC_ACQUIRE) ? &default_executor : nullptr;
+}
+
+// ==========================================================================
+// 任务
+// ==========================================================================
+
+static hrtimer_restart async_timer_fn(hrtimer* timer) {
+    async_wake(async_entry(timer, async_task, timer));
+    return HRTIMER_NORESTART;
+}
+
+void async_spawn(async_executor* ex, async_task* t, async_fn fn, void (*done)(async_task*)) {
+    if (!ex) ex = &default_executor;
+    t->fn = fn;
+    t->ex = ex;
+    t->next = nullptr;
+    t->wait_next = nullptr;
+    t->waiting_on = nullptr;
+    t->line = 0;
+    t->flags = 0;
+    t->timed_out = false;
+    t->deadline = 0;
+    t->done = done;
+    hrtimer_init(&t->timer, async_timer_fn);
+    __atomic_add_fetch(&ex->spawned, 1, __ATOMIC_RELAXED);
+    async_wake(t);
+}
+
+void async_wait(async_task* t) {
+    wait_event(done_wait, async_done(t));
+}
+
+bool async_can_block() {
+    if (!async_default_executor() || in_interrupt() || preempt_count() != 0) return false;
+    thread* self = current_thread();
+    if (!self || self->idle) return false;
+    for (uint32_t i = 0; i < nr_executors; i++) {
+        if (executors[i]->worker == self) return false;
+    }
+    return true;
+}
+
+void async_arm_timer(async_task* t, uint64_t expires_ns) {
+    // 堆满时退化成立即重新调用，由等待点自己检查时间
+    if (!hrtimer_start(&t->timer, expires_ns)) async_wake(t);
+}
+
+bool async_timeout_expired(async_task* t) {
+    if (clock_monotonic_ns() < t->deadline) return false;
+    t->ex->timeouts++;
+    return true;
+}
+
+// ==========================================================================
+// 事件
+// ==========================================================================
+
+void async_event_init(async_event* ev, const char* name) {
+    spin_lock_init(&ev->lock, name);
+    ev->waiters = nullptr;
+    ev->signals = 0;
+}
+
+void async_event_prepare(async_task* t, async_event* ev) {
+    uint64_t flags = spin_lock_irqsave(&ev->lock);
+    // 被其他原因 (定时器) 提前调用时已经挂在上面了
+    if (t->waiting_on != ev) {
+        t->wait_next = ev->waiters;
+        ev->waiters = t;
+        t->waiting_on = ev;
+    }
+    spin_unlock_irqrestore(&ev->lock, flags);
+}
+
+void async_event_finish(async_task* t) {
+    async_event* ev = t->waiting_on;
+    if (!ev) return;
+    uint64_t flags = spin_lock_irqsave(&ev->lock);
+    // 加锁之前 signal 可能已经把任务摘下了
+    if (t->waiting_on == ev) {
+        async_task** pp = &ev->waiters;
+        while (*pp && *pp != t) pp = &(*pp)->wait_next;
+        if (*pp) *pp = t->wait_next;
+        t->waiting_on = nullptr;
+    }
+    spin_unlock_irqrestore(&ev->lock, flags);
+}
+
+void async_event_signal(async_event* ev) {
+    uint64_t flags = spin_lock_irqsave(&ev->lock);
+    ev->signals++;
+    async_task* t = ev->waiters;
+    ev->waiters = nullptr;
+    // 在事件锁里唤醒：放开锁后任务可能已在执行器上重新挂到事件上，改写 wait_next
+    while (t) {
+        async_task* next = t->wait_next;
+        t->waiting_on = nullptr;
+        async_wake(t);
+        t = next;
+    }
+    spin_unlock_irqrestore(&ev->lock, flags);
+}
+
+// ==========================================================================
+// 统计
+// ==========================================================================
+
+void async_dump() {
+    tty_print("\nExecutor     cpu    spawned   completed      polls    wakeups   timeouts\n", 0xFFFF00);
+    char line[112];
+    for (uint32_t i = 0; i < nr_executors; i++) {
+        async_executor* ex = executors[i];
+        if (!ex->worker) continue;
+        snprintf(line, sizeof(line), "%-12s %3u %10llu %11llu %10llu %10llu %10llu\n", ex->name,
+                 ex->worker->cpu, (unsigned long long)ex->spawned, (unsigned long long)ex->completed,
+                 (unsigned long long)ex->polls, (unsigned long long)ex->wakeups,
+                 (unsigned long long)ex->timeouts);
+        tty_print(line, 0xFFFFFF);
+    }
+}
@@ -0,0 +1,188 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "kernel/sync/spinlock.h"
+#include "kernel/time/clock.h"
+#include "kernel/time/hrtimer.h"
+#include "sched.h"
+
+// ==========================================================================
+// 无栈异步任务
+// ==========================================================================
+// 驱动里“发命令、等状态位、再发下一个命令”的流程写成可以在等待处返回的函数，
+// 由绑定在一个 CPU 上的执行器线程反复调用 (protothread 的方式，用 switch 保存
+// 恢复点)。等待期间不占用 CPU、不占用线程栈，一个执行器可以同时推进许多任务。
+//
+//   struct my_req { async_task task; int step; ... };
+//   static async_status my_fn(async_task* t) {
+//       my_req* r = async_entry(t, my_req, task);
+//       ASYNC_BEGIN(t);
+//       start_io();
+//       ASYNC_AWAIT_TIMEOUT(t, &io_event, io_done, 10000000);   // 最多 10ms
+//       if (t->timed_out) ASYNC_RETURN(t);
+//       ...
+//       ASYNC_END(t);
+//   }
+//
+// 限制：等待点前后的局部变量不会保留，需要跨等待的状态放在任务结构里；
+// ASYNC_* 宏不能出现在任务函数自己的 switch 语句里。
+// 任务、事件和定时器都由调用者提供，执行路径上没有任何内存分配。
+
+enum async_status : uint8_t {
+    ASYNC_PENDING,      // 停在某个等待点，等被唤醒后再次调用
+    ASYNC_DONE,
+};
+
+struct async_task;
+struct async_executor;
+typedef async_status (*async_fn)(async_task* t);
+
+#define ASYNC_QUEUED    (1u << 0)   // 在执行器的就绪队列里
+#define ASYNC_FINISHED  (1u << 1)   // 已返回 ASYNC_DONE，不再接受唤醒
+#define ASYNC_COMPLETE  (1u << 2)   // 执行器不再访问任务，调用者可以重用或释放
+
+struct async_task {
+    async_fn fn;
+    async_executor* ex;
+    async_task* next;               // 就绪队列
+    async_task* wait_next;          // 等待的事件上的链表
+    struct async_event* waiting_on;
+    uint32_t line;                  // 恢复点 (0 表示从头开始)
+    volatile uint32_t flags;
+    bool timed_out;                 // 最近一次带超时的等待是否超时
+    uint64_t deadline;
+    hrtimer timer;                  // 睡眠、轮询间隔和超时都用它
+    void (*done)(async_task* t);    // 完成时在执行器线程里调用，可以为空
+};
+
+#define async_entry(ptr, type, member) \
+    ((type*)((char*)(ptr) - offsetof(type, member)))
+
+// 事件：中断处理函数、下半部或其他任务在条件可能变化时 signal，唤醒所有等待者，
+// 等待者醒来后重新检查自己的条件。事件本身不记状态。
+struct async_event {
+    spinlock lock;
+    async_task* waiters;
+    uint64_t signals;
+};
+
+void async_event_init(async_event* ev, const char* name);
+// 任何上下文都可以调用
+void async_event_signal(async_event* ev);
+
+// 执行器：一个绑定 CPU 的内核线程和一个就绪队列
+struct async_executor {
+    char name[THREAD_NAME_LEN];
+    spinlock lock;
+    async_task* ready_head;
+    async_task* ready_tail;
+    wait_queue wait;
+    thread* worker;
+    uint64_t spawned;
+    uint64_t polls;                 // 调用任务函数的次数
+    uint64_t wakeups;
+    uint64_t completed;
+    uint64_t timeouts;
+};
+
+// 创建默认执行器 (需要调度器)
+void async_init();
+async_executor* async_default_executor();
+// 初始化一个执行器并在 cpu 上启动它的线程 (-1 由调度器选择)；执行器不会被销毁
+bool async_executor_init(async_executor* ex, const char* name, int cpu);
+
+// 提交任务，从头开始执行；ex 为空时使用默认执行器
+void async_spawn(async_executor* ex, async_task* t, async_fn fn, void (*done)(async_task*));
+// 把任务放回就绪队列 (事件和定时器用它)；任何上下文都可以调用
+void async_wake(async_task* t);
+// 在线程上下文里等待任务完成
+void async_wait(async_task* t);
+// 当前上下文能否提交任务后睡眠等待：执行器已启动、可以睡眠、且不是执行器线程自己
+bool async_can_block();
+
+static inline bool async_done(const async_task* t) {
+    return __atomic_load_n(&t->flags, __ATOMIC_ACQUIRE) & ASYNC_COMPLETE;
+}
+
+// 以下由宏使用
+void async_event_prepare(async_task* t, async_event* ev);
+void async_event_finish(async_task* t);
+void async_arm_timer(async_task* t, uint64_t expires_ns);
+bool async_timeout_expired(async_task* t);
+
+static inline void async_set_timeout(async_task* t, uint64_t ns) {
+    t->deadline = clock_monotonic_ns() + ns;
+}
+
+#define ASYNC_BEGIN(t)  switch ((t)->line) { case 0:
+#define ASYNC_END(t)    } (t)->line = 0; return ASYNC_DONE
+#define ASYNC_RETURN(t) do { (t)->line = 0; return ASYNC_DONE; } while (0)
+
+// 让出执行器，给同一执行器上的其他任务运行的机会
+#define ASYNC_YIELD(t)                                          \
+    do {                                                        \
+        (t)->line = __LINE__;                                   \
+        async_wake(t);                                          \
+        return ASYNC_PENDING;                                   \
+        case __LINE__:;                                         \
+    } while (0)
+
+// 等待 ev 被 signal 且 cond 成立 (先挂上事件再检查条件，不会丢失唤醒)
+#define ASYNC_AWAIT(t, ev, cond)                                \
+    do {                                                        \
+        (t)->line = __LINE__;                                   \
+        [[fallthrough]];                                        \
+        case __LINE__:                                          \
+        async_event_prepare((t), (ev));                         \
+        if (!(cond)) return ASYNC_PENDING;                      \
+        async_event_finish(t);                                  \
+    } while (0)
+
+// 同上，最多等 ns 纳秒；返回后检查 t->timed_out
+#define ASYNC_AWAIT_TIMEOUT(t, ev, cond, ns)                    \
+    do {                                                        \
+        async_set_timeout((t), (ns));                           \
+        async_arm_timer((t), (t)->deadline);                    \
+        (t)->line = __LINE__;                                   \
+        [[fallthrough]];                                        \
+        case __LINE__:                                          \
+        async_event_prepare((t), (ev));                         \
+        if (cond) {                                             \
+            (t)->timed_out = false;                             \
+        } else if (async_timeout_expired(t)) {                  \
+            (t)->timed_out = true;                              \
+        } else {                                                \
+            return ASYNC_PENDING;                               \
+        }                                                       \
+        async_event_finish(t);                                  \
+        hrtimer_cancel(&(t)->timer);                            \
+    } while (0)
+
+// 没有中断可等的状态位：每 interval_ns 检查一次 cond，最多 timeout_ns
+#define ASYNC_POLL_TIMEOUT(t, cond, interval_ns, timeout_ns)    \
+    do {                                                        \
+        async_set_timeout((t), (timeout_ns));                   \
+        (t)->line = __LINE__;                                   \
+        [[fallthrough]];                                        \
+        case __LINE__:                                          \
+        if (cond) {                                             \
+            (t)->timed_out = false;                             \
+        } else if (async_timeout_expired(t)) {                  \
+            (t)->timed_out = true;                              \
+        } else {                                                \
+            async_arm_timer((t), clock_monotonic_ns() + (interval_ns)); \
+            return ASYNC_PENDING;                               \
+        }                                                       \
+    } while (0)
+
+#define ASYNC_SLEEP(t, ns)                                      \
+    do {                                                        \
+        async_set_timeout((t), (ns));                           \
+        async_arm_timer((t), (t)->deadline);                    \
+        (t)->line = __LINE__;                                   \
+        [[fallthrough]];                                        \
+        case __LINE__:                                          \
+        if (clock_monotonic_ns() < (t)->deadline) return ASYNC_PENDING; \
+    } while (0)
+
+void async_dump();
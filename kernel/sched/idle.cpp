@@ -0,0 +1,237 @@
+#include "idle.h"
+#include "sched.h"
+#include "kernel/cpu/msr.h"
+#include "kernel/cpu/cpufeature.h"
+#include "kernel/cpu/smp.h"
+#include "kernel/softirq.h"
+#include "kernel/sync/rcu.h"
+#include "kernel/time/clock.h"
+#include "kernel/time/tick.h"
+#include "kernel/drivers/tty.h"
+#include "kernel/klog.h"
+#include "lib/libc.h"
+
+// idle_cpu::mode：0 表示不在 cpu_idle 里，否则是 idle_state + 1。
+// 用 0 表示“不空闲”，idle_init 之前被唤醒的 CPU 也不会被当成在轮询
+#define IDLE_MODE_RUNNING   0
+
+struct idle_cpu {
+    volatile uint8_t mode;
+    volatile uint64_t wake_ns;  // 第一个唤醒请求的时刻，0 表示没有
+    idle_cpu_stats stats;
+};
+
+static per_cpu<idle_cpu> idle_cpus;
+static bool use_mwait = false;
+static volatile uint64_t poll_max_ns = IDLE_POLL_MAX_NS;
+
+static const char* const state_names[NR_IDLE_STATES] = { "POLL", "MWAIT", "HLT" };
+
+void idle_init() {
+    if (cpu_has(X86_FEATURE_MONITOR) && cpu_max_leaf() >= 5) {
+        uint32_t eax, ebx, ecx, edx;
+        cpuid(5, 0, &eax, &ebx, &ecx, &edx);
+        // 最小监视行大小为 0 的 CPU (或虚拟机) 报告不可靠，不使用
+        use_mwait = (eax & 0xFFFF) != 0;
+    }
+    pr_info("idle: %s, poll window up to %llu us", use_mwait ? "MWAIT" : "HLT",
+            (unsigned long long)(poll_max_ns / 1000));
+}
+
+bool idle_mwait_supported() {
+    return use_mwait;
+}
+
+void idle_set_poll_max_ns(uint64_t ns) {
+    __atomic_store_n(&poll_max_ns, ns, __ATOMIC_RELAXED);
+}
+
+uint64_t idle_poll_max_ns() {
+    return poll_max_ns;
+}
+
+const char* idle_state_name(idle_state state) {
+    return state_names[state];
+}
+
+static inline uint32_t hist_bucket(uint64_t ns) {
+    if (ns < 2) return 0;
+    uint32_t b = 63 - __builtin_clzll(ns);
+    return b < IDLE_HIST_BUCKETS ? b : IDLE_HIST_BUCKETS - 1;
+}
+
+static bool idle_work_pending(uint32_t cpu) {
+    if (need_resched() || softirq_pending()) return true;
+    // BSP 的空闲循环负责把日志环刷到屏幕上
+    return cpu == 0 && klog_pending();
+}
+
+static uint64_t poll_window(const idle_cpu* ic) {
+    uint64_t max = __atomic_load_n(&poll_max_ns, __ATOMIC_RELAXED);
+    // 最近的空闲都很短：下一个唤醒多半也很快到来，轮询比进出 hlt 划算
+    if (!max || ic->stats.avg_idle_ns >= max) return 0;
+    uint64_t window = ic->stats.avg_idle_ns * 2;
+    if (window < IDLE_POLL_MIN_NS) window = IDLE_POLL_MIN_NS;
+    return window < max ? window : max;
+}
+
+void cpu_idle() {
+    uint32_t cpu = smp_processor_id();
+    idle_cpu* ic = &idle_cpus.get();
+    uint64_t start = clock_monotonic_ns();
+    idle_state state = IDLE_POLL;
+    bool hit = false;
+
+    uint64_t window = poll_window(ic);
+    if (window) {
+        __atomic_store_n(&ic->mode, IDLE_POLL + 1, __ATOMIC_SEQ_CST);
+        asm volatile("sti");
+        uint64_t end = start + window;
+        while (!(hit = idle_work_pending(cpu)) && clock_monotonic_ns() < end) {
+            asm volatile("pause");
+        }
+        asm volatile("cli");
+    }
+
+    if (!hit) {
+        state = use_mwait ? IDLE_MWAIT : IDLE_HLT;
+        // 先公布状态再检查：唤醒方先写 need_resched 再读状态，两边总有一方看到对方
+        __atomic_store_n(&ic->mode, state + 1, __ATOMIC_SEQ_CST);
+        if (idle_work_pending(cpu)) {
+            hit = true;
+            state = IDLE_POLL;
+        } else if (window) {
+            ic->stats.poll_misses++;
+        }
+    }
+
+    if (!hit) {
+        // 停掉周期节拍，只在下一个定时器到期时唤醒；RCU 还有工作时最多睡一个节拍
+        tick_nohz_idle_enter(rcu_needs_cpu() ? clock_monotonic_ns() + TICK_NS : TICK_NO_DEADLINE);
+        rcu_idle_enter();
+        if (state == IDLE_MWAIT) {
+            // 监视 need_resched 所在的缓存行，其他 CPU 写它就会把本 CPU 唤醒
+            asm volatile("monitor" :: "a"(&this_cpu()->need_resched), "c"(0u), "d"(0u));
+            if (!need_resched()) {
+                asm volatile("sti; mwait" :: "a"(0u), "c"(0u) : "memory");
+            } else {
+                asm volatile("sti");
+            }
+        } else {
+            asm volatile("sti; hlt"); // sti 的下一条指令执行前不会响应中断，等待下一次中断
+        }
+        rcu_idle_exit();
+        tick_nohz_idle_exit();
+        asm volatile("cli");
+    }
+
+    __atomic_store_n(&ic->mode, IDLE_MODE_RUNNING, __ATOMIC_SEQ_CST);
+    uint64_t now = clock_monotonic_ns();
+    uint64_t duration = now - start;
+    idle_cpu_stats* st = &ic->stats;
+    st->entries[state]++;
+    st->residency_ns[state] += duration;
+    st->residency_hist[state][hist_bucket(duration)]++;
+    st->avg_idle_ns = (st->avg_idle_ns * 7 + duration) / 8;
+
+    uint64_t woke = __atomic_exchange_n(&ic->wake_ns, 0, __ATOMIC_ACQ_REL);
+    if (woke && now > woke) {
+        uint64_t latency = now - woke;
+        st->wake_latency_hist[state][hist_bucket(latency)]++;
+        if (latency > st->wake_latency_max_ns[state]) st->wake_latency_max_ns[state] = latency;
+    }
+    asm volatile("sti");
+}
+
+bool idle_wake_cpu(uint32_t cpu) {
+    idle_cpu* ic = &idle_cpus.on(cpu);
+    uint8_t mode = __atomic_load_n(&ic->mode, __ATOMIC_SEQ_CST);
+    if (mode == IDLE_MODE_RUNNING) return false;
+    uint64_t expected = 0;
+    __atomic_compare_exchange_n(&ic->wake_ns, &expected, clock_monotonic_ns(), false,
+                                __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+    if (mode == IDLE_HLT + 1) return false;
+    __atomic_add_fetch(&ic->stats.ipis_saved, 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+void idle_get_cpu_stats(uint32_t cpu, idle_cpu_stats* stats) {
+    *stats = idle_cpus.on(cpu).stats;
+}
+
+// ==========================================================================
+// 统计
+// ==========================================================================
+
+// 直方图第 b 格的上界 (2^(b+1) 纳秒)，按量级选单位
+static void format_bucket(char* buf, size_t size, uint32_t b) {
+    uint64_t ns = 2ull << b;
+    if (ns < 1000) {
+        snprintf(buf, size, "%llu ns", (unsigned long long)ns);
+    } else if (ns < 1000000) {
+        snprintf(buf, size, "%llu us", (unsigned long long)(ns / 1000));
+    } else if (ns < 1000000000) {
+        snprintf(buf, size, "%llu ms", (unsigned long long)(ns / 1000000));
+    } else {
+        snprintf(buf, size, "%llu s", (unsigned long long)(ns / 1000000000));
+    }
+}
+
+static void dump_hist(const char* title, uint64_t hist[NR_IDLE_STATES][IDLE_HIST_BUCKETS]) {
+    tty_print(title, 0xFFFF00);
+    tty_print("         <       POLL      MWAIT        HLT\n", 0xFFFF00);
+    char line[96];
+    char label[16];
+    for (uint32_t b = 0; b < IDLE_HIST_BUCKETS; b++) {
+        if (!hist[IDLE_POLL][b] && !hist[IDLE_MWAIT][b] && !hist[IDLE_HLT][b]) continue;
+        format_bucket(label, sizeof(label), b);
+        snprintf(line, sizeof(line), "%10s %10llu %10llu %10llu\n", label,
+                 (unsigned long long)hist[IDLE_POLL][b], (unsigned long long)hist[IDLE_MWAIT][b],
+                 (unsigned long long)hist[IDLE_HLT][b]);
+        tty_print(line, 0xFFFFFF);
+    }
+}
+
+void idle_dump() {
+    char line[128];
+    snprintf(line, sizeof(line), "\nDeep idle: %s  poll window: %llu-%llu us\n",
+             use_mwait ? "MWAIT" : "HLT", (unsigned long long)(IDLE_POLL_MIN_NS / 1000),
+             (unsigned long long)(poll_max_ns / 1000));
+    tty_print(line, 0x00FFFF);
+    tty_print("CPU     POLL    MWAIT      HLT  resid ms P/M/H        poll miss  IPIs saved  avg idle us\n",
+              0xFFFF00);
+
+    // 汇总结构有 1.5KB 多，不放在线程栈上；dump 只在 shell 里调用
+    static idle_cpu_stats total;
+    memset(&total, 0, sizeof(total));
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (!cpu_online(cpu)) continue;
+        const idle_cpu_stats* st = &idle_cpus.on(cpu).stats;
+        snprintf(line, sizeof(line), "%3u %8llu %8llu %8llu  %6llu/%6llu/%6llu %9llu %11llu %12llu\n", cpu,
+                 (unsigned long long)st->entries[IDLE_POLL], (unsigned long long)st->entries[IDLE_MWAIT],
+                 (unsigned long long)st->entries[IDLE_HLT],
+                 (unsigned long long)(st->residency_ns[IDLE_POLL] / 1000000),
+                 (unsigned long long)(st->residency_ns[IDLE_MWAIT] / 1000000),
+                 (unsigned long long)(st->residency_ns[IDLE_HLT] / 1000000),
+                 (unsigned long long)st->poll_misses, (unsigned long long)st->ipis_saved,
+                 (unsigned long long)(st->avg_idle_ns / 1000));
+        tty_print(line, 0xFFFFFF);
+        for (int s = 0; s < NR_IDLE_STATES; s++) {
+            for (uint32_t b = 0; b < IDLE_HIST_BUCKETS; b++) {
+                total.residency_hist[s][b] += st->residency_hist[s][b];
+                total.wake_latency_hist[s][b] += st->wake_latency_hist[s][b];
+            }
+            if (st->wake_latency_max_ns[s] > total.wake_latency_max_ns[s]) {
+                total.wake_latency_max_ns[s] = st->wake_latency_max_ns[s];
+            }
+        }
+    }
+
+    dump_hist("\nIdle residency (all CPUs)\n", total.residency_hist);
+    dump_hist("\nWake latency (all CPUs)\n", total.wake_latency_hist);
+    snprintf(line, sizeof(line), "%10s %10llu %10llu %10llu  (us)\n", "max",
+             (unsigned long long)(total.wake_latency_max_ns[IDLE_POLL] / 1000),
+             (unsigned long long)(total.wake_latency_max_ns[IDLE_MWAIT] / 1000),
+             (unsigned long long)(total.wake_latency_max_ns[IDLE_HLT] / 1000));
+    tty_print(line, 0xFFFFFF);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+
+// ==========================================================================
+// 空闲调节器
+// ==========================================================================
+// 空闲线程没有事可做时调用 cpu_idle。最近几次空闲都很短 (例如网络收发频繁) 时
+// 先开着中断轮询一小段时间，等到的工作不用付 hlt 的退出延迟；轮询窗口按最近
+// 空闲时长的滑动平均自动伸缩。窗口内没有等到工作再进入深度空闲：CPUID 报告
+// MONITOR/MWAIT 时用 MWAIT 监视本 CPU 的 need_resched，否则 hlt。
+// 轮询和 MWAIT 中的 CPU 被其他 CPU 唤醒时只需写 need_resched，不用发 IPI。
+
+enum idle_state : uint8_t {
+    IDLE_POLL,
+    IDLE_MWAIT,
+    IDLE_HLT,
+    NR_IDLE_STATES,
+};
+
+#define IDLE_POLL_MIN_NS    2000ull     // 轮询窗口下限
+#define IDLE_POLL_MAX_NS    100000ull   // 默认上限；平均空闲时长超过它时不轮询
+#define IDLE_HIST_BUCKETS   32          // 第 i 格统计 [2^i, 2^(i+1)) 纳秒
+
+// 检测 MONITOR/MWAIT (BSP 上调用一次，AP 上线之前)
+void idle_init();
+bool idle_mwait_supported();
+
+// 空闲循环在关中断、确认没有工作之后调用；返回时已开中断
+void cpu_idle();
+
+// 调度器把线程放到 cpu 上并设置 need_resched 之后调用：记录唤醒时刻，
+// 返回 true 表示 cpu 正在轮询或 MWAIT，会自己看到 need_resched，不需要 IPI
+bool idle_wake_cpu(uint32_t cpu);
+
+// 轮询窗口上限，0 表示关闭轮询
+void idle_set_poll_max_ns(uint64_t ns);
+uint64_t idle_poll_max_ns();
+
+struct idle_cpu_stats {
+    uint64_t entries[NR_IDLE_STATES];
+    uint64_t residency_ns[NR_IDLE_STATES];
+    uint64_t residency_hist[NR_IDLE_STATES][IDLE_HIST_BUCKETS];
+    // 从 idle_wake_cpu 到离开 cpu_idle，按离开时所处的状态分类
+    uint64_t wake_latency_hist[NR_IDLE_STATES][IDLE_HIST_BUCKETS];
+    uint64_t wake_latency_max_ns[NR_IDLE_STATES];
+    uint64_t poll_misses;       // 轮询窗口内没有等到工作，转入深度空闲
+    uint64_t ipis_saved;        // 唤醒时目标在轮询或 MWAIT，省掉了重新调度 IPI
+    uint64_t avg_idle_ns;
+};
+
+void idle_get_cpu_stats(uint32_t cpu, idle_cpu_stats* stats);
+const char* idle_state_name(idle_state state);
+void idle_dump();
@@ -0,0 +1,546 @@
+#include "sched.h"
+#include "idle.h"
+#include "kernel/cpu/smp.h"
+#include "kernel/cpu/isr.h"
+#include "kernel/mem/pmm.h"
+#include "kernel/time/clock.h"
+#include "kernel/time/tick.h"
+#include "kernel/time/hrtimer.h"
+#include "kernel/sync/rcu.h"
+#include "kernel/drivers/tty.h"
+#include "kernel/panic.h"
+#include "kernel/klog.h"
+#include "lib/libc.h"
+
+// ==========================================================================
+// 状态
+// ==========================================================================
+
+// nice -20 .. 19 对应的权重，相邻两级相差约 1.25 倍 (与 Linux 相同)
+static const uint32_t nice_to_weight[40] = {
+    88761, 71755, 56483, 46273, 36291,
+    29154, 23254, 18705, 14949, 11916,
+     9548,  7620,  6100,  4904,  3906,
+     3121,  2501,  1991,  1586,  1277,
+     1024,   820,   655,   526,   423,
+      335,   272,   215,   172,   137,
+      110,    87,    70,    56,    45,
+       36,    29,    23,    18,    15,
+};
+
+struct run_queue {
+    spinlock lock;
+    uint32_t cpu;
+    rb_root_cached tasks;           // 就绪线程，按 vruntime 排序
+    uint32_t nr_running;            // 树里的线程加上正在运行的非空闲线程
+    uint64_t load;                  // 这些线程的权重之和
+    uint64_t min_vruntime;          // 只增不减，新线程和醒来的线程以它为基准
+    thread* curr;
+    thread* idle;
+    uint64_t switches;
+    call_single_data resched_csd;   // 唤醒远端 CPU 用的 IPI
+};
+
+static per_cpu<run_queue> runqueues;
+static thread idle_threads[MAX_CPUS];
+
+static spinlock threads_lock;
+static thread* all_threads = nullptr;
+static volatile uint32_t next_tid = 1;
+
+extern "C" thread* sched_switch_to(thread* prev, thread* next);
+extern "C" void thread_entry_trampoline();
+
+static inline bool irqs_enabled() {
+    uint64_t flags;
+    asm volatile("pushfq; pop %0" : "=r"(flags));
+    return flags & RFLAGS_IF;
+}
+
+static inline void fpu_save(thread* t) {
+    asm volatile("fxsave64 (%0)" :: "r"(t->fpu_state) : "memory");
+}
+
+static inline void fpu_restore(thread* t) {
+    asm volatile("fxrstor64 (%0)" :: "r"(t->fpu_state) : "memory");
+}
+
+static inline thread* rb_thread(rb_node* node) {
+    return rb_entry(node, thread, run_node);
+}
+
+// ==========================================================================
+// 运行队列 (调用者持有 rq->lock)
+// ==========================================================================
+
+static void update_min_vruntime(run_queue* rq) {
+    thread* curr = rq->curr;
+    bool have = false;
+    uint64_t v = 0;
+    if (!curr->idle && curr->state == THREAD_RUNNING) {
+        v = curr->vruntime;
+        have = true;
+    }
+    rb_node* left = rb_first_cached(&rq->tasks);
+    if (left) {
+        uint64_t lv = rb_thread(left)->vruntime;
+        if (!have || (int64_t)(lv - v) < 0) v = lv;
+        have = true;
+    }
+    if (have && (int64_t)(v - rq->min_vruntime) > 0) rq->min_vruntime = v;
+}
+
+// 把当前线程从上次记账到 now 的运行时间折算进 vruntime
+static void update_curr(run_queue* rq, uint64_t now) {
+    thread* curr = rq->curr;
+    if (now <= curr->exec_start_ns) return;
+    uint64_t delta = now - curr->exec_start_ns;
+    curr->exec_start_ns = now;
+    curr->sum_exec_ns += delta;
+    if (curr->idle) return;
+    curr->vruntime += curr->weight == NICE_0_WEIGHT ? delta : delta * NICE_0_WEIGHT / curr->weight;
+    update_min_vruntime(rq);
+}
+
+static void enqueue_tree(run_queue* rq, thread* t) {
+    rb_node** link = &rq->tasks.root.node;
+    rb_node* parent = nullptr;
+    bool leftmost = true;
+    while (*link) {
+        parent = *link;
+        // vruntime 相同的排在后面，先来先运行
+        if ((int64_t)(t->vruntime - rb_thread(parent)->vruntime) < 0) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+            leftmost = false;
+        }
+    }
+    rb_link_node(&t->run_node, parent, link);
+    rb_insert_color_cached(&t->run_node, &rq->tasks, leftmost);
+}
+
+static void dequeue_tree(run_queue* rq, thread* t) {
+    rb_erase_cached(&t->run_node, &rq->tasks);
+}
+
+// 本线程在一个调度周期里应得的时间：周期按就绪线程数伸缩，再按权重分配
+static uint64_t sched_slice(const run_queue* rq, const thread* t) {
+    uint64_t period = SCHED_LATENCY_NS;
+    if (rq->nr_running > SCHED_LATENCY_NS / SCHED_MIN_GRANULARITY_NS) {
+        period = rq->nr_running * SCHED_MIN_GRANULARITY_NS;
+    }
+    uint64_t load = rq->load ? rq->load : t->weight;
+    return period * t->weight / load;
+}
+
+static void resched_ipi(void*) {
+    // 什么都不用做：中断返回路径或空闲循环会看到 need_resched
+}
+
+static void resched_cpu(run_queue* rq) {
+    // 与空闲调节器公布状态配对：先写 need_resched 再读对方是否在轮询
+    __atomic_store_n(&cpu_locals[rq->cpu].need_resched, true, __ATOMIC_SEQ_CST);
+    bool polling = idle_wake_cpu(rq->cpu);
+    if (rq->cpu == smp_processor_id() || polling) return;
+    // 上一个 IPI 还没处理完时它返回前一样会看到 need_resched
+    if (!(__atomic_load_n(&rq->resched_csd.flags, __ATOMIC_ACQUIRE) & CSD_LOCKED)) {
+        smp_call_function_single_async(rq->cpu, &rq->resched_csd);
+    }
+}
+
+// 把新建或醒来的线程放进队列，必要时要求抢占当前线程
+static void activate(run_queue* rq, thread* t) {
+    update_curr(rq, clock_monotonic_ns());
+    // 睡了很久的线程最多领先半个周期，既能尽快运行又不会长期霸占 CPU
+    uint64_t floor = rq->min_vruntime - SCHED_LATENCY_NS / 2;
+    if ((int64_t)(t->vruntime - floor) < 0) t->vruntime = floor;
+
+    t->state = THREAD_READY;
+    enqueue_tree(rq, t);
+    rq->nr_running++;
+    rq->load += t->weight;
+
+    thread* curr = rq->curr;
+    if (curr->idle || (int64_t)(curr->vruntime - t->vruntime) > (int64_t)SCHED_WAKEUP_GRAN_NS) {
+        resched_cpu(rq);
+    }
+}
+
+// ==========================================================================
+// 切换
+// ==========================================================================
+
+static void thread_reap(thread* t) {
+    uint64_t flags = spin_lock_irqsave(&threads_lock);
+    for (thread** pp = &all_threads; *pp; pp = &(*pp)->all_next) {
+        if (*pp == t) {
+            *pp = t->all_next;
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&threads_lock, flags);
+    buddy_free(t, THREAD_STACK_SIZE);
+}
+
+// 切换完成后在新线程上执行：放掉切换前拿的队列锁，回收已退出的上一个线程
+static void finish_switch(thread* last) {
+    fpu_restore(current_thread());
+    spin_unlock(&runqueues->lock);
+    if (last->state == THREAD_DEAD) thread_reap(last);
+}
+
+// 调用者已关中断
+static void __schedule(bool preempt) {
+    cpu_local* cpu = this_cpu();
+    thread* prev = cpu->current;
+    run_queue* rq = &runqueues.get();
+
+    if (!prev->idle && prev->stack_magic != THREAD_STACK_MAGIC) {
+        kernel_panic(nullptr, "kernel thread stack overflow");
+    }
+    // 切换线程时不可能处在 RCU 读侧临界区里
+    rcu_note_context_switch();
+
+    spin_lock(&rq->lock);
+    cpu->need_resched = false;
+    uint64_t now = clock_monotonic_ns();
+    update_curr(rq, now);
+
+    if (!prev->idle) {
+        if (prev->state == THREAD_RUNNING) {
+            prev->state = THREAD_READY;
+            enqueue_tree(rq, prev);
+        } else if (preempt) {
+            // 设了 SLEEPING 还没走到自己的 schedule() 就被抢占：这时唤醒可能已经发生过，
+            // 定时器也可能还没设好，不能就此拿下队列。状态不动，重新被选中后由它
+            // 随后的 schedule() 决定是真的睡下还是发现已被唤醒
+            prev->preempted_asleep = true;
+            enqueue_tree(rq, prev);
+        } else {
+            // 睡眠或退出：不再计入负载
+            rq->nr_running--;
+            rq->load -= prev->weight;
+        }
+    }
+
+    rb_node* left = rb_first_cached(&rq->tasks);
+    thread* next = left ? rb_thread(left) : rq->idle;
+    if (left) dequeue_tree(rq, next);
+    if (next->preempted_asleep) {
+        next->preempted_asleep = false;
+    } else {
+        next->state = THREAD_RUNNING;
+    }
+    next->exec_start_ns = now;
+    next->slice_start_exec_ns = next->sum_exec_ns;
+
+    if (next == prev) {
+        spin_unlock(&rq->lock);
+        return;
+    }
+
+    if (preempt) {
+        prev->preemptions++;
+    } else {
+        prev->voluntary_switches++;
+    }
+    rq->switches++;
+    rq->curr = next;
+    cpu->current = next;
+
+    fpu_save(prev);
+    thread* last = sched_switch_to(prev, next);
+    // prev 重新被选中，从这里继续
+    finish_switch(last);
+}
+
+void schedule() {
+    if (!current_thread()) return;
+    if (preempt_count() != 0 || in_interrupt()) {
+        pr_err("sched: schedule() called from atomic context");
+        current_thread()->state = THREAD_RUNNING;
+        return;
+    }
+    uint64_t flags = local_irq_save();
+    do {
+        __schedule(false);
+    } while (need_resched());
+    local_irq_restore(flags);
+}
+
+void yield() {
+    schedule();
+}
+
+void preempt_schedule() {
+    cpu_local* cpu = this_cpu();
+    if (!cpu->current || cpu->preempt_count || cpu->irq_nesting || !irqs_enabled()) return;
+    uint64_t flags = local_irq_save();
+    do {
+        __schedule(true);
+    } while (need_resched());
+    local_irq_restore(flags);
+}
+
+void preempt_schedule_irq() {
+    cpu_local* cpu = this_cpu();
+    // 空闲线程可能正处于 RCU 扩展静止状态，由空闲循环自己检查 need_resched
+    if (!cpu->current || cpu->current->idle || cpu->preempt_count) return;
+    do {
+        __schedule(true);
+    } while (need_resched());
+}
+
+void sched_tick() {
+    if (!current_thread()) return;
+    run_queue* rq = &runqueues.get();
+    spin_lock(&rq->lock);
+    update_curr(rq, clock_monotonic_ns());
+    thread* curr = rq->curr;
+    if (curr->idle) {
+        if (rb_first_cached(&rq->tasks)) resched_cpu(rq);
+    } else if (rq->nr_running > 1 &&
+               curr->sum_exec_ns - curr->slice_start_exec_ns > sched_slice(rq, curr)) {
+        resched_cpu(rq);
+    }
+    spin_unlock(&rq->lock);
+}
+
+bool thread_wake(thread* t) {
+    run_queue* rq = &runqueues.on(t->cpu);
+    uint64_t flags = spin_lock_irqsave(&rq->lock);
+    bool woke = t->state == THREAD_SLEEPING;
+    if (woke) {
+        if (rq->curr == t) {
+            // 已经设了 SLEEPING 但还没切走：让它继续运行即可
+            t->state = THREAD_RUNNING;
+        } else if (t->preempted_asleep) {
+            // 被抢占时还在树里：改成就绪，选中时照常变成 RUNNING
+            t->preempted_asleep = false;
+            t->state = THREAD_READY;
+        } else {
+            activate(rq, t);
+        }
+    }
+    spin_unlock_irqrestore(&rq->lock, flags);
+    return woke;
+}
+
+// ==========================================================================
+// 线程
+// ==========================================================================
+
+extern "C" void thread_bootstrap(thread* last) {
+    finish_switch(last);
+    asm volatile("sti");
+    thread* self = current_thread();
+    self->entry(self->arg);
+    thread_exit();
+}
+
+void thread_exit() {
+    asm volatile("cli");
+    current_thread()->state = THREAD_DEAD;
+    __schedule(false);
+    // 不会回到这里
+    for (;;) asm volatile("hlt");
+}
+
+static void thread_link(thread* t) {
+    uint64_t flags = spin_lock_irqsave(&threads_lock);
+    t->all_next = all_threads;
+    all_threads = t;
+    spin_unlock_irqrestore(&threads_lock, flags);
+}
+
+// 负载最轻的 CPU；没有自己节拍的 AP 不能做时间片轮转，只接受指定了 CPU 的线程
+static uint32_t sched_select_cpu() {
+    uint32_t best = 0;
+    uint32_t best_load = ~0u;
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (!cpu_online(cpu) || !runqueues.on(cpu).idle) continue;
+        if (cpu != 0 && !tick_cpu_enabled(cpu)) continue;
+        uint32_t load = __atomic_load_n(&runqueues.on(cpu).nr_running, __ATOMIC_RELAXED);
+        if (load < best_load) {
+            best = cpu;
+            best_load = load;
+        }
+    }
+    return best;
+}
+
+thread* thread_create_on(int cpu, const char* name, thread_fn entry, void* arg) {
+    if (cpu < 0) {
+        cpu = (int)sched_select_cpu();
+    } else if (cpu >= MAX_CPUS || !cpu_online(cpu) || !runqueues.on(cpu).idle) {
+        return nullptr;
+    }
+
+    thread* t = (thread*)buddy_alloc(THREAD_STACK_SIZE);
+    if (!t) {
+        pr_err("sched: no memory for thread %s", name);
+        return nullptr;
+    }
+    memset(t, 0, sizeof(*t));
+    t->tid = __atomic_fetch_add(&next_tid, 1, __ATOMIC_RELAXED);
+    strncpy(t->name, name, THREAD_NAME_LEN - 1);
+    t->cpu = (uint32_t)cpu;
+    t->weight = NICE_0_WEIGHT;
+    t->entry = entry;
+    t->arg = arg;
+    t->stack_magic = THREAD_STACK_MAGIC;
+    // 新线程从创建者当前的 FPU/SSE 状态开始 (控制字和 MXCSR 都是内核的默认值)
+    fpu_save(t);
+
+    // 伪造一个 sched_switch_to 保存的现场：6 个被调用者保存寄存器，返回地址是入口跳板
+    uint64_t* sp = (uint64_t*)((uint8_t*)t + THREAD_STACK_SIZE);
+    *--sp = (uint64_t)thread_entry_trampoline;
+    for (int i = 0; i < 6; i++) *--sp = 0;
+    t->rsp = (uint64_t)sp;
+
+    thread_link(t);
+
+    run_queue* rq = &runqueues.on(cpu);
+    uint64_t flags = spin_lock_irqsave(&rq->lock);
+    t->vruntime = rq->min_vruntime;
+    activate(rq, t);
+    spin_unlock_irqrestore(&rq->lock, flags);
+    return t;
+}
+
+thread* thread_create(const char* name, thread_fn entry, void* arg) {
+    return thread_create_on(-1, name, entry, arg);
+}
+
+void thread_set_nice(thread* t, int nice) {
+    if (nice < NICE_MIN) nice = NICE_MIN;
+    if (nice > NICE_MAX) nice = NICE_MAX;
+    run_queue* rq = &runqueues.on(t->cpu);
+    uint64_t flags = spin_lock_irqsave(&rq->lock);
+    uint32_t weight = nice_to_weight[nice - NICE_MIN];
+    // 在队列里的线程 (就绪或正在运行) 同时调整队列的总负载
+    if (!t->idle && (t->state == THREAD_READY || t->state == THREAD_RUNNING || t->preempted_asleep)) {
+        rq->load = rq->load - t->weight + weight;
+    }
+    t->nice = nice;
+    t->weight = weight;
+    spin_unlock_irqrestore(&rq->lock, flags);
+}
+
+struct sleeper {
+    hrtimer timer;
+    thread* t;
+};
+
+static hrtimer_restart sleeper_wake(hrtimer* timer) {
+    thread_wake(((sleeper*)timer)->t);
+    return HRTIMER_NORESTART;
+}
+
+void thread_sleep_ns(uint64_t ns) {
+    uint64_t deadline = clock_monotonic_ns() + ns;
+    thread* self = current_thread();
+    if (!self || self->idle) {
+        // 空闲线程不能睡眠 (启动阶段的 kmain 也是空闲线程)
+        while (clock_monotonic_ns() < deadline) cpu_relax();
+        return;
+    }
+    sleeper s;
+    hrtimer_init(&s.timer, sleeper_wake);
+    s.t = self;
+    while (clock_monotonic_ns() < deadline) {
+        set_current_state(THREAD_SLEEPING);
+        if (!hrtimer_start(&s.timer, deadline)) {
+            set_current_state(THREAD_RUNNING);
+            yield();
+            continue;
+        }
+        schedule();
+        hrtimer_cancel(&s.timer);
+    }
+}
+
+// ==========================================================================
+// 初始化
+// ==========================================================================
+
+static void sched_init_cpu(uint32_t cpu) {
+    run_queue* rq = &runqueues.on(cpu);
+    spin_lock_init(&rq->lock, "runqueue");
+    rq->cpu = cpu;
+    rq->tasks.root.node = nullptr;
+    rq->tasks.leftmost = nullptr;
+    rq->resched_csd.func = resched_ipi;
+    rq->resched_csd.info = nullptr;
+
+    // 当前上下文 (BSP 的 kmain、AP 的 ap_main) 就是本 CPU 的空闲线程，栈由启动代码提供
+    thread* idle = &idle_threads[cpu];
+    snprintf(idle->name, sizeof(idle->name), "idle/%u", cpu);
+    idle->idle = true;
+    idle->cpu = cpu;
+    idle->weight = NICE_0_WEIGHT;
+    idle->state = THREAD_RUNNING;
+    idle->exec_start_ns = clock_monotonic_ns();
+    thread_link(idle);
+
+    rq->curr = idle;
+    __atomic_store_n(&rq->idle, idle, __ATOMIC_RELEASE);
+    cpu_locals[cpu].current = idle;
+}
+
+void sched_init() {
+    spin_lock_init(&threads_lock, "threads");
+    sched_init_cpu(0);
+}
+
+void sched_init_ap(uint32_t cpu) {
+    sched_init_cpu(cpu);
+}
+
+// ==========================================================================
+// 统计
+// ==========================================================================
+
+void sched_get_cpu_stats(uint32_t cpu, sched_cpu_stats* stats) {
+    run_queue* rq = &runqueues.on(cpu);
+    uint64_t flags = spin_lock_irqsave(&rq->lock);
+    stats->nr_running = rq->nr_running;
+    stats->switches = rq->switches;
+    stats->idle_ns = rq->idle ? rq->idle->sum_exec_ns : 0;
+    stats->min_vruntime = rq->min_vruntime;
+    spin_unlock_irqrestore(&rq->lock, flags);
+}
+
+static const char* const state_names[] = { "run", "ready", "sleep", "dead" };
+
+void sched_dump() {
+    tty_print("\nCPU  running   switches    idle ms  current\n", 0xFFFF00);
+    char line[112];
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        run_queue* rq = &runqueues.on(cpu);
+        if (!cpu_online(cpu) || !rq->idle) continue;
+        sched_cpu_stats st;
+        sched_get_cpu_stats(cpu, &st);
+        snprintf(line, sizeof(line), "%3u %8u %10llu %10llu  %s\n", cpu, st.nr_running,
+                 (unsigned long long)st.switches, (unsigned long long)(st.idle_ns / 1000000),
+                 rq->curr->name);
+        tty_print(line, 0xFFFFFF);
+    }
+
+    tty_print("\n TID CPU STATE  NICE  vruntime ms  runtime ms    vol   invol  NAME\n", 0xFFFF00);
+    // 持锁期间线程不会被回收；输出先写进缓冲区，打印时已经放掉了锁
+    static char buf[4096];
+    size_t len = 0;
+    uint64_t flags = spin_lock_irqsave(&threads_lock);
+    for (thread* t = all_threads; t && len + 112 < sizeof(buf); t = t->all_next) {
+        len += snprintf(buf + len, sizeof(buf) - len, "%4u %3u %-6s %4d %12llu %11llu %6llu %7llu  %s\n",
+                        t->tid, t->cpu, state_names[t->state], t->nice,
+                        (unsigned long long)(t->vruntime / 1000000),
+                        (unsigned long long)(t->sum_exec_ns / 1000000),
+                        (unsigned long long)t->voluntary_switches,
+                        (unsigned long long)t->preemptions, t->name);
+    }
+    spin_unlock_irqrestore(&threads_lock, flags);
+    tty_print(buf, 0xFFFFFF);
+}
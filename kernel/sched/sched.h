@@ -0,0 +1,161 @@
+#pragma once
+#include <stdint.h>
+#include "kernel/cpu/percpu.h"
+#include "kernel/sync/spinlock.h"
+#include "lib/rbtree.h"
+
+// ==========================================================================
+// 内核线程与调度器
+// ==========================================================================
+// 每个 CPU 一个运行队列，按 CFS 的思路做公平调度：每个线程累计按权重折算的
+// 虚拟运行时间 (vruntime)，就绪线程按 vruntime 排在红黑树里，总是挑最小的运行。
+// 节拍中断检查当前线程是否用完了自己的时间片，需要切换时设置 need_resched，
+// 在最外层中断返回或 preempt_enable 时真正切换。正在运行的线程不在树里。
+//
+// 线程在创建时放到负载最轻的 CPU 上，之后不再迁移。每个 CPU 的空闲线程就是
+// 它的启动上下文 (BSP 是 kmain，AP 是 ap_main)，不参与公平调度。
+// 线程结构放在自己内核栈的最低处，栈和结构一起从 buddy 分配器申请。
+
+#define THREAD_STACK_SIZE   16384
+#define THREAD_NAME_LEN     16
+#define THREAD_STACK_MAGIC  0x57AC4D4A1C0FFEE5ull
+
+#define NICE_MIN            (-20)
+#define NICE_MAX            19
+#define NICE_0_WEIGHT       1024
+
+#define SCHED_LATENCY_NS        6000000ull  // 所有就绪线程各运行一次的目标周期
+#define SCHED_MIN_GRANULARITY_NS 750000ull  // 时间片下限
+#define SCHED_WAKEUP_GRAN_NS    1000000ull  // 被唤醒线程领先这么多才抢占当前线程
+
+#define RFLAGS_IF           (1u << 9)
+
+enum thread_state : uint8_t {
+    THREAD_RUNNING,     // 正在某个 CPU 上运行
+    THREAD_READY,       // 在运行队列的红黑树里
+    THREAD_SLEEPING,    // 等待 thread_wake
+    THREAD_DEAD,        // 已退出，切走之后由下一个线程回收
+};
+
+typedef void (*thread_fn)(void* arg);
+
+struct thread {
+    uint64_t rsp;                       // 切走时的栈指针 (switch.asm 依赖它在偏移 0)
+    alignas(16) uint8_t fpu_state[512]; // fxsave 区域
+    uint32_t tid;
+    char name[THREAD_NAME_LEN];
+    volatile thread_state state;
+    bool idle;
+    bool preempted_asleep;              // 设了 SLEEPING 后还没主动切走就被抢占，仍在运行队列的树里
+    uint32_t cpu;                       // 所属运行队列
+    int nice;
+    uint32_t weight;
+
+    uint64_t vruntime;
+    uint64_t exec_start_ns;             // 本次开始运行 (或上次记账) 的时刻
+    uint64_t sum_exec_ns;
+    uint64_t slice_start_exec_ns;       // 被选中运行时的 sum_exec_ns，用来判断时间片是否用完
+    uint64_t voluntary_switches;
+    uint64_t preemptions;
+    rb_node run_node;
+
+    thread_fn entry;
+    void* arg;
+    thread* all_next;                   // 全部线程链表 (ps 使用)
+    uint64_t stack_magic;               // 栈溢出时首先被覆盖
+};
+
+void sched_init();
+// AP 上线时调用：把当前上下文登记为本 CPU 的空闲线程
+void sched_init_ap(uint32_t cpu);
+
+// 创建线程并放入运行队列；cpu 为 -1 时选负载最轻的 CPU。失败返回 nullptr
+thread* thread_create(const char* name, thread_fn entry, void* arg);
+thread* thread_create_on(int cpu, const char* name, thread_fn entry, void* arg);
+[[noreturn]] void thread_exit();
+void thread_set_nice(thread* t, int nice);
+
+static inline thread* current_thread() {
+    return this_cpu()->current;
+}
+
+// 让出 CPU：当前线程状态不是 RUNNING (例如已设为 SLEEPING) 时不再放回运行队列。
+// 只有主动调用 schedule() 才会睡下；抢占总是把线程放回队列，状态留给它自己处理
+void schedule();
+// 当前线程是 RUNNING 时重新排队，给其他线程运行的机会
+void yield();
+// 把睡眠中的线程放回运行队列；返回它之前是否在睡眠
+bool thread_wake(thread* t);
+
+static inline void set_current_state(thread_state state) {
+    __atomic_store_n(&current_thread()->state, state, __ATOMIC_SEQ_CST);
+}
+
+static inline bool need_resched() {
+    return this_cpu()->need_resched;
+}
+
+// 睡眠至少 ns 纳秒 (高精度定时器唤醒)
+void thread_sleep_ns(uint64_t ns);
+static inline void msleep(uint64_t ms) {
+    thread_sleep_ns(ms * 1000000ull);
+}
+
+// 节拍中断里调用：记账并判断时间片是否用完
+void sched_tick();
+// isr_handler 在最外层中断返回前调用 (关中断，被打断的上下文开着中断)
+void preempt_schedule_irq();
+
+// ==========================================================================
+// 等待队列
+// ==========================================================================
+// 条件不满足时睡眠，条件可能改变的一方调用 wake_up：
+//   wait_event(queue, data_ready);          // 线程
+//   data_ready = true; wake_up(&queue);     // 任意上下文，包括中断处理函数
+// 先设 SLEEPING 再检查条件、唤醒方先改条件再唤醒，两者之间不会丢失唤醒。
+// 等待队列里有锁，锁会登记到 lockstat，所以等待队列必须是长期存在的对象。
+
+struct wait_queue_entry {
+    thread* t;
+    wait_queue_entry* next;
+    bool queued;
+};
+
+struct wait_queue {
+    spinlock lock;
+    wait_queue_entry* head;
+};
+
+void wait_queue_init(wait_queue* wq, const char* name);
+// 挂上等待队列并把当前线程设为 SLEEPING
+void prepare_to_wait(wait_queue* wq, wait_queue_entry* entry);
+// 恢复 RUNNING 并从队列里摘下 (已被 wake_up 摘下时什么都不做)
+void finish_wait(wait_queue* wq, wait_queue_entry* entry);
+// 唤醒所有等待者
+void wake_up(wait_queue* wq);
+
+#define wait_event(wq, condition)                       \
+    do {                                                \
+        wait_queue_entry __wait = { current_thread(), nullptr, false }; \
+        for (;;) {                                      \
+            prepare_to_wait(&(wq), &__wait);            \
+            if (condition) break;                       \
+            schedule();                                 \
+        }                                               \
+        finish_wait(&(wq), &__wait);                    \
+    } while (0)
+
+// ==========================================================================
+// 统计
+// ==========================================================================
+
+struct sched_cpu_stats {
+    uint32_t nr_running;        // 就绪和正在运行的线程 (不含空闲线程)
+    uint64_t switches;
+    uint64_t idle_ns;           // 空闲线程运行的时间
+    uint64_t min_vruntime;
+};
+
+void sched_get_cpu_stats(uint32_t cpu, sched_cpu_stats* stats);
+// 打印每个 CPU 的运行队列和全部线程
+void sched_dump();
@@ -0,0 +1,34 @@
+[bits 64]
+
+section .text
+
+; thread* sched_switch_to(thread* prev, thread* next)
+; 保存 prev 的被调用者保存寄存器和栈指针，切到 next 的栈上恢复。
+; 返回到 next 上次切走的地方时，rax 是切换到它的那个线程 (即这里的 prev)。
+global sched_switch_to
+sched_switch_to:
+    push rbx
+    push rbp
+    push r12
+    push r13
+    push r14
+    push r15
+    mov [rdi], rsp          ; thread::rsp 在偏移 0
+    mov rsp, [rsi]
+    pop r15
+    pop r14
+    pop r13
+    pop r12
+    pop rbp
+    pop rbx
+    mov rax, rdi
+    ret
+
+; 新线程第一次被切换到时从这里开始：rax 是上一个线程
+extern thread_bootstrap
+global thread_entry_trampoline
+thread_entry_trampoline:
+    mov rdi, rax
+    xor rbp, rbp            ; 栈回溯到这里终止
+    call thread_bootstrap
+    ud2
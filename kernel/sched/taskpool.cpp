@@ -0,0 +1,455 @@
+#include "taskpool.h"
+#include "sched.h"
+#include "kernel/cpu/smp.h"
+#include "kernel/mem/pmm.h"
+#include "kernel/drivers/tty.h"
+#include "kernel/klog.h"
+#include "lib/libc.h"
+
+// ==========================================================================
+// Chase-Lev 双端队列
+// ==========================================================================
+// 固定容量的环形数组，不扩容：队列满时任务直接在提交者里执行。
+// 所有者只动 bottom，窃取者只用 CAS 推进 top；只剩最后一个任务时所有者也用
+// CAS 和窃取者竞争。
+
+#define TASK_DEQUE_SIZE     1024
+#define TASK_SPIN_ROUNDS    256     // 睡眠前空转重试的次数
+#define TASK_MAX_CHUNKS     1024    // parallel_* 最多切成这么多块
+
+struct worker {
+    alignas(CACHE_LINE_SIZE) volatile int64_t top;
+    alignas(CACHE_LINE_SIZE) volatile int64_t bottom;
+    task* volatile buf[TASK_DEQUE_SIZE];
+    uint32_t index;
+    uint32_t cpu;
+    uint32_t seed;                  // 选择窃取对象的 xorshift 状态
+    thread* kthread;
+    taskpool_worker_stats stats;
+};
+
+static worker* workers[MAX_CPUS];
+static uint32_t nr_workers = 0;
+static volatile uint32_t active_workers = 0;
+static per_cpu<worker*> cpu_workers;
+
+static spinlock inject_lock;
+static task* inject_head = nullptr;
+static task* inject_tail = nullptr;
+
+static volatile uint32_t idle_workers = 0;
+static volatile uint64_t serial_fallbacks = 0;    // 因内存不足退回串行的 parallel_for/parallel_reduce
+static wait_queue pool_wait;        // 空闲的工作线程
+static wait_queue join_wait;        // 非工作线程在 task_wait 里等待
+
+static bool deque_push(worker* w, task* t) {
+    int64_t b = w->bottom;
+    int64_t top = __atomic_load_n(&w->top, __ATOMIC_ACQUIRE);
+    if (b - top >= TASK_DEQUE_SIZE) return false;
+    w->buf[b & (TASK_DEQUE_SIZE - 1)] = t;
+    __atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static task* deque_pop(worker* w) {
+    int64_t b = w->bottom - 1;
+    __atomic_store_n(&w->bottom, b, __ATOMIC_RELAXED);
+    // 先公布新的 bottom 再读 top，与 deque_steal 的先读 top 再读 bottom 配对
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&w->top, __ATOMIC_RELAXED);
+    if (top > b) {
+        __atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELAXED);
+        return nullptr;
+    }
+    task* t = w->buf[b & (TASK_DEQUE_SIZE - 1)];
+    if (top == b) {
+        // 最后一个任务：和窃取者抢
+        if (!__atomic_compare_exchange_n(&w->top, &top, top + 1, false,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            t = nullptr;
+        }
+        __atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+    return t;
+}
+
+static task* deque_steal(worker* w) {
+    int64_t top = __atomic_load_n(&w->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t b = __atomic_load_n(&w->bottom, __ATOMIC_ACQUIRE);
+    if (top >= b) return nullptr;
+    task* t = w->buf[top & (TASK_DEQUE_SIZE - 1)];
+    if (!__atomic_compare_exchange_n(&w->top, &top, top + 1, false,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return nullptr;
+    }
+    return t;
+}
+
+static inline bool deque_empty(const worker* w) {
+    return __atomic_load_n(&w->bottom, __ATOMIC_ACQUIRE) <= __atomic_load_n(&w->top, __ATOMIC_ACQUIRE);
+}
+
+// ==========================================================================
+// 调度
+// ==========================================================================
+
+// 当前线程是本 CPU 的工作线程时返回它 (线程不迁移，读本 CPU 的副本是安全的)
+static worker* current_worker() {
+    if (!nr_workers) return nullptr;
+    worker* w = cpu_workers.get();
+    return w && w->kthread == current_thread() ? w : nullptr;
+}
+
+static void inject_push(task* t) {
+    t->next = nullptr;
+    uint64_t flags = spin_lock_irqsave(&inject_lock);
+    if (inject_tail) {
+        inject_tail->next = t;
+    } else {
+        inject_head = t;
+    }
+    inject_tail = t;
+    spin_unlock_irqrestore(&inject_lock, flags);
+}
+
+static task* inject_pop() {
+    if (!__atomic_load_n(&inject_head, __ATOMIC_ACQUIRE)) return nullptr;
+    uint64_t flags = spin_lock_irqsave(&inject_lock);
+    task* t = inject_head;
+    if (t) {
+        inject_head = t->next;
+        if (!inject_head) inject_tail = nullptr;
+    }
+    spin_unlock_irqrestore(&inject_lock, flags);
+    return t;
+}
+
+static inline bool worker_active(const worker* w) {
+    return w->index < __atomic_load_n(&active_workers, __ATOMIC_RELAXED);
+}
+
+// 缩小活动集合时，被停用的工作线程队列里可能还有任务：它自己先把队列做完再睡，
+// 活动的工作线程也会从所有工作线程 (不只是活动的) 那里窃取，task_wait 不会永远等下去
+static bool pool_has_work(const worker* w) {
+    if (!deque_empty(w)) return true;
+    if (!worker_active(w)) return false;
+    if (__atomic_load_n(&inject_head, __ATOMIC_ACQUIRE)) return true;
+    for (uint32_t i = 0; i < nr_workers; i++) {
+        if (!deque_empty(workers[i])) return true;
+    }
+    return false;
+}
+
+static task* find_task(worker* w) {
+    task* t = deque_pop(w);
+    if (t) return t;
+    if (!worker_active(w)) return nullptr;
+
+    t = inject_pop();
+    if (t) {
+        w->stats.injected++;
+        return t;
+    }
+
+    // 从随机位置开始把其他工作线程扫一圈 (包括已停用的，它们的队列里可能还有任务)
+    uint32_t n = nr_workers;
+    if (n > 1) {
+        w->seed ^= w->seed << 13;
+        w->seed ^= w->seed >> 17;
+        w->seed ^= w->seed << 5;
+        uint32_t start = w->seed % n;
+        for (uint32_t i = 0; i < n; i++) {
+            worker* victim = workers[(start + i) % n];
+            if (victim == w) continue;
+            t = deque_steal(victim);
+            if (t) {
+                w->stats.stolen++;
+                return t;
+            }
+        }
+    }
+    w->stats.steal_failures++;
+    return nullptr;
+}
+
+static void run_task(task* t) {
+    task_group* g = t->group;
+    t->func(t);
+    // 减到 0 之后等待者随时可能返回并释放 g，不能再访问它
+    if (__atomic_sub_fetch(&g->pending, 1, __ATOMIC_ACQ_REL) == 0) wake_up(&join_wait);
+}
+
+static void wake_workers() {
+    // 与 worker_main 里 idle_workers++ 之后重新检查队列配对，两边至少有一方看到对方
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&idle_workers, __ATOMIC_RELAXED)) wake_up(&pool_wait);
+}
+
+void task_spawn(task_group* g, task* t, task_fn func) {
+    t->func = func;
+    t->group = g;
+    __atomic_add_fetch(&g->pending, 1, __ATOMIC_RELAXED);
+
+    worker* w = current_worker();
+    if (w) {
+        if (!deque_push(w, t)) {
+            run_task(t);
+            return;
+        }
+    } else {
+        inject_push(t);
+    }
+    wake_workers();
+}
+
+void task_wait(task_group* g) {
+    worker* w = current_worker();
+    if (!w) {
+        wait_event(join_wait, __atomic_load_n(&g->pending, __ATOMIC_ACQUIRE) == 0);
+        return;
+    }
+    // 工作线程不能睡：组里的任务可能就在自己的队列里
+    while (__atomic_load_n(&g->pending, __ATOMIC_ACQUIRE)) {
+        task* t = find_task(w);
+        if (t) {
+            w->stats.executed++;
+            run_task(t);
+        } else {
+            cpu_relax();
+        }
+    }
+}
+
+static void worker_main(void* arg) {
+    worker* w = (worker*)arg;
+    for (;;) {
+        task* t = find_task(w);
+        if (t) {
+            w->stats.executed++;
+            run_task(t);
+            continue;
+        }
+        bool found = false;
+        for (int i = 0; i < TASK_SPIN_ROUNDS && !found; i++) {
+            cpu_relax();
+            found = pool_has_work(w);
+        }
+        if (found) continue;
+
+        __atomic_add_fetch(&idle_workers, 1, __ATOMIC_SEQ_CST);
+        w->stats.sleeps++;
+        wait_event(pool_wait, pool_has_work(w));
+        __atomic_sub_fetch(&idle_workers, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+// ==========================================================================
+// parallel_for / parallel_reduce
+// ==========================================================================
+
+struct range_ctx {
+    task_group group;
+    uint64_t begin;
+    uint64_t grain;
+    parallel_for_fn fn;
+    parallel_map_fn map;
+    void* arg;
+    uint64_t* results;          // parallel_reduce：每块的 map 结果，按块号存放
+    struct range_task* tasks;
+    volatile uint32_t next_task;
+};
+
+struct range_task {
+    task t;
+    range_ctx* ctx;
+    uint64_t lo;
+    uint64_t hi;
+};
+
+static void range_run_chunk(range_ctx* ctx, uint64_t lo, uint64_t hi) {
+    if (ctx->map) {
+        ctx->results[(lo - ctx->begin) / ctx->grain] = ctx->map(lo, hi, ctx->arg);
+    } else {
+        ctx->fn(lo, hi, ctx->arg);
+    }
+}
+
+// 每次把右半边 (按 grain 对齐) 交给别人，自己继续处理左半边，直到只剩一块
+static void range_run(task* t) {
+    range_task* rt = task_entry(t, range_task, t);
+    range_ctx* ctx = rt->ctx;
+    uint64_t lo = rt->lo;
+    uint64_t hi = rt->hi;
+    while (hi - lo > ctx->grain) {
+        uint64_t chunks = (hi - lo + ctx->grain - 1) / ctx->grain;
+        uint64_t mid = lo + chunks / 2 * ctx->grain;
+        // 每次拆分正好多出一块，任务数等于块数，不会越界
+        range_task* right = &ctx->tasks[__atomic_fetch_add(&ctx->next_task, 1, __ATOMIC_RELAXED)];
+        right->ctx = ctx;
+        right->lo = mid;
+        right->hi = hi;
+        task_spawn(&ctx->group, &right->t, range_run);
+        hi = mid;
+    }
+    range_run_chunk(ctx, lo, hi);
+}
+
+static void range_serial(range_ctx* ctx, uint64_t end) {
+    for (uint64_t lo = ctx->begin; lo < end; lo += ctx->grain) {
+        uint64_t hi = end - lo > ctx->grain ? lo + ctx->grain : end;
+        range_run_chunk(ctx, lo, hi);
+    }
+}
+
+static void range_execute(range_ctx* ctx, uint64_t end, uint64_t chunks) {
+    ctx->tasks = nullptr;
+    if (chunks > 1 && active_workers > 1) {
+        ctx->tasks = (range_task*)buddy_alloc(chunks * sizeof(range_task));
+    }
+    // 单核、只有一块或者分配失败：在调用者里串行执行
+    if (!ctx->tasks) {
+        if (chunks > 1 && active_workers > 1) __atomic_add_fetch(&serial_fallbacks, 1, __ATOMIC_RELAXED);
+        range_serial(ctx, end);
+        return;
+    }
+    task_group_init(&ctx->group);
+    ctx->next_task = 1;
+    range_task* root = &ctx->tasks[0];
+    root->ctx = ctx;
+    root->lo = ctx->begin;
+    root->hi = end;
+    task_spawn(&ctx->group, &root->t, range_run);
+    task_wait(&ctx->group);
+    buddy_free(ctx->tasks, chunks * sizeof(range_task));
+}
+
+// 块数过多时放大 grain，任务数组和结果数组都不超过一个 buddy 块
+static uint64_t range_chunks(uint64_t n, uint64_t* grain) {
+    if (*grain == 0) *grain = 1;
+    uint64_t chunks = (n + *grain - 1) / *grain;
+    if (chunks > TASK_MAX_CHUNKS) {
+        *grain = (n + TASK_MAX_CHUNKS - 1) / TASK_MAX_CHUNKS;
+        chunks = (n + *grain - 1) / *grain;
+    }
+    return chunks;
+}
+
+void parallel_for(uint64_t begin, uint64_t end, uint64_t grain, parallel_for_fn fn, void* arg) {
+    if (end <= begin) return;
+    range_ctx ctx;
+    uint64_t chunks = range_chunks(end - begin, &grain);
+    ctx.begin = begin;
+    ctx.grain = grain;
+    ctx.fn = fn;
+    ctx.map = nullptr;
+    ctx.arg = arg;
+    ctx.results = nullptr;
+    range_execute(&ctx, end, chunks);
+}
+
+uint64_t parallel_reduce(uint64_t begin, uint64_t end, uint64_t grain, uint64_t identity,
+                         parallel_map_fn map, parallel_combine_fn combine, void* arg) {
+    if (end <= begin) return identity;
+    range_ctx ctx;
+    uint64_t chunks = range_chunks(end - begin, &grain);
+    ctx.begin = begin;
+    ctx.grain = grain;
+    ctx.fn = nullptr;
+    ctx.map = map;
+    ctx.arg = arg;
+    ctx.results = (uint64_t*)buddy_alloc(chunks * sizeof(uint64_t));
+    if (!ctx.results) {
+        // 没有结果数组：串行地边算边合并
+        __atomic_add_fetch(&serial_fallbacks, 1, __ATOMIC_RELAXED);
+        uint64_t acc = identity;
+        for (uint64_t lo = begin; lo < end; lo += grain) {
+            uint64_t hi = end - lo > grain ? lo + grain : end;
+            acc = combine(acc, map(lo, hi, arg));
+        }
+        return acc;
+    }
+    range_execute(&ctx, end, chunks);
+    uint64_t acc = identity;
+    for (uint64_t i = 0; i < chunks; i++) acc = combine(acc, ctx.results[i]);
+    buddy_free(ctx.results, chunks * sizeof(uint64_t));
+    return acc;
+}
+
+// ==========================================================================
+// 初始化与统计
+// ==========================================================================
+
+void taskpool_init() {
+    spin_lock_init(&inject_lock, "task_inject");
+    wait_queue_init(&pool_wait, "task_pool");
+    wait_queue_init(&join_wait, "task_join");
+
+    char name[THREAD_NAME_LEN];
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (!cpu_online(cpu)) continue;
+        worker* w = (worker*)buddy_alloc(sizeof(worker));
+        if (!w) break;
+        memset(w, 0, sizeof(*w));
+        w->index = nr_workers;
+        w->cpu = cpu;
+        w->seed = 0x9E3779B9u * (cpu + 1);
+        w->stats.cpu = cpu;
+        // 先登记再创建线程：线程一运行就可能去扫描 workers[]
+        workers[nr_workers] = w;
+        cpu_workers.on(cpu) = w;
+        snprintf(name, sizeof(name), "worker/%u", cpu);
+        w->kthread = thread_create_on((int)cpu, name, worker_main, w);
+        if (!w->kthread) {
+            pr_err("taskpool: cannot start worker on CPU %u", cpu);
+            workers[nr_workers] = nullptr;
+            cpu_workers.on(cpu) = nullptr;
+            buddy_free(w, sizeof(worker));
+            continue;
+        }
+        nr_workers++;
+        __atomic_store_n(&active_workers, nr_workers, __ATOMIC_RELEASE);
+    }
+}
+
+uint32_t taskpool_workers() {
+    return nr_workers;
+}
+
+void taskpool_set_active(uint32_t n) {
+    if (n == 0 || n > nr_workers) n = nr_workers;
+    __atomic_store_n(&active_workers, n, __ATOMIC_RELEASE);
+    // 新加入的工作线程可能正睡着
+    wake_up(&pool_wait);
+}
+
+bool taskpool_get_worker_stats(uint32_t index, taskpool_worker_stats* stats) {
+    if (index >= nr_workers) return false;
+    *stats = workers[index]->stats;
+    return true;
+}
+
+uint64_t taskpool_serial_fallbacks() {
+    return __atomic_load_n(&serial_fallbacks, __ATOMIC_RELAXED);
+}
+
+void taskpool_dump() {
+    tty_print("\nTask pool: ", 0xFFFF00);
+    print_dec(nr_workers, 0x00FFFF);
+    tty_print(" worker(s), ", 0xFFFF00);
+    print_dec(active_workers, 0x00FFFF);
+    tty_print(" active, ", 0xFFFF00);
+    print_dec(taskpool_serial_fallbacks(), 0x00FFFF);
+    tty_print(" serial fallback(s)\n", 0xFFFF00);
+    tty_print("CPU   executed     stolen   injected  steal-miss     sleeps\n", 0xFFFFFF);
+    char line[96];
+    for (uint32_t i = 0; i < nr_workers; i++) {
+        taskpool_worker_stats st;
+        taskpool_get_worker_stats(i, &st);
+        snprintf(line, sizeof(line), "%3u %10llu %10llu %10llu %11llu %10llu\n", st.cpu,
+                 (unsigned long long)st.executed, (unsigned long long)st.stolen,
+                 (unsigned long long)st.injected, (unsigned long long)st.steal_failures,
+                 (unsigned long long)st.sleeps);
+        tty_print(line, 0xFFFFFF);
+    }
+}
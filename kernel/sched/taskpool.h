@@ -0,0 +1,78 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// ==========================================================================
+// 任务池 (fork/join)
+// ==========================================================================
+// 每个在线 CPU 上有一个绑定的工作线程，各自有一个 Chase-Lev 双端队列：
+// 自己在底部压入和弹出 (后进先出，缓存是热的)，空闲的工作线程从随机选中的
+// 其他队列顶部窃取 (取走最老、通常也是最大的任务)。非工作线程提交的任务进
+// 一个加锁的注入队列。
+//
+//   struct job { task t; ... };
+//   task_group g; task_group_init(&g);
+//   task_spawn(&g, &j1.t, job_fn); task_spawn(&g, &j2.t, job_fn);
+//   task_wait(&g);      // 工作线程在等待时继续执行任务，其他线程睡眠
+//
+// 大多数调用者只需要 parallel_for / parallel_reduce：区间按 grain 递归二分，
+// 只有一个 CPU 时直接在调用者里串行执行。
+
+struct task;
+typedef void (*task_fn)(task* t);
+
+struct task {
+    task_fn func;
+    struct task_group* group;
+    task* next;                 // 注入队列
+};
+
+struct task_group {
+    volatile uint32_t pending;  // 已提交但尚未执行完的任务
+};
+
+#define task_entry(ptr, type, member) \
+    ((type*)((char*)(ptr) - offsetof(type, member)))
+
+// 在每个在线 CPU 上创建工作线程 (需要调度器和 AP 都已启动)
+void taskpool_init();
+// 工作线程个数；不超过 1 时 parallel_* 退化为串行
+uint32_t taskpool_workers();
+
+static inline void task_group_init(task_group* g) {
+    g->pending = 0;
+}
+
+// 提交任务；task 在执行完之前必须保持有效
+void task_spawn(task_group* g, task* t, task_fn func);
+// 等待组内所有任务 (包括任务里再提交的) 执行完
+void task_wait(task_group* g);
+
+typedef void (*parallel_for_fn)(uint64_t begin, uint64_t end, void* arg);
+typedef uint64_t (*parallel_map_fn)(uint64_t begin, uint64_t end, void* arg);
+typedef uint64_t (*parallel_combine_fn)(uint64_t a, uint64_t b);
+
+// 对 [begin, end) 的每个长度不超过 grain 的子区间调用 fn (可能在不同 CPU 上并发)
+void parallel_for(uint64_t begin, uint64_t end, uint64_t grain, parallel_for_fn fn, void* arg);
+// 每个子区间求 map，再按区间顺序用 combine 从 identity 开始合并 (结果与串行一致)
+uint64_t parallel_reduce(uint64_t begin, uint64_t end, uint64_t grain, uint64_t identity,
+                         parallel_map_fn map, parallel_combine_fn combine, void* arg);
+
+// 只让前 n 个工作线程取任务 (测试扩展性用)，0 表示全部
+void taskpool_set_active(uint32_t n);
+
+struct taskpool_worker_stats {
+    uint32_t cpu;
+    uint64_t executed;          // 执行的任务
+    uint64_t stolen;            // 其中从别的队列窃取的
+    uint64_t steal_failures;    // 扫了一圈没有偷到
+    uint64_t injected;          // 其中从注入队列取的
+    uint64_t sleeps;
+};
+
+bool taskpool_get_worker_stats(uint32_t worker, taskpool_worker_stats* stats);
+// 任务数组或结果数组分配失败、只好串行执行的次数
+uint64_t taskpool_serial_fallbacks();
+void taskpool_dump();
+// 把至多 16MiB (不超过空闲内存的一半) 清零，比较串行与 1、2、4…个工作线程的耗时
+void taskpool_benchmark();
@@ -0,0 +1,113 @@
+#include "taskpool.h"
+#include "kernel/mem/pmm.h"
+#include "kernel/time/clock.h"
+#include "kernel/drivers/tty.h"
+#include "lib/libc.h"
+
+// ==========================================================================
+// 页清零的扩展性测试
+// ==========================================================================
+// 从 buddy 分配器拿若干 64KiB 块 (至多 256 块共 16MiB，且不超过空闲内存的一半，
+// 给其他 CPU 的线程栈、网卡收包和 parallel_for 自己的任务数组留出余量)，先填满
+// 0xFF，再按页并行清零。先测串行 memset，再依次只让 1、2、4…个工作线程参与；
+// 最后用 parallel_reduce 数一遍非零的 8 字节字，确认每一页都被清过。
+
+#define BENCH_BLOCK_SIZE    65536
+#define BENCH_BLOCKS        256
+#define BENCH_PAGES_PER_BLOCK (BENCH_BLOCK_SIZE / PAGE_SIZE)
+#define BENCH_GRAIN         16      // 每块 16 页，一个任务清一个 buddy 块
+
+static void* bench_blocks[BENCH_BLOCKS];
+
+static inline uint8_t* bench_page(uint64_t page) {
+    return (uint8_t*)bench_blocks[page / BENCH_PAGES_PER_BLOCK] + (page % BENCH_PAGES_PER_BLOCK) * PAGE_SIZE;
+}
+
+static void bench_fill(uint64_t pages) {
+    for (uint64_t p = 0; p < pages; p++) memset(bench_page(p), 0xFF, PAGE_SIZE);
+}
+
+static void zero_pages(uint64_t begin, uint64_t end, void*) {
+    for (uint64_t p = begin; p < end; p++) memset(bench_page(p), 0, PAGE_SIZE);
+}
+
+static uint64_t count_nonzero(uint64_t begin, uint64_t end, void*) {
+    uint64_t count = 0;
+    for (uint64_t p = begin; p < end; p++) {
+        const uint64_t* words = (const uint64_t*)bench_page(p);
+        for (uint32_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i++) count += words[i] != 0;
+    }
+    return count;
+}
+
+static uint64_t add(uint64_t a, uint64_t b) {
+    return a + b;
+}
+
+static void bench_report(const char* label, uint64_t pages, uint64_t ns, uint64_t serial_ns) {
+    char line[80];
+    uint64_t mb_per_s = ns ? pages * PAGE_SIZE * 1000 / ns : 0;    // 字节/纳秒 * 1000 = MB/s
+    uint64_t speedup = ns ? serial_ns * 100 / ns : 0;
+    snprintf(line, sizeof(line), "  %-10s %8llu.%03llu %8llu %5llu.%02llux\n", label,
+             (unsigned long long)(ns / 1000000), (unsigned long long)(ns / 1000 % 1000),
+             (unsigned long long)mb_per_s,
+             (unsigned long long)(speedup / 100), (unsigned long long)(speedup % 100));
+    tty_print(line, 0xFFFFFF);
+}
+
+void taskpool_benchmark() {
+    uint64_t want = buddy_get_free_pages() / 2 / BENCH_PAGES_PER_BLOCK;
+    if (want > BENCH_BLOCKS) want = BENCH_BLOCKS;
+    uint32_t blocks = 0;
+    while (blocks < want) {
+        void* b = buddy_alloc(BENCH_BLOCK_SIZE);
+        if (!b) break;
+        bench_blocks[blocks++] = b;
+    }
+    if (blocks == 0) {
+        tty_print("\nNo memory for the benchmark.\n", 0xFF6060);
+        return;
+    }
+    uint64_t pages = (uint64_t)blocks * BENCH_PAGES_PER_BLOCK;
+
+    tty_print("\nZeroing ", 0xFFFF00);
+    print_dec(pages * PAGE_SIZE / 1024, 0x00FFFF);
+    tty_print(" KiB with ", 0xFFFF00);
+    print_dec(taskpool_workers(), 0x00FFFF);
+    tty_print(" worker(s)\n", 0xFFFF00);
+    tty_print("  workers          ms     MB/s  speedup\n", 0xFFFFFF);
+
+    bench_fill(pages);
+    uint64_t start = clock_monotonic_ns();
+    zero_pages(0, pages, nullptr);
+    uint64_t serial_ns = clock_monotonic_ns() - start;
+    bench_report("serial", pages, serial_ns, serial_ns);
+
+    uint32_t workers = taskpool_workers();
+    bool ok = true;
+    bool any_fallback = false;
+    // 只有一个工作线程时 parallel_for 走串行路径，这一行就是单核退化的开销
+    for (uint32_t n = 1; n <= workers; n = n < workers && n * 2 > workers ? workers : n * 2) {
+        taskpool_set_active(n);
+        bench_fill(pages);
+        uint64_t fallbacks = taskpool_serial_fallbacks();
+        start = clock_monotonic_ns();
+        parallel_for(0, pages, BENCH_GRAIN, zero_pages, nullptr);
+        uint64_t ns = clock_monotonic_ns() - start;
+        // 任务数组没分配到时这一行测的其实是串行路径
+        bool fell_back = taskpool_serial_fallbacks() != fallbacks;
+        any_fallback |= fell_back;
+
+        char label[16];
+        snprintf(label, sizeof(label), "%u%s", n, fell_back ? "*" : "");
+        bench_report(label, pages, ns, serial_ns);
+        if (parallel_reduce(0, pages, BENCH_GRAIN, 0, count_nonzero, add, nullptr) != 0) ok = false;
+    }
+    taskpool_set_active(0);
+    if (any_fallback) tty_print("  * out of memory for the task array, ran serially\n", 0x808080);
+
+    tty_print(ok ? "  All pages verified zero.\n" : "  Some pages were not zeroed!\n",
+              ok ? 0x00FF00 : 0xFF6060);
+
+    for (uint32_t i = 0; i < blocks; i++) buddy_free(bench_blocks[i], BENCH_BLOCK_SIZE);
+}
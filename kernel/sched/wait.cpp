@@ -0,0 +1,54 @@
+#include "sched.h"
+
+// ==========================================================================
+// 等待队列
+// ==========================================================================
+// 等待项放在等待者的栈上 (wait_event 展开处)，链表只在持锁时修改。
+// wake_up 唤醒后立即把等待项摘下，等待者醒来时就不必再拿锁。
+
+void wait_queue_init(wait_queue* wq, const char* name) {
+    spin_lock_init(&wq->lock, name);
+    wq->head = nullptr;
+}
+
+void prepare_to_wait(wait_queue* wq, wait_queue_entry* entry) {
+    uint64_t flags = spin_lock_irqsave(&wq->lock);
+    if (!entry->queued) {
+        entry->next = wq->head;
+        wq->head = entry;
+        entry->queued = true;
+    }
+    // 在锁内设置：wake_up 要么在这之前 (调用者随后会看到条件成立)，要么会看到 SLEEPING
+    set_current_state(THREAD_SLEEPING);
+    spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+void finish_wait(wait_queue* wq, wait_queue_entry* entry) {
+    set_current_state(THREAD_RUNNING);
+    if (!__atomic_load_n(&entry->queued, __ATOMIC_ACQUIRE)) return;
+    uint64_t flags = spin_lock_irqsave(&wq->lock);
+    if (entry->queued) {
+        for (wait_queue_entry** pp = &wq->head; *pp; pp = &(*pp)->next) {
+            if (*pp == entry) {
+                *pp = entry->next;
+                break;
+            }
+        }
+        entry->queued = false;
+    }
+    spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+void wake_up(wait_queue* wq) {
+    uint64_t flags = spin_lock_irqsave(&wq->lock);
+    wait_queue_entry* entry = wq->head;
+    wq->head = nullptr;
+    while (entry) {
+        wait_queue_entry* next = entry->next;
+        thread_wake(entry->t);
+        // 摘下后等待者随时可能返回并释放这个栈上的等待项，之后不能再访问它
+        __atomic_store_n(&entry->queued, false, __ATOMIC_RELEASE);
+        entry = next;
+    }
+    spin_unlock_irqrestore(&wq->lock, flags);
+}
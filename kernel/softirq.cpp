@@ -0,0 +1,202 @@
+#include "softirq.h"
+#include "cpu/smp.h"
+#include "sched/sched.h"
+#include "time/clock.h"
+#include "klog.h"
+#include "lib/libc.h"
+
+// 一次 do_softirq 最多重新检查这么多轮，防止软中断不断自我触发饿死其他工作
+#define SOFTIRQ_MAX_RESTART 10
+// 同时也不超过这么长时间；之后剩下的交给 ksoftirqd
+#define SOFTIRQ_BUDGET_NS   2000000ull
+
+struct softirq_cpu {
+    volatile uint32_t pending;
+    volatile bool running;
+    thread* ksoftirqd;
+    tasklet* tasklet_head;          // 本 CPU 上挂起的 tasklet (只在关中断时修改)
+    tasklet** tasklet_tail;
+    softirq_cpu_stats stats;
+};
+
+static softirq_action_t actions[NR_SOFTIRQS];
+static per_cpu<softirq_cpu> softirq_cpus;
+static uint64_t counts[NR_SOFTIRQS];
+
+static const char* const names[NR_SOFTIRQS] = { "TIMER", "HRTIMER", "TASKLET", "RCU" };
+
+static inline uint64_t irq_save() {
+    uint64_t flags;
+    asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint64_t flags) {
+    asm volatile("push %0; popfq" :: "r"(flags) : "memory", "cc");
+}
+
+void open_softirq(softirq_nr nr, softirq_action_t action) {
+    actions[nr] = action;
+}
+
+void raise_softirq(softirq_nr nr) {
+    __atomic_fetch_or(&softirq_cpus->pending, 1u << nr, __ATOMIC_RELAXED);
+}
+
+bool softirq_pending() {
+    return softirq_cpus->pending != 0;
+}
+
+static void wakeup_ksoftirqd(softirq_cpu* sc) {
+    if (sc->ksoftirqd) thread_wake(sc->ksoftirqd);
+}
+
+void do_softirq() {
+    uint64_t flags = irq_save();
+    softirq_cpu* sc = &softirq_cpus.get();
+    if (sc->running) {
+        irq_restore(flags);
+        return;
+    }
+    sc->running = true;
+    // 软中断处理函数不会被切走 (与硬件中断处理函数一样属于原子上下文)
+    preempt_disable();
+
+    uint64_t deadline = clock_monotonic_ns() + SOFTIRQ_BUDGET_NS;
+    for (int restart = 0;; restart++) {
+        uint32_t mask = __atomic_exchange_n(&sc->pending, 0, __ATOMIC_ACQ_REL);
+        if (!mask) break;
+        // 软中断期间允许硬件中断嵌套进来
+        asm volatile("sti");
+        for (int nr = 0; nr < NR_SOFTIRQS; nr++) {
+            if ((mask & (1u << nr)) && actions[nr]) {
+                counts[nr]++;
+                actions[nr]();
+            }
+        }
+        asm volatile("cli");
+        if (sc->pending && (restart + 1 >= SOFTIRQ_MAX_RESTART || clock_monotonic_ns() >= deadline)) {
+            // 预算用完：挂起位保留，由 ksoftirqd 在线程上下文里按调度器的节奏继续
+            sc->stats.budget_exhausted++;
+            wakeup_ksoftirqd(sc);
+            break;
+        }
+    }
+
+    preempt_enable_no_resched();
+    sc->running = false;
+    irq_restore(flags);
+}
+
+uint64_t softirq_count(softirq_nr nr) {
+    return counts[nr];
+}
+
+const char* softirq_name(softirq_nr nr) {
+    return names[nr];
+}
+
+void softirq_get_cpu_stats(uint32_t cpu, softirq_cpu_stats* stats) {
+    *stats = softirq_cpus.on(cpu).stats;
+}
+
+// ==========================================================================
+// ksoftirqd
+// ==========================================================================
+
+static void ksoftirqd_main(void*) {
+    softirq_cpu* sc = &softirq_cpus.get();
+    for (;;) {
+        // 先设 SLEEPING 再检查：检查之后挂起的软中断会把线程重新唤醒
+        set_current_state(THREAD_SLEEPING);
+        if (!softirq_pending()) schedule();
+        set_current_state(THREAD_RUNNING);
+
+        while (softirq_pending()) {
+            sc->stats.ksoftirqd_runs++;
+            do_softirq();
+            if (need_resched()) schedule();
+        }
+    }
+}
+
+void ksoftirqd_init() {
+    char name[THREAD_NAME_LEN];
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (!cpu_online(cpu)) continue;
+        snprintf(name, sizeof(name), "ksoftirqd/%u", cpu);
+        thread* t = thread_create_on((int)cpu, name, ksoftirqd_main, nullptr);
+        if (!t) {
+            pr_err("softirq: cannot start %s", name);
+            continue;
+        }
+        __atomic_store_n(&softirq_cpus.on(cpu).ksoftirqd, t, __ATOMIC_RELEASE);
+    }
+}
+
+// ==========================================================================
+// tasklet
+// ==========================================================================
+
+void tasklet_init(tasklet* t, void (*func)(void* data), void* data) {
+    t->next = nullptr;
+    t->state = 0;
+    t->func = func;
+    t->data = data;
+    t->runs = 0;
+}
+
+static void tasklet_enqueue(softirq_cpu* sc, tasklet* t) {
+    t->next = nullptr;
+    *sc->tasklet_tail = t;
+    sc->tasklet_tail = &t->next;
+}
+
+void tasklet_schedule(tasklet* t) {
+    if (__atomic_fetch_or(&t->state, TASKLET_STATE_SCHED, __ATOMIC_ACQ_REL) & TASKLET_STATE_SCHED) return;
+    uint64_t flags = irq_save();
+    tasklet_enqueue(&softirq_cpus.get(), t);
+    raise_softirq(SOFTIRQ_TASKLET);
+    irq_restore(flags);
+}
+
+void tasklet_kill(tasklet* t) {
+    while (__atomic_load_n(&t->state, __ATOMIC_ACQUIRE) & (TASKLET_STATE_SCHED | TASKLET_STATE_RUN)) {
+        yield();
+    }
+}
+
+static void tasklet_action() {
+    softirq_cpu* sc = &softirq_cpus.get();
+    uint64_t flags = irq_save();
+    tasklet* list = sc->tasklet_head;
+    sc->tasklet_head = nullptr;
+    sc->tasklet_tail = &sc->tasklet_head;
+    irq_restore(flags);
+
+    while (list) {
+        tasklet* t = list;
+        list = t->next;
+
+        if (__atomic_fetch_or(&t->state, TASKLET_STATE_RUN, __ATOMIC_ACQUIRE) & TASKLET_STATE_RUN) {
+            // 正在别的 CPU 上运行：放回本 CPU 的队列，下一轮再试
+            flags = irq_save();
+            tasklet_enqueue(sc, t);
+            raise_softirq(SOFTIRQ_TASKLET);
+            irq_restore(flags);
+            continue;
+        }
+        __atomic_fetch_and(&t->state, ~TASKLET_STATE_SCHED, __ATOMIC_ACQ_REL);
+        t->func(t->data);
+        t->runs++;
+        __atomic_fetch_and(&t->state, ~TASKLET_STATE_RUN, __ATOMIC_RELEASE);
+    }
+}
+
+void softirq_init() {
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        softirq_cpu* sc = &softirq_cpus.on(cpu);
+        sc->tasklet_tail = &sc->tasklet_head;
+    }
+    open_softirq(SOFTIRQ_TASKLET, tasklet_action);
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <stdint.h>
+
+// ==========================================================================
+// 软中断
+// ==========================================================================
+// 硬件中断处理函数只做最少的工作，其余部分挂到软中断上，在最外层中断返回前
+// (已发送 EOI、开中断) 或空闲循环里统一执行。每个 CPU 有自己的挂起位图。
+// 一次 do_softirq 有轮数和时间预算，用完后剩下的交给本 CPU 的 ksoftirqd 线程，
+// 中断风暴时软中断不会把普通线程饿死。
+
+enum softirq_nr {
+    SOFTIRQ_TIMER,      // 定时器轮
+    SOFTIRQ_HRTIMER,    // 高精度定时器
+    SOFTIRQ_TASKLET,    // 驱动的 tasklet
+    SOFTIRQ_RCU,        // 推进 RCU 宽限期、执行 call_rcu 回调
+    NR_SOFTIRQS,
+};
+
+typedef void (*softirq_action_t)();
+
+void softirq_init();
+// 在每个在线 CPU 上创建 ksoftirqd 线程 (需要调度器)
+void ksoftirqd_init();
+
+void open_softirq(softirq_nr nr, softirq_action_t action);
+// 标记软中断待执行，可以在任何上下文调用
+void raise_softirq(softirq_nr nr);
+bool softirq_pending();
+// 执行当前 CPU 上所有挂起的软中断；已经在软中断里时直接返回
+void do_softirq();
+
+uint64_t softirq_count(softirq_nr nr);
+const char* softirq_name(softirq_nr nr);
+
+struct softirq_cpu_stats {
+    uint64_t budget_exhausted;  // 预算用完时仍有挂起的软中断
+    uint64_t ksoftirqd_runs;    // ksoftirqd 被唤醒后执行的次数
+};
+
+void softirq_get_cpu_stats(uint32_t cpu, softirq_cpu_stats* stats);
+
+// ==========================================================================
+// tasklet
+// ==========================================================================
+// 挂在 TASKLET 软中断上的一次性回调。同一个 tasklet 同一时刻只在一个 CPU 上
+// 运行 (不同的 tasklet 可以并行)，所以驱动的接收路径不需要自己加锁。
+// 运行前已清除挂起位：回调里可以重新调度自己 (例如收包超出预算时)。
+
+#define TASKLET_STATE_SCHED (1u << 0)   // 已挂在某个 CPU 的队列上
+#define TASKLET_STATE_RUN   (1u << 1)   // 正在某个 CPU 上运行
+
+struct tasklet {
+    tasklet* next;
+    volatile uint32_t state;
+    void (*func)(void* data);
+    void* data;
+    uint64_t runs;
+};
+
+void tasklet_init(tasklet* t, void (*func)(void* data), void* data);
+// 挂到当前 CPU 的队列上；已经挂起时什么都不做。可以在任何上下文调用
+void tasklet_schedule(tasklet* t);
+// 等待 tasklet 既不挂起也不在运行 (线程上下文)
+void tasklet_kill(tasklet* t);
@@ -0,0 +1,52 @@
+#include "lockstat.h"
+#include "kernel/drivers/tty.h"
+#include "lib/libc.h"
+
+static lock_stats* volatile lockstat_list = nullptr;
+
+static const char* const kind_names[] = { "spin", "mcs", "rw", "seq" };
+
+void lockstat_register(lock_stats* stats, const char* name, lock_kind kind) {
+    stats->name = name;
+    stats->kind = kind;
+    stats->acquisitions = 0;
+    stats->contended = 0;
+    stats->wait_cycles = 0;
+    stats->max_wait = 0;
+    // 无锁压栈：登记可能发生在任意 CPU、任意上下文
+    lock_stats* head = __atomic_load_n(&lockstat_list, __ATOMIC_RELAXED);
+    do {
+        stats->next = head;
+    } while (!__atomic_compare_exchange_n(&lockstat_list, &head, stats, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+void lockstat_dump() {
+#if CONFIG_LOCKSTAT
+    tty_print("\nname              kind   acquired    contended      %  avg wait  max wait (cycles)\n", 0xFFFF00);
+    char line[112];
+    for (lock_stats* s = __atomic_load_n(&lockstat_list, __ATOMIC_ACQUIRE); s; s = s->next) {
+        uint64_t acq = s->acquisitions;
+        uint64_t cont = s->contended;
+        // 百分比保留一位小数
+        uint64_t pct10 = acq ? cont * 1000 / acq : 0;
+        uint64_t avg = cont ? s->wait_cycles / cont : 0;
+        snprintf(line, sizeof(line), "%-17s %-5s %9llu %12llu %4llu.%llu %9llu %9llu\n",
+                 s->name, kind_names[s->kind], (unsigned long long)acq, (unsigned long long)cont,
+                 (unsigned long long)(pct10 / 10), (unsigned long long)(pct10 % 10),
+                 (unsigned long long)avg, (unsigned long long)s->max_wait);
+        tty_print(line, cont ? 0xFFAA00 : 0xFFFFFF);
+    }
+#else
+    tty_print("\nlockstat disabled (build with LOCKSTAT=1)\n", 0xFF6060);
+#endif
+}
+
+void lockstat_reset() {
+    for (lock_stats* s = __atomic_load_n(&lockstat_list, __ATOMIC_ACQUIRE); s; s = s->next) {
+        s->acquisitions = 0;
+        s->contended = 0;
+        s->wait_cycles = 0;
+        s->max_wait = 0;
+    }
+}
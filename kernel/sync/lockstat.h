@@ -0,0 +1,56 @@
+#pragma once
+#include <stdint.h>
+
+// ==========================================================================
+// 锁竞争统计
+// ==========================================================================
+// 每把锁内嵌一个 lock_stats，初始化时挂到全局链表上，`lockstat` 命令按链表打印。
+// 统计只在拿到锁之后更新 (读锁除外)，所以不需要额外的原子操作。
+// make LOCKSTAT=0 (即 -DCONFIG_LOCKSTAT=0) 时统计字段和所有计数代码都不会生成。
+
+#ifndef CONFIG_LOCKSTAT
+#define CONFIG_LOCKSTAT 1
+#endif
+
+enum lock_kind : uint8_t {
+    LOCK_SPIN,      // 票据自旋锁
+    LOCK_MCS,       // MCS 排队锁
+    LOCK_RW,        // 读写锁
+    LOCK_SEQ,       // 顺序锁 (写者一侧)
+};
+
+struct lock_stats {
+    const char* name;
+    lock_kind kind;
+    lock_stats* next;
+    uint64_t acquisitions;
+    uint64_t contended;     // 第一次尝试没有拿到锁的次数
+    uint64_t wait_cycles;   // 等锁花掉的 TSC 周期总和
+    uint64_t max_wait;
+};
+
+#if CONFIG_LOCKSTAT
+// 锁结构里的统计字段和统计语句都包在这两个宏里，关闭时不占空间也不生成代码
+#define LOCKSTAT_FIELD          lock_stats stats;
+#define LOCKSTAT(stmt)          do { stmt; } while (0)
+#else
+#define LOCKSTAT_FIELD
+#define LOCKSTAT(stmt)          do {} while (0)
+#endif
+
+// 登记一把锁；同一个 lock_stats 只能登记一次
+void lockstat_register(lock_stats* stats, const char* name, lock_kind kind);
+
+static inline void lockstat_acquired(lock_stats* stats) {
+    stats->acquisitions++;
+}
+
+static inline void lockstat_waited(lock_stats* stats, uint64_t cycles) {
+    stats->contended++;
+    stats->wait_cycles += cycles;
+    if (cycles > stats->max_wait) stats->max_wait = cycles;
+}
+
+// 打印所有已登记的锁 / 把计数清零
+void lockstat_dump();
+void lockstat_reset();
@@ -0,0 +1,286 @@
+#include "rcu.h"
+#include "spinlock.h"
+#include "kernel/cpu/smp.h"
+#include "kernel/cpu/isr.h"
+#include "kernel/softirq.h"
+#include "kernel/time/clock.h"
+#include "kernel/drivers/tty.h"
+#include "kernel/klog.h"
+
+// ==========================================================================
+// 状态
+// ==========================================================================
+// 全局只有一个宽限期状态机，由 rcu_lock 保护：
+//   completed  已结束的宽限期个数
+//   gp_active  是否有宽限期正在进行；进行中时 qs_mask 记录还没经过静止状态的 CPU
+// 宽限期开始时给每个在线 CPU 拍一张 dynticks 快照：偶数 (空闲中) 直接算作静止；
+// 之后只要计数变了 (进出过一次空闲) 也算，这样长时间 hlt 的 AP 不会拖住宽限期。
+
+struct rcu_data {
+    volatile uint64_t dynticks;     // 奇数：活跃；偶数：处于空闲 (扩展静止状态)
+    rcu_head* cb_head;              // 本 CPU 登记的回调，按 gp 递增排列
+    rcu_head** cb_tail;
+    uint64_t cb_count;
+    uint64_t last_gp;               // 最后一个回调需要的宽限期
+};
+
+static per_cpu<rcu_data> rcu_cpus;
+
+static spinlock rcu_lock;
+static volatile uint64_t completed = 0;
+static volatile bool gp_active = false;
+static volatile uint64_t qs_mask = 0;
+static uint64_t dynticks_snap[MAX_CPUS];
+static uint64_t gp_start_ns = 0;
+
+static uint64_t gp_total_ns = 0;
+static uint64_t gp_max_ns = 0;
+static uint64_t fqs_reports = 0;
+static volatile uint64_t queued = 0;
+static volatile uint64_t invoked = 0;
+
+static_assert(MAX_CPUS <= 64, "qs_mask holds one bit per CPU");
+
+// ==========================================================================
+// 宽限期状态机 (调用者持有 rcu_lock)
+// ==========================================================================
+
+static void rcu_gp_end() {
+    uint64_t ns = clock_monotonic_ns() - gp_start_ns;
+    gp_total_ns += ns;
+    if (ns > gp_max_ns) gp_max_ns = ns;
+    __atomic_store_n(&gp_active, false, __ATOMIC_RELEASE);
+    __atomic_store_n(&completed, completed + 1, __ATOMIC_RELEASE);
+}
+
+static void rcu_report_qs_locked(uint32_t cpu) {
+    uint64_t mask = qs_mask & ~(1ull << cpu);
+    qs_mask = mask;
+    if (!mask) rcu_gp_end();
+}
+
+static void rcu_gp_start() {
+    uint64_t mask = 0;
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (!cpu_online(cpu)) continue;
+        uint64_t snap = __atomic_load_n(&rcu_cpus.on(cpu).dynticks, __ATOMIC_ACQUIRE);
+        if (!(snap & 1)) continue;      // 正在空闲，已经是静止状态
+        dynticks_snap[cpu] = snap;
+        mask |= 1ull << cpu;
+    }
+    gp_start_ns = clock_monotonic_ns();
+    qs_mask = mask;
+    __atomic_store_n(&gp_active, true, __ATOMIC_RELEASE);
+    if (!mask) rcu_gp_end();
+}
+
+// 替还没报告的 CPU 检查 dynticks：进入过空闲或正在空闲，都说明它经过了静止状态
+static void rcu_force_qs() {
+    uint64_t mask = qs_mask;
+    for (uint32_t cpu = 0; mask && cpu < MAX_CPUS; cpu++) {
+        if (!(mask & (1ull << cpu))) continue;
+        uint64_t cur = __atomic_load_n(&rcu_cpus.on(cpu).dynticks, __ATOMIC_ACQUIRE);
+        if (!(cur & 1) || cur != dynticks_snap[cpu]) {
+            fqs_reports++;
+            mask &= ~(1ull << cpu);
+            rcu_report_qs_locked(cpu);
+            if (!gp_active) return;
+        }
+    }
+}
+
+// 本 CPU 处于静止状态
+static void rcu_note_qs() {
+    uint32_t cpu = smp_processor_id();
+    if (!__atomic_load_n(&gp_active, __ATOMIC_ACQUIRE)) return;
+    if (!(__atomic_load_n(&qs_mask, __ATOMIC_RELAXED) & (1ull << cpu))) return;
+    uint64_t flags = spin_lock_irqsave(&rcu_lock);
+    if (gp_active && (qs_mask & (1ull << cpu))) rcu_report_qs_locked(cpu);
+    spin_unlock_irqrestore(&rcu_lock, flags);
+}
+
+void rcu_note_context_switch() {
+    rcu_note_qs();
+}
+
+// 本 CPU 最后一个回调需要的宽限期还没开始
+static bool rcu_cpu_needs_gp(const rcu_data* rd) {
+    return rd->cb_head && rd->last_gp > completed + (gp_active ? 1 : 0);
+}
+
+// ==========================================================================
+// 回调
+// ==========================================================================
+
+// 推进宽限期，并执行本 CPU 上已经安全的回调；调用者不在读侧临界区里时顺便报告静止状态
+static void rcu_process(bool quiescent) {
+    rcu_data* rd = &rcu_cpus.get();
+
+    uint64_t flags = spin_lock_irqsave(&rcu_lock);
+    if (gp_active) rcu_force_qs();
+    if (!gp_active && rcu_cpu_needs_gp(rd)) rcu_gp_start();
+    spin_unlock_irqrestore(&rcu_lock, flags);
+    if (quiescent) rcu_note_qs();
+
+    // 回调按 gp 递增排列，已经安全的是一个前缀；逐个摘下，开着中断执行
+    for (;;) {
+        flags = local_irq_save();
+        rcu_head* head = rd->cb_head;
+        if (!head || head->gp > __atomic_load_n(&completed, __ATOMIC_ACQUIRE)) {
+            local_irq_restore(flags);
+            break;
+        }
+        rd->cb_head = head->next;
+        if (!rd->cb_head) rd->cb_tail = &rd->cb_head;
+        rd->cb_count--;
+        local_irq_restore(flags);
+
+        head->func(head);
+        __atomic_fetch_add(&invoked, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static void rcu_softirq() {
+    // 被打断的普通上下文可能正处在读侧临界区里；do_softirq 自己禁止了一层抢占
+    rcu_process(preempt_count() == 1);
+}
+
+void call_rcu(rcu_head* head, rcu_callback_t func) {
+    head->func = func;
+    head->next = nullptr;
+
+    // completed 和 gp_active 必须是同一时刻的值：两次读之间宽限期结束的话，
+    // 算出的 gp 已经完成，回调会在读者还拿着旧指针时执行
+    uint64_t flags = spin_lock_irqsave(&rcu_lock);
+    rcu_data* rd = &rcu_cpus.get();
+    // 正在进行的宽限期可能开始于读者拿到旧指针之后，必须再等下一个
+    head->gp = completed + (gp_active ? 2 : 1);
+    rd->last_gp = head->gp;
+    *rd->cb_tail = head;
+    rd->cb_tail = &head->next;
+    rd->cb_count++;
+    spin_unlock_irqrestore(&rcu_lock, flags);
+
+    __atomic_fetch_add(&queued, 1, __ATOMIC_RELAXED);
+    raise_softirq(SOFTIRQ_RCU);
+}
+
+struct rcu_sync {
+    rcu_head head;
+    volatile bool done;
+};
+
+static void rcu_sync_done(rcu_head* head) {
+    ((rcu_sync*)head)->done = true;
+}
+
+void synchronize_rcu() {
+    if (preempt_count() != 0 || in_interrupt()) {
+        pr_err("rcu: synchronize_rcu called from atomic context");
+        return;
+    }
+    rcu_sync sync;
+    sync.done = false;
+    call_rcu(&sync.head, rcu_sync_done);
+    while (!sync.done) {
+        rcu_process(true);
+        if (!sync.done) cpu_relax();
+    }
+}
+
+// ==========================================================================
+// 节拍、空闲与中断
+// ==========================================================================
+
+void rcu_check_callbacks() {
+    cpu_local* cpu = this_cpu();
+    // 节拍打断的是普通上下文 (嵌套深度只有节拍中断自己) 且不在读侧临界区
+    if (cpu->preempt_count == 0 && cpu->irq_nesting == 1) rcu_note_qs();
+    if (rcu_needs_cpu()) raise_softirq(SOFTIRQ_RCU);
+}
+
+bool rcu_needs_cpu() {
+    rcu_data* rd = &rcu_cpus.get();
+    if (rd->cb_head) return true;
+    return gp_active && (qs_mask & (1ull << smp_processor_id()));
+}
+
+void rcu_idle_enter() {
+    // 原子加带完整的内存屏障：之前读侧的访问都先于“进入空闲”可见
+    __atomic_fetch_add(&rcu_cpus->dynticks, 1, __ATOMIC_SEQ_CST);
+}
+
+void rcu_idle_exit() {
+    __atomic_fetch_add(&rcu_cpus->dynticks, 1, __ATOMIC_SEQ_CST);
+}
+
+bool rcu_irq_enter() {
+    rcu_data* rd = &rcu_cpus.get();
+    if (rd->dynticks & 1) return false;
+    __atomic_fetch_add(&rd->dynticks, 1, __ATOMIC_SEQ_CST);
+    return true;
+}
+
+void rcu_irq_exit() {
+    __atomic_fetch_add(&rcu_cpus->dynticks, 1, __ATOMIC_SEQ_CST);
+}
+
+// ==========================================================================
+// 初始化与统计
+// ==========================================================================
+
+void rcu_init() {
+    spin_lock_init(&rcu_lock, "rcu");
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        rcu_data* rd = &rcu_cpus.on(cpu);
+        rd->dynticks = 1;
+        rd->cb_head = nullptr;
+        rd->cb_tail = &rd->cb_head;
+        rd->cb_count = 0;
+        rd->last_gp = 0;
+    }
+    open_softirq(SOFTIRQ_RCU, rcu_softirq);
+}
+
+void rcu_get_stats(rcu_stats* stats) {
+    uint64_t flags = spin_lock_irqsave(&rcu_lock);
+    stats->completed = completed;
+    stats->gp_active = gp_active;
+    stats->gp_total_ns = gp_total_ns;
+    stats->gp_max_ns = gp_max_ns;
+    stats->fqs_reports = fqs_reports;
+    stats->queued = queued;
+    stats->invoked = invoked;
+    spin_unlock_irqrestore(&rcu_lock, flags);
+}
+
+void rcu_dump() {
+    rcu_stats st;
+    rcu_get_stats(&st);
+
+    tty_print("\nGrace periods: ", 0xFFFFFF);
+    print_dec(st.completed, 0x00FFFF);
+    tty_print(st.gp_active ? " (one in progress)" : "", 0xFFFF00);
+    tty_print("  avg ", 0xFFFFFF);
+    print_dec(st.completed ? st.gp_total_ns / st.completed / 1000 : 0, 0x00FF00);
+    tty_print(" us  max ", 0xFFFFFF);
+    print_dec(st.gp_max_ns / 1000, 0x00FF00);
+    tty_print(" us\nCallbacks: ", 0xFFFFFF);
+    print_dec(st.queued, 0x00FFFF);
+    tty_print(" queued, ", 0xFFFFFF);
+    print_dec(st.invoked, 0x00FFFF);
+    tty_print(" invoked  Idle CPUs reported by snapshot: ", 0xFFFFFF);
+    print_dec(st.fqs_reports, 0x00FFFF);
+    tty_print("\n", 0xFFFFFF);
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (!cpu_online(cpu)) continue;
+        const rcu_data* rd = &rcu_cpus.on(cpu);
+        tty_print("  CPU ", 0xFFFFFF);
+        print_dec(cpu, 0x00FF00);
+        tty_print((rd->dynticks & 1) ? "  active" : "  idle  ", 0xAAAAAA);
+        tty_print("  pending callbacks: ", 0xFFFFFF);
+        print_dec(rd->cb_count, 0x00FFFF);
+        tty_print("\n", 0xFFFFFF);
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <stdint.h>
+#include "kernel/cpu/percpu.h"
+
+// ==========================================================================
+// RCU (读-复制-更新)
+// ==========================================================================
+// 读者只做 rcu_read_lock()/rcu_read_unlock()，即本 CPU 禁止抢占计数的加减，
+// 不写任何共享内存。写者复制出新版本，用 rcu_assign_pointer 发布，旧版本等一个
+// 宽限期 (grace period) 之后再释放：宽限期结束时，每个 CPU 都至少经过了一次
+// 静止状态 (不在读侧临界区里)，不可能还有读者拿着旧指针。
+//
+// 静止状态的来源：
+//   - 节拍中断打断的是普通上下文，且本 CPU 禁止抢占计数为 0；
+//   - 空闲循环 (hlt 期间整个 CPU 处于扩展静止状态，用 dynticks 计数的奇偶表示)；
+//   - 线程切换；
+//   - 在普通上下文里调用 synchronize_rcu / 执行 RCU 软中断。
+// 硬件中断处理函数本身隐含是读侧临界区。
+//
+//   rcu_read_lock();
+//   route* r = rcu_dereference(route_table);
+//   ... 使用 r ...
+//   rcu_read_unlock();
+
+struct rcu_head;
+typedef void (*rcu_callback_t)(rcu_head* head);
+
+struct rcu_head {
+    rcu_head* next;
+    rcu_callback_t func;
+    uint64_t gp;            // 需要等到第几个宽限期结束
+};
+
+static inline void rcu_read_lock() {
+    preempt_disable();
+}
+
+static inline void rcu_read_unlock() {
+    preempt_enable();
+}
+
+// 读取一个被 RCU 保护的指针 (x86 上依赖顺序天然成立，只需阻止编译器重读)
+template <typename T>
+static inline T rcu_dereference(T& p) {
+    return __atomic_load_n(&p, __ATOMIC_CONSUME);
+}
+
+// 发布新版本：之前对新对象的初始化保证先于指针可见
+template <typename T>
+static inline void rcu_assign_pointer(T& p, T v) {
+    __atomic_store_n(&p, v, __ATOMIC_RELEASE);
+}
+
+void rcu_init();
+
+// 宽限期结束后在登记它的 CPU 上 (软中断上下文) 调用 func(head)；可以在任何上下文调用
+void call_rcu(rcu_head* head, rcu_callback_t func);
+// 等待一个完整的宽限期；不能在读侧临界区或嵌套的中断处理函数里调用
+void synchronize_rcu();
+
+// 调度器切换线程时调用：能切换就说明不在读侧临界区里
+void rcu_note_context_switch();
+// 节拍中断里调用：报告静止状态，必要时挂起 RCU 软中断
+void rcu_check_callbacks();
+// 本 CPU 是否还有 RCU 工作，有的话空闲时不能无限期停掉节拍
+bool rcu_needs_cpu();
+
+// 空闲循环在 hlt 前后调用
+void rcu_idle_enter();
+void rcu_idle_exit();
+// isr_handler 调用：中断打断了空闲的 CPU 时临时退出扩展静止状态，返回值交给 rcu_irq_exit
+bool rcu_irq_enter();
+void rcu_irq_exit();
+
+struct rcu_stats {
+    uint64_t completed;         // 已结束的宽限期
+    bool gp_active;
+    uint64_t gp_total_ns;
+    uint64_t gp_max_ns;
+    uint64_t fqs_reports;       // 通过 dynticks 快照判定 (而不是 CPU 自己报告) 的静止状态
+    uint64_t queued;            // call_rcu 次数
+    uint64_t invoked;           // 已执行的回调
+};
+
+void rcu_get_stats(rcu_stats* stats);
+void rcu_dump();
+
+// 读多写少负载下 RCU 与读写锁的对比测试，结果直接打印
+void rcu_benchmark();
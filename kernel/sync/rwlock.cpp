@@ -0,0 +1,61 @@
+#include "rwlock.h"
+#include "kernel/cpu/msr.h"
+
+void rwlock_init(rwlock* lock, const char* name) {
+    lock->value = 0;
+    LOCKSTAT(lockstat_register(&lock->stats, name, LOCK_RW));
+    (void)name;
+}
+
+void read_lock(rwlock* lock) {
+    preempt_disable();
+    uint32_t v = __atomic_load_n(&lock->value, __ATOMIC_RELAXED);
+    [[maybe_unused]] uint64_t start = 0;
+    for (;;) {
+        if (!(v & (RWLOCK_WRITER_HELD | RWLOCK_WRITER_WAITING))) {
+            if (__atomic_compare_exchange_n(&lock->value, &v, v + 1, true,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                break;
+            }
+            continue;   // v 已被更新为最新值
+        }
+        LOCKSTAT(if (!start) start = rdtsc());
+        cpu_relax();
+        v = __atomic_load_n(&lock->value, __ATOMIC_RELAXED);
+    }
+    // 多个读者同时持锁，计数需要原子累加
+    LOCKSTAT(__atomic_fetch_add(&lock->stats.acquisitions, 1, __ATOMIC_RELAXED));
+    LOCKSTAT(if (start) {
+        __atomic_fetch_add(&lock->stats.contended, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&lock->stats.wait_cycles, rdtsc() - start, __ATOMIC_RELAXED);
+    });
+}
+
+void write_lock(rwlock* lock) {
+    preempt_disable();
+    uint32_t v = __atomic_load_n(&lock->value, __ATOMIC_RELAXED);
+    if (v == 0 && __atomic_compare_exchange_n(&lock->value, &v, RWLOCK_WRITER_HELD, false,
+                                              __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        LOCKSTAT(lockstat_acquired(&lock->stats));
+        return;
+    }
+
+    [[maybe_unused]] uint64_t start = rdtsc();
+    for (;;) {
+        v = __atomic_load_n(&lock->value, __ATOMIC_RELAXED);
+        if ((v & ~RWLOCK_WRITER_WAITING) == 0) {
+            // 没有读者也没有写者：拿锁的同时清掉等待位，其他仍在等的写者会重新设置
+            if (__atomic_compare_exchange_n(&lock->value, &v, RWLOCK_WRITER_HELD, false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                break;
+            }
+            continue;
+        }
+        if (!(v & RWLOCK_WRITER_WAITING)) {
+            __atomic_fetch_or(&lock->value, RWLOCK_WRITER_WAITING, __ATOMIC_RELAXED);
+        }
+        cpu_relax();
+    }
+    LOCKSTAT(lockstat_waited(&lock->stats, rdtsc() - start));
+    LOCKSTAT(lockstat_acquired(&lock->stats));
+}
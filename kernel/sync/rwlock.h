@@ -0,0 +1,57 @@
+#pragma once
+#include <stdint.h>
+#include "spinlock.h"
+
+// ==========================================================================
+// 读写锁
+// ==========================================================================
+// 一个 32 位字：低 30 位是读者数，bit 30 表示有写者在等，bit 31 表示写者持有。
+// 写者优先：一旦有写者在等，新读者就不再进入，避免写者被源源不断的读者饿死。
+// 读多写少而且读侧临界区较长时才值得用；很短的读侧用 seqlock 或 RCU 更便宜。
+
+#define RWLOCK_WRITER_HELD      (1u << 31)
+#define RWLOCK_WRITER_WAITING   (1u << 30)
+#define RWLOCK_READER_MASK      (RWLOCK_WRITER_WAITING - 1)
+
+struct rwlock {
+    volatile uint32_t value;
+    LOCKSTAT_FIELD
+};
+
+void rwlock_init(rwlock* lock, const char* name);
+
+void read_lock(rwlock* lock);
+void write_lock(rwlock* lock);
+
+static inline void read_unlock(rwlock* lock) {
+    __atomic_fetch_sub(&lock->value, 1, __ATOMIC_RELEASE);
+    preempt_enable();
+}
+
+static inline void write_unlock(rwlock* lock) {
+    // 保留其他写者设置的等待位
+    __atomic_fetch_and(&lock->value, ~RWLOCK_WRITER_HELD, __ATOMIC_RELEASE);
+    preempt_enable();
+}
+
+static inline uint64_t read_lock_irqsave(rwlock* lock) {
+    uint64_t flags = local_irq_save();
+    read_lock(lock);
+    return flags;
+}
+
+static inline void read_unlock_irqrestore(rwlock* lock, uint64_t flags) {
+    read_unlock(lock);
+    local_irq_restore(flags);
+}
+
+static inline uint64_t write_lock_irqsave(rwlock* lock) {
+    uint64_t flags = local_irq_save();
+    write_lock(lock);
+    return flags;
+}
+
+static inline void write_unlock_irqrestore(rwlock* lock, uint64_t flags) {
+    write_unlock(lock);
+    local_irq_restore(flags);
+}
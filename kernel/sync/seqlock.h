@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+#include "spinlock.h"
+
+// ==========================================================================
+// 顺序锁
+// ==========================================================================
+// 读者不写任何共享状态：读之前记下序号，读完后序号没变 (而且不是奇数) 就说明
+// 期间没有写者，否则重读。写者之间用内嵌的票据锁互斥，写期间序号为奇数。
+// 适合很小、写得很少的数据 (时间基准、统计快照)；被保护的数据里不能有指针，
+// 因为读者可能读到写了一半的内容。
+//
+//   uint32_t seq;
+//   do {
+//       seq = read_seqbegin(&lock);
+//       copy = shared;
+//   } while (read_seqretry(&lock, seq));
+
+struct seqlock {
+    volatile uint32_t sequence;
+    spinlock lock;
+};
+
+static inline void seqlock_init(seqlock* sl, const char* name) {
+    sl->sequence = 0;
+    spin_lock_init(&sl->lock, name);
+    LOCKSTAT(sl->lock.stats.kind = LOCK_SEQ);
+}
+
+static inline uint32_t read_seqbegin(const seqlock* sl) {
+    uint32_t seq;
+    while ((seq = __atomic_load_n(&sl->sequence, __ATOMIC_ACQUIRE)) & 1) {
+        cpu_relax();
+    }
+    return seq;
+}
+
+static inline bool read_seqretry(const seqlock* sl, uint32_t start) {
+    // 先确保受保护数据的读取都已完成，再重新读序号
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&sl->sequence, __ATOMIC_RELAXED) != start;
+}
+
+static inline void write_seqlock(seqlock* sl) {
+    spin_lock(&sl->lock);
+    __atomic_store_n(&sl->sequence, sl->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void write_sequnlock(seqlock* sl) {
+    __atomic_store_n(&sl->sequence, sl->sequence + 1, __ATOMIC_RELEASE);
+    spin_unlock(&sl->lock);
+}
+
+static inline uint64_t write_seqlock_irqsave(seqlock* sl) {
+    uint64_t flags = local_irq_save();
+    write_seqlock(sl);
+    return flags;
+}
+
+static inline void write_sequnlock_irqrestore(seqlock* sl, uint64_t flags) {
+    write_sequnlock(sl);
+    local_irq_restore(flags);
+}
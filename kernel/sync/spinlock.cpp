@@ -0,0 +1,66 @@
+#include "spinlock.h"
+#include "kernel/cpu/msr.h"
+
+// ==========================================================================
+// 票据自旋锁
+// ==========================================================================
+
+void spin_lock_init(spinlock* lock, const char* name) {
+    lock->value = 0;
+    LOCKSTAT(lockstat_register(&lock->stats, name, LOCK_SPIN));
+    (void)name;
+}
+
+void spin_lock_wait(spinlock* lock, uint16_t ticket) {
+    [[maybe_unused]] uint64_t start = rdtsc();
+    while (__atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE) != ticket) {
+        cpu_relax();
+    }
+    // 已经持有锁，统计字段由锁本身保护
+    LOCKSTAT(lockstat_waited(&lock->stats, rdtsc() - start));
+}
+
+// ==========================================================================
+// MCS 排队锁
+// ==========================================================================
+
+void mcs_lock_init(mcs_lock* lock, const char* name) {
+    lock->tail = nullptr;
+    LOCKSTAT(lockstat_register(&lock->stats, name, LOCK_MCS));
+    (void)name;
+}
+
+void mcs_spin_lock(mcs_lock* lock, mcs_node* node) {
+    preempt_disable();
+    node->next = nullptr;
+    node->locked = 1;
+    mcs_node* prev = __atomic_exchange_n(&lock->tail, node, __ATOMIC_ACQ_REL);
+    if (prev) {
+        // 排在 prev 后面，只在自己的节点上自旋，直到 prev 释放时把 locked 清零
+        [[maybe_unused]] uint64_t start = rdtsc();
+        __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+        while (__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE)) {
+            cpu_relax();
+        }
+        LOCKSTAT(lockstat_waited(&lock->stats, rdtsc() - start));
+    }
+    LOCKSTAT(lockstat_acquired(&lock->stats));
+}
+
+void mcs_spin_unlock(mcs_lock* lock, mcs_node* node) {
+    mcs_node* next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+    if (!next) {
+        // 没有后继：尝试把 tail 清空；失败说明有人刚刚排到后面，等它挂上链
+        mcs_node* expected = node;
+        if (__atomic_compare_exchange_n(&lock->tail, &expected, nullptr, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            preempt_enable();
+            return;
+        }
+        while (!(next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE))) {
+            cpu_relax();
+        }
+    }
+    __atomic_store_n(&next->locked, 0, __ATOMIC_RELEASE);
+    preempt_enable();
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <stdint.h>
+#include "lockstat.h"
+#include "kernel/cpu/percpu.h"
+
+// ==========================================================================
+// 自旋锁
+// ==========================================================================
+// spinlock：票据锁，按到达顺序 FIFO 授予，两个 16 位计数器放在同一个 32 位字里。
+//   所有等待者都在同一条缓存行上自旋，适合竞争不激烈的锁。
+// mcs_lock：MCS 排队锁，每个等待者在自己的节点上自旋，释放时只唤醒后继，
+//   锁被多个 CPU 同时争抢时缓存行不会来回颠簸。节点通常放在调用者的栈上。
+// 在中断处理函数里也会获取的锁必须使用 _irqsave 版本，否则本 CPU 在持锁时
+// 被中断、中断处理函数再去拿同一把锁就会死锁。
+// 持锁期间禁止抢占：线程在持锁时被切走，同一 CPU 上的下一个线程就会在这把锁上空转。
+
+static inline uint64_t local_irq_save() {
+    uint64_t flags;
+    asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+    return flags;
+}
+
+static inline void local_irq_restore(uint64_t flags) {
+    asm volatile("push %0; popfq" :: "r"(flags) : "memory", "cc");
+}
+
+static inline void cpu_relax() {
+    asm volatile("pause" ::: "memory");
+}
+
+// ==========================================================================
+// 票据自旋锁
+// ==========================================================================
+
+struct spinlock {
+    union {
+        volatile uint32_t value;
+        struct {
+            volatile uint16_t owner;    // 当前持有者的票号
+            volatile uint16_t next;     // 下一个到达者领取的票号
+        };
+    };
+    LOCKSTAT_FIELD
+};
+
+// name 用于 lockstat 显示，必须是静态字符串
+void spin_lock_init(spinlock* lock, const char* name);
+
+// 竞争路径：等到 ticket 轮到自己，并记录等待时间
+void spin_lock_wait(spinlock* lock, uint16_t ticket);
+
+static inline void spin_lock(spinlock* lock) {
+    preempt_disable();
+    uint16_t ticket = __atomic_fetch_add(&lock->next, 1, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE) != ticket) {
+        spin_lock_wait(lock, ticket);
+    }
+    LOCKSTAT(lockstat_acquired(&lock->stats));
+}
+
+static inline bool spin_trylock(spinlock* lock) {
+    preempt_disable();
+    uint32_t old = __atomic_load_n(&lock->value, __ATOMIC_RELAXED);
+    // next 加一 (高 16 位)；只有锁空闲且期间没有别人领票时才会成功
+    if ((old & 0xFFFF) != (old >> 16) ||
+        !__atomic_compare_exchange_n(&lock->value, &old, old + 0x10000, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        preempt_enable();
+        return false;
+    }
+    LOCKSTAT(lockstat_acquired(&lock->stats));
+    return true;
+}
+
+static inline void spin_release(spinlock* lock) {
+    // 只有持有者会写 owner，普通读加 release 写即可
+    __atomic_store_n(&lock->owner, (uint16_t)(lock->owner + 1), __ATOMIC_RELEASE);
+}
+
+static inline void spin_unlock(spinlock* lock) {
+    spin_release(lock);
+    preempt_enable();
+}
+
+static inline bool spin_is_locked(const spinlock* lock) {
+    uint32_t v = __atomic_load_n(&lock->value, __ATOMIC_RELAXED);
+    return (v & 0xFFFF) != (v >> 16);
+}
+
+static inline uint64_t spin_lock_irqsave(spinlock* lock) {
+    uint64_t flags = local_irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+static inline void spin_unlock_irqrestore(spinlock* lock, uint64_t flags) {
+    // 先开中断再检查切换请求，持锁期间唤醒的线程才能立即抢占
+    spin_release(lock);
+    local_irq_restore(flags);
+    preempt_enable();
+}
+
+// ==========================================================================
+// MCS 排队锁
+// ==========================================================================
+
+struct mcs_node {
+    mcs_node* volatile next;
+    volatile uint32_t locked;
+};
+
+struct mcs_lock {
+    mcs_node* volatile tail;
+    LOCKSTAT_FIELD
+};
+
+void mcs_lock_init(mcs_lock* lock, const char* name);
+void mcs_spin_lock(mcs_lock* lock, mcs_node* node);
+void mcs_spin_unlock(mcs_lock* lock, mcs_node* node);
+
+static inline uint64_t mcs_spin_lock_irqsave(mcs_lock* lock, mcs_node* node) {
+    uint64_t flags = local_irq_save();
+    mcs_spin_lock(lock, node);
+    return flags;
+}
+
+static inline void mcs_spin_unlock_irqrestore(mcs_lock* lock, mcs_node* node, uint64_t flags) {
+    mcs_spin_unlock(lock, node);
+    local_irq_restore(flags);
+}
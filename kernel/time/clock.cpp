@@ -0,0 +1,125 @@
+#include "clock.h"
+#include "hpet.h"
+#include "kernel/cpu/cpufeature.h"
+#include "kernel/cpu/ports.h"
+#include "kernel/klog.h"
+
+// 校准前假设 4GHz：在更慢的 CPU 上延迟只会偏长，不会偏短
+#define CLOCK_DEFAULT_KHZ   4000000ull
+
+#define PIT_HZ              1193182ull
+#define CALIBRATE_MS        10
+#define CALIBRATE_RUNS      3
+
+uint64_t clock_mult = (1000000ull << CLOCK_SHIFT) / CLOCK_DEFAULT_KHZ;
+uint64_t clock_ns_mult = (CLOCK_DEFAULT_KHZ << CLOCK_SHIFT) / 1000000ull;
+uint64_t clock_tsc_base = 0;
+
+static clock_info info = { CLOCK_DEFAULT_KHZ, false, CLOCK_REF_NONE };
+
+// ==========================================================================
+// 校准
+// ==========================================================================
+
+// 用 HPET 主计数器量一段时间，按实际经过的 HPET 计数折算 TSC 频率
+static uint64_t calibrate_hpet() {
+    uint64_t mask = hpet_counter_mask();
+    uint64_t target = hpet_frequency() * CALIBRATE_MS / 1000;
+
+    uint64_t h0 = hpet_counter();
+    uint64_t t0 = rdtsc();
+    uint64_t elapsed;
+    do {
+        asm volatile("pause");
+        elapsed = (hpet_counter() - h0) & mask;
+    } while (elapsed < target);
+    uint64_t t1 = rdtsc();
+
+    uint64_t elapsed_ns = elapsed * hpet_period_fs() / 1000000;
+    return elapsed_ns ? (t1 - t0) * 1000000 / elapsed_ns : 0;
+}
+
+// PIT 通道 2 单次计数：门控打开后计到 0 时端口 0x61 的 bit 5 (OUT2) 变高
+static uint64_t calibrate_pit() {
+    uint32_t latch = (uint32_t)(PIT_HZ * CALIBRATE_MS / 1000);
+
+    // 打开通道 2 门控，关闭扬声器输出
+    outb(0x61, (inb(0x61) & ~0x02) | 0x01);
+    // 通道 2，先低后高字节，模式 0 (计数结束时输出变高)
+    outb(0x43, 0xB0);
+    outb(0x42, latch & 0xFF);
+    outb(0x42, (latch >> 8) & 0xFF);
+
+    uint64_t t0 = rdtsc();
+    uint32_t spins = 0;
+    while (!(inb(0x61) & 0x20)) {
+        // 端口不存在时不要卡死 (每次 inb 约 1us，留出 100 倍余量)
+        if (++spins > CALIBRATE_MS * 100000) return 0;
+    }
+    uint64_t t1 = rdtsc();
+    return (t1 - t0) / CALIBRATE_MS;
+}
+
+static uint64_t median3(uint64_t a, uint64_t b, uint64_t c) {
+    if (a > b) { uint64_t t = a; a = b; b = t; }
+    if (b > c) { b = c; }
+    return a > b ? a : b;
+}
+
+void clock_init() {
+    info.invariant = cpu_has(X86_FEATURE_INVARIANT_TSC);
+
+    clock_ref ref = hpet_init() ? CLOCK_REF_HPET : CLOCK_REF_PIT;
+    uint64_t runs[CALIBRATE_RUNS];
+    for (int i = 0; i < CALIBRATE_RUNS; i++) {
+        runs[i] = ref == CLOCK_REF_HPET ? calibrate_hpet() : calibrate_pit();
+    }
+    uint64_t khz = median3(runs[0], runs[1], runs[2]);
+    if (khz == 0) {
+        pr_warn("clock: TSC calibration failed, assuming %llu MHz",
+                (unsigned long long)(CLOCK_DEFAULT_KHZ / 1000));
+        return;
+    }
+
+    info.tsc_khz = khz;
+    info.ref = ref;
+    clock_mult = (1000000ull << CLOCK_SHIFT) / khz;
+    clock_ns_mult = (khz << CLOCK_SHIFT) / 1000000ull;
+    clock_tsc_base = rdtsc();
+
+    pr_info("clock: TSC %llu.%03llu MHz (%s, calibrated against %s)",
+            (unsigned long long)(khz / 1000), (unsigned long long)(khz % 1000),
+            info.invariant ? "invariant" : "not invariant", clock_ref_name(ref));
+}
+
+const clock_info* clock_get_info() {
+    return &info;
+}
+
+const char* clock_ref_name(clock_ref ref) {
+    switch (ref) {
+    case CLOCK_REF_PIT:  return "PIT";
+    case CLOCK_REF_HPET: return "HPET";
+    default:             return "none";
+    }
+}
+
+// ==========================================================================
+// 延迟
+// ==========================================================================
+
+void ndelay(uint64_t ns) {
+    uint64_t start = rdtsc();
+    uint64_t cycles = clock_ns_to_cycles(ns);
+    while (rdtsc() - start < cycles) {
+        asm volatile("pause");
+    }
+}
+
+void udelay(uint64_t us) {
+    ndelay(us * 1000);
+}
+
+void mdelay(uint64_t ms) {
+    ndelay(ms * 1000000);
+}
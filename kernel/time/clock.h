@@ -0,0 +1,51 @@
+#pragma once
+#include <stdint.h>
+#include "kernel/cpu/msr.h"
+
+// ==========================================================================
+// 单调时钟 (TSC 时钟源)
+// ==========================================================================
+// 启动时用 HPET (没有则用 PIT 通道 2) 校准 TSC 频率。之后读一次时间只需要
+// rdtsc 加一次乘法和移位，不再访问任何 I/O 端口。
+
+enum clock_ref {
+    CLOCK_REF_NONE,     // 尚未校准，使用保守的默认频率
+    CLOCK_REF_PIT,
+    CLOCK_REF_HPET,
+};
+
+struct clock_info {
+    uint64_t tsc_khz;
+    bool invariant;     // CPUID 80000007h EDX[8]：频率不随 P/C 状态变化
+    clock_ref ref;
+};
+
+// 周期与纳秒的换算因子：ns = (cycles * clock_mult) >> CLOCK_SHIFT
+#define CLOCK_SHIFT 32
+
+extern uint64_t clock_mult;         // 周期 -> 纳秒
+extern uint64_t clock_ns_mult;      // 纳秒 -> 周期
+extern uint64_t clock_tsc_base;     // clock_init 时的 TSC 读数
+
+// 校准 TSC。需要在 irq_init (解析 ACPI) 之后调用，以便优先使用 HPET
+void clock_init();
+const clock_info* clock_get_info();
+const char* clock_ref_name(clock_ref ref);
+
+static inline uint64_t clock_cycles_to_ns(uint64_t cycles) {
+    return (uint64_t)(((unsigned __int128)cycles * clock_mult) >> CLOCK_SHIFT);
+}
+
+static inline uint64_t clock_ns_to_cycles(uint64_t ns) {
+    return (uint64_t)(((unsigned __int128)ns * clock_ns_mult) >> CLOCK_SHIFT);
+}
+
+// 自 clock_init 起经过的纳秒数，单调递增
+static inline uint64_t clock_monotonic_ns() {
+    return clock_cycles_to_ns(rdtsc() - clock_tsc_base);
+}
+
+// 忙等待延迟 (不依赖中断，关中断时也能使用)
+void ndelay(uint64_t ns);
+void udelay(uint64_t us);
+void mdelay(uint64_t ms);
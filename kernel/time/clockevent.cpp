@@ -0,0 +1,215 @@
+#include "clockevent.h"
+#include "clock.h"
+#include "hpet.h"
+#include "kernel/cpu/isr.h"
+#include "kernel/cpu/irq.h"
+#include "kernel/cpu/cpufeature.h"
+#include "kernel/cpu/ports.h"
+#include "kernel/klog.h"
+
+static clock_event_device* current = nullptr;
+static clockevent_handler_t event_handler = nullptr;
+static volatile uint64_t event_count = 0;
+
+static void clockevents_event() {
+    // 每个 CPU 的 LAPIC 定时器都走这里
+    __atomic_add_fetch(&event_count, 1, __ATOMIC_RELAXED);
+    if (event_handler) event_handler();
+}
+
+static irq_return_t clockevent_irq(registers_t*, void*) {
+    clockevents_event();
+    return IRQ_HANDLED;
+}
+
+// ==========================================================================
+// LAPIC 定时器 (TSC-deadline 与单次计数两种模式)
+// ==========================================================================
+
+// 分频系数 16 (TIMER_DIV 编码 0x3)
+#define LAPIC_TIMER_DIV_16      0x3
+
+static uint64_t lapic_timer_hz = 0;
+
+static bool lapic_deadline_probe(clock_event_device*) {
+    if (!irq_using_apic() || clock_get_info()->ref == CLOCK_REF_NONE) return false;
+    if (!cpu_has(X86_FEATURE_TSC_DEADLINE)) return false;
+
+    register_irq_handler(LAPIC_TIMER_VECTOR, clockevent_irq, nullptr);
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_TSC_DEADLINE | LAPIC_TIMER_VECTOR);
+    // xAPIC 下 LVT 是 MMIO 写，之后的 WRMSR 必须排在它后面
+    asm volatile("mfence" ::: "memory");
+    return true;
+}
+
+static bool lapic_deadline_set_next(uint64_t deadline_ns, uint64_t) {
+    wrmsr(MSR_IA32_TSC_DEADLINE, clock_tsc_base + clock_ns_to_cycles(deadline_ns));
+    return true;
+}
+
+static void lapic_deadline_shutdown() {
+    wrmsr(MSR_IA32_TSC_DEADLINE, 0);
+}
+
+static bool lapic_oneshot_probe(clock_event_device* dev) {
+    if (!irq_using_apic()) return false;
+
+    // 用已校准的 TSC 量出 LAPIC 定时器的计数频率
+    lapic_write(LAPIC_REG_TIMER_DIV, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_REG_TIMER_INIT, 0xFFFFFFFF);
+    mdelay(10);
+    uint32_t elapsed = 0xFFFFFFFF - lapic_read(LAPIC_REG_TIMER_CURRENT);
+    lapic_write(LAPIC_REG_TIMER_INIT, 0);
+    lapic_timer_hz = (uint64_t)elapsed * 100;
+    if (lapic_timer_hz == 0) return false;
+
+    dev->max_delta_ns = 0xFFFFFFFFull * 1000000000ull / lapic_timer_hz;
+    register_irq_handler(LAPIC_TIMER_VECTOR, clockevent_irq, nullptr);
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_ONESHOT | LAPIC_TIMER_VECTOR);
+    pr_info("clockevent: LAPIC timer %llu kHz", (unsigned long long)(lapic_timer_hz / 1000));
+    return true;
+}
+
+static bool lapic_oneshot_set_next(uint64_t, uint64_t delta_ns) {
+    uint64_t count = delta_ns * lapic_timer_hz / 1000000000ull;
+    lapic_write(LAPIC_REG_TIMER_INIT, count ? (uint32_t)count : 1);
+    return true;
+}
+
+static void lapic_oneshot_shutdown() {
+    lapic_write(LAPIC_REG_TIMER_INIT, 0);
+}
+
+// ==========================================================================
+// HPET 定时器 0 (传统替换路由：接到 IRQ0，取代 PIT)
+// ==========================================================================
+
+static bool hpet_probe(clock_event_device*) {
+    if (!hpet_available()) return false;
+    hpet_write(HPET_REG_CONFIG, hpet_read(HPET_REG_CONFIG) | HPET_CONFIG_LEGACY);
+    // 单次、边沿触发，先不使能中断
+    uint64_t cfg = hpet_read(HPET_REG_TIMER_CONFIG(0));
+    cfg &= ~(uint64_t)(HPET_TN_PERIODIC | HPET_TN_INT_ENB | (1u << 1));
+    hpet_write(HPET_REG_TIMER_CONFIG(0), cfg);
+
+    register_irq_handler(IRQ_VECTOR_BASE + 0, clockevent_irq, nullptr);
+    irq_unmask(0);
+    return true;
+}
+
+static bool hpet_set_next(uint64_t, uint64_t delta_ns) {
+    uint64_t mask = hpet_counter_mask();
+    uint64_t ticks = delta_ns * 1000000 / hpet_period_fs();
+    uint64_t cmp = (hpet_counter() + (ticks ? ticks : 1)) & mask;
+    hpet_write(HPET_REG_TIMER_COMPARATOR(0), cmp);
+    hpet_write(HPET_REG_TIMER_CONFIG(0), hpet_read(HPET_REG_TIMER_CONFIG(0)) | HPET_TN_INT_ENB);
+    // 比较器只在计数器"等于"它时触发，写入前已经越过就不会再来中断
+    int64_t remaining = (int64_t)((cmp - hpet_counter()) & mask);
+    if (mask != ~0ull && remaining > (int64_t)(mask >> 1)) remaining -= (int64_t)mask + 1;
+    return remaining > 0;
+}
+
+static void hpet_shutdown() {
+    hpet_write(HPET_REG_TIMER_CONFIG(0), hpet_read(HPET_REG_TIMER_CONFIG(0)) & ~(uint64_t)HPET_TN_INT_ENB);
+}
+
+// ==========================================================================
+// PIT 通道 0 (模式 0：计数到 0 时产生一次 IRQ0)
+// ==========================================================================
+
+#define PIT_HZ 1193182ull
+
+static bool pit_probe(clock_event_device*) {
+    register_irq_handler(IRQ_VECTOR_BASE + 0, clockevent_irq, nullptr);
+    irq_unmask(0);
+    return true;
+}
+
+static void pit_load(uint16_t count) {
+    outb(0x43, 0x30);   // 通道 0，先低后高字节，模式 0
+    outb(0x40, count & 0xFF);
+    outb(0x40, (count >> 8) & 0xFF);
+}
+
+static bool pit_set_next(uint64_t, uint64_t delta_ns) {
+    uint64_t count = delta_ns * PIT_HZ / 1000000000ull;
+    if (count == 0) count = 1;
+    if (count > 0xFFFF) count = 0xFFFF;
+    pit_load((uint16_t)count);
+    return true;
+}
+
+// PIT 没有真正的停止命令：装入最大计数，最多再来一次中断
+static void pit_shutdown() {
+    pit_load(0);
+}
+
+// ==========================================================================
+// 设备选择
+// ==========================================================================
+
+static clock_event_device devices[] = {
+    { "lapic-deadline", 400, 1000,  1000000000000ull, lapic_deadline_probe, lapic_deadline_set_next, lapic_deadline_shutdown },
+    { "lapic-oneshot",  300, 2000,  0,                lapic_oneshot_probe,  lapic_oneshot_set_next,  lapic_oneshot_shutdown },
+    { "hpet",           200, 20000, 1000000000ull,    hpet_probe,           hpet_set_next,           hpet_shutdown },
+    { "pit",            100, 10000, 50000000ull,      pit_probe,            pit_set_next,            pit_shutdown },
+};
+
+bool clockevents_init(clockevent_handler_t handler) {
+    event_handler = handler;
+    // 表已按 rating 从高到低排列，第一个探测成功的就是最好的
+    for (auto& dev : devices) {
+        if (dev.probe(&dev)) {
+            current = &dev;
+            pr_info("clockevent: using %s (min %llu ns, max %llu ms)", dev.name,
+                    (unsigned long long)dev.min_delta_ns,
+                    (unsigned long long)(dev.max_delta_ns / 1000000));
+            return true;
+        }
+    }
+    return false;
+}
+
+bool clockevents_init_ap() {
+    if (current == &devices[0]) {
+        lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_TSC_DEADLINE | LAPIC_TIMER_VECTOR);
+        asm volatile("mfence" ::: "memory");
+        return true;
+    }
+    if (current == &devices[1]) {
+        // 各 CPU 的 LAPIC 定时器同频，沿用 BSP 校准的频率
+        lapic_write(LAPIC_REG_TIMER_DIV, LAPIC_TIMER_DIV_16);
+        lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_ONESHOT | LAPIC_TIMER_VECTOR);
+        return true;
+    }
+    return false;
+}
+
+const clock_event_device* clockevents_device() {
+    return current;
+}
+
+void clockevents_program_event(uint64_t deadline_ns) {
+    if (!current) return;
+    uint64_t now = clock_monotonic_ns();
+    uint64_t delta = deadline_ns > now ? deadline_ns - now : 0;
+    if (delta < current->min_delta_ns) delta = current->min_delta_ns;
+    if (delta > current->max_delta_ns) delta = current->max_delta_ns;
+
+    // 来不及编程时加倍重试；几次都不行就直接当作已经到期
+    for (int tries = 0; tries < 4; tries++) {
+        if (current->set_next_event(now + delta, delta)) return;
+        now = clock_monotonic_ns();
+        delta *= 2;
+    }
+    clockevents_event();
+}
+
+void clockevents_shutdown() {
+    if (current) current->shutdown();
+}
+
+uint64_t clockevents_event_count() {
+    return event_count;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+
+// ==========================================================================
+// 时钟事件设备
+// ==========================================================================
+// 可以在未来某个时刻产生一次中断的硬件。启动时按 rating 从高到低挑选：
+//   LAPIC TSC-deadline > LAPIC 单次计数 > HPET 比较器 > PIT 通道 0
+// 所有设备都只工作在单次模式，周期节拍由 tick 层自己重新编程得到。
+
+struct clock_event_device {
+    const char* name;
+    int rating;
+    uint64_t min_delta_ns;
+    uint64_t max_delta_ns;
+    // 检测硬件并完成初始化 (登记中断处理函数等)，不可用时返回 false
+    bool (*probe)(clock_event_device* dev);
+    // 在 deadline_ns (单调时钟) 产生一次中断；delta_ns 为距离现在的时间，已按设备范围裁剪。
+    // 截止时间已经错过 (来不及编程) 时返回 false
+    bool (*set_next_event)(uint64_t deadline_ns, uint64_t delta_ns);
+    void (*shutdown)();
+};
+
+typedef void (*clockevent_handler_t)();
+
+// 选择最好的设备；需要在 clock_init 和 irq_init 之后调用
+bool clockevents_init(clockevent_handler_t handler);
+const clock_event_device* clockevents_device();
+// AP 上线时调用：所选设备是本地 APIC 定时器时在本 CPU 上做同样的设置。
+// HPET/PIT 只能给 BSP 产生中断，返回 false
+bool clockevents_init_ap();
+
+// 编程本 CPU 的下一次事件 (单调时钟纳秒)，超出设备范围时会提前到期，由处理函数重新编程
+void clockevents_program_event(uint64_t deadline_ns);
+// 停掉设备，直到下一次 clockevents_program_event
+void clockevents_shutdown();
+
+// 设备产生的事件总数
+uint64_t clockevents_event_count();
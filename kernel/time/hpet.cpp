@@ -0,0 +1,70 @@
+#include "hpet.h"
+#include "kernel/cpu/acpi.h"
+#include "kernel/klog.h"
+
+struct acpi_hpet_table {
+    acpi_sdt_header header;
+    uint32_t event_timer_block_id;
+    // 通用地址结构 (GAS)
+    uint8_t address_space;      // 0 = 系统内存
+    uint8_t register_width;
+    uint8_t register_offset;
+    uint8_t access_size;
+    uint64_t address;
+    uint8_t hpet_number;
+    uint16_t min_tick;
+    uint8_t page_protection;
+} __attribute__((packed));
+
+// HPET 寄存器块位于前 4GB 内，已经被恒等映射
+static volatile uint64_t* hpet_mmio = nullptr;
+static uint32_t hpet_period = 0;
+static uint64_t hpet_mask = 0;
+
+#define HPET_CAP_COUNT_SIZE     (1ull << 13)
+
+uint64_t hpet_read(uint32_t reg) {
+    return hpet_mmio[reg / 8];
+}
+
+void hpet_write(uint32_t reg, uint64_t value) {
+    hpet_mmio[reg / 8] = value;
+}
+
+bool hpet_init() {
+    const acpi_hpet_table* table = (const acpi_hpet_table*)acpi_find_table("HPET");
+    if (!table || table->address_space != 0 || !table->address) return false;
+
+    hpet_mmio = (volatile uint64_t*)table->address;
+    uint64_t cap = hpet_read(HPET_REG_CAP_ID);
+    hpet_period = (uint32_t)(cap >> 32);
+    // 规范要求周期不超过 100ns (1e8 fs)，读到 0 或更大的值说明映射不对
+    if (hpet_period == 0 || hpet_period > 100000000) {
+        hpet_mmio = nullptr;
+        return false;
+    }
+
+    hpet_mask = (cap & HPET_CAP_COUNT_SIZE) ? ~0ull : 0xFFFFFFFFull;
+
+    // 使能主计数器 (不开启传统替换路由，PIT/RTC 中断保持原样)
+    hpet_write(HPET_REG_CONFIG, hpet_read(HPET_REG_CONFIG) | HPET_CONFIG_ENABLE);
+    pr_info("hpet: %llu Hz, %u timers", (unsigned long long)hpet_frequency(),
+            (unsigned)((cap >> 8) & 0x1F) + 1);
+    return true;
+}
+
+bool hpet_available() {
+    return hpet_mmio != nullptr;
+}
+
+uint32_t hpet_period_fs() {
+    return hpet_period;
+}
+
+uint64_t hpet_frequency() {
+    return hpet_period ? 1000000000000000ull / hpet_period : 0;
+}
+
+uint64_t hpet_counter_mask() {
+    return hpet_mask;
+}
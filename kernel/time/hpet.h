@@ -0,0 +1,36 @@
+#pragma once
+#include <stdint.h>
+
+// ==========================================================================
+// HPET (高精度事件定时器)
+// ==========================================================================
+// 只使用主计数器作为参考时钟；比较器由时钟事件层按需使用。
+
+#define HPET_REG_CAP_ID         0x000   // bit 63:32 计数周期 (飞秒)，bit 13 64 位计数器
+#define HPET_REG_CONFIG         0x010   // bit 0 总使能，bit 1 传统替换路由
+#define HPET_REG_MAIN_COUNTER   0x0F0
+#define HPET_REG_TIMER_CONFIG(n)   (0x100 + 0x20 * (n))
+#define HPET_REG_TIMER_COMPARATOR(n) (0x108 + 0x20 * (n))
+
+#define HPET_CONFIG_ENABLE      (1u << 0)
+#define HPET_CONFIG_LEGACY      (1u << 1)   // 定时器 0 接 IRQ0、定时器 1 接 IRQ8 (取代 PIT/RTC)
+
+#define HPET_TN_INT_ENB         (1u << 2)
+#define HPET_TN_PERIODIC        (1u << 3)
+
+// 从 ACPI HPET 表找到寄存器块并启动主计数器，没有 HPET 时返回 false
+bool hpet_init();
+bool hpet_available();
+
+// 计数周期 (飞秒/个) 与频率 (Hz)
+uint32_t hpet_period_fs();
+uint64_t hpet_frequency();
+// 主计数器有效位：32 位计数器会回绕，求差值时需要与它相与
+uint64_t hpet_counter_mask();
+
+uint64_t hpet_read(uint32_t reg);
+void hpet_write(uint32_t reg, uint64_t value);
+
+static inline uint64_t hpet_counter() {
+    return hpet_read(HPET_REG_MAIN_COUNTER);
+}
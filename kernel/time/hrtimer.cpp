@@ -0,0 +1,166 @@
+#include "hrtimer.h"
+#include "clock.h"
+#include "tick.h"
+#include "kernel/cpu/smp.h"
+#include "kernel/softirq.h"
+#include "kernel/klog.h"
+
+#define HRTIMER_HEAP_SIZE 128
+
+struct hrtimer_base {
+    hrtimer* heap[HRTIMER_HEAP_SIZE];
+    uint32_t count;
+};
+
+static hrtimer_base bases[MAX_CPUS];
+
+static inline uint64_t irq_save() {
+    uint64_t flags;
+    asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint64_t flags) {
+    asm volatile("push %0; popfq" :: "r"(flags) : "memory", "cc");
+}
+
+// ==========================================================================
+// 最小堆
+// ==========================================================================
+
+static void heap_set(hrtimer_base* base, uint32_t i, hrtimer* t) {
+    base->heap[i] = t;
+    t->index = (int32_t)i;
+}
+
+static void sift_up(hrtimer_base* base, uint32_t i) {
+    hrtimer* t = base->heap[i];
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (base->heap[parent]->expires <= t->expires) break;
+        heap_set(base, i, base->heap[parent]);
+        i = parent;
+    }
+    heap_set(base, i, t);
+}
+
+static void sift_down(hrtimer_base* base, uint32_t i) {
+    hrtimer* t = base->heap[i];
+    for (;;) {
+        uint32_t child = i * 2 + 1;
+        if (child >= base->count) break;
+        if (child + 1 < base->count && base->heap[child + 1]->expires < base->heap[child]->expires) {
+            child++;
+        }
+        if (t->expires <= base->heap[child]->expires) break;
+        heap_set(base, i, base->heap[child]);
+        i = child;
+    }
+    heap_set(base, i, t);
+}
+
+static bool heap_push(hrtimer_base* base, hrtimer* t) {
+    if (base->count >= HRTIMER_HEAP_SIZE) return false;
+    heap_set(base, base->count++, t);
+    sift_up(base, base->count - 1);
+    return true;
+}
+
+static void heap_remove(hrtimer_base* base, hrtimer* t) {
+    uint32_t i = (uint32_t)t->index;
+    hrtimer* last = base->heap[--base->count];
+    t->index = -1;
+    if (i == base->count) return;
+    heap_set(base, i, last);
+    // 替换上来的节点可能需要上浮也可能需要下沉
+    sift_up(base, i);
+    sift_down(base, (uint32_t)last->index);
+}
+
+// ==========================================================================
+// 公共接口
+// ==========================================================================
+
+void hrtimer_init(hrtimer* timer, hrtimer_restart (*function)(hrtimer* timer)) {
+    timer->expires = 0;
+    timer->function = function;
+    timer->index = -1;
+    timer->cpu = smp_processor_id();
+}
+
+bool hrtimer_start(hrtimer* timer, uint64_t expires_ns) {
+    uint64_t flags = irq_save();
+    if (timer->index >= 0) heap_remove(&bases[timer->cpu], timer);
+
+    timer->cpu = smp_processor_id();
+    timer->expires = expires_ns;
+    hrtimer_base* base = &bases[timer->cpu];
+    bool ok = heap_push(base, timer);
+    bool first = ok && base->heap[0] == timer;
+    irq_restore(flags);
+
+    if (!ok) {
+        pr_err("hrtimer: queue full on cpu %u", timer->cpu);
+        return false;
+    }
+    // 成为新的堆顶时，时钟事件需要提前
+    if (first) tick_update_next_event();
+    return true;
+}
+
+bool hrtimer_cancel(hrtimer* timer) {
+    uint64_t flags = irq_save();
+    bool was_active = timer->index >= 0;
+    if (was_active) heap_remove(&bases[timer->cpu], timer);
+    irq_restore(flags);
+    return was_active;
+}
+
+uint64_t hrtimer_forward(hrtimer* timer, uint64_t now, uint64_t interval) {
+    if (interval == 0 || timer->expires > now) return 0;
+    uint64_t overruns = (now - timer->expires) / interval + 1;
+    timer->expires += overruns * interval;
+    return overruns;
+}
+
+uint64_t hrtimer_next_expiry() {
+    hrtimer_base* base = &bases[smp_processor_id()];
+    return base->count ? base->heap[0]->expires : ~0ull;
+}
+
+uint32_t hrtimer_pending() {
+    return bases[smp_processor_id()].count;
+}
+
+void hrtimer_check(uint64_t now) {
+    if (hrtimer_next_expiry() <= now) raise_softirq(SOFTIRQ_HRTIMER);
+}
+
+// ==========================================================================
+// 到期处理 (HRTIMER 软中断)
+// ==========================================================================
+
+static void run_hrtimers() {
+    hrtimer_base* base = &bases[smp_processor_id()];
+    uint64_t flags = irq_save();
+    uint64_t now = clock_monotonic_ns();
+
+    while (base->count && base->heap[0]->expires <= now) {
+        hrtimer* t = base->heap[0];
+        heap_remove(base, t);
+        irq_restore(flags);
+
+        hrtimer_restart restart = t->function(t);
+
+        flags = irq_save();
+        // 回调里可能已经自己重新启动了定时器
+        if (restart == HRTIMER_RESTART && t->index < 0) heap_push(base, t);
+        now = clock_monotonic_ns();
+    }
+    irq_restore(flags);
+    tick_update_next_event();
+}
+
+void hrtimers_init() {
+    open_softirq(SOFTIRQ_HRTIMER, run_hrtimers);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+
+// ==========================================================================
+// 高精度定时器
+// ==========================================================================
+// 每个 CPU 一个按到期时间 (单调时钟纳秒) 排列的最小堆。堆顶决定下一次
+// 时钟事件的编程时刻，所以到期精度只受时钟事件设备限制，而不是节拍。
+// 回调在 HRTIMER 软中断中执行 (开中断)。
+
+enum hrtimer_restart {
+    HRTIMER_NORESTART,
+    HRTIMER_RESTART,    // 回调已用 hrtimer_forward 推进了到期时间，重新排队
+};
+
+struct hrtimer {
+    uint64_t expires;   // 单调时钟纳秒
+    hrtimer_restart (*function)(hrtimer* timer);
+    int32_t index;      // 在堆中的位置，-1 表示未排队
+    uint32_t cpu;
+};
+
+void hrtimer_init(hrtimer* timer, hrtimer_restart (*function)(hrtimer* timer));
+// 在当前 CPU 上按绝对时间启动 (已在排队时先取消)；堆满时返回 false
+bool hrtimer_start(hrtimer* timer, uint64_t expires_ns);
+// 取消，返回取消前是否在排队
+bool hrtimer_cancel(hrtimer* timer);
+// 把到期时间按 interval 向后推进到晚于 now，返回推进的次数 (周期定时器使用)
+uint64_t hrtimer_forward(hrtimer* timer, uint64_t now, uint64_t interval);
+
+static inline bool hrtimer_active(const hrtimer* timer) {
+    return timer->index >= 0;
+}
+
+void hrtimers_init();
+// 时钟事件中断里调用：堆顶到期时触发 HRTIMER 软中断
+void hrtimer_check(uint64_t now);
+// 当前 CPU 上最早的到期时间，没有定时器时返回 ~0
+uint64_t hrtimer_next_expiry();
+uint32_t hrtimer_pending();
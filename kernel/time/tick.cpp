@@ -0,0 +1,190 @@
+#include "tick.h"
+#include "clock.h"
+#include "clockevent.h"
+#include "timer_wheel.h"
+#include "hrtimer.h"
+#include "kernel/cpu/isr.h"
+#include "kernel/sync/spinlock.h"
+#include "kernel/sync/rcu.h"
+#include "kernel/sched/sched.h"
+#include "kernel/perf.h"
+
+volatile uint64_t jiffies = 0;
+
+// jiffies 由任何一个收到节拍的 CPU 推进：BSP 空闲停掉节拍时，忙着的 AP 接手
+static uint64_t tick_epoch_ns = 0;      // jiffies 为 0 的时刻
+static volatile uint64_t next_jiffy_ns = 0;
+static spinlock jiffies_lock;
+
+// 每个 CPU 的节拍状态；AP 只有在所选时钟事件设备是本地 APIC 定时器时才有节拍
+struct tick_cpu {
+    bool enabled;
+    volatile bool stopped;
+    uint64_t next_tick_ns;      // 下一个周期节拍的时刻
+    uint64_t idle_wake_ns;
+
+    uint64_t idle_enter_ns;
+    uint64_t idle_enter_irqs;
+    uint64_t idle_ns_total;
+    uint64_t idle_irqs_total;
+};
+
+static per_cpu<tick_cpu> tick_cpus;
+
+static inline uint64_t irq_save() {
+    uint64_t flags;
+    asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint64_t flags) {
+    asm volatile("push %0; popfq" :: "r"(flags) : "memory", "cc");
+}
+
+// 把 jiffies 追到 now
+static void tick_do_update_jiffies(uint64_t now) {
+    if (now < __atomic_load_n(&next_jiffy_ns, __ATOMIC_ACQUIRE)) return;
+    spin_lock(&jiffies_lock);
+    if (now >= next_jiffy_ns) {
+        uint64_t missed = (now - next_jiffy_ns) / TICK_NS + 1;
+        __atomic_store_n(&jiffies, jiffies + missed, __ATOMIC_RELEASE);
+        __atomic_store_n(&next_jiffy_ns, next_jiffy_ns + missed * TICK_NS, __ATOMIC_RELEASE);
+    }
+    spin_unlock(&jiffies_lock);
+}
+
+// 让 next_tick_ns 指向 now 之后的第一个节拍 (所有 CPU 的节拍对齐到同一个网格)
+static void tick_catch_up(tick_cpu* tc, uint64_t now) {
+    tick_do_update_jiffies(now);
+    if (now < tc->next_tick_ns) return;
+    tc->next_tick_ns = tick_epoch_ns + ((now - tick_epoch_ns) / TICK_NS + 1) * TICK_NS;
+}
+
+uint64_t tick_jiffies_to_ns(uint64_t j) {
+    return tick_epoch_ns + j * TICK_NS;
+}
+
+// 下一次需要时钟事件的时刻：忙时是下一个节拍，空闲时是最早的定时器或唤醒时刻
+static uint64_t tick_next_deadline(const tick_cpu* tc) {
+    uint64_t deadline = tc->next_tick_ns;
+    if (tc->stopped) {
+        deadline = tc->idle_wake_ns;
+        uint64_t wheel = timer_wheel_next_expiry();
+        if (wheel != ~0ull && tick_jiffies_to_ns(wheel) < deadline) {
+            deadline = tick_jiffies_to_ns(wheel);
+        }
+    }
+    uint64_t hr = hrtimer_next_expiry();
+    return hr < deadline ? hr : deadline;
+}
+
+static void tick_program(const tick_cpu* tc) {
+    if (!tc->enabled) return;
+    uint64_t deadline = tick_next_deadline(tc);
+    if (deadline == TICK_NO_DEADLINE) {
+        clockevents_shutdown();
+    } else {
+        clockevents_program_event(deadline);
+    }
+}
+
+// 时钟事件中断：推进 jiffies，把到期的定时器交给软中断，再编程下一次事件
+static void tick_handle_event() {
+    tick_cpu* tc = &tick_cpus.get();
+    uint64_t now = clock_monotonic_ns();
+    tick_catch_up(tc, now);
+    timer_wheel_tick();
+    hrtimer_check(now);
+    rcu_check_callbacks();
+    sched_tick();
+    perf_tick();
+    tick_program(tc);
+}
+
+void tick_update_next_event() {
+    uint64_t flags = irq_save();
+    tick_program(&tick_cpus.get());
+    irq_restore(flags);
+}
+
+static void tick_start_local(tick_cpu* tc) {
+    tc->enabled = true;
+    tc->idle_wake_ns = TICK_NO_DEADLINE;
+    tc->next_tick_ns = tick_epoch_ns;
+    tick_catch_up(tc, clock_monotonic_ns());
+    clockevents_program_event(tc->next_tick_ns);
+}
+
+bool tick_init() {
+    spin_lock_init(&jiffies_lock, "jiffies");
+    timer_wheel_init();
+    hrtimers_init();
+    if (!clockevents_init(tick_handle_event)) return false;
+    tick_epoch_ns = clock_monotonic_ns();
+    next_jiffy_ns = tick_epoch_ns + TICK_NS;
+    tick_start_local(&tick_cpus.get());
+    return true;
+}
+
+bool tick_init_ap() {
+    if (!clockevents_init_ap()) return false;
+    uint64_t flags = irq_save();
+    tick_start_local(&tick_cpus.get());
+    irq_restore(flags);
+    return true;
+}
+
+bool tick_cpu_enabled(uint32_t cpu) {
+    return tick_cpus.on(cpu).enabled;
+}
+
+void tick_nohz_idle_enter(uint64_t wake_ns) {
+    uint64_t flags = irq_save();
+    tick_cpu* tc = &tick_cpus.get();
+    tc->stopped = true;
+    tc->idle_wake_ns = wake_ns;
+    tc->idle_enter_ns = clock_monotonic_ns();
+    tc->idle_enter_irqs = irq_cpu_total(smp_processor_id());
+
+    tick_program(tc);
+    irq_restore(flags);
+}
+
+void tick_nohz_idle_exit() {
+    uint64_t flags = irq_save();
+    tick_cpu* tc = &tick_cpus.get();
+    uint64_t now = clock_monotonic_ns();
+    tc->idle_ns_total += now - tc->idle_enter_ns;
+    tc->idle_irqs_total += irq_cpu_total(smp_processor_id()) - tc->idle_enter_irqs;
+    tc->stopped = false;
+    tc->idle_wake_ns = TICK_NO_DEADLINE;
+
+    tick_catch_up(tc, now);
+    tick_program(tc);
+    irq_restore(flags);
+}
+
+bool tick_stopped() {
+    return tick_cpus->stopped;
+}
+
+void tick_get_stats(uint32_t cpu, tick_stats* stats) {
+    uint64_t flags = irq_save();
+    const tick_cpu* tc = &tick_cpus.on(cpu);
+    uint64_t now = clock_monotonic_ns();
+    uint64_t irqs = irq_cpu_total(cpu);
+    uint64_t idle_ns = tc->idle_ns_total;
+    uint64_t idle_irqs = tc->idle_irqs_total;
+    // 该 CPU 正处于空闲时，把当前这段也算进去 (别的 CPU 的字段可能正在更新，只是近似值)
+    if (tc->stopped) {
+        idle_ns += now - tc->idle_enter_ns;
+        idle_irqs += irqs - tc->idle_enter_irqs;
+    }
+    uint64_t up_ns = now - cpu_locals[cpu].online_ns;
+    stats->idle_ns = idle_ns;
+    stats->busy_ns = up_ns > idle_ns ? up_ns - idle_ns : 0;
+    stats->idle_irqs = idle_irqs;
+    stats->busy_irqs = irqs > idle_irqs ? irqs - idle_irqs : 0;
+    stats->events = clockevents_event_count();
+    irq_restore(flags);
+}
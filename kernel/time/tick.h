@@ -0,0 +1,50 @@
+#pragma once
+#include <stdint.h>
+
+// ==========================================================================
+// 节拍与无节拍空闲 (NO_HZ idle)
+// ==========================================================================
+// CPU 忙时用单次时钟事件模拟 TICK_HZ 的周期节拍；进入空闲时停掉节拍，
+// 只为下一个真正需要的唤醒时刻 (定时器轮、高精度定时器中最早的一个) 编程一次中断。
+// 节拍状态每个 CPU 一份，jiffies 由任何一个正在产生节拍的 CPU 推进。
+
+#define TICK_HZ         1000
+#define TICK_NS         (1000000000ull / TICK_HZ)
+
+// 没有任何待办事件时传给 tick_nohz_idle_enter
+#define TICK_NO_DEADLINE (~0ull)
+
+// 自启动以来的节拍数 (空闲期间跳过的节拍在退出空闲时补上)
+extern volatile uint64_t jiffies;
+
+static inline uint64_t msecs_to_jiffies(uint64_t ms) {
+    return ms * TICK_HZ / 1000;
+}
+
+// 初始化定时器轮、高精度定时器和时钟事件设备，开始 BSP 的周期节拍
+bool tick_init();
+// AP 上线时调用：时钟事件设备是本地 APIC 定时器时，本 CPU 也开始周期节拍
+bool tick_init_ap();
+// cpu 是否有自己的节拍 (没有节拍的 CPU 上不能做时间片轮转)
+bool tick_cpu_enabled(uint32_t cpu);
+// jiffies 对应的单调时钟时刻
+uint64_t tick_jiffies_to_ns(uint64_t j);
+// 定时器队列的最早到期时间变了 (例如空闲时新加了定时器)，重新编程时钟事件
+void tick_update_next_event();
+
+// 空闲循环在关中断、hlt 之前调用：停掉本 CPU 的周期节拍，只在下一个定时器或 wake_ns 唤醒
+void tick_nohz_idle_enter(uint64_t wake_ns);
+// hlt 返回后调用：补齐 jiffies，恢复周期节拍
+void tick_nohz_idle_exit();
+bool tick_stopped();
+
+struct tick_stats {
+    uint64_t idle_ns;           // 在 hlt 中度过的时间
+    uint64_t busy_ns;
+    uint64_t idle_irqs;         // 空闲期间到来的中断 (每一个都意味着一次唤醒)
+    uint64_t busy_irqs;
+    uint64_t events;            // 时钟事件设备的中断次数
+};
+
+// cpu 上线以来的空闲/忙碌时间和各自期间该 CPU 收到的中断
+void tick_get_stats(uint32_t cpu, tick_stats* stats);
@@ -0,0 +1,233 @@
+#include "timer_wheel.h"
+#include "tick.h"
+#include "kernel/cpu/smp.h"
+#include "kernel/softirq.h"
+
+#define TVR_BITS    8
+#define TVN_BITS    6
+#define TVR_SIZE    (1 << TVR_BITS)
+#define TVN_SIZE    (1 << TVN_BITS)
+#define TVR_MASK    (TVR_SIZE - 1)
+#define TVN_MASK    (TVN_SIZE - 1)
+#define TVN_LEVELS  4
+
+// 第 n 级 (0 起，不含第 0 级时间轮) 的槽号
+#define TVN_INDEX(clk, n) (((clk) >> (TVR_BITS + (n) * TVN_BITS)) & TVN_MASK)
+
+#define TIMER_MAX_DELTA 0xFFFFFFFFull
+
+struct timer_base {
+    uint64_t clk;                           // 下一个要处理的 jiffy
+    timer_list* tv1[TVR_SIZE];
+    timer_list* tvn[TVN_LEVELS][TVN_SIZE];
+    uint32_t count;
+    uint64_t next_expiry;                   // 缓存的最早到期时间
+    bool next_valid;
+};
+
+static timer_base bases[MAX_CPUS];
+
+static inline uint64_t irq_save() {
+    uint64_t flags;
+    asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint64_t flags) {
+    asm volatile("push %0; popfq" :: "r"(flags) : "memory", "cc");
+}
+
+// ==========================================================================
+// 链表与散列
+// ==========================================================================
+
+static void list_add(timer_list** head, timer_list* t) {
+    t->next = *head;
+    if (t->next) t->next->pprev = &t->next;
+    *head = t;
+    t->pprev = head;
+}
+
+static void list_del(timer_list* t) {
+    *t->pprev = t->next;
+    if (t->next) t->next->pprev = t->pprev;
+    t->next = nullptr;
+    t->pprev = nullptr;
+}
+
+static void enqueue(timer_base* base, timer_list* t) {
+    uint64_t expires = t->expires;
+    // 已经过期的定时器放进下一个要处理的槽
+    if ((int64_t)(expires - base->clk) < 0) expires = base->clk;
+    uint64_t delta = expires - base->clk;
+    if (delta > TIMER_MAX_DELTA) {
+        delta = TIMER_MAX_DELTA;
+        expires = base->clk + delta;
+    }
+
+    timer_list** slot;
+    if (delta < TVR_SIZE) {
+        slot = &base->tv1[expires & TVR_MASK];
+    } else {
+        int level = 0;
+        while (level < TVN_LEVELS - 1 && delta >= (1ull << (TVR_BITS + (level + 1) * TVN_BITS))) {
+            level++;
+        }
+        slot = &base->tvn[level][TVN_INDEX(expires, level)];
+    }
+    list_add(slot, t);
+}
+
+// 把第 level 级 index 槽里的定时器重新散列到更低的级别，返回 index
+static uint32_t cascade(timer_base* base, int level, uint32_t index) {
+    timer_list* t = base->tvn[level][index];
+    base->tvn[level][index] = nullptr;
+    while (t) {
+        timer_list* next = t->next;
+        t->next = nullptr;
+        t->pprev = nullptr;
+        enqueue(base, t);
+        t = next;
+    }
+    return index;
+}
+
+// ==========================================================================
+// 公共接口
+// ==========================================================================
+
+void timer_setup(timer_list* timer, void (*function)(timer_list* timer)) {
+    timer->next = nullptr;
+    timer->pprev = nullptr;
+    timer->expires = 0;
+    timer->function = function;
+    timer->cpu = smp_processor_id();
+}
+
+static bool detach(timer_list* timer) {
+    if (!timer->pprev) return false;
+    list_del(timer);
+    timer_base* base = &bases[timer->cpu];
+    base->count--;
+    base->next_valid = false;
+    return true;
+}
+
+bool mod_timer(timer_list* timer, uint64_t expires) {
+    uint64_t flags = irq_save();
+    bool was_pending = detach(timer);
+
+    timer_base* base = &bases[smp_processor_id()];
+    // 空的时间轮不需要逐个节拍追赶，直接对齐到当前 jiffies
+    if (base->count == 0) base->clk = jiffies;
+    timer->cpu = smp_processor_id();
+    timer->expires = expires;
+    enqueue(base, timer);
+    base->count++;
+
+    // 只会让最早到期时间变小，缓存有效时直接更新
+    bool earliest = !base->next_valid || expires < base->next_expiry;
+    if (base->next_valid && expires < base->next_expiry) base->next_expiry = expires;
+    irq_restore(flags);
+
+    // 空闲时唤醒时刻可能因此提前，需要重新编程时钟事件
+    if (earliest && tick_stopped()) tick_update_next_event();
+    return was_pending;
+}
+
+void add_timer(timer_list* timer) {
+    mod_timer(timer, timer->expires);
+}
+
+bool del_timer(timer_list* timer) {
+    uint64_t flags = irq_save();
+    bool was_pending = detach(timer);
+    irq_restore(flags);
+    return was_pending;
+}
+
+uint64_t timer_wheel_next_expiry() {
+    uint64_t flags = irq_save();
+    timer_base* base = &bases[smp_processor_id()];
+    if (!base->next_valid) {
+        uint64_t next = ~0ull;
+        if (base->count) {
+            for (int i = 0; i < TVR_SIZE; i++) {
+                for (timer_list* t = base->tv1[i]; t; t = t->next) {
+                    if (t->expires < next) next = t->expires;
+                }
+            }
+            for (int level = 0; level < TVN_LEVELS; level++) {
+                for (int i = 0; i < TVN_SIZE; i++) {
+                    for (timer_list* t = base->tvn[level][i]; t; t = t->next) {
+                        if (t->expires < next) next = t->expires;
+                    }
+                }
+            }
+        }
+        base->next_expiry = next;
+        base->next_valid = true;
+    }
+    uint64_t next = base->next_expiry;
+    irq_restore(flags);
+    return next;
+}
+
+uint32_t timer_wheel_pending() {
+    return bases[smp_processor_id()].count;
+}
+
+void timer_wheel_tick() {
+    timer_base* base = &bases[smp_processor_id()];
+    if (base->count && timer_wheel_next_expiry() <= jiffies) {
+        raise_softirq(SOFTIRQ_TIMER);
+    }
+}
+
+// ==========================================================================
+// 到期处理 (TIMER 软中断)
+// ==========================================================================
+
+static void run_timers() {
+    timer_base* base = &bases[smp_processor_id()];
+    uint64_t flags = irq_save();
+
+    while ((int64_t)(jiffies - base->clk) >= 0) {
+        if (base->count == 0) {
+            base->clk = jiffies + 1;
+            break;
+        }
+        uint32_t index = base->clk & TVR_MASK;
+        if (!index) {
+            // 第 0 级转完一圈，逐级把上一级的槽散列下来
+            for (int level = 0; level < TVN_LEVELS; level++) {
+                if (cascade(base, level, TVN_INDEX(base->clk, level)) != 0) break;
+            }
+        }
+        base->clk++;
+
+        // 先把整个槽摘到本地链表，回调里修改其他定时器不会影响遍历
+        timer_list* work = base->tv1[index];
+        base->tv1[index] = nullptr;
+        if (work) work->pprev = &work;
+        while (work) {
+            timer_list* t = work;
+            void (*fn)(timer_list*) = t->function;
+            list_del(t);
+            base->count--;
+            base->next_valid = false;
+            irq_restore(flags);
+            fn(t);
+            flags = irq_save();
+        }
+    }
+    irq_restore(flags);
+}
+
+void timer_wheel_init() {
+    open_softirq(SOFTIRQ_TIMER, run_timers);
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        bases[cpu].clk = jiffies;
+        bases[cpu].next_valid = false;
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <stdint.h>
+
+// ==========================================================================
+// 定时器轮 (粗粒度超时，以 jiffies 为单位)
+// ==========================================================================
+// 五级分层时间轮：第 0 级 256 个槽，每槽一个节拍；之后四级各 64 个槽，
+// 每级粒度乘以 64，共覆盖 2^32 个节拍。插入和删除都是 O(1)，
+// 第 0 级转完一圈时把上一级对应槽里的定时器重新散列下来 (cascade)。
+// 每个 CPU 一个时间轮，到期回调在 TIMER 软中断中执行 (开中断)。
+
+struct timer_list {
+    timer_list* next;
+    timer_list** pprev;     // 指向前一个节点的 next (或槽头)，为空表示未排队
+    uint64_t expires;       // 到期的 jiffies
+    void (*function)(timer_list* timer);
+    uint32_t cpu;
+};
+
+void timer_setup(timer_list* timer, void (*function)(timer_list* timer));
+// 在当前 CPU 上按 timer->expires 启动
+void add_timer(timer_list* timer);
+// 修改到期时间 (已在排队时先删除)，返回修改前是否在排队
+bool mod_timer(timer_list* timer, uint64_t expires);
+// 删除，返回删除前是否在排队
+bool del_timer(timer_list* timer);
+
+static inline bool timer_pending(const timer_list* timer) {
+    return timer->pprev != nullptr;
+}
+
+void timer_wheel_init();
+// 时钟事件中断里调用：有定时器到期时触发 TIMER 软中断
+void timer_wheel_tick();
+// 当前 CPU 上最早的到期时间 (jiffies)，没有定时器时返回 ~0
+uint64_t timer_wheel_next_expiry();
+uint32_t timer_wheel_pending();
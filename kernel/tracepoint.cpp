@@ -0,0 +1,112 @@
+#include "tracepoint.h"
+#include "drivers/tty.h"
+#include "cpu/smp.h"
+#include "lib/libc.h"
+
+// 由 linker.ld 定义的段边界
+extern struct tracepoint __tracepoints_start[];
+extern struct tracepoint __tracepoints_end[];
+extern struct tracepoint_site __tracepoint_sites_start[];
+extern struct tracepoint_site __tracepoint_sites_end[];
+
+// 5 字节 NOP: nopl 0x0(%rax,%rax,1)
+static const uint8_t nop5[5] = { 0x0F, 0x1F, 0x44, 0x00, 0x00 };
+
+// ==========================================================================
+// 改写调用点
+// ==========================================================================
+// 其他 CPU 可能正在执行同一个调用点，5 个字节不是一次原子写入，直接覆盖会让它们
+// 取到新旧混杂的指令。按 int3 的顺序分三步改写，每步之后让所有 CPU 串行化一次：
+//   1. 首字节写成 int3：此后执行到这里的 CPU 陷入 tracepoint_poke_int3，
+//      由它直接跳到新指令的去向，不会再读后面 4 个字节
+//   2. 改写后 4 个字节
+//   3. 把首字节写成新指令的首字节
+// 内核 .text 由 stivale 映射为可写。
+
+static volatile uint64_t poke_addr = 0;     // 正在改写的调用点，0 表示没有
+static volatile uint64_t poke_dest = 0;     // 新指令执行后的去向
+static volatile bool poke_busy = false;      // 同一时刻只允许一个改写者
+
+static inline void sync_core() {
+    uint32_t eax = 0, ebx, ecx = 0, edx;
+    asm volatile("cpuid" : "+a"(eax), "=b"(ebx), "+c"(ecx), "=d"(edx) : : "memory");
+}
+
+static void sync_core_ipi(void*) {
+    sync_core();
+}
+
+// 修改代码后本 CPU 和其他 CPU 都执行一条串行化指令，丢弃可能已经预取的旧指令。
+// 等 IPI 都执行完才返回，也保证了没有 CPU 还停在 int3 处理函数里
+static void text_poke_sync() {
+    sync_core();
+    smp_call_function(sync_core_ipi, nullptr, true);
+}
+
+static void tracepoint_patch_site(const tracepoint_site* site, bool enable) {
+    uint8_t insn[5];
+    if (enable) {
+        int32_t rel = (int32_t)(site->target - (site->code + 5));
+        insn[0] = 0xE9; // jmp rel32
+        memcpy(&insn[1], &rel, 4);
+    } else {
+        memcpy(insn, nop5, 5);
+    }
+
+    volatile uint8_t* code = (volatile uint8_t*)site->code;
+    poke_dest = enable ? site->target : site->code + 5;
+    __atomic_store_n(&poke_addr, site->code, __ATOMIC_RELEASE);
+
+    code[0] = 0xCC;
+    text_poke_sync();
+    for (int i = 1; i < 5; i++) code[i] = insn[i];
+    text_poke_sync();
+    code[0] = insn[0];
+    text_poke_sync();
+
+    __atomic_store_n(&poke_addr, 0, __ATOMIC_RELEASE);
+}
+
+bool tracepoint_poke_int3(registers_t* regs) {
+    uint64_t addr = __atomic_load_n(&poke_addr, __ATOMIC_ACQUIRE);
+    // int3 是陷阱，保存的 RIP 指向 0xCC 的下一个字节
+    if (!addr || regs->rip != addr + 1) return false;
+    regs->rip = poke_dest;
+    return true;
+}
+
+int tracepoint_set(const char* name, bool enable) {
+    // 改写期间要等 IPI，不能关中断持锁；用一个标志让并发的改写者排队
+    while (__atomic_exchange_n(&poke_busy, true, __ATOMIC_ACQUIRE)) {
+        asm volatile("pause");
+    }
+    bool all = strcmp(name, "all") == 0;
+    int count = 0;
+    for (tracepoint* tp = __tracepoints_start; tp < __tracepoints_end; tp++) {
+        if (!all && strcmp(tp->name, name) != 0) continue;
+        count++;
+        if (tp->enabled == enable) continue;
+        tp->enabled = enable;
+        for (tracepoint_site* site = __tracepoint_sites_start; site < __tracepoint_sites_end; site++) {
+            if (site->tp == tp) {
+                tracepoint_patch_site(site, enable);
+            }
+        }
+    }
+    __atomic_store_n(&poke_busy, false, __ATOMIC_RELEASE);
+    return count;
+}
+
+void tracepoint_list() {
+    for (tracepoint* tp = __tracepoints_start; tp < __tracepoints_end; tp++) {
+        int sites = 0;
+        for (tracepoint_site* site = __tracepoint_sites_start; site < __tracepoint_sites_end; site++) {
+            if (site->tp == tp) sites++;
+        }
+        tty_print("  ", 0xFFFFFF);
+        tty_print(tp->name, 0x00FFFF);
+        tty_print(tp->enabled ? "  [on]  " : "  [off] ", tp->enabled ? 0x00FF00 : 0xAAAAAA);
+        print_dec(sites, 0xFFFFFF);
+        tty_print(" site(s)\n", 0xFFFFFF);
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+#include "klog.h"
+#include "kernel/cpu/isr.h"
+
+// ==========================================================================
+// 静态追踪点 (static tracepoints)
+// ==========================================================================
+// 每个 trace() 调用点在代码里只留下一条 5 字节的 NOP。启用追踪点时，
+// 运行期把这条 NOP 改写成 jmp 到记录日志的代码；关闭时再改回 NOP。
+// 因此关闭状态下的开销只有一条 NOP，没有任何内存读取或条件分支。
+
+struct tracepoint {
+    const char* name;
+    bool enabled;
+};
+
+// 每个 trace() 调用点在 .tracepoint_sites 段中留下的一条记录
+struct tracepoint_site {
+    uint64_t code;             // 5 字节 NOP 的地址
+    uint64_t target;           // 启用时跳转到的地址
+    struct tracepoint* tp;
+};
+
+// 在 .cpp 中定义一个追踪点，在头文件中声明
+#define DEFINE_TRACEPOINT(name) \
+    __attribute__((section(".tracepoints"), used)) \
+    struct tracepoint __tracepoint_##name = { #name, false }
+#define DECLARE_TRACEPOINT(name) \
+    extern struct tracepoint __tracepoint_##name
+
+// 记录一条追踪日志 (级别为 KLOG_DEBUG，正文以 "[追踪点名]" 开头)
+#define trace(name, fmt, ...) do {                                          \
+        __label__ trace_on;                                                 \
+        asm goto("1: .byte 0x0f, 0x1f, 0x44, 0x00, 0x00\n\t"                \
+                 ".pushsection .tracepoint_sites, \"aw\"\n\t"               \
+                 ".balign 8\n\t"                                            \
+                 ".quad 1b, %l[trace_on]     , %c0\n\t"                   \
+                 ".popsection"                                              \
+                 : : "i"(&__tracepoint_##name) : : trace_on);                \
+        break;                                                              \
+    trace_on: __attribute__((cold));                                        \
+        klog(KLOG_DEBUG, "[" #name "] " fmt, ##__VA_ARGS__);                \
+    } while (0)
+
+// 按名字启用/关闭追踪点，"all" 表示全部。返回受影响的追踪点个数
+int tracepoint_set(const char* name, bool enable);
+
+// 列出所有追踪点及其状态
+void tracepoint_list();
+
+// int3 异常处理函数先调用：命中正在改写的调用点时把 RIP 改到新指令的去向并返回 true
+bool tracepoint_poke_int3(registers_t* regs);
@@ -0,0 +1,136 @@
+#include "workqueue.h"
+#include "sched/sched.h"
+#include "time/clock.h"
+#include "drivers/tty.h"
+#include "klog.h"
+#include "lib/libc.h"
+
+// 队列里有锁和等待队列，锁登记在 lockstat 里，所以队列从静态池里分配、不销毁
+#define MAX_WORKQUEUES 8
+
+struct workqueue {
+    char name[THREAD_NAME_LEN];
+    spinlock lock;
+    work_struct* head;
+    work_struct* tail;
+    wait_queue more_work;       // 工作线程等待新工作
+    wait_queue flushed;         // flush_workqueue 等待 done_seq 追上
+    thread* worker;
+    volatile uint64_t queued_seq;   // 已排队的工作数
+    volatile uint64_t done_seq;     // 已执行完的工作数
+    uint64_t max_latency_ns;        // 从排队到开始执行的最长时间
+};
+
+static workqueue workqueues[MAX_WORKQUEUES];
+static uint32_t nr_workqueues = 0;
+static spinlock workqueues_lock;
+static workqueue* system_wq = nullptr;
+
+static void worker_thread(void* arg) {
+    workqueue* wq = (workqueue*)arg;
+    for (;;) {
+        wait_event(wq->more_work, __atomic_load_n(&wq->head, __ATOMIC_ACQUIRE) != nullptr);
+
+        uint64_t flags = spin_lock_irqsave(&wq->lock);
+        work_struct* work = wq->head;
+        if (work) {
+            wq->head = work->next;
+            if (!wq->head) wq->tail = nullptr;
+            // 开始执行前清除：工作函数里或执行期间可以再次排队
+            work->pending = false;
+        }
+        spin_unlock_irqrestore(&wq->lock, flags);
+        if (!work) continue;
+
+        uint64_t latency = clock_monotonic_ns() - work->queued_ns;
+        if (latency > wq->max_latency_ns) wq->max_latency_ns = latency;
+        work->func(work);
+
+        __atomic_add_fetch(&wq->done_seq, 1, __ATOMIC_RELEASE);
+        wake_up(&wq->flushed);
+    }
+}
+
+workqueue* workqueue_create(const char* name, int cpu) {
+    uint64_t flags = spin_lock_irqsave(&workqueues_lock);
+    workqueue* wq = nr_workqueues < MAX_WORKQUEUES ? &workqueues[nr_workqueues++] : nullptr;
+    spin_unlock_irqrestore(&workqueues_lock, flags);
+    if (!wq) {
+        pr_err("workqueue: no free slot for %s", name);
+        return nullptr;
+    }
+
+    strncpy(wq->name, name, THREAD_NAME_LEN - 1);
+    spin_lock_init(&wq->lock, "workqueue");
+    wait_queue_init(&wq->more_work, "wq_more_work");
+    wait_queue_init(&wq->flushed, "wq_flushed");
+    wq->head = wq->tail = nullptr;
+
+    char thread_name[THREAD_NAME_LEN];
+    snprintf(thread_name, sizeof(thread_name), "kworker/%s", name);
+    wq->worker = thread_create_on(cpu, thread_name, worker_thread, wq);
+    if (!wq->worker) {
+        // 槽位不回收：里面的锁已经登记过了
+        pr_err("workqueue: cannot start %s", thread_name);
+        return nullptr;
+    }
+    return wq;
+}
+
+bool queue_work(workqueue* wq, work_struct* work) {
+    if (!wq) return false;
+    uint64_t flags = spin_lock_irqsave(&wq->lock);
+    bool queued = !work->pending;
+    if (queued) {
+        work->pending = true;
+        work->next = nullptr;
+        work->queued_ns = clock_monotonic_ns();
+        if (wq->tail) {
+            wq->tail->next = work;
+        } else {
+            wq->head = work;
+        }
+        wq->tail = work;
+        wq->queued_seq++;
+    }
+    spin_unlock_irqrestore(&wq->lock, flags);
+    if (queued) wake_up(&wq->more_work);
+    return queued;
+}
+
+bool schedule_work(work_struct* work) {
+    return queue_work(system_wq, work);
+}
+
+void flush_workqueue(workqueue* wq) {
+    if (!wq) return;
+    uint64_t flags = spin_lock_irqsave(&wq->lock);
+    uint64_t target = wq->queued_seq;
+    spin_unlock_irqrestore(&wq->lock, flags);
+    // 单个工作线程按顺序执行，done_seq 追上时之前排队的都已完成
+    wait_event(wq->flushed, __atomic_load_n(&wq->done_seq, __ATOMIC_ACQUIRE) >= target);
+}
+
+void flush_scheduled_work() {
+    flush_workqueue(system_wq);
+}
+
+void workqueue_init() {
+    spin_lock_init(&workqueues_lock, "workqueues");
+    system_wq = workqueue_create("events", -1);
+}
+
+void workqueue_dump() {
+    tty_print("\nWorkqueue        queued       done  pending  max latency us\n", 0xFFFF00);
+    char line[96];
+    for (uint32_t i = 0; i < nr_workqueues; i++) {
+        workqueue* wq = &workqueues[i];
+        if (!wq->worker) continue;
+        uint64_t queued = wq->queued_seq;
+        uint64_t done = wq->done_seq;
+        snprintf(line, sizeof(line), "%-12s %10llu %10llu %8llu %15llu\n", wq->name,
+                 (unsigned long long)queued, (unsigned long long)done,
+                 (unsigned long long)(queued - done), (unsigned long long)(wq->max_latency_ns / 1000));
+        tty_print(line, 0xFFFFFF);
+    }
+}
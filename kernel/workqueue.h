@@ -0,0 +1,49 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// ==========================================================================
+// 工作队列
+// ==========================================================================
+// 需要睡眠、耗时较长或者要打印大量信息的延后工作放到工作队列里，由队列自己的
+// 内核线程按提交顺序执行。可以在任何上下文 (包括硬件中断) 里提交。
+//
+//   static work_struct link_work;
+//   work_init(&link_work, link_changed);    // 初始化一次
+//   schedule_work(&link_work);              // 中断里：交给系统工作队列
+
+struct work_struct;
+typedef void (*work_func_t)(work_struct* work);
+
+struct work_struct {
+    work_struct* next;
+    work_func_t func;
+    volatile bool pending;      // 已排队，尚未开始执行
+    uint64_t queued_ns;
+};
+
+#define work_entry(ptr, type, member) \
+    ((type*)((char*)(ptr) - offsetof(type, member)))
+
+struct workqueue;
+
+static inline void work_init(work_struct* work, work_func_t func) {
+    work->next = nullptr;
+    work->func = func;
+    work->pending = false;
+    work->queued_ns = 0;
+}
+
+// 创建系统工作队列 (需要调度器)
+void workqueue_init();
+// 新建一个带专用线程的工作队列；cpu 为 -1 时由调度器选择。队列不会被销毁
+workqueue* workqueue_create(const char* name, int cpu);
+// 排队；已经在排队时返回 false
+bool queue_work(workqueue* wq, work_struct* work);
+// 提交到系统工作队列 "events"
+bool schedule_work(work_struct* work);
+// 等待调用前已排队的工作全部执行完 (线程上下文，不能在本队列的工作里调用)
+void flush_workqueue(workqueue* wq);
+void flush_scheduled_work();
+
+void workqueue_dump();
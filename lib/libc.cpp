@@ -1,6 +1,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include "libc.h"
+#include "kernel/cpu/alternative.h"
 
 int toupper(int c) {
     if (c >= 'a' && c <= 'z') {
@@ -68,13 +69,28 @@ size_t strlen(const char *str) {
     return len;
 }
 
-void *memcpy(void *dest, const void *src, size_t n) {
-    uint8_t *pdest = (uint8_t *)dest;
-    const uint8_t *psrc = (const uint8_t *)src;
-    for (size_t i = 0; i < n; i++)
-        pdest[i] = psrc[i];
-    return dest;
-}
+// memcpy/memset 用字符串指令实现。默认先按 8 字节搬运，零头再按字节；CPU 报告
+// ERMS (rep movsb/stosb 对任意长度都快) 时，apply_alternatives 把入口处跳到 8 字节
+// 版本的 jmp 改写成 NOP，直接执行一条 rep movsb/stosb。改写之前两条路径都正确。
+asm(".pushsection .text\n"
+    ".globl memcpy\n"
+    ".type memcpy, @function\n"
+    "memcpy:\n\t"
+    "movq %rdi, %rax\n\t"
+    "movq %rdx, %rcx\n\t"
+    ALTERNATIVE("jmp .Lmemcpy_movsq", "", X86_FEATURE_ERMS)
+    "rep movsb\n\t"
+    "ret\n"
+    ".Lmemcpy_movsq:\n\t"
+    "shrq $3, %rcx\n\t"
+    "rep movsq\n\t"
+    "movl %edx, %ecx\n\t"
+    "andl $7, %ecx\n\t"
+    "rep movsb\n\t"
+    "ret\n"
+    ".size memcpy, .-memcpy\n"
+    ".popsection\n");
+
 void* memmove(void* dest, const void* src, size_t n) {
     unsigned char* pd = (unsigned char*)dest;
     const unsigned char* ps = (unsigned char*)src;
@@ -93,10 +109,143 @@ void* memmove(void* dest, const void* src, size_t n) {
     return dest;
 }
 
-void *memset(void *s, int c, size_t n) {
-    uint8_t *p = (uint8_t *)s;
-    for (size_t i = 0; i < n; i++) {
-        p[i] = (uint8_t)c;
+asm(".pushsection .text\n"
+    ".globl memset\n"
+    ".type memset, @function\n"
+    "memset:\n\t"
+    "movq %rdi, %r9\n\t"
+    "movzbl %sil, %eax\n\t"
+    "movq %rdx, %rcx\n\t"
+    ALTERNATIVE("jmp .Lmemset_stosq", "", X86_FEATURE_ERMS)
+    "rep stosb\n\t"
+    "movq %r9, %rax\n\t"
+    "ret\n"
+    ".Lmemset_stosq:\n\t"
+    "movabsq $0x0101010101010101, %r8\n\t"
+    "imulq %r8, %rax\n\t"
+    "shrq $3, %rcx\n\t"
+    "rep stosq\n\t"
+    "movl %edx, %ecx\n\t"
+    "andl $7, %ecx\n\t"
+    "rep stosb\n\t"
+    "movq %r9, %rax\n\t"
+    "ret\n"
+    ".size memset, .-memset\n"
+    ".popsection\n");
+
+//  格式化输出 
+// 向 buf 中追加一个字符，超出 size 的部分只计数不写入 (与标准 C 语义一致)
+static void fmt_putc(char *buf, size_t size, size_t *pos, char c) {
+    if (*pos + 1 < size)
+        buf[*pos] = c;
+    (*pos)++;
+}
+
+static void fmt_number(char *buf, size_t size, size_t *pos, uint64_t value, unsigned base,
+                       bool negative, bool upper, int width, bool left, bool zero_pad) {
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char tmp[24];
+    int len = 0;
+    do {
+        tmp[len++] = digits[value % base];
+        value /= base;
+    } while (value);
+    if (negative) width--;
+
+    int pad = width > len ? width - len : 0;
+    if (!left && !zero_pad)
+        while (pad-- > 0) fmt_putc(buf, size, pos, ' ');
+    if (negative) fmt_putc(buf, size, pos, '-');
+    if (!left && zero_pad)
+        while (pad-- > 0) fmt_putc(buf, size, pos, '0');
+    while (len > 0) fmt_putc(buf, size, pos, tmp[--len]);
+    if (left)
+        while (pad-- > 0) fmt_putc(buf, size, pos, ' ');
+}
+
+int vsnprintf(char *buf, size_t size, const char *fmt, va_list ap) {
+    size_t pos = 0;
+
+    for (; *fmt; fmt++) {
+        if (*fmt != '%') {
+            fmt_putc(buf, size, &pos, *fmt);
+            continue;
+        }
+        fmt++;
+
+        bool left = false, zero_pad = false;
+        for (;; fmt++) {
+            if (*fmt == '-') left = true;
+            else if (*fmt == '0') zero_pad = true;
+            else break;
+        }
+        int width = 0;
+        while (*fmt >= '0' && *fmt <= '9')
+            width = width * 10 + (*fmt++ - '0');
+
+        int longs = 0;
+        while (*fmt == 'l' || *fmt == 'z') {
+            longs++;
+            fmt++;
+        }
+
+        switch (*fmt) {
+        case 'd':
+        case 'i': {
+            int64_t v = longs ? va_arg(ap, int64_t) : va_arg(ap, int);
+            uint64_t mag = v < 0 ? (uint64_t)0 - (uint64_t)v : (uint64_t)v;
+            fmt_number(buf, size, &pos, mag, 10, v < 0, false, width, left, zero_pad);
+            break;
+        }
+        case 'u':
+        case 'x':
+        case 'X': {
+            uint64_t v = longs ? va_arg(ap, uint64_t) : va_arg(ap, unsigned int);
+            fmt_number(buf, size, &pos, v, *fmt == 'u' ? 10 : 16, false, *fmt == 'X',
+                       width, left, zero_pad);
+            break;
+        }
+        case 'p':
+            fmt_putc(buf, size, &pos, '0');
+            fmt_putc(buf, size, &pos, 'x');
+            fmt_number(buf, size, &pos, (uint64_t)va_arg(ap, void *), 16, false, false,
+                       width, left, zero_pad);
+            break;
+        case 's': {
+            const char *str = va_arg(ap, const char *);
+            if (!str) str = "(null)";
+            int len = (int)strlen(str);
+            int pad = width > len ? width - len : 0;
+            if (!left) while (pad-- > 0) fmt_putc(buf, size, &pos, ' ');
+            while (*str) fmt_putc(buf, size, &pos, *str++);
+            if (left) while (pad-- > 0) fmt_putc(buf, size, &pos, ' ');
+            break;
+        }
+        case 'c':
+            fmt_putc(buf, size, &pos, (char)va_arg(ap, int));
+            break;
+        case '%':
+            fmt_putc(buf, size, &pos, '%');
+            break;
+        case '\0':
+            fmt--; // 格式串以单个 '%' 结尾
+            break;
+        default:
+            fmt_putc(buf, size, &pos, '%');
+            fmt_putc(buf, size, &pos, *fmt);
+            break;
+        }
     }
-    return s;
+
+    if (size)
+        buf[pos < size ? pos : size - 1] = '\0';
+    return (int)pos;
+}
+
+int snprintf(char *buf, size_t size, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int ret = vsnprintf(buf, size, fmt, ap);
+    va_end(ap);
+    return ret;
 }
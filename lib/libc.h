@@ -1,6 +1,7 @@
 #pragma once
 #include <stddef.h> // size_t
 #include <stdint.h> // integer types
+#include <stdarg.h> // va_list
 
 #ifdef __cplusplus
 
@@ -17,11 +18,16 @@ extern "C" {
 
     size_t strlen(const char *str);
 
-    //  声明由 memcpy_asm.asm 实现的 memcpy ---
+    // memcpy/memset 在 libc.cpp 里用汇编实现，启动时按 CPU 特性选择 (见 alternative.h)
     void *memcpy(void *dest, const void *src, size_t n);
     void* memmove(void* dest, const void* src, size_t n);
     void *memset(void *s, int c, size_t n);
 
+    // 精简版格式化输出，支持 %d %i %u %x %X %p %s %c %%，
+    // 以及 '-'/'0' 标志、宽度和 l/ll/z 长度修饰符
+    int vsnprintf(char *buf, size_t size, const char *fmt, va_list ap);
+    int snprintf(char *buf, size_t size, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
     #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,194 @@
+#include "rbtree.h"
+
+// 把 node 的位置换成 child (child 可以为空)
+static void rb_replace_child(rb_node* node, rb_node* child, rb_root* root) {
+    rb_node* parent = node->parent;
+    if (!parent) {
+        root->node = child;
+    } else if (parent->left == node) {
+        parent->left = child;
+    } else {
+        parent->right = child;
+    }
+    if (child) child->parent = parent;
+}
+
+static void rb_rotate_left(rb_node* x, rb_root* root) {
+    rb_node* y = x->right;
+    x->right = y->left;
+    if (y->left) y->left->parent = x;
+    rb_replace_child(x, y, root);
+    y->left = x;
+    x->parent = y;
+}
+
+static void rb_rotate_right(rb_node* x, rb_root* root) {
+    rb_node* y = x->left;
+    x->left = y->right;
+    if (y->right) y->right->parent = x;
+    rb_replace_child(x, y, root);
+    y->right = x;
+    x->parent = y;
+}
+
+static inline bool rb_is_red(const rb_node* node) {
+    return node && node->color == RB_RED;
+}
+
+void rb_insert_color(rb_node* node, rb_root* root) {
+    rb_node* parent;
+    while ((parent = node->parent) && parent->color == RB_RED) {
+        // 父节点是红色，它一定不是根，祖父存在
+        rb_node* gparent = parent->parent;
+        if (parent == gparent->left) {
+            rb_node* uncle = gparent->right;
+            if (rb_is_red(uncle)) {
+                // 叔节点也是红色：父、叔变黑，祖父变红，问题上移两层
+                parent->color = RB_BLACK;
+                uncle->color = RB_BLACK;
+                gparent->color = RB_RED;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->right) {
+                rb_rotate_left(parent, root);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->color = RB_BLACK;
+            gparent->color = RB_RED;
+            rb_rotate_right(gparent, root);
+        } else {
+            rb_node* uncle = gparent->left;
+            if (rb_is_red(uncle)) {
+                parent->color = RB_BLACK;
+                uncle->color = RB_BLACK;
+                gparent->color = RB_RED;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->left) {
+                rb_rotate_right(parent, root);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->color = RB_BLACK;
+            gparent->color = RB_RED;
+            rb_rotate_left(gparent, root);
+        }
+    }
+    root->node->color = RB_BLACK;
+}
+
+// 删除黑色节点后，从 node (可能为空) 所在位置开始补回少掉的一个黑色
+static void rb_erase_color(rb_node* node, rb_node* parent, rb_root* root) {
+    while (node != root->node && !rb_is_red(node)) {
+        if (node == parent->left) {
+            rb_node* sibling = parent->right;
+            if (rb_is_red(sibling)) {
+                sibling->color = RB_BLACK;
+                parent->color = RB_RED;
+                rb_rotate_left(parent, root);
+                sibling = parent->right;
+            }
+            if (!rb_is_red(sibling->left) && !rb_is_red(sibling->right)) {
+                sibling->color = RB_RED;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+            if (!rb_is_red(sibling->right)) {
+                sibling->left->color = RB_BLACK;
+                sibling->color = RB_RED;
+                rb_rotate_right(sibling, root);
+                sibling = parent->right;
+            }
+            sibling->color = parent->color;
+            parent->color = RB_BLACK;
+            sibling->right->color = RB_BLACK;
+            rb_rotate_left(parent, root);
+            node = root->node;
+            break;
+        } else {
+            rb_node* sibling = parent->left;
+            if (rb_is_red(sibling)) {
+                sibling->color = RB_BLACK;
+                parent->color = RB_RED;
+                rb_rotate_right(parent, root);
+                sibling = parent->left;
+            }
+            if (!rb_is_red(sibling->left) && !rb_is_red(sibling->right)) {
+                sibling->color = RB_RED;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+            if (!rb_is_red(sibling->left)) {
+                sibling->right->color = RB_BLACK;
+                sibling->color = RB_RED;
+                rb_rotate_left(sibling, root);
+                sibling = parent->left;
+            }
+            sibling->color = parent->color;
+            parent->color = RB_BLACK;
+            sibling->left->color = RB_BLACK;
+            rb_rotate_right(parent, root);
+            node = root->node;
+            break;
+        }
+    }
+    if (node) node->color = RB_BLACK;
+}
+
+void rb_erase(rb_node* node, rb_root* root) {
+    rb_node* child;
+    rb_node* parent;
+    rb_color color;
+
+    if (!node->left || !node->right) {
+        child = node->left ? node->left : node->right;
+        parent = node->parent;
+        color = node->color;
+        rb_replace_child(node, child, root);
+    } else {
+        // 两个子节点：用后继 (右子树的最小节点) 顶替 node 的位置和颜色
+        rb_node* succ = node->right;
+        while (succ->left) succ = succ->left;
+        child = succ->right;
+        color = succ->color;
+        if (succ->parent == node) {
+            parent = succ;
+        } else {
+            parent = succ->parent;
+            parent->left = child;
+            if (child) child->parent = parent;
+            succ->right = node->right;
+            node->right->parent = succ;
+        }
+        succ->left = node->left;
+        node->left->parent = succ;
+        succ->color = node->color;
+        rb_replace_child(node, succ, root);
+    }
+
+    if (color == RB_BLACK) rb_erase_color(child, parent, root);
+}
+
+rb_node* rb_first(const rb_root* root) {
+    rb_node* n = root->node;
+    if (!n) return nullptr;
+    while (n->left) n = n->left;
+    return n;
+}
+
+rb_node* rb_next(const rb_node* node) {
+    if (node->right) {
+        node = node->right;
+        while (node->left) node = node->left;
+        return (rb_node*)node;
+    }
+    // 没有右子树：向上找第一个从左边上来的祖先
+    rb_node* parent;
+    while ((parent = node->parent) && node == parent->right) node = parent;
+    return parent;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// ==========================================================================
+// 侵入式红黑树
+// ==========================================================================
+// 节点嵌在宿主结构里，树本身不分配内存，也不知道键是什么：调用者自己从根往下
+// 比较找到插入位置，用 rb_link_node 挂上，再调用 rb_insert_color 重新平衡。
+//   rb_node** link = &root->node; rb_node* parent = nullptr;
+//   while (*link) { parent = *link; link = key < KEY(parent) ? &parent->left : &parent->right; }
+//   rb_link_node(&obj->node, parent, link);
+//   rb_insert_color(&obj->node, root);
+// rb_root_cached 另外缓存最左节点，取最小值是 O(1)。
+
+enum rb_color : uint8_t {
+    RB_RED,
+    RB_BLACK,
+};
+
+struct rb_node {
+    rb_node* parent;
+    rb_node* left;
+    rb_node* right;
+    rb_color color;
+};
+
+struct rb_root {
+    rb_node* node;
+};
+
+struct rb_root_cached {
+    rb_root root;
+    rb_node* leftmost;
+};
+
+#define rb_entry(ptr, type, member) \
+    ((type*)((char*)(ptr) - offsetof(type, member)))
+
+static inline void rb_link_node(rb_node* node, rb_node* parent, rb_node** link) {
+    node->parent = parent;
+    node->left = node->right = nullptr;
+    node->color = RB_RED;
+    *link = node;
+}
+
+void rb_insert_color(rb_node* node, rb_root* root);
+void rb_erase(rb_node* node, rb_root* root);
+
+rb_node* rb_first(const rb_root* root);
+rb_node* rb_next(const rb_node* node);
+
+// leftmost 为 true 表示插入时一路向左走 (新节点是最小的)
+static inline void rb_insert_color_cached(rb_node* node, rb_root_cached* root, bool leftmost) {
+    if (leftmost) root->leftmost = node;
+    rb_insert_color(node, &root->root);
+}
+
+static inline void rb_erase_cached(rb_node* node, rb_root_cached* root) {
+    if (root->leftmost == node) root->leftmost = rb_next(node);
+    rb_erase(node, &root->root);
+}
+
+static inline rb_node* rb_first_cached(const rb_root_cached* root) {
+    return root->leftmost;
+}
@@ -0,0 +1,35 @@
+#!/bin/sh
+# 从 nm 的输出生成内核符号表 (NASM 源码)，只收录代码段里的函数符号：
+#   x86_64-elf-nm -n -C --defined-only kernel.elf | sh tools/gen_ksyms.sh > ksyms.asm
+# 没有输入时生成空表，供第一次链接使用。
+# 表的布局见 kernel/ksyms.cpp：按地址升序的地址数组、名字偏移数组和名字串。
+LC_ALL=C awk '
+BEGIN { n = 0 }
+$2 ~ /^[tTwW]$/ {
+    addr = $1
+    name = $0
+    sub(/^[0-9a-fA-F]+ [tTwW] /, "", name)
+    # 去掉 C++ 的参数列表，只留函数名 (火焰图里更短、更好读)
+    sub(/\([^()]*\)( const)?$/, "", name)
+    if (name ~ /"/ || name == "") next
+    addrs[n] = addr
+    names[n] = name
+    n++
+}
+END {
+    print "; 由 tools/gen_ksyms.sh 生成，不要手工修改"
+    print "section .ksyms progbits alloc noexec nowrite align=8"
+    print "global __ksym_count, __ksym_addrs, __ksym_offsets, __ksym_names"
+    print "__ksym_count: dq " n
+    print "__ksym_addrs:"
+    for (i = 0; i < n; i++) print "    dq 0x" addrs[i]
+    print "__ksym_offsets:"
+    off = 0
+    for (i = 0; i < n; i++) {
+        print "    dd " off
+        off += length(names[i]) + 1
+    }
+    print "__ksym_names:"
+    for (i = 0; i < n; i++) print "    db \"" names[i] "\", 0"
+    print "    db 0"
+}'